@@ -15,12 +15,35 @@ public class UETensorVoxLibrary : ModuleRules
 
 		if (Target.Platform == UnrealTargetPlatform.Win64)
 		{
-			PublicAdditionalLibraries.Add(Path.Combine(PluginDirectory, "Binaries", "ThirdParty", "Win64", "libdeepspeech.so.if.lib"));
-			RuntimeDependencies.Add(Path.Combine(PluginDirectory, "Binaries", "ThirdParty", "Win64", "libdeepspeech.so"));
+			string LibraryDirectory = Path.Combine(PluginDirectory, "Binaries", "ThirdParty", "Win64");
+			PublicAdditionalLibraries.Add(Path.Combine(LibraryDirectory, "libdeepspeech.so.if.lib"));
+			RuntimeDependencies.Add(Path.Combine(LibraryDirectory, "libdeepspeech.so"));
+
+			// Builds for other instruction sets export the same functions, the module picks one for the CPU before anything is called.
+			foreach (string Variant in new string[] { "avx512", "avx2", "sse4.1" })
+			{
+				string VariantLibrary = Path.Combine(LibraryDirectory, Variant, "libdeepspeech.so");
+				if (File.Exists(VariantLibrary))
+				{
+					RuntimeDependencies.Add(VariantLibrary);
+				}
+			}
 		}
 		else if (Target.Platform == UnrealTargetPlatform.Linux && Target.Architecture.bIsX64)
 		{
-			RuntimeDependencies.Add(Path.Combine(PluginDirectory, "Binaries", "ThirdParty", "Linux64", "libdeepspeech.so"));
+			// Not linked against: the module binds the DS_ functions to the build it picks for the CPU itself, so the dynamic loader
+			// can't pick one of its own first. See DeepSpeechLibrary.h.
+			string LibraryDirectory = Path.Combine(PluginDirectory, "Binaries", "ThirdParty", "Linux64");
+			RuntimeDependencies.Add(Path.Combine(LibraryDirectory, "libdeepspeech.so"));
+
+			foreach (string Variant in new string[] { "avx512", "avx2", "sse4.1" })
+			{
+				string VariantLibrary = Path.Combine(LibraryDirectory, Variant, "libdeepspeech.so");
+				if (File.Exists(VariantLibrary))
+				{
+					RuntimeDependencies.Add(VariantLibrary);
+				}
+			}
 		}
 		else if (Target.IsInPlatformGroup(UnrealPlatformGroup.Apple))
 		{
@@ -2,283 +2,113 @@
 #include "HAL/ThreadManager.h"
 
 #include "UETensorVox.h"
-#if TENSORVOX_VALID_PLATFORM
-#include "DeepSpeechMicrophoneRecorder.h"
-#include "WebRtcCommonAudioIncludes.h"
-#include "deepspeech.h"
-#endif
+#include "DeepSpeechSessionManager.h"
+#include "DeepSpeechStats.h"
 
 UAudioTranscriberComponent::UAudioTranscriberComponent(const FObjectInitializer& ObjectInitializer) : Super(ObjectInitializer)
 {
 	PrimaryComponentTick.bCanEverTick = true;
-	PrimaryComponentTick.TickInterval = 1.0f / 5.0f;
+	// Results are delivered from the tick, so every frame.
+	PrimaryComponentTick.TickInterval = 0.0f;
 	bAutoActivate = false;
 	ModelSampleRate = INDEX_NONE;
 	RuntimeSampleRate = INDEX_NONE;
 }
 
-FThreadSafeBool GTranscriberQueueRunning;
-FThreadSafeBool GTranscribeRequested;
-FEvent* GTranscribeQueueNotify = FPlatformProcess::GetSynchEventFromPool();
-
-void UAudioTranscriberComponent::CreateTranscriptionThread(UAudioTranscriberComponent* TranscriberComponent)
+void UAudioTranscriberComponent::CreateTranscriptionSession()
 {
 #if TENSORVOX_VALID_PLATFORM
-	if (FUETensorVoxModule::CanRunTranscriber() && TranscriberComponent && TranscriberComponent->CanLoadModel() && !GTranscriberQueueRunning)
+	if (!TranscriptionSession && CanLoadModel())
 	{
-		GTranscriberQueueRunning = true;
-		AsyncThread([TranscriberComponent, Config = TranscriberComponent->SpeechConfiguration]()
+		// The workers only ever touch the mailbox, never the component, so nothing has to be queued to the game thread per result.
+		ResultMailbox = MakeShared<FDeepSpeechResultMailbox, ESPMode::ThreadSafe>();
+		FDeepSpeechResultMailboxPtr Mailbox = ResultMailbox;
+
+		// Results are only decoded with metadata for listeners who want them, they're handed over by reference. The results carry their
+		// text, so they're posted instead of the plain transcriptions.
+		const bool bWithMetadata = OnTranscriptionResult.IsBound();
+		FOnDeepSpeechResult OnResult;
+		if (bWithMetadata)
 		{
-			const FString& ModelFullPath = FPaths::ProjectContentDir() + Config.ModelPath;
-			const FString& ScorerFullPath = FPaths::ProjectContentDir() + Config.ScorerPath;
-
-			TArray<TFuture<void>> DispatchedFuturesVoid;
-
-			ModelState* Model;
-			if (CheckForError(TEXT("Model"), DS_CreateModel(TCHAR_TO_UTF8(*ModelFullPath), &Model)))
+			OnResult.BindLambda([Mailbox](const FDeepSpeechResultPtr& Result)
 			{
-				return;
-			}
-
-			if (!Config.ScorerPath.IsEmpty())
-			{
-				if (CheckForError(TEXT("EnableExternalScorer"), DS_EnableExternalScorer(Model, TCHAR_TO_UTF8(*ScorerFullPath))))
+				if (Result->IsFinal())
 				{
-					DS_FreeModel(Model);
-					return;
+					Mailbox->PostFinal(FString(Result->GetBestText()), Result->Timings, Result);
 				}
-
-				if (Config.ModelAlphaBeta.X != INDEX_NONE || Config.ModelAlphaBeta.Y != INDEX_NONE)
+				else
 				{
-					if (CheckForError(TEXT("SetAlphaBeta"), DS_SetScorerAlphaBeta(Model, Config.ModelAlphaBeta.X, Config.ModelAlphaBeta.Y)))
-					{
-						DS_FreeModel(Model);
-						return;
-					}
+					Mailbox->PostPartial(FString(Result->GetBestText()), Result->Timings, Result);
 				}
-			}
+			});
+		}
 
-			if (Config.BeamWidth != 0)
+		TranscriptionSession = FDeepSpeechSessionManager::Get().OpenSession(SpeechConfiguration, FOnDeepSpeechTranscribed::CreateLambda(
+			[Mailbox, bWithMetadata, Native = OnAudioTranscribedNative](const FString& Transcription, bool bFinal, const FDeepSpeechUtteranceTimings& Timings)
 			{
-				if (CheckForError(TEXT("SetModelBeamWidth"), DS_SetModelBeamWidth(Model, Config.BeamWidth)))
+				Native.Broadcast(Transcription, bFinal, Timings);
+				if (bWithMetadata)
 				{
-					DS_FreeModel(Model);
 					return;
 				}
-			}
-
-	
-			const float GarbageFeedStart = 0.3f, GarbageFeedEnd = 0.1f;
-			
-			// We use VAD to determine what silence is and we just fill a buffer with the largest amount of garbage we need.
-			const int32 SampleRate = 16000;
-			const int32 SilenceTargetSamples = FMath::Max(GarbageFeedEnd, GarbageFeedStart) * (float)SampleRate;
-			TAlignedSignedInt16Array Silence;
-			Silence.Reserve(SilenceTargetSamples);
-			
-			UE_LOG(LogUETensorVox, Warning, TEXT("Started transcription worker. Model (alpha, beta): %s"), *Config.ModelAlphaBeta.ToString());
-			{
-				FDeepSpeechMicrophoneRecorder Recorder;
-				TAlignedSignedInt16Array RecordedSamples;
-				TFuture<FString> IntermediateTranscriptionResult;
-				bool bLastRequestTranscribe = false;
-
-				// VAD Aggressiveness mode (0, 1, 2, or 3).
-				const int32 VadAggressivenes = 0;
-
-#if WITH_WEBRTC
-				// Create a WebRTC vad to determine voice level. 
-				VadInst* VadInstance = WebRtcVad_Create();
-				WebRtcVad_Init(VadInstance);				
-				WebRtcVad_set_mode(VadInstance, VadAggressivenes);
-#endif
-
-				StreamingState* StreamState = nullptr;				
-				while (GTranscriberQueueRunning)
+				if (bFinal)
 				{
-					bool bFeedVoiceData = false;
-					while (Recorder.RawRecordingBlocks.Peek())
-					{
-						const FDeinterleavedAudio& Audio = *Recorder.RawRecordingBlocks.Peek();
-						if (Audio.PCMData.Num() > 0)
-						{
-							bool bVoiceDetected = true;
-
-#if WITH_WEBRTC
-							const int32 VoiceStatus = WebRtcVad_Process(VadInstance, Recorder.RecordingSampleRate, Audio.PCMData.GetData(),
-							                                            Audio.PCMData.Num());
-							bVoiceDetected = VoiceStatus == 1 || VoiceStatus == -1;
-#endif
-							// Let audio data in if the vad has detected a voice level, or if it errors out due to a special mic or something.
-
-							if (bVoiceDetected)
-							{
-								RecordedSamples.Append(Audio.PCMData);
-								if(StreamState)
-								{
-									DS_FeedAudioContent(StreamState, Audio.PCMData.GetData(), Audio.PCMData.Num());
-									bFeedVoiceData = true;
-								}
-							} else if(Silence.Num() != SilenceTargetSamples)
-							{
-								// Fill silence buffer
-								const int32 SamplesToAdd = FMath::Min(Audio.PCMData.Num(), SilenceTargetSamples - Silence.Num());
-								if (SamplesToAdd > 0)
-								{
-									Silence.Append(Audio.PCMData.GetData(), SamplesToAdd);
-								}
-							}
-						}
-						Recorder.RawRecordingBlocks.Pop();
-					}
-
-					if (StreamState && bFeedVoiceData)
-					{
-						char* IntermediateResult = DS_IntermediateDecode(StreamState);
-						if (IntermediateResult)
-						{
-							FString IntermediateTranscribe = FString(IntermediateResult);
-							DS_FreeString(IntermediateResult);
-							if (!IntermediateTranscribe.IsEmpty())
-							{
-								AsyncTask(ENamedThreads::GameThread, [TranscriberComponent, IntermediateTranscribe]()
-								{
-									if (IsValid(TranscriberComponent))
-									{
-										TranscriberComponent->PushTranscribeResult(IntermediateTranscribe);
-									}
-								});
-							}
-						}
-					}
-					
-
-					// Handle transcriptions state.
-					if (bLastRequestTranscribe != GTranscribeRequested)
-					{
-						if (GTranscribeRequested)
-						{
-							// Start recording
-							RecordedSamples.Empty();
-							
-							// WebRTC vad supports frame lengths of 320 and 480 at a 16000 sample rate.
-							GTranscribeRequested = Recorder.StartRecording(SampleRate, 480);
-							if(GTranscribeRequested)
-							{
-								if(!CheckForError(TEXT("StreamingState Init"), DS_CreateStream(Model, &StreamState)))
-								{
-									if (GarbageFeedStart > 0.0f)
-									{
-                                        TAlignedSignedInt16Array Garbage;
-										if(Silence.Num() == SilenceTargetSamples)
-										{
-											Garbage = TAlignedSignedInt16Array(Silence, (float)Silence.Num() * GarbageFeedStart);
-										} else
-										{
-											Garbage.SetNumZeroed(FMath::TruncToInt((float)SampleRate * GarbageFeedStart));												
-										}
-										
-                                        DS_FeedAudioContent(StreamState, Garbage.GetData(), Garbage.Num());
-                                    }
-								}
-							}
-						}
-						else
-						{
-							if (StreamState)
-							{
-								DispatchedFuturesVoid.Emplace(AsyncThread(
-									[=]()
-								{
-									if (Model)
-									{
-										if (GarbageFeedEnd > 0.0f)
-										{
-											TAlignedSignedInt16Array Garbage;
-											if (Silence.Num() == SilenceTargetSamples)
-											{
-												Garbage = TAlignedSignedInt16Array(Silence, (float)Silence.Num() * GarbageFeedEnd);
-												UE_LOG(LogUETensorVox, Warning, TEXT("Used filled silence buffer"));
-											}
-											else
-											{
-												Garbage.SetNumZeroed(FMath::TruncToInt((float)SampleRate * GarbageFeedEnd));
-											}
-										}
-
-										
-										UE_LOG(LogUETensorVox, Warning, TEXT("Fed garbage"));
-										char* TranscriptionChar = DS_FinishStream(StreamState);
-										if (TranscriptionChar)
-										{
-											const FString& Word = FString(TranscriptionChar);
-											if (!Word.IsEmpty())
-											{
-												// Check if game thread is up
-												if (!IsEngineExitRequested())
-												{
-													AsyncTask(ENamedThreads::GameThread, [TranscriberComponent, Word]()
-													{
-														if (IsValid(TranscriberComponent))
-														{
-															TranscriberComponent->PushTranscribeResult(Word, true);
-														}
-													});
-												} 
-											}
-
-											DS_FreeString(TranscriptionChar);
-										}
-									}
-								}, 0, EThreadPriority::TPri_Normal));
-								
-								StreamState = nullptr;
-							}
-							
-							// Finish recording
-							Recorder.StopRecording();
-#if 0
-							AsyncTask(ENamedThreads::GameThread, [=, SampleRate = Recorder.RecordingSampleRate]()
-							{
-								FDeepSpeechMicrophoneRecorder::SaveAsWavMono(RecordedSamples, TEXT("/Game/TranscriberAudio/"), FString::Printf(TEXT("TranscriberAudioVAD%i"), VadAggressivenes), SampleRate);
-							});
-#endif
-						}
-						bLastRequestTranscribe = GTranscribeRequested;
-					}
-					GTranscribeQueueNotify->Wait(FMath::TruncToInt(Config.AsyncTickTranscriptionInterval * 1000.0f));
+					Mailbox->PostFinal(Transcription, Timings);
 				}
-#if WITH_WEBRTC
-				// Clean up WebRTC.
-				WebRtcVad_Free(VadInstance);
-#endif WITH_WEBRTC
-
-				// The futures use the model, so we can't clean it up until they are done. 
-				for (const TFuture<void>& Dispatch : DispatchedFuturesVoid)
+				else
 				{
-					Dispatch.Wait();
+					Mailbox->PostPartial(Transcription, Timings);
 				}
-
-				DS_FreeModel(Model);
-				Model = nullptr;
-			}
-			UE_LOG(LogUETensorVox, Warning, TEXT("Stopped transcription worker."));
-		}, 0, EThreadPriority::TPri_Normal);
+			}), nullptr, MoveTemp(OnResult));
+		bHotWordsDirty = HotWords.Num() > 0;
+		bCommandsDirty = PhrasesToCommands.Num() > 0;
 	}
 #endif
 }
 
-void UAudioTranscriberComponent::DestroyTranscriptionThread(UAudioTranscriberComponent* TranscriberComponent)
+void UAudioTranscriberComponent::DestroyTranscriptionSession()
 {
 #if TENSORVOX_VALID_PLATFORM
-	if (TranscriberComponent && TranscriberComponent->CanLoadModel())
+	if (TranscriptionSession)
 	{
-		GTranscriberQueueRunning = false;
-		NotifyTranscriptionThread();
+		FDeepSpeechSessionManager::Get().CloseSession(TranscriptionSession);
+		TranscriptionSession.Reset();
+		ResultMailbox.Reset();
 	}
 #endif
 }
 
+void UAudioTranscriberComponent::DeliverResults()
+{
+	if (!ResultMailbox)
+	{
+		return;
+	}
+
+	TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxBroadcast);
+	// Commands were heard before the results of their utterance were in.
+	ResultMailbox->DrainCommands([this](const FDeepSpeechCommandMatch& Match)
+	{
+		OnCommand.Broadcast(Match);
+	});
+	ResultMailbox->Drain([this](FDeepSpeechMailboxEntry& Entry)
+	{
+		if (Entry.Result)
+		{
+			OnTranscriptionResult.Broadcast(Entry.Result);
+		}
+		if (!Entry.Text.IsEmpty())
+		{
+			PushTranscribeResult(Entry.Text, Entry.bFinal, Entry.Timings.UtteranceId);
+		}
+		if (Entry.bFinal)
+		{
+			Entry.Timings.MarkDelivered(FPlatformTime::Seconds());
+			PushUtteranceTimings(Entry.Timings);
+		}
+	});
+}
+
 void UAudioTranscriberComponent::BeginPlay()
 {
 	Super::BeginPlay();
@@ -287,9 +117,10 @@ void UAudioTranscriberComponent::BeginPlay()
 void UAudioTranscriberComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
-#if TENSORVOX_VALID_PLATFORM
-	CreateTranscriptionThread(this);
-#endif
+	CreateTranscriptionSession();
+	PushHotWords();
+	PushCommands();
+	DeliverResults();
 }
 
 void UAudioTranscriberComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
@@ -298,47 +129,112 @@ void UAudioTranscriberComponent::EndPlay(const EEndPlayReason::Type EndPlayReaso
 	if (CanLoadModel())
 	{
 		EndRealtimeTranscription();
-		DestroyTranscriptionThread(this);
+		DestroyTranscriptionSession();
 	}
 #endif
 
 	Super::EndPlay(EndPlayReason);
 }
 
-void UAudioTranscriberComponent::PushTranscribeResult(const FString& InTrancribedResult, bool bFinal)
+void UAudioTranscriberComponent::PushTranscribeResult(const FString& InTrancribedResult, bool bFinal, int32 TranscriptionId)
 {
 	TranscribedResult = InTrancribedResult;
-	OnAudioTranscribed.Broadcast(InTrancribedResult, bFinal, 0);
+	OnAudioTranscribed.Broadcast(InTrancribedResult, bFinal, TranscriptionId);
 }
 
-void UAudioTranscriberComponent::StartRealtimeTranscription()
+void UAudioTranscriberComponent::PushUtteranceTimings(const FDeepSpeechUtteranceTimings& Timings)
+{
+	LastUtteranceTimings = Timings;
+	UE_LOG(LogUETensorVox, Verbose, TEXT("Utterance of %.2fs: capture to feed avg %.1f ms, feed %.1f ms, decode %.1f ms, endpoint %.1f ms, finish queue %.1f ms, finish %.1f ms, game thread %.1f ms, end to final %.1f ms, RTF %.2f."),
+	       Timings.AudioSeconds, Timings.QueueWaitAverageMs, Timings.FeedMs, Timings.DecodeMs, Timings.EndpointMs, Timings.FinishQueueMs, Timings.FinishMs,
+	       Timings.DeliveryMs, Timings.EndToFinalMs, Timings.RealTimeFactor);
+	OnUtteranceTimings.Broadcast(Timings);
+}
+
+void UAudioTranscriberComponent::SetHotWords(const TMap<FString, float>& InHotWords)
+{
+	HotWords = InHotWords;
+	bHotWordsDirty = true;
+}
+
+void UAudioTranscriberComponent::AddHotWord(const FString& Word, float Boost)
+{
+	HotWords.Add(Word, Boost);
+	bHotWordsDirty = true;
+}
+
+void UAudioTranscriberComponent::RemoveHotWord(const FString& Word)
+{
+	bHotWordsDirty |= HotWords.Remove(Word) > 0;
+}
+
+void UAudioTranscriberComponent::ClearHotWords()
+{
+	bHotWordsDirty |= HotWords.Num() > 0;
+	HotWords.Reset();
+}
+
+void UAudioTranscriberComponent::PushHotWords()
 {
 #if TENSORVOX_VALID_PLATFORM
-	if (CanLoadModel())
+	if (bHotWordsDirty && TranscriptionSession)
 	{
-		GTranscribeRequested = true;
-		NotifyTranscriptionThread();
+		TranscriptionSession->SetHotWords(HotWords);
+		bHotWordsDirty = false;
 	}
 #endif
 }
 
-void UAudioTranscriberComponent::EndRealtimeTranscription()
+void UAudioTranscriberComponent::SetCommands(const TMap<FString, FName>& InPhrasesToCommands)
+{
+	PhrasesToCommands = InPhrasesToCommands;
+	bCommandsDirty = true;
+}
+
+void UAudioTranscriberComponent::PushCommands()
 {
 #if TENSORVOX_VALID_PLATFORM
-	if (CanLoadModel())
+	if (bCommandsDirty && TranscriptionSession)
 	{
-		GTranscribeRequested = false;
-		NotifyTranscriptionThread();
+		if (PhrasesToCommands.Num() > 0)
+		{
+			FDeepSpeechResultMailboxPtr Mailbox = ResultMailbox;
+			TranscriptionSession->SetCommands(FDeepSpeechCommandGrammar::Compile(PhrasesToCommands), FOnDeepSpeechCommand::CreateLambda(
+				[Mailbox](const FDeepSpeechCommandMatch& Match)
+				{
+					Mailbox->PostCommand(Match);
+				}));
+		}
+		else
+		{
+			TranscriptionSession->SetCommands(nullptr, FOnDeepSpeechCommand());
+		}
+		bCommandsDirty = false;
 	}
 #endif
 }
 
-void UAudioTranscriberComponent::NotifyTranscriptionThread()
+void UAudioTranscriberComponent::StartRealtimeTranscription()
 {
-	if (GTranscribeQueueNotify)
+#if TENSORVOX_VALID_PLATFORM
+	CreateTranscriptionSession();
+	PushHotWords();
+	PushCommands();
+	if (TranscriptionSession)
 	{
-		GTranscribeQueueNotify->Trigger();
+		TranscriptionSession->SetTranscriptionRequested(true);
 	}
+#endif
+}
+
+void UAudioTranscriberComponent::EndRealtimeTranscription()
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (TranscriptionSession)
+	{
+		TranscriptionSession->SetTranscriptionRequested(false);
+	}
+#endif
 }
 
 bool UAudioTranscriberComponent::CanLoadModel()
@@ -351,15 +247,5 @@ bool UAudioTranscriberComponent::CanLoadModel()
 
 bool UAudioTranscriberComponent::CheckForError(const FString& Name, int32 Error)
 {
-#if TENSORVOX_VALID_PLATFORM
-	if (Error != 0)
-	{
-		char* Buffer = DS_ErrorCodeToErrorMessage(Error);
-		const FString& ErrorString = FString(Buffer);
-		UE_LOG(LogUETensorVox, Error, TEXT("%s DeepSpeech Error: %s"), *Name, *ErrorString);
-		DS_FreeString(Buffer);
-		return true;
-	}
-#endif
-	return false;
+	return FDeepSpeechModel::CheckForError(Name, Error);
 }
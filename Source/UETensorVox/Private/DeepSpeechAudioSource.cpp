@@ -0,0 +1,397 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechAudioSource.h"
+#include "DeepSpeechRtAudioSource.h"
+#include "Audio.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UETensorVox.h"
+
+static FString GTensorVoxAudioSource;
+static FAutoConsoleVariableRef CVarTensorVoxAudioSource(
+	TEXT("TensorVox.AudioSource"),
+	GTensorVoxAudioSource,
+	TEXT("What new sessions record from: empty or Capture for the microphone, Synthetic for generated speech like audio, or the path of a WAV/raw PCM file."),
+	ECVF_Default);
+
+static float GTensorVoxAudioSourceSpeed = 1.0f;
+static FAutoConsoleVariableRef CVarTensorVoxAudioSourceSpeed(
+	TEXT("TensorVox.AudioSource.Speed"),
+	GTensorVoxAudioSourceSpeed,
+	TEXT("Playback speed of file and synthetic sources, 1 is real time and 0 as fast as the session takes it."),
+	ECVF_Default);
+
+static float GTensorVoxAudioSourceJitterMs = 0.0f;
+static FAutoConsoleVariableRef CVarTensorVoxAudioSourceJitterMs(
+	TEXT("TensorVox.AudioSource.JitterMs"),
+	GTensorVoxAudioSourceJitterMs,
+	TEXT("Most a file or synthetic block is delivered late by."),
+	ECVF_Default);
+
+static float GTensorVoxAudioSourceBlockVariation = 0.0f;
+static FAutoConsoleVariableRef CVarTensorVoxAudioSourceBlockVariation(
+	TEXT("TensorVox.AudioSource.BlockVariation"),
+	GTensorVoxAudioSourceBlockVariation,
+	TEXT("File and synthetic blocks vary in size by up to this fraction."),
+	ECVF_Default);
+
+static int32 GTensorVoxAudioSourceSeed = 0;
+static FAutoConsoleVariableRef CVarTensorVoxAudioSourceSeed(
+	TEXT("TensorVox.AudioSource.Seed"),
+	GTensorVoxAudioSourceSeed,
+	TEXT("Seed of the jitter, block sizes and synthetic audio."),
+	ECVF_Default);
+
+static bool GTensorVoxAudioSourceLoop = true;
+static FAutoConsoleVariableRef CVarTensorVoxAudioSourceLoop(
+	TEXT("TensorVox.AudioSource.Loop"),
+	GTensorVoxAudioSourceLoop,
+	TEXT("Restart file sources once they end."),
+	ECVF_Default);
+
+static int32 GTensorVoxInputChannel = INDEX_NONE;
+static FAutoConsoleVariableRef CVarTensorVoxInputChannel(
+	TEXT("TensorVox.Input.Channel"),
+	GTensorVoxInputChannel,
+	TEXT("Capture device channel to transcribe, like the mic input of a multi channel interface. -1 averages all of them. Applies when recording starts."),
+	ECVF_Default);
+
+static float GTensorVoxInputGainDb = 0.0f;
+static FAutoConsoleVariableRef CVarTensorVoxInputGainDb(
+	TEXT("TensorVox.Input.GainDb"),
+	GTensorVoxInputGainDb,
+	TEXT("Gain applied to the captured audio before it's transcribed, in dB."),
+	ECVF_Default);
+
+static bool GTensorVoxInputRemoveDC = true;
+static FAutoConsoleVariableRef CVarTensorVoxInputRemoveDC(
+	TEXT("TensorVox.Input.RemoveDC"),
+	GTensorVoxInputRemoveDC,
+	TEXT("Remove any DC offset from the captured audio."),
+	ECVF_Default);
+
+// Longest the pacing thread sleeps at once, so Stop doesn't wait on a long block.
+static const float MaxPacingSleepSeconds = 0.005f;
+
+FDeepSpeechPacedAudioSource::FDeepSpeechPacedAudioSource(const FDeepSpeechAudioPacing& InPacing)
+	: Pacing(InPacing), Random(InPacing.Seed), SampleRate(0), BlockSize(0), Sink(nullptr), Thread(nullptr), bRunning(false), bFinished(false)
+{
+}
+
+FDeepSpeechPacedAudioSource::~FDeepSpeechPacedAudioSource()
+{
+	Stop();
+}
+
+bool FDeepSpeechPacedAudioSource::Open(int32 PreferredSampleRate, int32 InBlockSize)
+{
+	Stop();
+	SampleRate = OpenSource(PreferredSampleRate);
+	if (SampleRate <= 0)
+	{
+		return false;
+	}
+
+	BlockSize = FMath::Max(InBlockSize, 1);
+	Block.SetNumUninitialized(FMath::CeilToInt(BlockSize * (1.0f + FMath::Clamp(Pacing.BlockSizeVariation, 0.0f, 1.0f))));
+	Random.Initialize(Pacing.Seed);
+	bFinished = false;
+	return true;
+}
+
+bool FDeepSpeechPacedAudioSource::Start(IDeepSpeechAudioSink& InSink)
+{
+	check(!Thread && SampleRate > 0);
+	Sink = &InSink;
+	bRunning = true;
+	Thread = FRunnableThread::Create(this, *FString::Printf(TEXT("TensorVox%sSource"), GetName()), 0, TPri_AboveNormal);
+	return Thread != nullptr;
+}
+
+void FDeepSpeechPacedAudioSource::Stop()
+{
+	bRunning = false;
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+uint32 FDeepSpeechPacedAudioSource::Run()
+{
+	const float Variation = FMath::Clamp(Pacing.BlockSizeVariation, 0.0f, 1.0f);
+	const double StartTime = FPlatformTime::Seconds();
+	int64 NumDelivered = 0;
+
+	while (bRunning)
+	{
+		int32 NumSamples = BlockSize;
+		if (Variation > 0.0f)
+		{
+			NumSamples = FMath::Clamp(FMath::RoundToInt(BlockSize * (1.0f + Random.FRandRange(-Variation, Variation))), 1, Block.Num());
+		}
+
+		NumSamples = Generate(Block.GetData(), NumSamples);
+		if (NumSamples == 0)
+		{
+			bFinished = true;
+			break;
+		}
+
+		if (Pacing.Speed > 0.0f)
+		{
+			// A block can't come in before the last of it was "recorded", and jitter only ever makes it later.
+			double DueTime = StartTime + (double)(NumDelivered + NumSamples) / (SampleRate * Pacing.Speed);
+			if (Pacing.JitterSeconds > 0.0f)
+			{
+				DueTime += Random.FRandRange(0.0f, Pacing.JitterSeconds);
+			}
+
+			for (double Remaining = DueTime - FPlatformTime::Seconds(); Remaining > 0.0 && bRunning; Remaining = DueTime - FPlatformTime::Seconds())
+			{
+				FPlatformProcess::SleepNoStats(FMath::Min((float)Remaining, MaxPacingSleepSeconds));
+			}
+		}
+		else
+		{
+			// Unthrottled, but never faster than the sink drains, so nothing is dropped.
+			while (bRunning && Sink->GetNumFreeFrames() < NumSamples)
+			{
+				FPlatformProcess::SleepNoStats(0.0f);
+			}
+		}
+
+		if (bRunning)
+		{
+			Sink->OnAudioCaptured(Block.GetData(), NumSamples, false);
+			NumDelivered += NumSamples;
+		}
+	}
+	return 0;
+}
+
+FDeepSpeechFileAudioSource::FDeepSpeechFileAudioSource(const FString& InPath, const FDeepSpeechAudioPacing& InPacing, bool bInLoop,
+                                                       int32 InRawSampleRate)
+	: FDeepSpeechPacedAudioSource(InPacing), Path(InPath), bLoop(bInLoop), RawSampleRate(InRawSampleRate), Position(0)
+{
+}
+
+int32 FDeepSpeechFileAudioSource::OpenSource(int32 PreferredSampleRate)
+{
+	Position = 0;
+	if (Samples.Num() > 0)
+	{
+		return SampleRate;
+	}
+
+	TArray<uint8> FileData;
+	if (!FFileHelper::LoadFileToArray(FileData, *Path))
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Couldn't read audio source file %s."), *Path);
+		return 0;
+	}
+
+	if (!FPaths::GetExtension(Path).Equals(TEXT("wav"), ESearchCase::IgnoreCase))
+	{
+		Samples.SetNumUninitialized(FileData.Num() / sizeof(int16));
+		FMemory::Memcpy(Samples.GetData(), FileData.GetData(), Samples.Num() * sizeof(int16));
+		return RawSampleRate;
+	}
+
+	FWaveModInfo WaveInfo;
+	FString Error;
+	if (!WaveInfo.ReadWaveInfo(FileData.GetData(), FileData.Num(), &Error) || *WaveInfo.pBitsPerSample != 16 || *WaveInfo.pChannels == 0)
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("%s isn't a 16 bit PCM WAV. %s"), *Path, *Error);
+		return 0;
+	}
+
+	FDeepSpeechFrontEndSettings Settings;
+	Settings.NumChannels = *WaveInfo.pChannels;
+	const int32 NumFrames = WaveInfo.SampleDataSize / (sizeof(int16) * Settings.NumChannels);
+	Samples.SetNumUninitialized(NumFrames);
+	if (NumFrames > 0)
+	{
+		FDeepSpeechFrontEnd FrontEnd;
+		FrontEnd.Initialize(Settings, *WaveInfo.pSamplesPerSec, *WaveInfo.pSamplesPerSec, NumFrames);
+		FrontEnd.Process(WaveInfo.SampleDataStart, NumFrames, Samples.GetData());
+	}
+	return *WaveInfo.pSamplesPerSec;
+}
+
+int32 FDeepSpeechFileAudioSource::Generate(int16* OutSamples, int32 NumSamples)
+{
+	if (Position >= Samples.Num() && bLoop)
+	{
+		Position = 0;
+	}
+
+	const int32 NumCopied = FMath::Min(NumSamples, Samples.Num() - Position);
+	FMemory::Memcpy(OutSamples, Samples.GetData() + Position, NumCopied * sizeof(int16));
+	Position += NumCopied;
+	return NumCopied;
+}
+
+FDeepSpeechSyntheticAudioSource::FDeepSpeechSyntheticAudioSource(const FDeepSpeechAudioPacing& InPacing, int32 InSampleRate, float InDurationSeconds)
+	: FDeepSpeechPacedAudioSource(InPacing), FixedSampleRate(InSampleRate), DurationSeconds(InDurationSeconds), NumGenerated(0), bVoiced(false),
+	  SegmentLength(0), SegmentRemaining(0), Pitch(120.0f), Phase(0.0)
+{
+}
+
+int32 FDeepSpeechSyntheticAudioSource::OpenSource(int32 PreferredSampleRate)
+{
+	NumGenerated = 0;
+	bVoiced = false;
+	SegmentRemaining = 0;
+	Phase = 0.0;
+	return FixedSampleRate > 0 ? FixedSampleRate : PreferredSampleRate;
+}
+
+int32 FDeepSpeechSyntheticAudioSource::Generate(int16* OutSamples, int32 NumSamples)
+{
+	if (DurationSeconds > 0.0f)
+	{
+		NumSamples = (int32)FMath::Min<int64>(NumSamples, (int64)(DurationSeconds * SampleRate) - NumGenerated);
+		if (NumSamples <= 0)
+		{
+			return 0;
+		}
+	}
+
+	for (int32 Index = 0; Index < NumSamples; ++Index)
+	{
+		if (SegmentRemaining <= 0)
+		{
+			// Alternate between words and pauses of random length.
+			bVoiced = !bVoiced;
+			SegmentLength = FMath::RoundToInt((bVoiced ? Random.FRandRange(0.3f, 1.2f) : Random.FRandRange(0.2f, 0.8f)) * SampleRate);
+			SegmentRemaining = SegmentLength;
+			Pitch = Random.FRandRange(90.0f, 220.0f);
+		}
+
+		double Value = Random.FRandRange(-150.0f, 150.0f);
+		if (bVoiced)
+		{
+			// Harmonics of the pitch weighted by two formant bumps, faded in and out over 10 ms.
+			const double Fade = FMath::Min(1.0, FMath::Min(SegmentRemaining, SegmentLength - SegmentRemaining + 1) / (0.01 * SampleRate));
+			double Voice = 0.0;
+			for (int32 Harmonic = 1; Harmonic <= 12; ++Harmonic)
+			{
+				const double Frequency = Harmonic * Pitch;
+				if (Frequency >= SampleRate * 0.5)
+				{
+					break;
+				}
+				const double Weight = FMath::Exp(-FMath::Square((Frequency - 700.0) / 300.0)) + 0.6 * FMath::Exp(-FMath::Square((Frequency - 1300.0) / 400.0)) + 0.05;
+				Voice += Weight * FMath::Sin(Harmonic * Phase);
+			}
+			Value += 5000.0 * Fade * Voice;
+			Phase = FMath::Fmod(Phase + 2.0 * UE_DOUBLE_PI * Pitch / SampleRate, 2.0 * UE_DOUBLE_PI);
+		}
+
+		OutSamples[Index] = (int16)FMath::Clamp(Value, -32768.0, 32767.0);
+		--SegmentRemaining;
+		++NumGenerated;
+	}
+	return NumSamples;
+}
+
+FDeepSpeechPushAudioSource::FDeepSpeechPushAudioSource(int32 InSampleRate)
+	: SampleRate(InSampleRate), Sink(nullptr), NumDelivered(0)
+{
+}
+
+bool FDeepSpeechPushAudioSource::Start(IDeepSpeechAudioSink& InSink)
+{
+	FScopeLock Lock(&SinkCritical);
+	Sink = &InSink;
+	NumDelivered = 0;
+	return true;
+}
+
+void FDeepSpeechPushAudioSource::Stop()
+{
+	FScopeLock Lock(&SinkCritical);
+	Sink = nullptr;
+}
+
+void FDeepSpeechPushAudioSource::PushAudio(const int16* Samples, int32 NumSamples)
+{
+	FScopeLock Lock(&SinkCritical);
+	if (Sink && NumSamples > 0)
+	{
+		Sink->OnAudioCaptured(Samples, NumSamples, false);
+		NumDelivered.fetch_add(NumSamples, std::memory_order_relaxed);
+	}
+}
+
+// The recorder owns its source, this lets it own a reference to a shared one instead.
+class FDeepSpeechPushAudioSourceProxy : public IDeepSpeechAudioSource
+{
+public:
+	explicit FDeepSpeechPushAudioSourceProxy(const TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe>& InShared) : Shared(InShared) {}
+	virtual ~FDeepSpeechPushAudioSourceProxy() override { Shared->Stop(); }
+
+	virtual bool Open(int32 PreferredSampleRate, int32 BlockSize) override { return Shared->Open(PreferredSampleRate, BlockSize); }
+	virtual bool Start(IDeepSpeechAudioSink& Sink) override { return Shared->Start(Sink); }
+	virtual void Stop() override { Shared->Stop(); }
+	virtual int32 GetSampleRate() const override { return Shared->GetSampleRate(); }
+	virtual const TCHAR* GetName() const override { return Shared->GetName(); }
+
+private:
+	TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe> Shared;
+};
+
+TUniquePtr<IDeepSpeechAudioSource> FDeepSpeechPushAudioSource::CreateProxy(const TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe>& Shared)
+{
+	return MakeUnique<FDeepSpeechPushAudioSourceProxy>(Shared);
+}
+
+TUniquePtr<IDeepSpeechAudioSource> FDeepSpeechAudioSources::CreateCapture()
+{
+#if TENSORVOX_VALID_PLATFORM && TENSORVOX_WITH_RTAUDIO
+	return MakeUnique<FDeepSpeechRtAudioSource>();
+#else
+	return nullptr;
+#endif
+}
+
+TUniquePtr<IDeepSpeechAudioSource> FDeepSpeechAudioSources::CreateDefault()
+{
+	if (GTensorVoxAudioSource.IsEmpty() || GTensorVoxAudioSource.Equals(TEXT("Capture"), ESearchCase::IgnoreCase))
+	{
+		return CreateCapture();
+	}
+
+	if (GTensorVoxAudioSource.Equals(TEXT("Synthetic"), ESearchCase::IgnoreCase))
+	{
+		return MakeUnique<FDeepSpeechSyntheticAudioSource>(GetDefaultPacing());
+	}
+
+	return MakeUnique<FDeepSpeechFileAudioSource>(GTensorVoxAudioSource, GetDefaultPacing(), GTensorVoxAudioSourceLoop);
+}
+
+FDeepSpeechAudioPacing FDeepSpeechAudioSources::GetDefaultPacing()
+{
+	FDeepSpeechAudioPacing Pacing;
+	Pacing.Speed = FMath::Max(GTensorVoxAudioSourceSpeed, 0.0f);
+	Pacing.JitterSeconds = FMath::Max(GTensorVoxAudioSourceJitterMs, 0.0f) * 0.001f;
+	Pacing.BlockSizeVariation = GTensorVoxAudioSourceBlockVariation;
+	Pacing.Seed = GTensorVoxAudioSourceSeed;
+	return Pacing;
+}
+
+FDeepSpeechFrontEndSettings FDeepSpeechAudioSources::GetCaptureFrontEnd(int32 NumChannels, EDeepSpeechSampleFormat Format)
+{
+	FDeepSpeechFrontEndSettings Settings;
+	Settings.NumChannels = NumChannels;
+	Settings.Format = Format;
+	Settings.Channel = GTensorVoxInputChannel;
+	Settings.Gain = FMath::Pow(10.0f, GTensorVoxInputGainDb / 20.0f);
+	Settings.bRemoveDC = GTensorVoxInputRemoveDC;
+	return Settings;
+}
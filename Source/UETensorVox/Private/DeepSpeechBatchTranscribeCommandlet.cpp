@@ -0,0 +1,64 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechBatchTranscribeCommandlet.h"
+#include "DeepSpeechBatchTranscriber.h"
+#include "Misc/Paths.h"
+#include "UETensorVox.h"
+
+UDeepSpeechBatchTranscribeCommandlet::UDeepSpeechBatchTranscribeCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UDeepSpeechBatchTranscribeCommandlet::Main(const FString& Params)
+{
+	FString Input, Output;
+	FDeepSpeechConfiguration Config;
+	if (!FParse::Value(*Params, TEXT("Input="), Input) || !FParse::Value(*Params, TEXT("Output="), Output) ||
+		!FParse::Value(*Params, TEXT("Model="), Config.ModelPath))
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Usage: -run=DeepSpeechBatchTranscribe -Input=<directory or manifest> -Output=<file.json|file.csv> -Model=<path> ")
+		       TEXT("[-Scorer=<path>] [-BeamWidth=N] [-Alpha=A -Beta=B] [-Threads=N]"));
+		return 1;
+	}
+
+	FParse::Value(*Params, TEXT("Scorer="), Config.ScorerPath);
+	FParse::Value(*Params, TEXT("BeamWidth="), Config.BeamWidth);
+	FParse::Value(*Params, TEXT("Alpha="), Config.ModelAlphaBeta.X);
+	FParse::Value(*Params, TEXT("Beta="), Config.ModelAlphaBeta.Y);
+	int32 NumThreads = 0;
+	FParse::Value(*Params, TEXT("Threads="), NumThreads);
+
+	TArray<FString> Files;
+	if (!FDeepSpeechBatchTranscriber::GatherFiles(Input, Files))
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("%s is neither a directory nor a manifest."), *Input);
+		return 1;
+	}
+	UE_LOG(LogUETensorVox, Display, TEXT("Transcribing %i files from %s."), Files.Num(), *Input);
+
+	FDeepSpeechBatchTranscriber Transcriber(Config);
+	FDeepSpeechBatchReport Report;
+	if (!Transcriber.Run(Files, Report, NumThreads))
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Couldn't load model %s."), *Config.ModelPath);
+		return 1;
+	}
+
+	const bool bWritten = FPaths::GetExtension(Output).Equals(TEXT("csv"), ESearchCase::IgnoreCase)
+		                      ? FDeepSpeechBatchTranscriber::WriteCsv(Report, Output)
+		                      : FDeepSpeechBatchTranscriber::WriteJson(Report, Output);
+	if (!bWritten)
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Couldn't write %s."), *Output);
+		return 1;
+	}
+
+	UE_LOG(LogUETensorVox, Display, TEXT("%i files (%i failed), %.2f h of audio in %.1f s on %i threads: %.1f audio hours per wall hour, real time factor %.3f."),
+	       Report.Results.Num(), Report.NumFailed, Report.AudioSeconds / 3600.0, Report.WallSeconds, Report.NumThreads,
+	       Report.GetAudioHoursPerWallHour(), Report.GetRealTimeFactor());
+	return Report.NumFailed > 0 ? 2 : 0;
+}
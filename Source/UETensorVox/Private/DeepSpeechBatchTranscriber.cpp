@@ -0,0 +1,289 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechBatchTranscriber.h"
+#include "DeepSpeechModelRegistry.h"
+#include "DeepSpeechFrontEnd.h"
+#include "Audio.h"
+#include "Async/ParallelFor.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeExit.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+#include "UETensorVox.h"
+#include <atomic>
+
+#if TENSORVOX_VALID_PLATFORM
+#include "DeepSpeechLibrary.h"
+#endif
+
+// Input block size for converting whole files.
+static const int32 BatchResampleBlockSize = 4096;
+
+struct FDeepSpeechBatchTranscriber::FThreadContext
+{
+	TArray<uint8> FileData;
+	TArray<int16> Samples;
+	FDeepSpeechFrontEnd FrontEnd;
+};
+
+FDeepSpeechBatchTranscriber::FDeepSpeechBatchTranscriber(const FDeepSpeechConfiguration& InConfig)
+	: Config(InConfig)
+{
+}
+
+bool FDeepSpeechBatchTranscriber::GatherFiles(const FString& DirectoryOrManifest, TArray<FString>& OutFiles)
+{
+	IFileManager& FileManager = IFileManager::Get();
+	if (FileManager.DirectoryExists(*DirectoryOrManifest))
+	{
+		FileManager.FindFilesRecursive(OutFiles, *DirectoryOrManifest, TEXT("*.wav"), true, false, false);
+		OutFiles.Sort();
+		return true;
+	}
+
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *DirectoryOrManifest))
+	{
+		return false;
+	}
+
+	const FString ManifestDirectory = FPaths::GetPath(DirectoryOrManifest);
+	for (FString& Line : Lines)
+	{
+		Line.TrimStartAndEndInline();
+		if (Line.IsEmpty() || Line.StartsWith(TEXT("#")))
+		{
+			continue;
+		}
+		OutFiles.Add(FPaths::IsRelative(Line) ? FPaths::Combine(ManifestDirectory, Line) : Line);
+	}
+	return true;
+}
+
+bool FDeepSpeechBatchTranscriber::LoadWave(const FString& Path, int32 TargetSampleRate, TArray<int16>& OutSamples, double& OutSeconds, FString& OutError)
+{
+	FThreadContext Context;
+	if (!LoadWave(Context, Path, TargetSampleRate, OutSeconds, OutError))
+	{
+		return false;
+	}
+	OutSamples = MoveTemp(Context.Samples);
+	return true;
+}
+
+bool FDeepSpeechBatchTranscriber::LoadWave(FThreadContext& Context, const FString& Path, int32 TargetSampleRate, double& OutSeconds, FString& OutError)
+{
+	Context.FileData.Reset();
+	if (!FFileHelper::LoadFileToArray(Context.FileData, *Path))
+	{
+		OutError = TEXT("Couldn't read the file.");
+		return false;
+	}
+
+	FWaveModInfo WaveInfo;
+	if (!WaveInfo.ReadWaveInfo(Context.FileData.GetData(), Context.FileData.Num(), &OutError))
+	{
+		return false;
+	}
+
+	if (*WaveInfo.pBitsPerSample != 16 || *WaveInfo.pChannels == 0)
+	{
+		OutError = FString::Printf(TEXT("Only 16 bit PCM is supported, got %i bits and %i channels."), *WaveInfo.pBitsPerSample, *WaveInfo.pChannels);
+		return false;
+	}
+
+	FDeepSpeechFrontEndSettings Settings;
+	Settings.NumChannels = *WaveInfo.pChannels;
+	const int32 SampleRate = *WaveInfo.pSamplesPerSec;
+	const int32 NumFrames = WaveInfo.SampleDataSize / (sizeof(int16) * Settings.NumChannels);
+	OutSeconds = (double)NumFrames / SampleRate;
+
+	// Downmixed and resampled straight out of the file data. The filter bank is only rebuilt when the rate changes, corpora usually have one or two.
+	Context.FrontEnd.Initialize(Settings, SampleRate, TargetSampleRate, BatchResampleBlockSize);
+	Context.Samples.SetNumUninitialized(Context.FrontEnd.GetMaxOutputSamples(NumFrames) + Context.FrontEnd.GetMaxOutputSamples(Context.FrontEnd.GetFlushFrames()), false);
+	int32 NumOutput = Context.FrontEnd.Process(WaveInfo.SampleDataStart, NumFrames, Context.Samples.GetData());
+	// Flush the filter with silence so the end of the file isn't left in the history.
+	NumOutput += Context.FrontEnd.Flush(Context.Samples.GetData() + NumOutput);
+	Context.Samples.SetNum(NumOutput, false);
+	return true;
+}
+
+bool FDeepSpeechBatchTranscriber::Run(const TArray<FString>& Files, FDeepSpeechBatchReport& OutReport, int32 NumThreads)
+{
+	OutReport = FDeepSpeechBatchReport();
+	Model = FDeepSpeechModelRegistry::Get().Acquire(Config);
+	if (!Model)
+	{
+		return false;
+	}
+
+	OutReport.Results.SetNum(Files.Num());
+	for (int32 Index = 0; Index < Files.Num(); ++Index)
+	{
+		OutReport.Results[Index].File = Files[Index];
+	}
+
+	OutReport.NumThreads = FMath::Clamp(NumThreads > 0 ? NumThreads : FPlatformMisc::NumberOfCoresIncludingHyperthreads(), 1, FMath::Max(Files.Num(), 1));
+	const double StartTime = FPlatformTime::Seconds();
+
+	// One task per thread pulling files off a shared counter, so long and short files even out and each thread reuses its context.
+	std::atomic<int32> NextFile(0);
+	ParallelFor(OutReport.NumThreads, [this, &OutReport, &NextFile](int32)
+	{
+		FThreadContext Context;
+		for (int32 Index = NextFile++; Index < OutReport.Results.Num(); Index = NextFile++)
+		{
+			TranscribeFile(Context, OutReport.Results[Index]);
+		}
+	}, EParallelForFlags::Unbalanced);
+
+	OutReport.WallSeconds = FPlatformTime::Seconds() - StartTime;
+	for (const FDeepSpeechBatchResult& Result : OutReport.Results)
+	{
+		OutReport.AudioSeconds += Result.AudioSeconds;
+		OutReport.ProcessSeconds += Result.ProcessSeconds;
+		OutReport.NumFailed += Result.Error.IsEmpty() ? 0 : 1;
+	}
+
+	Model.Reset();
+	return true;
+}
+
+void FDeepSpeechBatchTranscriber::TranscribeFile(FThreadContext& Context, FDeepSpeechBatchResult& Result) const
+{
+#if TENSORVOX_VALID_PLATFORM
+	const double StartTime = FPlatformTime::Seconds();
+	ON_SCOPE_EXIT
+	{
+		Result.ProcessSeconds = FPlatformTime::Seconds() - StartTime;
+	};
+
+	if (!LoadWave(Context, Result.File, Model->GetSampleRate(), Result.AudioSeconds, Result.Error))
+	{
+		return;
+	}
+
+	Metadata* TranscriptMetadata = nullptr;
+	{
+		FDeepSpeechInferenceScope InferenceScope(*Model);
+		StreamingState* Stream = nullptr;
+		if (FDeepSpeechModel::CheckForError(TEXT("Batch CreateStream"), Model->CreateStream(Stream)))
+		{
+			Result.Error = TEXT("Couldn't create a stream.");
+			return;
+		}
+		DS_FeedAudioContent(Stream, Context.Samples.GetData(), Context.Samples.Num());
+		TranscriptMetadata = DS_FinishStreamWithMetadata(Stream, 1);
+	}
+
+	if (!TranscriptMetadata || TranscriptMetadata->num_transcripts == 0)
+	{
+		Result.Error = TEXT("No transcript.");
+		if (TranscriptMetadata)
+		{
+			DS_FreeMetadata(TranscriptMetadata);
+		}
+		return;
+	}
+
+	const CandidateTranscript& Best = TranscriptMetadata->transcripts[0];
+	Result.Confidence = Best.confidence;
+
+	// Tokens are characters, spaces split words.
+	FDeepSpeechBatchWord* Word = nullptr;
+	for (uint32 TokenIndex = 0; TokenIndex < Best.num_tokens; ++TokenIndex)
+	{
+		const TokenMetadata& Token = Best.tokens[TokenIndex];
+		const FString Text = UTF8_TO_TCHAR(Token.text);
+		Result.Transcript += Text;
+
+		if (Text.TrimStartAndEnd().IsEmpty())
+		{
+			Word = nullptr;
+			continue;
+		}
+
+		if (!Word)
+		{
+			Word = &Result.Words.AddDefaulted_GetRef();
+			Word->StartTime = Token.start_time;
+		}
+		Word->Text += Text;
+		Word->EndTime = Token.start_time;
+	}
+	DS_FreeMetadata(TranscriptMetadata);
+#else
+	Result.Error = TEXT("DeepSpeech isn't available on this platform.");
+#endif
+}
+
+bool FDeepSpeechBatchTranscriber::WriteJson(const FDeepSpeechBatchReport& Report, const FString& Path)
+{
+	TSharedRef<FJsonObject> Root = MakeShared<FJsonObject>();
+	Root->SetNumberField(TEXT("audio_seconds"), Report.AudioSeconds);
+	Root->SetNumberField(TEXT("wall_seconds"), Report.WallSeconds);
+	Root->SetNumberField(TEXT("threads"), Report.NumThreads);
+	Root->SetNumberField(TEXT("failed"), Report.NumFailed);
+	Root->SetNumberField(TEXT("audio_hours_per_wall_hour"), Report.GetAudioHoursPerWallHour());
+	Root->SetNumberField(TEXT("real_time_factor"), Report.GetRealTimeFactor());
+
+	TArray<TSharedPtr<FJsonValue>> Files;
+	for (const FDeepSpeechBatchResult& Result : Report.Results)
+	{
+		TSharedRef<FJsonObject> File = MakeShared<FJsonObject>();
+		File->SetStringField(TEXT("file"), Result.File);
+		File->SetNumberField(TEXT("audio_seconds"), Result.AudioSeconds);
+		File->SetNumberField(TEXT("process_seconds"), Result.ProcessSeconds);
+		if (!Result.Error.IsEmpty())
+		{
+			File->SetStringField(TEXT("error"), Result.Error);
+		}
+		else
+		{
+			File->SetStringField(TEXT("transcript"), Result.Transcript);
+			File->SetNumberField(TEXT("confidence"), Result.Confidence);
+
+			TArray<TSharedPtr<FJsonValue>> Words;
+			for (const FDeepSpeechBatchWord& Word : Result.Words)
+			{
+				TSharedRef<FJsonObject> WordObject = MakeShared<FJsonObject>();
+				WordObject->SetStringField(TEXT("word"), Word.Text);
+				WordObject->SetNumberField(TEXT("start"), Word.StartTime);
+				WordObject->SetNumberField(TEXT("end"), Word.EndTime);
+				Words.Add(MakeShared<FJsonValueObject>(WordObject));
+			}
+			File->SetArrayField(TEXT("words"), Words);
+		}
+		Files.Add(MakeShared<FJsonValueObject>(File));
+	}
+	Root->SetArrayField(TEXT("files"), Files);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+	return FJsonSerializer::Serialize(Root, Writer) && FFileHelper::SaveStringToFile(Json, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM);
+}
+
+bool FDeepSpeechBatchTranscriber::WriteCsv(const FDeepSpeechBatchReport& Report, const FString& Path)
+{
+	const auto Quote = [](const FString& Value)
+	{
+		return TEXT("\"") + Value.Replace(TEXT("\""), TEXT("\"\"")) + TEXT("\"");
+	};
+
+	// Words are word@start-end, space separated.
+	FString Csv = TEXT("File,AudioSeconds,ProcessSeconds,Confidence,Transcript,Words,Error\n");
+	for (const FDeepSpeechBatchResult& Result : Report.Results)
+	{
+		TArray<FString> Words;
+		for (const FDeepSpeechBatchWord& Word : Result.Words)
+		{
+			Words.Add(FString::Printf(TEXT("%s@%.2f-%.2f"), *Word.Text, Word.StartTime, Word.EndTime));
+		}
+		Csv += FString::Printf(TEXT("%s,%.3f,%.3f,%.3f,%s,%s,%s\n"), *Quote(Result.File), Result.AudioSeconds, Result.ProcessSeconds, Result.Confidence,
+		                       *Quote(Result.Transcript), *Quote(FString::Join(Words, TEXT(" "))), *Quote(Result.Error));
+	}
+	return FFileHelper::SaveStringToFile(Csv, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM);
+}
@@ -0,0 +1,1509 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "CoreMinimal.h"
+#include "HAL/IConsoleManager.h"
+#include "Async/Async.h"
+#include "Misc/Paths.h"
+#include "DeepSpeechBenchmarks.h"
+#include "DeepSpeechResampler.h"
+#include "DeepSpeechFrontEnd.h"
+#include "DeepSpeechLoadGovernor.h"
+#include "DeepSpeechMicrophoneRecorder.h"
+#include "DeepSpeechSimd.h"
+#include "DeepSpeechAudioSource.h"
+#include "DeepSpeechBatchTranscriber.h"
+#include "DeepSpeechModelRegistry.h"
+#include "DeepSpeechNoiseFloor.h"
+#include "DeepSpeechSessionManager.h"
+#include "DeepSpeechStreamService.h"
+#include "DeepSpeechVoiceDetector.h"
+#include "Math/RandomStream.h"
+#include "Misc/FileHelper.h"
+#include "UETensorVox.h"
+#include <atomic>
+
+#if TENSORVOX_VALID_PLATFORM
+#include "DeepSpeechLibrary.h"
+#endif
+
+/**
+ * Console commands measuring the speech pipeline. None of them need a microphone, the ones running whole sessions play files instead.
+ * PressLatency records from whatever TensorVox.AudioSource says, the microphone unless told otherwise, since the device is what it measures.
+ * The measurements in DeepSpeechBenchmarks.h are shared with the automation tests under Tests/, which hold them to thresholds.
+ */
+
+namespace DeepSpeechBenchmarks
+{
+	// The per sample lerp the recorder used before the polyphase resampler, kept as the baseline.
+	static void LegacyLerpSampleRateConvert(float CurrentSR, float TargetSR, const TArray<int16>& InSamples, TArray<int16>& OutConverted)
+	{
+		const int32 NumOutputSamples = InSamples.Num() * TargetSR / CurrentSR;
+		OutConverted.Reset(NumOutputSamples);
+
+		const float SrFactor = (double)CurrentSR / TargetSR;
+		float CurrentFrameIndexInterpolated = 0.0f;
+		int32 CurrentFrameIndex = 0;
+		for (;;)
+		{
+			const int32 NextFrameIndex = CurrentFrameIndex + 1;
+			if (NextFrameIndex >= InSamples.Num())
+			{
+				break;
+			}
+
+			OutConverted.Add(FMath::Lerp(InSamples[CurrentFrameIndex], InSamples[NextFrameIndex], CurrentFrameIndexInterpolated));
+
+			CurrentFrameIndexInterpolated += SrFactor;
+			while (CurrentFrameIndexInterpolated >= 1.0f)
+			{
+				CurrentFrameIndexInterpolated -= 1.0f;
+				++CurrentFrameIndex;
+			}
+		}
+	}
+
+	// Tones the model cares about, they should come out untouched.
+	static double InBandSignal(double Time, double TopFrequency)
+	{
+		return 6000.0 * FMath::Sin(2.0 * UE_DOUBLE_PI * 440.0 * Time) + 4000.0 * FMath::Sin(2.0 * UE_DOUBLE_PI * 1250.0 * Time + 0.3) +
+			2500.0 * FMath::Sin(2.0 * UE_DOUBLE_PI * TopFrequency * 0.5 * Time + 1.1) + 1500.0 * FMath::Sin(2.0 * UE_DOUBLE_PI * TopFrequency * Time + 2.0);
+	}
+
+	// Tones above the output Nyquist frequency, they should be filtered out instead of aliasing into the band.
+	static double OutOfBandSignal(double Time, int32 InputRate, int32 OutputRate)
+	{
+		double Value = 0.0;
+		if (InputRate > OutputRate)
+		{
+			for (const double Fraction : {0.6, 0.85})
+			{
+				const double Frequency = OutputRate * Fraction;
+				if (Frequency < InputRate * 0.5)
+				{
+					Value += 3000.0 * FMath::Sin(2.0 * UE_DOUBLE_PI * Frequency * Time + Fraction);
+				}
+			}
+		}
+		return Value;
+	}
+
+	static double MeasureSnr(const TArray<int16>& Converted, int32 OutputRate, double DelaySeconds, double TopFrequency)
+	{
+		// Skip the filter warm up at both ends.
+		const int32 Skip = 256;
+		double SignalPower = 0.0, ErrorPower = 0.0;
+		for (int32 Index = Skip; Index < Converted.Num() - Skip; ++Index)
+		{
+			const double Reference = InBandSignal((double)Index / OutputRate - DelaySeconds, TopFrequency);
+			const double Error = Converted[Index] - Reference;
+			SignalPower += Reference * Reference;
+			ErrorPower += Error * Error;
+		}
+		return 10.0 * FMath::LogX(10.0, SignalPower / FMath::Max(ErrorPower, 1e-9));
+	}
+
+	FResamplerMeasurement MeasureResampler(int32 InputRate, int32 OutputRate, int32 Seconds)
+	{
+		const int32 BlockSize = 480;
+		const double TopFrequency = FMath::Min(InputRate, OutputRate) * 0.38;
+		TArray<int16> Input;
+		Input.SetNumUninitialized(InputRate * Seconds);
+		for (int32 Index = 0; Index < Input.Num(); ++Index)
+		{
+			const double Time = (double)Index / InputRate;
+			Input[Index] = (int16)FMath::RoundToInt(InBandSignal(Time, TopFrequency) + OutOfBandSignal(Time, InputRate, OutputRate));
+		}
+
+		TArray<int16> LerpOutput;
+		double StartTime = FPlatformTime::Seconds();
+		LegacyLerpSampleRateConvert(InputRate, OutputRate, Input, LerpOutput);
+		const double LerpSeconds = FPlatformTime::Seconds() - StartTime;
+
+		FDeepSpeechResampler Resampler;
+		Resampler.Initialize(InputRate, OutputRate, BlockSize);
+		TArray<int16> PolyphaseOutput;
+		PolyphaseOutput.SetNumUninitialized(Resampler.GetMaxOutputSamples(Input.Num()) + BlockSize);
+		int32 NumOutput = 0;
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Offset = 0; Offset < Input.Num(); Offset += BlockSize)
+		{
+			NumOutput += Resampler.Process(Input.GetData() + Offset, FMath::Min(BlockSize, Input.Num() - Offset), PolyphaseOutput.GetData() + NumOutput);
+		}
+		const double PolyphaseSeconds = FPlatformTime::Seconds() - StartTime;
+		PolyphaseOutput.SetNum(NumOutput);
+
+		FResamplerMeasurement Measurement;
+		Measurement.InputRate = InputRate;
+		Measurement.OutputRate = OutputRate;
+		Measurement.LerpSnr = MeasureSnr(LerpOutput, OutputRate, 0.0, TopFrequency);
+		Measurement.LerpSamplesPerSecond = Input.Num() / FMath::Max(LerpSeconds, 1e-9);
+		Measurement.Snr = MeasureSnr(PolyphaseOutput, OutputRate, Resampler.GetGroupDelay() / InputRate, TopFrequency);
+		Measurement.SamplesPerSecond = Input.Num() / FMath::Max(PolyphaseSeconds, 1e-9);
+		Measurement.KernelName = Resampler.GetKernelName();
+		Measurement.NumTapsPerPhase = Resampler.GetNumTapsPerPhase();
+		Measurement.NumPhases = Resampler.GetNumPhases();
+		return Measurement;
+	}
+
+	static void BenchmarkResampler(const TArray<FString>& Args)
+	{
+		const int32 Seconds = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10;
+		for (const int32 InputRate : {8000, 22050, 44100, 48000})
+		{
+			const FResamplerMeasurement Measurement = MeasureResampler(InputRate, 16000, Seconds);
+			UE_LOG(LogUETensorVox, Display,
+			       TEXT("Resample %5i -> %i hz | lerp: SNR %5.1f dB, %7.1f Msamples/s | polyphase (%s, %i taps, %i phases): SNR %5.1f dB, %7.1f Msamples/s"),
+			       Measurement.InputRate, Measurement.OutputRate, Measurement.LerpSnr, Measurement.LerpSamplesPerSecond / 1e6, Measurement.KernelName,
+			       Measurement.NumTapsPerPhase, Measurement.NumPhases, Measurement.Snr, Measurement.SamplesPerSecond / 1e6);
+		}
+	}
+
+	// What capture looked like before the front end: planar copies per channel, a downmix, a gain and DC pass, then the resampler.
+	struct FMultiPassFrontEnd
+	{
+		TArray<TArray<int16>> Planar;
+		TArray<int16> Mono;
+		FDeepSpeechResampler Resampler;
+		float DCEstimate = 0.0f;
+		bool bHasDCEstimate = false;
+
+		int32 Process(const uint8* Interleaved, int32 NumFrames, const FDeepSpeechFrontEndSettings& Settings, int32 SampleRate, int16* OutSamples)
+		{
+			const int32 NumChannels = Settings.NumChannels;
+			Planar.SetNum(NumChannels);
+			for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+			{
+				Planar[Channel].SetNumUninitialized(NumFrames, false);
+				for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+				{
+					Planar[Channel][Frame] = Settings.Format == EDeepSpeechSampleFormat::Float
+						                         ? (int16)FMath::Clamp(FMath::RoundToInt(reinterpret_cast<const float*>(Interleaved)[Frame * NumChannels + Channel] * 32767.0f), -32768, 32767)
+						                         : reinterpret_cast<const int16*>(Interleaved)[Frame * NumChannels + Channel];
+				}
+			}
+
+			Mono.SetNumUninitialized(NumFrames, false);
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+			{
+				int32 Sum = 0;
+				for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+				{
+					Sum += Planar[Channel][Frame];
+				}
+				Mono[Frame] = Sum / NumChannels;
+			}
+
+			float BlockSum = 0.0f;
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+			{
+				const float Value = Mono[Frame] * Settings.Gain;
+				BlockSum += Value;
+				Mono[Frame] = (int16)FMath::Clamp(FMath::RoundToInt(Value - DCEstimate), -32768, 32767);
+			}
+			DCEstimate = bHasDCEstimate ? DCEstimate + (BlockSum / NumFrames - DCEstimate) * FMath::Min((float)NumFrames / SampleRate, 1.0f) : BlockSum / NumFrames;
+			bHasDCEstimate = true;
+
+			return Resampler.Process(Mono.GetData(), NumFrames, OutSamples);
+		}
+	};
+
+	static void BenchmarkFrontEnd(const TArray<FString>& Args)
+	{
+		const int32 Seconds = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10;
+		const int32 InputRate = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 48000;
+		const int32 OutputRate = 16000;
+		const int32 BlockFrames = InputRate / 100;
+		FRandomStream Random(0);
+
+		for (const EDeepSpeechSampleFormat Format : {EDeepSpeechSampleFormat::Int16, EDeepSpeechSampleFormat::Float})
+		{
+			for (const int32 NumChannels : {1, 2, 4, 8})
+			{
+				FDeepSpeechFrontEndSettings Settings;
+				Settings.NumChannels = NumChannels;
+				Settings.Format = Format;
+				Settings.Gain = 0.8f;
+				Settings.bRemoveDC = true;
+
+				// Speech band content with a DC offset, different per channel.
+				const int32 NumFrames = InputRate * Seconds;
+				const int32 BytesPerSample = Format == EDeepSpeechSampleFormat::Float ? sizeof(float) : sizeof(int16);
+				TArray<uint8> Interleaved;
+				Interleaved.SetNumUninitialized(NumFrames * NumChannels * BytesPerSample);
+				for (int32 Index = 0; Index < NumFrames * NumChannels; ++Index)
+				{
+					const double Time = (double)(Index / NumChannels) / InputRate;
+					const float Value = (float)(InBandSignal(Time, 4000.0) * 0.5 + Random.FRandRange(-500.0f, 500.0f) + 300.0 * (Index % NumChannels + 1));
+					if (Format == EDeepSpeechSampleFormat::Float)
+					{
+						reinterpret_cast<float*>(Interleaved.GetData())[Index] = Value / 32767.0f;
+					}
+					else
+					{
+						reinterpret_cast<int16*>(Interleaved.GetData())[Index] = (int16)FMath::Clamp(FMath::RoundToInt(Value), -32768, 32767);
+					}
+				}
+
+				FMultiPassFrontEnd MultiPass;
+				MultiPass.Resampler.Initialize(InputRate, OutputRate, BlockFrames);
+				TArray<int16> MultiPassOutput;
+				MultiPassOutput.SetNumUninitialized(MultiPass.Resampler.GetMaxOutputSamples(BlockFrames) * FMath::DivideAndRoundUp(NumFrames, BlockFrames));
+				int32 NumMultiPass = 0;
+				double StartTime = FPlatformTime::Seconds();
+				for (int32 Offset = 0; Offset < NumFrames; Offset += BlockFrames)
+				{
+					NumMultiPass += MultiPass.Process(Interleaved.GetData() + (int64)Offset * NumChannels * BytesPerSample, FMath::Min(BlockFrames, NumFrames - Offset),
+					                                  Settings, InputRate, MultiPassOutput.GetData() + NumMultiPass);
+				}
+				const double MultiPassSeconds = FPlatformTime::Seconds() - StartTime;
+
+				FDeepSpeechFrontEnd FrontEnd;
+				FrontEnd.Initialize(Settings, InputRate, OutputRate, BlockFrames);
+				TArray<int16> FusedOutput;
+				FusedOutput.SetNumUninitialized(FrontEnd.GetMaxOutputSamples(BlockFrames) * FMath::DivideAndRoundUp(NumFrames, BlockFrames));
+				int32 NumFused = 0;
+				StartTime = FPlatformTime::Seconds();
+				for (int32 Offset = 0; Offset < NumFrames; Offset += BlockFrames)
+				{
+					NumFused += FrontEnd.Process(Interleaved.GetData() + (int64)Offset * NumChannels * BytesPerSample, FMath::Min(BlockFrames, NumFrames - Offset),
+					                             FusedOutput.GetData() + NumFused);
+				}
+				const double FusedSeconds = FPlatformTime::Seconds() - StartTime;
+
+				// The mix on its own, scalar against the widest kernel, without the resampler's share.
+				const float Scale = Settings.Gain * (Format == EDeepSpeechSampleFormat::Float ? 32767.0f : 1.0f) / NumChannels;
+				TArray<float> Weights;
+				Weights.Init(Scale, NumChannels);
+				TArray<int16> MixOutput;
+				MixOutput.SetNumUninitialized(BlockFrames);
+				double MixSeconds[2];
+				const DeepSpeechSimd::EKernel Kernels[2] = {DeepSpeechSimd::EKernel::Scalar, DeepSpeechSimd::GetBestKernel()};
+				for (int32 KernelIndex = 0; KernelIndex < 2; ++KernelIndex)
+				{
+					const DeepSpeechSimd::FMixFunction Mix = DeepSpeechSimd::GetMix(Kernels[KernelIndex], Format, EDeepSpeechSampleFormat::Int16);
+					StartTime = FPlatformTime::Seconds();
+					for (int32 Offset = 0; Offset < NumFrames; Offset += BlockFrames)
+					{
+						Mix(Interleaved.GetData() + (int64)Offset * NumChannels * BytesPerSample, FMath::Min(BlockFrames, NumFrames - Offset), NumChannels,
+						    Weights.GetData(), 0.0f, MixOutput.GetData());
+					}
+					MixSeconds[KernelIndex] = FPlatformTime::Seconds() - StartTime;
+				}
+
+				// Past the first second both have settled on the same DC estimate, so the outputs should only differ by rounding.
+				int32 MaxDifference = 0;
+				for (int32 Index = OutputRate; Index < FMath::Min(NumMultiPass, NumFused); ++Index)
+				{
+					MaxDifference = FMath::Max(MaxDifference, FMath::Abs(MultiPassOutput[Index] - FusedOutput[Index]));
+				}
+
+				UE_LOG(LogUETensorVox, Display,
+				       TEXT("Front end %-5s x%i %5i -> %i hz | multi pass %7.1f Mframes/s | fused (%s) %7.1f Mframes/s, %4.2fx | mix alone: scalar %7.1f, %s %7.1f Mframes/s | max difference %i"),
+				       Format == EDeepSpeechSampleFormat::Float ? TEXT("float") : TEXT("int16"), NumChannels, InputRate, OutputRate,
+				       NumFrames / FMath::Max(MultiPassSeconds, 1e-9) / 1e6, FrontEnd.GetKernelName(), NumFrames / FMath::Max(FusedSeconds, 1e-9) / 1e6,
+				       MultiPassSeconds / FMath::Max(FusedSeconds, 1e-9), NumFrames / FMath::Max(MixSeconds[0], 1e-9) / 1e6,
+				       DeepSpeechSimd::LexToString(Kernels[1]), NumFrames / FMath::Max(MixSeconds[1], 1e-9) / 1e6, MaxDifference);
+			}
+		}
+	}
+
+	/**
+	 * A min spec machine the governor can be run against without a model: finishing costs a fixed part plus a part per beam entry, and
+	 * speech work on the cores the game uses stretches the frame. Load scales both, the machine getting busier.
+	 */
+	struct FSyntheticSpeechLoad
+	{
+		int32 ModelBeamWidth = 500;
+		float FinishBaseMs = 30.0f;
+		float FinishPerBeamMs = 0.6f;
+		// Game thread time with no speech at all, and what a fully busy speech core adds to it.
+		float BaseFrameMs = 10.0f;
+		float FrameMsPerSpeechCore = 8.0f;
+		// Speech cores feeding takes, and decoding at the configured rate and full beam.
+		float FeedCores = 0.1f;
+		float DecodeCores = 0.4f;
+
+		FDeepSpeechLoadSample Measure(int32 BeamWidth, float DecodeRate, float Load, FRandomStream& Random) const
+		{
+			const int32 Width = BeamWidth > 0 ? BeamWidth : ModelBeamWidth;
+			const float SpeechCores = Load * (FeedCores + DecodeCores * DecodeRate * Width / ModelBeamWidth);
+			const float Jitter = Random.FRandRange(0.95f, 1.05f);
+
+			FDeepSpeechLoadSample Sample;
+			Sample.LatencyMs = Load * (FinishBaseMs + FinishPerBeamMs * Width) * Jitter;
+			Sample.FrameMs = (BaseFrameMs + FrameMsPerSpeechCore * SpeechCores) * Jitter;
+			// One worker, one stream: the worker's load is the stream's cost per second of audio.
+			Sample.WorkerLoad = FMath::Min(SpeechCores, 1.0f);
+			Sample.RealTimeFactor = SpeechCores;
+			return Sample;
+		}
+	};
+
+	void RunGovernor(int32 NumSteps, float Load, FGovernorReport& OutReport)
+	{
+		OutReport = FGovernorReport();
+		FDeepSpeechGovernorSettings& Settings = OutReport.Settings;
+		Settings.TargetLatencyMs = 250.0f;
+		Settings.TargetFrameMs = 16.6f;
+		// Tight enough that cost, not latency, is what holds the level down.
+		Settings.MaxRealTimeFactor = 0.25f;
+		const FSyntheticSpeechLoad Machine;
+		FRandomStream Random(0);
+
+		FDeepSpeechLoadGovernor Governor;
+		for (int32 Half = 0; Half < 2; ++Half)
+		{
+			FGovernorPhase& Phase = OutReport.Phases[Half];
+			Phase.Load = Load * (Half + 1);
+			const int32 NumHalfSteps = NumSteps / 2;
+			for (int32 Step = 0; Step < NumHalfSteps; ++Step)
+			{
+				const int32 BeamWidth = Governor.GetBeamWidth(Machine.ModelBeamWidth);
+				const float DecodeRate = Governor.GetDecodeRateScale();
+				const FDeepSpeechLoadSample Sample = Machine.Measure(BeamWidth, DecodeRate, Phase.Load, Random);
+				Governor.Decide(Sample, Settings);
+
+				UE_LOG(LogUETensorVox, Log, TEXT("Step %3i | load %.2f | beam %3i, decode rate x%.2f | latency %6.1f ms, frame %5.1f ms, RTF %.2f | pressure %.2f -> level %.2f"),
+				       Half * NumHalfSteps + Step, Phase.Load, BeamWidth > 0 ? BeamWidth : Machine.ModelBeamWidth, DecodeRate, Sample.LatencyMs, Sample.FrameMs,
+				       Sample.RealTimeFactor, Governor.GetLastPressure(), Governor.GetLevel());
+
+				if (Step >= NumHalfSteps * 3 / 4)
+				{
+					Phase.MinLevel = FMath::Min(Phase.MinLevel, Governor.GetLevel());
+					Phase.MaxLevel = FMath::Max(Phase.MaxLevel, Governor.GetLevel());
+					Phase.WorstLatencyMs = FMath::Max(Phase.WorstLatencyMs, Sample.LatencyMs);
+					Phase.WorstFrameMs = FMath::Max(Phase.WorstFrameMs, Sample.FrameMs);
+					Phase.WorstRealTimeFactor = FMath::Max(Phase.WorstRealTimeFactor, Sample.RealTimeFactor);
+				}
+			}
+
+			// Cost is a budget, not a target: at the narrowest beam and slowest decodes it can stay over without that being a failure.
+			Phase.bConverged = Phase.MaxLevel - Phase.MinLevel < 0.1f && Phase.WorstLatencyMs <= Settings.TargetLatencyMs &&
+				Phase.WorstFrameMs <= Settings.TargetFrameMs && (Phase.WorstRealTimeFactor <= Settings.MaxRealTimeFactor || Phase.MaxLevel <= 0.0f);
+		}
+	}
+
+	static void BenchmarkGovernor(const TArray<FString>& Args)
+	{
+		const int32 NumSteps = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 4) : 40;
+		const float Load = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 1.5f;
+
+		FGovernorReport Report;
+		RunGovernor(NumSteps, Load, Report);
+		const FDeepSpeechGovernorSettings& Settings = Report.Settings;
+		UE_LOG(LogUETensorVox, Display, TEXT("Governor against synthetic load %.2f, doubling halfway. Targets: latency %.0f ms, frame %.1f ms, RTF %.2f, at %.0f%%."),
+		       Load, Settings.TargetLatencyMs, Settings.TargetFrameMs, Settings.MaxRealTimeFactor, Settings.TargetUtilization * 100.0f);
+		for (const FGovernorPhase& Phase : Report.Phases)
+		{
+			UE_LOG(LogUETensorVox, Display, TEXT("Load %.2f: level %.2f to %.2f over the last quarter, worst latency %.1f ms, worst frame %.1f ms, worst RTF %.2f. %s"),
+			       Phase.Load, Phase.MinLevel, Phase.MaxLevel, Phase.WorstLatencyMs, Phase.WorstFrameMs, Phase.WorstRealTimeFactor,
+			       Phase.bConverged ? TEXT("Converged.") : TEXT("Did NOT converge."));
+		}
+	}
+
+	double Percentile(TArray<float>& Values, double Fraction)
+	{
+		if (Values.Num() == 0)
+		{
+			return 0.0;
+		}
+		Values.Sort();
+		return Values[FMath::Min(FMath::FloorToInt(Fraction * Values.Num()), Values.Num() - 1)];
+	}
+
+	static void LogLatencyPercentiles(const TCHAR* Name, TArray<float>& Values)
+	{
+		UE_LOG(LogUETensorVox, Display, TEXT("  %-22s p50 %7.1f ms | p95 %7.1f ms | p99 %7.1f ms"), Name, Percentile(Values, 0.50), Percentile(Values, 0.95),
+		       Percentile(Values, 0.99));
+	}
+
+	// Waits for the recorder's first frame, the way a session's tick would get it. 0 if none came in time.
+	static double WaitForFirstFrame(FDeepSpeechMicrophoneRecorder& Recorder, int32 FrameSamples)
+	{
+		const double Deadline = FPlatformTime::Seconds() + 2.0;
+		while (FPlatformTime::Seconds() < Deadline)
+		{
+			if (Recorder.ReadFrame(FrameSamples).Num() > 0)
+			{
+				return Recorder.GetLastFrameArrivalTime();
+			}
+			FPlatformProcess::Sleep(0.0005f);
+		}
+		return 0.0;
+	}
+
+	static void RunPressLatencyBenchmark(int32 NumPresses, float LookbackSeconds)
+	{
+		const int32 SampleRate = 16000;
+		const int32 FrameSamples = SampleRate / 50;
+		TArray<float> Reopened, Persistent;
+
+		// What every press used to cost: the source opened, started, and the first block waited for.
+		{
+			FDeepSpeechMicrophoneRecorder Recorder(FDeepSpeechAudioSources::CreateDefault());
+			for (int32 Press = 0; Press < NumPresses; ++Press)
+			{
+				const double PressTime = FPlatformTime::Seconds();
+				if (!Recorder.StartRecording(SampleRate, FrameSamples, 2.0f))
+				{
+					UE_LOG(LogUETensorVox, Error, TEXT("Couldn't start the audio source."));
+					return;
+				}
+				const double GateOpenTime = FPlatformTime::Seconds();
+				const double ArrivalTime = WaitForFirstFrame(Recorder, FrameSamples);
+				if (ArrivalTime > 0.0)
+				{
+					Reopened.Add((float)((FMath::Max(ArrivalTime, GateOpenTime) - PressTime) * 1000.0));
+				}
+				Recorder.StopRecording();
+				FPlatformProcess::Sleep(0.1f);
+			}
+		}
+
+		// The source left running, every press opens the gate on what's already there.
+		float LookbackTotal = 0.0f;
+		{
+			FDeepSpeechMicrophoneRecorder Recorder(FDeepSpeechAudioSources::CreateDefault());
+			if (!Recorder.StartGatedRecording(SampleRate, FrameSamples, 2.0f, LookbackSeconds))
+			{
+				UE_LOG(LogUETensorVox, Error, TEXT("Couldn't start the audio source."));
+				return;
+			}
+			for (int32 Press = 0; Press < NumPresses; ++Press)
+			{
+				FPlatformProcess::Sleep(0.1f + LookbackSeconds);
+				const double PressTime = FPlatformTime::Seconds();
+				LookbackTotal += Recorder.OpenGate();
+				const double GateOpenTime = FPlatformTime::Seconds();
+				const double ArrivalTime = WaitForFirstFrame(Recorder, FrameSamples);
+				if (ArrivalTime > 0.0)
+				{
+					Persistent.Add((float)((FMath::Max(ArrivalTime, GateOpenTime) - PressTime) * 1000.0));
+				}
+				Recorder.CloseGate();
+			}
+			Recorder.StopRecording();
+		}
+
+		UE_LOG(LogUETensorVox, Display, TEXT("Press to first sample over %i presses, %i and %i got audio. Persistent capture started with %.0f ms of lookback on average:"),
+		       NumPresses, Reopened.Num(), Persistent.Num(), LookbackTotal / FMath::Max(NumPresses, 1) * 1000.0f);
+		LogLatencyPercentiles(TEXT("source opened"), Reopened);
+		LogLatencyPercentiles(TEXT("persistent capture"), Persistent);
+	}
+
+	static void BenchmarkPressLatency(const TArray<FString>& Args)
+	{
+		const int32 NumPresses = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 20;
+		const float LookbackSeconds = (Args.Num() > 1 ? FMath::Max(FCString::Atof(*Args[1]), 0.0f) : 200.0f) * 0.001f;
+		Async(EAsyncExecution::Thread, [NumPresses, LookbackSeconds]()
+		{
+			RunPressLatencyBenchmark(NumPresses, LookbackSeconds);
+		});
+	}
+
+	static FAutoConsoleCommand GBenchmarkPressLatencyCommand(
+		TEXT("TensorVox.Benchmark.PressLatency"),
+		TEXT("Presses a virtual push to talk key repeatedly and reports how long the first audio takes to be there to transcribe, with the source opened ")
+		TEXT("on every press and with persistent capture. Records from TensorVox.AudioSource. Usage: TensorVox.Benchmark.PressLatency [Presses=20] [LookbackMs=200]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPressLatency));
+
+	// One file played through a whole session, from the file source to the final result.
+	// Shared with the session's callback, which may outlive the wait for it.
+	struct FLatencyRun
+	{
+		FLatencyRun() : FinalEvent(FPlatformProcess::GetSynchEventFromPool(true)) {}
+		~FLatencyRun() { FPlatformProcess::ReturnSynchEventToPool(FinalEvent); }
+
+		FEvent* FinalEvent;
+		FDeepSpeechUtteranceTimings Timings;
+		FString Transcript;
+		std::atomic<IDeepSpeechAudioSource*> Source{nullptr};
+		// The first command spotted, set on the session's worker before the stream is handed over to be finished.
+		FName Command;
+	};
+
+	bool MeasureLatency(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, float Speed, FLatencyReport& OutReport)
+	{
+		// Keeps the model resident between the sessions, and fails early if it can't be loaded.
+		const FDeepSpeechModelPtr Model = FDeepSpeechModelRegistry::Get().Acquire(Config);
+		if (!Model)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Latency benchmark couldn't load model %s."), *Config.ModelPath);
+			return false;
+		}
+
+		FDeepSpeechAudioPacing Pacing = FDeepSpeechAudioSources::GetDefaultPacing();
+		Pacing.Speed = Speed;
+
+		OutReport = FLatencyReport();
+		for (const FString& File : Files)
+		{
+			const TSharedRef<FLatencyRun, ESPMode::ThreadSafe> Run = MakeShared<FLatencyRun, ESPMode::ThreadSafe>();
+
+			const FDeepSpeechSessionPtr Session = FDeepSpeechSessionManager::Get().OpenSession(Config, FOnDeepSpeechTranscribed::CreateLambda(
+				[Run](const FString& Transcription, bool bFinal, const FDeepSpeechUtteranceTimings& Timings)
+				{
+					if (bFinal)
+					{
+						Run->Transcript = Transcription;
+						Run->Timings = Timings;
+						Run->Timings.MarkDelivered(FPlatformTime::Seconds());
+						Run->FinalEvent->Trigger();
+					}
+				}), [Run, File, Pacing]()
+				{
+					TUniquePtr<IDeepSpeechAudioSource> Source = MakeUnique<FDeepSpeechFileAudioSource>(File, Pacing);
+					Run->Source = Source.Get();
+					return Source;
+				});
+
+			// Talk for as long as the file plays, then let go like a push to talk key would.
+			Session->SetTranscriptionRequested(true);
+			const double TimeoutSeconds = 600.0;
+			const double StartTime = FPlatformTime::Seconds();
+			while (!Session->HasFailed() && FPlatformTime::Seconds() - StartTime < TimeoutSeconds)
+			{
+				const IDeepSpeechAudioSource* Source = Run->Source;
+				if (Source && Source->IsFinished())
+				{
+					break;
+				}
+				FPlatformProcess::Sleep(0.005f);
+			}
+			Session->SetTranscriptionRequested(false);
+
+			const bool bDelivered = !Session->HasFailed() && Run->FinalEvent->Wait(FTimespan::FromSeconds(30.0));
+			FDeepSpeechSessionManager::Get().CloseSession(Session);
+
+			if (bDelivered)
+			{
+				const FDeepSpeechUtteranceTimings& Timings = Run->Timings;
+				OutReport.EndToFinal.Add(Timings.EndToFinalMs);
+				OutReport.QueueWait.Add(Timings.QueueWaitMaxMs);
+				OutReport.Endpoint.Add(Timings.EndpointMs);
+				OutReport.FinishQueue.Add(Timings.FinishQueueMs);
+				OutReport.Finish.Add(Timings.FinishMs);
+				OutReport.AudioSeconds += Timings.AudioSeconds;
+				OutReport.ProcessSeconds += (Timings.FeedMs + Timings.DecodeMs + Timings.FinishMs) * 0.001;
+				UE_LOG(LogUETensorVox, Log, TEXT("%s: %.2fs voiced, end to final %.1f ms, RTF %.3f: \"%s\""), *FPaths::GetCleanFilename(File), Timings.AudioSeconds,
+				       Timings.EndToFinalMs, Timings.RealTimeFactor, *Run->Transcript);
+			}
+			else
+			{
+				OutReport.NumFailed++;
+				UE_LOG(LogUETensorVox, Warning, TEXT("%s: no final transcription."), *File);
+			}
+		}
+		return true;
+	}
+
+	static void BenchmarkLatency(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 2)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.Benchmark.Latency <ModelPath> <Directory or manifest> [Speed] [ScorerPath]"));
+			return;
+		}
+
+		FDeepSpeechConfiguration Config;
+		Config.ModelPath = Args[0];
+		if (Args.Num() > 3)
+		{
+			Config.ScorerPath = Args[3];
+		}
+
+		TArray<FString> Files;
+		if (!FDeepSpeechBatchTranscriber::GatherFiles(Args[1], Files) || Files.Num() == 0)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("No reference utterances in %s."), *Args[1]);
+			return;
+		}
+
+		// Latency only means something with the audio arriving at a real pace, so no unthrottled playback here.
+		const float Speed = Args.Num() > 2 ? FMath::Max(FCString::Atof(*Args[2]), 0.1f) : 1.0f;
+		Async(EAsyncExecution::Thread, [Config, Files = MoveTemp(Files), Speed]()
+		{
+			FLatencyReport Report;
+			if (MeasureLatency(Config, Files, Speed, Report))
+			{
+				UE_LOG(LogUETensorVox, Display, TEXT("Latency over %i utterances (%i failed) at %.1fx speed, %.1fs of voiced audio, real time factor %.3f:"),
+				       Report.EndToFinal.Num(), Report.NumFailed, Speed, Report.AudioSeconds, Report.GetRealTimeFactor());
+				LogLatencyPercentiles(TEXT("End to final"), Report.EndToFinal);
+				LogLatencyPercentiles(TEXT("Capture to feed (max)"), Report.QueueWait);
+				LogLatencyPercentiles(TEXT("Last voice to endpoint"), Report.Endpoint);
+				LogLatencyPercentiles(TEXT("Finish queue"), Report.FinishQueue);
+				LogLatencyPercentiles(TEXT("Finish"), Report.Finish);
+			}
+		});
+	}
+
+	static FAutoConsoleCommand GBenchmarkLatencyCommand(
+		TEXT("TensorVox.Benchmark.Latency"),
+		TEXT("Plays every reference utterance in a directory or manifest through its own session at the given speed and reports end to final, ")
+		TEXT("stage latency percentiles and the real time factor, the TensorVox.Pipeline.Latency test checks them. ")
+		TEXT("Usage: TensorVox.Benchmark.Latency <ModelPath> <Directory or manifest> [Speed] [ScorerPath]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkLatency));
+
+	bool MeasureCommands(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, const TArray<FName>& Expected,
+	                     const FDeepSpeechCommandGrammarPtr& Grammar, FCommandReport& OutReport)
+	{
+		const FDeepSpeechModelPtr Model = FDeepSpeechModelRegistry::Get().Acquire(Config);
+		if (!Model)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Command benchmark couldn't load model %s."), *Config.ModelPath);
+			return false;
+		}
+
+		const FDeepSpeechAudioPacing Pacing = FDeepSpeechAudioSources::GetDefaultPacing();
+		OutReport = FCommandReport();
+
+		for (int32 Index = 0; Index < Files.Num(); ++Index)
+		{
+			const FString& File = Files[Index];
+			const TSharedRef<FLatencyRun, ESPMode::ThreadSafe> Run = MakeShared<FLatencyRun, ESPMode::ThreadSafe>();
+
+			const FDeepSpeechSessionPtr Session = FDeepSpeechSessionManager::Get().OpenSession(Config, FOnDeepSpeechTranscribed::CreateLambda(
+				[Run](const FString& Transcription, bool bFinal, const FDeepSpeechUtteranceTimings& Timings)
+				{
+					if (bFinal)
+					{
+						Run->Transcript = Transcription;
+						Run->Timings = Timings;
+						Run->Timings.MarkDelivered(FPlatformTime::Seconds());
+						Run->FinalEvent->Trigger();
+					}
+				}), [Run, File, Pacing]()
+				{
+					TUniquePtr<IDeepSpeechAudioSource> Source = MakeUnique<FDeepSpeechFileAudioSource>(File, Pacing);
+					Run->Source = Source.Get();
+					return Source;
+				});
+			Session->SetCommands(Grammar, FOnDeepSpeechCommand::CreateLambda([Run](const FDeepSpeechCommandMatch& Match)
+			{
+				if (Run->Command.IsNone())
+				{
+					Run->Command = Match.Command;
+				}
+			}));
+
+			Session->SetTranscriptionRequested(true);
+			const double StartTime = FPlatformTime::Seconds();
+			while (!Session->HasFailed() && FPlatformTime::Seconds() - StartTime < 600.0)
+			{
+				const IDeepSpeechAudioSource* Source = Run->Source;
+				if (Source && Source->IsFinished())
+				{
+					break;
+				}
+				FPlatformProcess::Sleep(0.005f);
+			}
+			Session->SetTranscriptionRequested(false);
+
+			const bool bDelivered = !Session->HasFailed() && Run->FinalEvent->Wait(FTimespan::FromSeconds(30.0));
+			FDeepSpeechSessionManager::Get().CloseSession(Session);
+			if (!bDelivered)
+			{
+				OutReport.NumFailed++;
+				UE_LOG(LogUETensorVox, Warning, TEXT("%s: no final transcription."), *File);
+				continue;
+			}
+
+			const FDeepSpeechUtteranceTimings& Timings = Run->Timings;
+			OutReport.EndToFinal.Add(Timings.EndToFinalMs);
+			if (Run->Command.IsNone())
+			{
+				OutReport.NumMissed++;
+			}
+			else
+			{
+				OutReport.NumCorrect += Run->Command == Expected[Index] ? 1 : 0;
+				OutReport.NumWrong += Run->Command != Expected[Index] ? 1 : 0;
+				OutReport.EndToCommand.Add(Timings.EndToCommandMs);
+				OutReport.Lead.Add(Timings.CommandLeadMs + Timings.DeliveryMs);
+			}
+			UE_LOG(LogUETensorVox, Log, TEXT("%s: expected %s, heard %s, end to command %.1f ms, end to final %.1f ms: \"%s\""), *FPaths::GetCleanFilename(File),
+			       *Expected[Index].ToString(), *Run->Command.ToString(), Timings.EndToCommandMs, Timings.EndToFinalMs, *Run->Transcript);
+		}
+		return true;
+	}
+
+	bool MakeCommandCorpus(const TArray<FString>& AllFiles, TArray<FString>& OutFiles, TArray<FName>& OutExpected, FDeepSpeechCommandGrammarPtr& OutGrammar)
+	{
+		// Every reference transcript is a command of its own, named after its file, so they compete with each other like a real grammar.
+		OutFiles.Reset();
+		OutExpected.Reset();
+		TMap<FString, FName> PhrasesToCommands;
+		for (const FString& File : AllFiles)
+		{
+			FString Reference;
+			if (FFileHelper::LoadFileToString(Reference, *FPaths::ChangeExtension(File, TEXT("txt"))) && !Reference.TrimStartAndEnd().IsEmpty())
+			{
+				const FName Command(*FPaths::GetBaseFilename(File));
+				PhrasesToCommands.Add(Reference.TrimStartAndEnd(), Command);
+				OutFiles.Add(File);
+				OutExpected.Add(Command);
+			}
+		}
+		OutGrammar = FDeepSpeechCommandGrammar::Compile(PhrasesToCommands);
+		return OutFiles.Num() > 0;
+	}
+
+	static void BenchmarkCommands(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 2)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.Benchmark.Commands <ModelPath> <Directory or manifest> [FuzzyTolerance=0.2] [Prefix=0] [ScorerPath]"));
+			return;
+		}
+
+		FDeepSpeechConfiguration Config;
+		Config.ModelPath = Args[0];
+		Config.CommandFuzzyTolerance = Args.Num() > 2 ? FMath::Clamp(FCString::Atof(*Args[2]), 0.0f, 0.5f) : 0.2f;
+		Config.bCommandsFireOnUniquePrefix = Args.Num() > 3 && FCString::Atoi(*Args[3]) != 0;
+		if (Args.Num() > 4)
+		{
+			Config.ScorerPath = Args[4];
+		}
+
+		TArray<FString> AllFiles;
+		if (!FDeepSpeechBatchTranscriber::GatherFiles(Args[1], AllFiles))
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("No reference utterances in %s."), *Args[1]);
+			return;
+		}
+
+		TArray<FString> Files;
+		TArray<FName> Expected;
+		FDeepSpeechCommandGrammarPtr Grammar;
+		if (!MakeCommandCorpus(AllFiles, Files, Expected, Grammar))
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("No utterance in %s has a transcript next to it to use as its command."), *Args[1]);
+			return;
+		}
+
+		Async(EAsyncExecution::Thread, [Config, Files = MoveTemp(Files), Expected = MoveTemp(Expected), Grammar]()
+		{
+			FCommandReport Report;
+			if (MeasureCommands(Config, Files, Expected, Grammar, Report))
+			{
+				UE_LOG(LogUETensorVox, Display, TEXT("Commands over %i utterances (%i failed): %i right, %i wrong, %i missed, stability %i, fuzzy tolerance %.2f%s%s."),
+				       Report.EndToFinal.Num(), Report.NumFailed, Report.NumCorrect, Report.NumWrong, Report.NumMissed, Config.CommandStabilityDecodes,
+				       Config.CommandFuzzyTolerance, Config.bCommandsFireOnUniquePrefix ? TEXT(", unique prefixes") : TEXT(""),
+				       Config.bEndUtteranceOnCommand ? TEXT(", ending utterances") : TEXT(""));
+				LogLatencyPercentiles(TEXT("End to command"), Report.EndToCommand);
+				LogLatencyPercentiles(TEXT("End to final"), Report.EndToFinal);
+				LogLatencyPercentiles(TEXT("Command ahead of final"), Report.Lead);
+			}
+		});
+	}
+
+	static FAutoConsoleCommand GBenchmarkCommandsCommand(
+		TEXT("TensorVox.Benchmark.Commands"),
+		TEXT("Uses every reference transcript in a directory or manifest as a command, plays each utterance through its own session in real time and ")
+		TEXT("reports how many commands were spotted right, and end of speech to command against end of speech to final result. The TensorVox.Pipeline.Commands ")
+		TEXT("test checks them. ")
+		TEXT("Usage: TensorVox.Benchmark.Commands <ModelPath> <Directory or manifest> [FuzzyTolerance=0.2] [Prefix=0] [ScorerPath]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkCommands));
+
+	// Word level edit distance over the number of reference words.
+	static double WordErrorRate(const FString& Reference, const FString& Hypothesis)
+	{
+		TArray<FString> ReferenceWords, HypothesisWords;
+		Reference.ToLower().ParseIntoArrayWS(ReferenceWords);
+		Hypothesis.ToLower().ParseIntoArrayWS(HypothesisWords);
+		if (ReferenceWords.Num() == 0)
+		{
+			return HypothesisWords.Num() > 0 ? 1.0 : 0.0;
+		}
+
+		TArray<int32> Previous, Current;
+		Previous.SetNumUninitialized(HypothesisWords.Num() + 1);
+		Current.SetNumUninitialized(HypothesisWords.Num() + 1);
+		for (int32 Column = 0; Column <= HypothesisWords.Num(); ++Column)
+		{
+			Previous[Column] = Column;
+		}
+		for (int32 Row = 1; Row <= ReferenceWords.Num(); ++Row)
+		{
+			Current[0] = Row;
+			for (int32 Column = 1; Column <= HypothesisWords.Num(); ++Column)
+			{
+				const int32 Substitution = Previous[Column - 1] + (ReferenceWords[Row - 1] == HypothesisWords[Column - 1] ? 0 : 1);
+				Current[Column] = FMath::Min3(Substitution, Previous[Column] + 1, Current[Column - 1] + 1);
+			}
+			Swap(Previous, Current);
+		}
+		return (double)Previous[HypothesisWords.Num()] / ReferenceWords.Num();
+	}
+
+	// A reference utterance split the way a session would see it: the voiced part, and the noise around it for padding.
+	struct FPaddingUtterance
+	{
+		FString File;
+		FString Reference;
+		TArray<int16> Speech;
+		FDeepSpeechNoiseFloor NoiseFloor;
+	};
+
+	// Frames quieter than a few times the quietest tenth of the file are noise, speech runs from the first loud frame to the last.
+	static void SplitNoise(const TArray<int16>& Samples, int32 FrameSamples, int32 NoiseSamples, FPaddingUtterance& OutUtterance)
+	{
+		const int32 NumFrames = Samples.Num() / FrameSamples;
+		TArray<float> Levels;
+		Levels.SetNumUninitialized(NumFrames);
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			double Sum = 0.0;
+			for (int32 Index = Frame * FrameSamples; Index < (Frame + 1) * FrameSamples; ++Index)
+			{
+				Sum += FMath::Abs((int32)Samples[Index]);
+			}
+			Levels[Frame] = Sum / FrameSamples;
+		}
+
+		TArray<float> Sorted = Levels;
+		const float Threshold = FMath::Max((float)Percentile(Sorted, 0.1) * 4.0f, 100.0f);
+
+		int32 First = NumFrames, Last = -1;
+		OutUtterance.NoiseFloor.Initialize(NoiseSamples);
+		for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+		{
+			if (Levels[Frame] >= Threshold)
+			{
+				First = FMath::Min(First, Frame);
+				Last = Frame;
+			}
+			else
+			{
+				OutUtterance.NoiseFloor.Add(Samples.GetData() + Frame * FrameSamples, FrameSamples);
+			}
+		}
+
+		if (Last >= First)
+		{
+			OutUtterance.Speech = TArray<int16>(Samples.GetData() + First * FrameSamples, (Last - First + 1) * FrameSamples);
+		}
+	}
+
+	const FPaddingResult* FPaddingReport::Find(int32 LeadMs, int32 TrailMs) const
+	{
+		return Results.FindByPredicate([LeadMs, TrailMs](const FPaddingResult& Result)
+		{
+			return Result.LeadMs == LeadMs && Result.TrailMs == TrailMs;
+		});
+	}
+
+	bool MeasurePadding(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, FPaddingReport& OutReport)
+	{
+#if TENSORVOX_VALID_PLATFORM
+		const FDeepSpeechModelPtr Model = FDeepSpeechModelRegistry::Get().Acquire(Config);
+		if (!Model)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Padding benchmark couldn't load model %s."), *Config.ModelPath);
+			return false;
+		}
+
+		const int32 SampleRate = Model->GetSampleRate();
+		const int32 LeadSteps[] = {0, 50, 100, 150, 200, 300};
+		const int32 TrailSteps[] = {0, 50, 100, 200};
+		const int32 WidestLeadMs = LeadSteps[UE_ARRAY_COUNT(LeadSteps) - 1], WidestTrailMs = TrailSteps[UE_ARRAY_COUNT(TrailSteps) - 1];
+
+		// The noise rings are cache line aligned, keep them where the allocator put them.
+		TArray<TUniquePtr<FPaddingUtterance>> Utterances;
+		for (const FString& File : Files)
+		{
+			TArray<int16> Samples;
+			double Seconds;
+			FString Error;
+			if (!FDeepSpeechBatchTranscriber::LoadWave(File, SampleRate, Samples, Seconds, Error))
+			{
+				UE_LOG(LogUETensorVox, Warning, TEXT("%s: %s"), *File, *Error);
+				continue;
+			}
+
+			FPaddingUtterance& Utterance = *Utterances.Add_GetRef(MakeUnique<FPaddingUtterance>());
+			Utterance.File = File;
+			SplitNoise(Samples, SampleRate / 50, SampleRate * FMath::Max(WidestLeadMs, WidestTrailMs) / 1000, Utterance);
+			// A transcript next to the file is the ground truth, otherwise the widest padding is.
+			FFileHelper::LoadFileToString(Utterance.Reference, *FPaths::ChangeExtension(File, TEXT("txt")));
+			Utterance.Reference.TrimStartAndEndInline();
+		}
+
+		const auto Transcribe = [&Model, SampleRate](const FPaddingUtterance& Utterance, int32 LeadMs, int32 TrailMs, double& InOutSeconds)
+		{
+			const double StartTime = FPlatformTime::Seconds();
+			FDeepSpeechInferenceScope InferenceScope(*Model);
+			StreamingState* Stream = nullptr;
+			if (FDeepSpeechModel::CheckForError(TEXT("Padding CreateStream"), Model->CreateStream(Stream)))
+			{
+				return FString();
+			}
+			Utterance.NoiseFloor.Feed(Stream, SampleRate * LeadMs / 1000);
+			DS_FeedAudioContent(Stream, Utterance.Speech.GetData(), Utterance.Speech.Num());
+			Utterance.NoiseFloor.Feed(Stream, SampleRate * TrailMs / 1000);
+			char* Text = DS_FinishStream(Stream);
+			const FString Result = Text ? FString(UTF8_TO_TCHAR(Text)) : FString();
+			if (Text)
+			{
+				DS_FreeString(Text);
+			}
+			InOutSeconds += FPlatformTime::Seconds() - StartTime;
+			return Result;
+		};
+
+		double WidestSeconds = 0.0;
+		TArray<FString> References;
+		for (const TUniquePtr<FPaddingUtterance>& Utterance : Utterances)
+		{
+			const FString Widest = Transcribe(*Utterance, WidestLeadMs, WidestTrailMs, WidestSeconds);
+			References.Add(Utterance->Reference.IsEmpty() ? Widest : Utterance->Reference);
+		}
+
+		OutReport = FPaddingReport();
+		OutReport.NumUtterances = Utterances.Num();
+		for (const int32 LeadMs : LeadSteps)
+		{
+			for (const int32 TrailMs : TrailSteps)
+			{
+				double Seconds = 0.0, ErrorSum = 0.0;
+				for (int32 Index = 0; Index < Utterances.Num(); ++Index)
+				{
+					ErrorSum += WordErrorRate(References[Index], Transcribe(*Utterances[Index], LeadMs, TrailMs, Seconds));
+				}
+				FPaddingResult& Result = OutReport.Results.AddDefaulted_GetRef();
+				Result.LeadMs = LeadMs;
+				Result.TrailMs = TrailMs;
+				Result.WordErrorRate = ErrorSum / FMath::Max(Utterances.Num(), 1);
+				Result.InferenceMs = Seconds / FMath::Max(Utterances.Num(), 1) * 1000.0;
+			}
+		}
+
+		// The cheapest padding that's still as accurate as the widest, give or take half a point.
+		OutReport.Best = OutReport.Results.Last();
+		for (const FPaddingResult& Result : OutReport.Results)
+		{
+			if (Result.WordErrorRate <= OutReport.Results.Last().WordErrorRate + 0.005 && Result.InferenceMs < OutReport.Best.InferenceMs)
+			{
+				OutReport.Best = Result;
+			}
+		}
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	static void BenchmarkPadding(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 2)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.Benchmark.Padding <ModelPath> <Directory or manifest> [ScorerPath]"));
+			return;
+		}
+
+		FDeepSpeechConfiguration Config;
+		Config.ModelPath = Args[0];
+		if (Args.Num() > 2)
+		{
+			Config.ScorerPath = Args[2];
+		}
+
+		TArray<FString> Files;
+		if (!FDeepSpeechBatchTranscriber::GatherFiles(Args[1], Files) || Files.Num() == 0)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("No reference utterances in %s."), *Args[1]);
+			return;
+		}
+
+		Async(EAsyncExecution::Thread, [Config, Files = MoveTemp(Files)]()
+		{
+			FPaddingReport Report;
+			if (!MeasurePadding(Config, Files, Report))
+			{
+				return;
+			}
+
+			UE_LOG(LogUETensorVox, Display, TEXT("Padding sweep over %i utterances, word error rate and inference time per utterance:"), Report.NumUtterances);
+			for (const FPaddingResult& Result : Report.Results)
+			{
+				UE_LOG(LogUETensorVox, Display, TEXT("  lead %3i ms, trail %3i ms: WER %5.1f%%, %7.1f ms"), Result.LeadMs, Result.TrailMs, Result.WordErrorRate * 100.0,
+				       Result.InferenceMs);
+			}
+			const FPaddingResult& Widest = Report.Results.Last();
+			UE_LOG(LogUETensorVox, Display, TEXT("Cheapest padding within 0.5%% WER of lead %i / trail %i ms: lead %i ms, trail %i ms, saving %.1f ms per utterance."),
+			       Widest.LeadMs, Widest.TrailMs, Report.Best.LeadMs, Report.Best.TrailMs, Widest.InferenceMs - Report.Best.InferenceMs);
+		});
+	}
+
+	static FAutoConsoleCommand GBenchmarkPaddingCommand(
+		TEXT("TensorVox.Benchmark.Padding"),
+		TEXT("Transcribes every reference utterance with a range of lead and trail padding lengths and reports the word error rate and inference time ")
+		TEXT("of each, against .txt transcripts next to the files or the widest padding. The TensorVox.Pipeline.Padding test checks the default padding against them. ")
+		TEXT("Usage: TensorVox.Benchmark.Padding <ModelPath> <Directory or manifest> [ScorerPath]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkPadding));
+
+	static void RunHotWordBenchmark(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, float Boost)
+	{
+#if TENSORVOX_VALID_PLATFORM
+		const FDeepSpeechModelPtr Model = FDeepSpeechModelRegistry::Get().Acquire(Config);
+		if (!Model)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Hot word benchmark couldn't load model %s."), *Config.ModelPath);
+			return;
+		}
+
+		const int32 SampleRate = Model->GetSampleRate();
+		TArray<TArray<int16>> Utterances;
+		TArray<FString> Words;
+		double AudioSeconds = 0.0;
+		for (const FString& File : Files)
+		{
+			double Seconds;
+			FString Error;
+			if (!FDeepSpeechBatchTranscriber::LoadWave(File, SampleRate, Utterances.AddDefaulted_GetRef(), Seconds, Error))
+			{
+				UE_LOG(LogUETensorVox, Warning, TEXT("%s: %s"), *File, *Error);
+				Utterances.Pop();
+				continue;
+			}
+			AudioSeconds += Seconds;
+
+			// Words that are actually said make the decoder do real work with them, the rest are made up.
+			FString Reference;
+			if (FFileHelper::LoadFileToString(Reference, *FPaths::ChangeExtension(File, TEXT("txt"))))
+			{
+				TArray<FString> FileWords;
+				Reference.ToLower().ParseIntoArrayWS(FileWords);
+				for (const FString& Word : FileWords)
+				{
+					Words.AddUnique(Word);
+				}
+			}
+		}
+
+		FRandomStream Random(1337);
+		const int32 Counts[] = {0, 10, 50, 100, 250, 500, 1000};
+		while (Words.Num() < Counts[UE_ARRAY_COUNT(Counts) - 1])
+		{
+			FString Word;
+			for (int32 Letter = Random.RandRange(4, 9); Letter > 0; --Letter)
+			{
+				Word.AppendChar(TEXT('a') + Random.RandRange(0, 25));
+			}
+			Words.AddUnique(Word);
+		}
+
+		// Fed and decoded the way a session does it by default.
+		const int32 ChunkSamples = SampleRate / 5;
+		UE_LOG(LogUETensorVox, Display, TEXT("Hot word cost over %i utterances (%.1fs), boost %.1f, per utterance:"), Utterances.Num(), AudioSeconds, Boost);
+		double BaselineDecodeMs = 0.0;
+		for (const int32 Count : Counts)
+		{
+			FDeepSpeechHotWords HotWords;
+			for (int32 Index = 0; Index < Count; ++Index)
+			{
+				HotWords.Add(Words[Index], Boost);
+			}
+
+			double CreateSeconds = 0.0, DecodeSeconds = 0.0, FinishSeconds = 0.0;
+			for (const TArray<int16>& Samples : Utterances)
+			{
+				StreamingState* Stream = nullptr;
+				double StartTime = FPlatformTime::Seconds();
+				{
+					FDeepSpeechInferenceScope InferenceScope(*Model);
+					if (FDeepSpeechModel::CheckForError(TEXT("Hot word CreateStream"), Model->CreateStream(Stream, HotWords)))
+					{
+						continue;
+					}
+				}
+				CreateSeconds += FPlatformTime::Seconds() - StartTime;
+
+				for (int32 Offset = 0; Offset < Samples.Num(); Offset += ChunkSamples)
+				{
+					{
+						FDeepSpeechInferenceScope InferenceScope(*Model);
+						DS_FeedAudioContent(Stream, Samples.GetData() + Offset, FMath::Min(ChunkSamples, Samples.Num() - Offset));
+					}
+					StartTime = FPlatformTime::Seconds();
+					DS_FreeString(DS_IntermediateDecode(Stream));
+					DecodeSeconds += FPlatformTime::Seconds() - StartTime;
+				}
+
+				StartTime = FPlatformTime::Seconds();
+				{
+					FDeepSpeechInferenceScope InferenceScope(*Model);
+					DS_FreeString(DS_FinishStream(Stream));
+				}
+				FinishSeconds += FPlatformTime::Seconds() - StartTime;
+			}
+
+			const double Scale = 1000.0 / FMath::Max(Utterances.Num(), 1);
+			if (Count == 0)
+			{
+				BaselineDecodeMs = DecodeSeconds * Scale;
+			}
+			UE_LOG(LogUETensorVox, Display, TEXT("  %4i hot words: create %6.2f ms, intermediate decodes %7.1f ms (%+.0f%%), finish %7.1f ms"), Count,
+			       CreateSeconds * Scale, DecodeSeconds * Scale, BaselineDecodeMs > 0.0 ? (DecodeSeconds * Scale / BaselineDecodeMs - 1.0) * 100.0 : 0.0,
+			       FinishSeconds * Scale);
+		}
+
+		// Leave the shared model the way sessions expect to find it.
+		StreamingState* Stream = nullptr;
+		FDeepSpeechInferenceScope InferenceScope(*Model);
+		if (Model->CreateStream(Stream) == 0)
+		{
+			DS_FreeStream(Stream);
+		}
+#endif
+	}
+
+	static void BenchmarkHotWords(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 3)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.Benchmark.HotWords <ModelPath> <Directory or manifest> <ScorerPath> [Boost]"));
+			return;
+		}
+
+		// Hot words only change how the scorer rates prefixes, without one they cost nothing.
+		FDeepSpeechConfiguration Config;
+		Config.ModelPath = Args[0];
+		Config.ScorerPath = Args[2];
+
+		TArray<FString> Files;
+		if (!FDeepSpeechBatchTranscriber::GatherFiles(Args[1], Files) || Files.Num() == 0)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("No reference utterances in %s."), *Args[1]);
+			return;
+		}
+
+		const float Boost = Args.Num() > 3 ? FCString::Atof(*Args[3]) : 5.0f;
+		Async(EAsyncExecution::Thread, [Config, Files = MoveTemp(Files), Boost]()
+		{
+			RunHotWordBenchmark(Config, Files, Boost);
+		});
+	}
+
+	static FAutoConsoleCommand GBenchmarkHotWordsCommand(
+		TEXT("TensorVox.Benchmark.HotWords"),
+		TEXT("Transcribes every reference utterance with 0 to 1000 hot words and reports the cost of creating streams, intermediate decodes and finishing. ")
+		TEXT("Usage: TensorVox.Benchmark.HotWords <ModelPath> <Directory or manifest> <ScorerPath> [Boost]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkHotWords));
+
+	// Speech segments in seconds, one "start end [label]" per line like Audacity exports label tracks.
+	static bool LoadSpeechLabels(const FString& File, TArray<TTuple<double, double>>& OutSegments)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *FPaths::ChangeExtension(File, TEXT("lab"))))
+		{
+			return false;
+		}
+
+		for (const FString& Line : Lines)
+		{
+			TArray<FString> Fields;
+			if (Line.ParseIntoArrayWS(Fields) >= 2)
+			{
+				OutSegments.Emplace(FCString::Atod(*Fields[0]), FCString::Atod(*Fields[1]));
+			}
+		}
+		return true;
+	}
+
+	static void RunVadBenchmark(const TArray<FString>& Files, int32 Aggressiveness)
+	{
+		const int32 SampleRate = 16000;
+		const int32 FrameSamples = SampleRate / 50;
+
+		struct FCorpusFile
+		{
+			TArray<int16> Samples;
+			// Per frame, true if the frame's middle is inside a labelled speech segment.
+			TArray<bool> Speech;
+		};
+
+		TArray<FCorpusFile> Corpus;
+		int32 NumFrames = 0, NumSpeechFrames = 0;
+		for (const FString& File : Files)
+		{
+			TArray<TTuple<double, double>> Segments;
+			if (!LoadSpeechLabels(File, Segments))
+			{
+				UE_LOG(LogUETensorVox, Warning, TEXT("%s has no .lab file next to it, skipped."), *File);
+				continue;
+			}
+
+			FCorpusFile& CorpusFile = Corpus.AddDefaulted_GetRef();
+			double Seconds;
+			FString Error;
+			if (!FDeepSpeechBatchTranscriber::LoadWave(File, SampleRate, CorpusFile.Samples, Seconds, Error))
+			{
+				UE_LOG(LogUETensorVox, Warning, TEXT("%s: %s"), *File, *Error);
+				Corpus.Pop();
+				continue;
+			}
+
+			const int32 NumFileFrames = CorpusFile.Samples.Num() / FrameSamples;
+			CorpusFile.Speech.SetNumZeroed(NumFileFrames);
+			for (int32 Frame = 0; Frame < NumFileFrames; ++Frame)
+			{
+				const double Middle = (Frame + 0.5) * FrameSamples / SampleRate;
+				CorpusFile.Speech[Frame] = Segments.ContainsByPredicate([Middle](const TTuple<double, double>& Segment)
+				{
+					return Middle >= Segment.Get<0>() && Middle < Segment.Get<1>();
+				});
+				NumSpeechFrames += CorpusFile.Speech[Frame] ? 1 : 0;
+			}
+			NumFrames += NumFileFrames;
+		}
+
+		if (NumFrames == 0)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("VAD benchmark found no labelled audio."));
+			return;
+		}
+
+		UE_LOG(LogUETensorVox, Display, TEXT("VAD comparison over %.1f s of labelled audio, %.1f%% speech, aggressiveness %i:"),
+		       (double)NumFrames * FrameSamples / SampleRate, 100.0 * NumSpeechFrames / NumFrames, Aggressiveness);
+
+		const EDeepSpeechVoiceDetector Detectors[] = {EDeepSpeechVoiceDetector::WebRtc, EDeepSpeechVoiceDetector::Builtin, EDeepSpeechVoiceDetector::Off};
+		for (const EDeepSpeechVoiceDetector Detector : Detectors)
+		{
+			if (FDeepSpeechVoiceDetector::Resolve(Detector) != Detector)
+			{
+				continue;
+			}
+
+			int32 NumPassed = 0, NumSpeechPassed = 0;
+			double Seconds = 0.0;
+			// Decisions hashed in order, the built in detector must come out the same on every platform.
+			uint32 DecisionHash = 0;
+			for (const FCorpusFile& CorpusFile : Corpus)
+			{
+				// Every file is its own recording, with its own noise floor.
+				FDeepSpeechVoiceDetector VoiceDetector;
+				VoiceDetector.Initialize(Detector, Aggressiveness, SampleRate, FrameSamples);
+				for (int32 Frame = 0; Frame < CorpusFile.Speech.Num(); ++Frame)
+				{
+					const double StartTime = FPlatformTime::Seconds();
+					const bool bVoiced = VoiceDetector.ProcessFrame(CorpusFile.Samples.GetData() + Frame * FrameSamples);
+					Seconds += FPlatformTime::Seconds() - StartTime;
+
+					NumPassed += bVoiced ? 1 : 0;
+					NumSpeechPassed += bVoiced && CorpusFile.Speech[Frame] ? 1 : 0;
+					DecisionHash = HashCombine(DecisionHash, bVoiced ? 1 : 0);
+				}
+			}
+
+			const int32 NumNoiseFrames = NumFrames - NumSpeechFrames;
+			UE_LOG(LogUETensorVox, Display, TEXT("  %-8s let through %5.1f%% of the audio: %5.1f%% of speech, %5.1f%% of non speech. %.2f us per frame, %.3f%% of a core. Decisions %08x"),
+			       *StaticEnum<EDeepSpeechVoiceDetector>()->GetNameStringByValue((int64)Detector), 100.0 * NumPassed / NumFrames,
+			       100.0 * NumSpeechPassed / FMath::Max(NumSpeechFrames, 1), 100.0 * (NumPassed - NumSpeechPassed) / FMath::Max(NumNoiseFrames, 1),
+			       Seconds * 1e6 / NumFrames, 100.0 * Seconds / ((double)NumFrames * FrameSamples / SampleRate), DecisionHash);
+		}
+	}
+
+	static void BenchmarkVad(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 1)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.Benchmark.Vad <Directory or manifest> [Aggressiveness]"));
+			return;
+		}
+
+		TArray<FString> Files;
+		if (!FDeepSpeechBatchTranscriber::GatherFiles(Args[0], Files) || Files.Num() == 0)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("No labelled audio in %s."), *Args[0]);
+			return;
+		}
+
+		const int32 Aggressiveness = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 0;
+		Async(EAsyncExecution::Thread, [Files = MoveTemp(Files), Aggressiveness]()
+		{
+			RunVadBenchmark(Files, Aggressiveness);
+		});
+	}
+
+	static FAutoConsoleCommand GBenchmarkVadCommand(
+		TEXT("TensorVox.Benchmark.Vad"),
+		TEXT("Runs every voice activity detector available on this platform over audio labelled with speech segments (a .lab file of \"start end\" ")
+		TEXT("seconds next to each file) and reports how much audio, speech and non speech each lets through, and what it costs. ")
+		TEXT("Usage: TensorVox.Benchmark.Vad <Directory or manifest> [Aggressiveness]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkVad));
+
+	bool MeasureServer(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, int32 NumStreams, double Seconds, FServerReport& OutReport)
+	{
+		const FDeepSpeechModelPtr Model = FDeepSpeechModelRegistry::Get().Acquire(Config);
+		if (!Model)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Server benchmark couldn't load model %s."), *Config.ModelPath);
+			return false;
+		}
+
+		const int32 SampleRate = 16000;
+		TArray<TArray<int16>> Utterances;
+		for (const FString& File : Files)
+		{
+			double FileSeconds;
+			FString Error;
+			if (!FDeepSpeechBatchTranscriber::LoadWave(File, SampleRate, Utterances.AddDefaulted_GetRef(), FileSeconds, Error))
+			{
+				UE_LOG(LogUETensorVox, Warning, TEXT("%s: %s"), *File, *Error);
+				Utterances.Pop();
+			}
+		}
+		if (Utterances.Num() == 0)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Server benchmark couldn't load any audio."));
+			return false;
+		}
+
+		// Every stream plays the corpus end to end on a loop, each from its own offset so they don't all talk at once.
+		TArray<int16> Corpus;
+		for (const TArray<int16>& Utterance : Utterances)
+		{
+			Corpus.Append(Utterance);
+		}
+
+		FDeepSpeechStreamService Service(Config);
+		const TSharedRef<std::atomic<int32>, ESPMode::ThreadSafe> NumFinals = MakeShared<std::atomic<int32>, ESPMode::ThreadSafe>(0);
+
+		struct FPlayer
+		{
+			FDeepSpeechServiceStreamPtr Stream;
+			int32 Position = 0;
+		};
+		TArray<FPlayer> Players;
+		int32 NumAttempted = 0;
+
+		const int32 BlockSamples = SampleRate / 50;
+		const double BlockSeconds = (double)BlockSamples / SampleRate;
+		// New players join over the first quarter of the run, like a server filling up.
+		const double RampSeconds = Seconds * 0.25;
+		OutReport = FServerReport();
+
+		const double StartTime = FPlatformTime::Seconds();
+		double NextBlockTime = StartTime;
+		double NextSampleTime = StartTime + 1.0;
+		while (NextBlockTime - StartTime < Seconds)
+		{
+			const double Elapsed = NextBlockTime - StartTime;
+			while (NumAttempted < NumStreams && Elapsed >= RampSeconds * NumAttempted / NumStreams)
+			{
+				NumAttempted++;
+				const FDeepSpeechServiceStreamPtr Stream = Service.OpenStream(SampleRate, FOnDeepSpeechTranscribed::CreateLambda(
+					[NumFinals](const FString& Transcription, bool bFinal, const FDeepSpeechUtteranceTimings& Timings)
+					{
+						if (bFinal)
+						{
+							NumFinals->fetch_add(1, std::memory_order_relaxed);
+						}
+					}));
+				if (Stream)
+				{
+					FPlayer& Player = Players.AddDefaulted_GetRef();
+					Player.Stream = Stream;
+					Player.Position = (int32)(((int64)Corpus.Num() * (NumAttempted - 1) / NumStreams) % Corpus.Num());
+				}
+			}
+
+			for (FPlayer& Player : Players)
+			{
+				const int32 NumSamples = FMath::Min(BlockSamples, Corpus.Num() - Player.Position);
+				Player.Stream->PushAudio(Corpus.GetData() + Player.Position, NumSamples);
+				Player.Position = (Player.Position + NumSamples) % Corpus.Num();
+			}
+
+			if (NextBlockTime >= NextSampleTime)
+			{
+				NextSampleTime += 1.0;
+				OutReport.PeakUtilization = FMath::Max(OutReport.PeakUtilization, Service.GetUtilization());
+				for (const FPlayer& Player : Players)
+				{
+					OutReport.LagMs.Add(Player.Stream->GetLagSeconds() * 1000.0f);
+				}
+			}
+
+			// Paced against the start, so a slow iteration is caught up on instead of stretching the run.
+			NextBlockTime += BlockSeconds;
+			const double Wait = NextBlockTime - FPlatformTime::Seconds();
+			if (Wait > 0.0)
+			{
+				FPlatformProcess::Sleep((float)Wait);
+			}
+		}
+
+		OutReport.NumAdmitted = Players.Num();
+		OutReport.NumRejected = Service.GetNumRejected();
+		OutReport.NumFinals = NumFinals->load();
+		OutReport.Utilization = Service.GetUtilization();
+		Service.CloseAllStreams();
+		return true;
+	}
+
+	static void BenchmarkServer(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 2)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.Benchmark.Server <ModelPath> <Directory or manifest> [Streams] [Seconds] [ScorerPath]"));
+			return;
+		}
+
+		FDeepSpeechConfiguration Config;
+		Config.ModelPath = Args[0];
+		if (Args.Num() > 4)
+		{
+			Config.ScorerPath = Args[4];
+		}
+
+		TArray<FString> Files;
+		if (!FDeepSpeechBatchTranscriber::GatherFiles(Args[1], Files) || Files.Num() == 0)
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("No audio in %s."), *Args[1]);
+			return;
+		}
+
+		const int32 NumStreams = Args.Num() > 2 ? FMath::Max(FCString::Atoi(*Args[2]), 1) : 64;
+		const double Seconds = Args.Num() > 3 ? FMath::Max(FCString::Atod(*Args[3]), 1.0) : 30.0;
+		Async(EAsyncExecution::Thread, [Config, Files = MoveTemp(Files), NumStreams, Seconds]()
+		{
+			FServerReport Report;
+			if (MeasureServer(Config, Files, NumStreams, Seconds, Report))
+			{
+				UE_LOG(LogUETensorVox, Display, TEXT("Server benchmark: %i of %i streams admitted (%i turned away) over %.0fs with %i workers, utilization %.0f%% (peak %.0f%%), %i finals:"),
+				       Report.NumAdmitted, NumStreams, Report.NumRejected, Seconds, FDeepSpeechSessionManager::Get().GetNumWorkers(), Report.Utilization * 100.0f,
+				       Report.PeakUtilization * 100.0f, Report.NumFinals);
+				LogLatencyPercentiles(TEXT("Stream lag"), Report.LagMs);
+				// Sorted by the percentiles.
+				UE_LOG(LogUETensorVox, Display, TEXT("  %-22s max %7.1f ms"), TEXT("Stream lag"), Report.LagMs.Num() > 0 ? Report.LagMs.Last() : 0.0f);
+			}
+		});
+	}
+
+	static FAutoConsoleCommand GBenchmarkServerCommand(
+		TEXT("TensorVox.Benchmark.Server"),
+		TEXT("Stands in for a dedicated server full of talking players: opens up to the given number of streams on a stream service over the first quarter ")
+		TEXT("of the run, pushes audio looped from the files to each of them in real time, and reports how many were admitted, worker utilization and ")
+		TEXT("how far streams fall behind. The TensorVox.StreamService.Admission test checks who gets in. Usage: TensorVox.Benchmark.Server <ModelPath> <Directory or manifest> [Streams=64] [Seconds=30] [ScorerPath]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkServer));
+
+	static FAutoConsoleCommand GBenchmarkGovernorCommand(
+		TEXT("TensorVox.Benchmark.Governor"),
+		TEXT("Runs the load governor against a synthetic min spec machine whose load doubles halfway, and reports whether it settles on a beam width ")
+		TEXT("and decode rate that keep latency and frame time under target and cost within budget both times, the TensorVox.Governor.Converges test fails if it doesn't. Needs no model. Usage: TensorVox.Benchmark.Governor [Steps=40] [Load=1.5]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkGovernor));
+
+	static FAutoConsoleCommand GBenchmarkFrontEndCommand(
+		TEXT("TensorVox.Benchmark.FrontEnd"),
+		TEXT("Times the fused capture front end against separate deinterleave, downmix, gain and resample passes, for 1 to 8 int16 and float channels. ")
+		TEXT("Usage: TensorVox.Benchmark.FrontEnd [Seconds=10] [InputRate=48000]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkFrontEnd));
+
+	static FAutoConsoleCommand GBenchmarkResamplerCommand(
+		TEXT("TensorVox.Benchmark.Resampler"),
+		TEXT("Compares the capture resampler against the old per sample lerp. Reports SNR and throughput, the TensorVox.Resampler test checks them. ")
+		TEXT("Usage: TensorVox.Benchmark.Resampler [Seconds]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkResampler));
+}
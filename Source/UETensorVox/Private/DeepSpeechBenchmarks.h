@@ -0,0 +1,139 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechConfiguration.h"
+#include "DeepSpeechCommandSpotter.h"
+#include "DeepSpeechLoadGovernor.h"
+
+/** Measurements behind the TensorVox.Benchmark console commands, which log them, and the TensorVox automation tests, which check them. */
+namespace DeepSpeechBenchmarks
+{
+	struct FResamplerMeasurement
+	{
+		int32 InputRate = 0;
+		int32 OutputRate = 0;
+		// Of the tones in band after conversion, in dB. Lerp is the per sample lerp the recorder used before the polyphase resampler.
+		double LerpSnr = 0.0;
+		double Snr = 0.0;
+		// Input samples converted per second.
+		double LerpSamplesPerSecond = 0.0;
+		double SamplesPerSecond = 0.0;
+		const TCHAR* KernelName = TEXT("None");
+		int32 NumTapsPerPhase = 0;
+		int32 NumPhases = 0;
+	};
+
+	/** Converts Seconds of tones in the speech band, and above the output Nyquist frequency when downsampling, with both resamplers. */
+	FResamplerMeasurement MeasureResampler(int32 InputRate, int32 OutputRate, int32 Seconds);
+
+	/** How the governor did over the last quarter of one load. */
+	struct FGovernorPhase
+	{
+		float Load = 0.0f;
+		float MinLevel = 1.0f;
+		float MaxLevel = 0.0f;
+		float WorstLatencyMs = 0.0f;
+		float WorstFrameMs = 0.0f;
+		float WorstRealTimeFactor = 0.0f;
+		// The level settled with latency and frame time under target, and cost within budget unless the level has nothing left to give.
+		bool bConverged = false;
+	};
+
+	struct FGovernorReport
+	{
+		FDeepSpeechGovernorSettings Settings;
+		FGovernorPhase Phases[2];
+	};
+
+	/** Runs the load governor for NumSteps decisions against a synthetic min spec machine at Load, doubled halfway. Needs no model. */
+	void RunGovernor(int32 NumSteps, float Load, FGovernorReport& OutReport);
+
+	/** Sorts Values, 0 if there are none. */
+	double Percentile(TArray<float>& Values, double Fraction);
+
+	/** Stage latencies of every final delivered, in ms. */
+	struct FLatencyReport
+	{
+		TArray<float> EndToFinal;
+		TArray<float> QueueWait;
+		TArray<float> Endpoint;
+		TArray<float> FinishQueue;
+		TArray<float> Finish;
+		double AudioSeconds = 0.0;
+		double ProcessSeconds = 0.0;
+		// Utterances that never got a final.
+		int32 NumFailed = 0;
+
+		double GetRealTimeFactor() const { return AudioSeconds > 0.0 ? ProcessSeconds / AudioSeconds : 0.0; }
+	};
+
+	/**
+	 * Plays every file through a session of its own at Speed times real time, requesting transcription for as long as it plays like a
+	 * push to talk key would. Blocks until every final is in.
+	 * @return false if the model couldn't be loaded.
+	 */
+	bool MeasureLatency(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, float Speed, FLatencyReport& OutReport);
+
+	struct FCommandReport
+	{
+		// In ms. The first two only for the utterances a command was heard in.
+		TArray<float> EndToCommand;
+		TArray<float> Lead;
+		TArray<float> EndToFinal;
+		int32 NumCorrect = 0;
+		int32 NumWrong = 0;
+		int32 NumMissed = 0;
+		int32 NumFailed = 0;
+	};
+
+	/** Makes the transcript next to every file that has one a command of its own, named after the file. False if none has one. */
+	bool MakeCommandCorpus(const TArray<FString>& AllFiles, TArray<FString>& OutFiles, TArray<FName>& OutExpected, FDeepSpeechCommandGrammarPtr& OutGrammar);
+
+	/** Plays every file through a session of its own in real time, spotting Grammar's commands. Blocks until every final is in. */
+	bool MeasureCommands(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, const TArray<FName>& Expected,
+	                     const FDeepSpeechCommandGrammarPtr& Grammar, FCommandReport& OutReport);
+
+	struct FPaddingResult
+	{
+		int32 LeadMs = 0;
+		int32 TrailMs = 0;
+		// Against the .txt transcript next to each file, or what the widest padding heard.
+		double WordErrorRate = 0.0;
+		// Per utterance.
+		double InferenceMs = 0.0;
+	};
+
+	struct FPaddingReport
+	{
+		int32 NumUtterances = 0;
+		// Every lead and trail tried, the widest last.
+		TArray<FPaddingResult> Results;
+		// The cheapest within half a point of the widest's word error rate.
+		FPaddingResult Best;
+
+		const FPaddingResult* Find(int32 LeadMs, int32 TrailMs) const;
+	};
+
+	/** Transcribes the voiced part of every file with a range of lead and trail noise padding. */
+	bool MeasurePadding(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, FPaddingReport& OutReport);
+
+	struct FServerReport
+	{
+		int32 NumAdmitted = 0;
+		int32 NumRejected = 0;
+		int32 NumFinals = 0;
+		float Utilization = 0.0f;
+		float PeakUtilization = 0.0f;
+		// Every stream's, sampled once a second.
+		TArray<float> LagMs;
+	};
+
+	/**
+	 * Stands in for a dedicated server full of talking players: opens NumStreams streams on a stream service over the first quarter of the run,
+	 * and pushes audio looped from Files to every admitted one in real time for Seconds.
+	 * @return false if the model or none of the files could be loaded.
+	 */
+	bool MeasureServer(const FDeepSpeechConfiguration& Config, const TArray<FString>& Files, int32 NumStreams, double Seconds, FServerReport& OutReport);
+}
@@ -0,0 +1,378 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechCaptureWriter.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "HAL/RunnableThread.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UETensorVox.h"
+
+#if WITH_EDITOR
+#include "Audio.h"
+#include "DeepSpeechMicrophoneRecorder.h"
+#endif
+
+static bool GTensorVoxCapture = false;
+static FAutoConsoleVariableRef CVarTensorVoxCapture(
+	TEXT("TensorVox.Capture"),
+	GTensorVoxCapture,
+	TEXT("Writes the audio of every utterance, where the voice detector heard a voice and the final transcript to Saved/TensorVoxCapture, ")
+	TEXT("for training and debugging. Taken up by the next utterance."),
+	ECVF_Default);
+
+static int32 GTensorVoxCaptureMaxBufferedKilobytes = 2048;
+static FAutoConsoleVariableRef CVarTensorVoxCaptureMaxBufferedKilobytes(
+	TEXT("TensorVox.Capture.MaxBufferedKilobytes"),
+	GTensorVoxCaptureMaxBufferedKilobytes,
+	TEXT("Most captured audio waiting to be written at once. Utterances are cut short when the disk can't keep up, nothing waits for it."),
+	ECVF_Default);
+
+// A bit over a second of audio at 16 kHz, so a block is handed to the writer about once a second.
+static const int32 CaptureBlockBytes = 32 * 1024;
+static const int32 WaveHeaderBytes = 44;
+
+static void WriteWaveHeader(TArray<uint8>& OutHeader, int32 SampleRate, uint32 NumDataBytes)
+{
+	const auto Append32 = [&OutHeader](uint32 Value)
+	{
+		for (int32 Shift = 0; Shift < 32; Shift += 8)
+		{
+			OutHeader.Add((uint8)(Value >> Shift));
+		}
+	};
+	const auto Append16 = [&OutHeader](uint16 Value)
+	{
+		OutHeader.Add((uint8)Value);
+		OutHeader.Add((uint8)(Value >> 8));
+	};
+	const auto AppendTag = [&OutHeader](const char* Tag)
+	{
+		OutHeader.Append((const uint8*)Tag, 4);
+	};
+
+	// Canonical 16 bit mono PCM.
+	OutHeader.Reset(WaveHeaderBytes);
+	AppendTag("RIFF");
+	Append32(WaveHeaderBytes - 8 + NumDataBytes);
+	AppendTag("WAVE");
+	AppendTag("fmt ");
+	Append32(16);
+	Append16(1);
+	Append16(1);
+	Append32(SampleRate);
+	Append32(SampleRate * sizeof(int16));
+	Append16(sizeof(int16));
+	Append16(16);
+	AppendTag("data");
+	Append32(NumDataBytes);
+}
+
+/**
+* FDeepSpeechCaptureUtterance Implementation
+*/
+
+FDeepSpeechCaptureUtterance::FDeepSpeechCaptureUtterance(FDeepSpeechCaptureWriter& InWriter, const FString& InBasePath, int32 InSampleRate)
+	: Writer(InWriter), BasePath(InBasePath), SampleRate(InSampleRate), NumSamples(0), VoicedStart(INDEX_NONE), bTruncated(false), bEnded(false)
+{
+	Block.Reserve(CaptureBlockBytes);
+}
+
+void FDeepSpeechCaptureUtterance::AppendFrame(const int16* Samples, int32 NumFrameSamples, bool bVoiced)
+{
+	if (bTruncated || bEnded || NumFrameSamples == 0)
+	{
+		return;
+	}
+
+	if (bVoiced && VoicedStart == INDEX_NONE)
+	{
+		VoicedStart = NumSamples;
+	}
+	else if (!bVoiced && VoicedStart != INDEX_NONE)
+	{
+		Labels += FString::Printf(TEXT("%.3f\t%.3f\tspeech\n"), (double)VoicedStart / SampleRate, (double)NumSamples / SampleRate);
+		VoicedStart = INDEX_NONE;
+	}
+
+	Block.Append((const uint8*)Samples, NumFrameSamples * sizeof(int16));
+	NumSamples += NumFrameSamples;
+	if (Block.Num() >= CaptureBlockBytes)
+	{
+		FlushBlock();
+	}
+}
+
+void FDeepSpeechCaptureUtterance::FlushBlock()
+{
+	if (Block.Num() == 0)
+	{
+		return;
+	}
+
+	TArray<uint8> Full = MoveTemp(Block);
+	if (!Writer.TryQueueBlock(BasePath + TEXT(".wav"), MoveTemp(Full)))
+	{
+		bTruncated = true;
+		Writer.NumTruncated.fetch_add(1, std::memory_order_relaxed);
+		UE_LOG(LogUETensorVox, Warning, TEXT("Capture of %s cut short after %.2fs, the disk isn't keeping up."), *FPaths::GetCleanFilename(BasePath),
+		       (double)NumSamples / SampleRate);
+	}
+	Block.Reset(CaptureBlockBytes);
+}
+
+void FDeepSpeechCaptureUtterance::End()
+{
+	if (bEnded)
+	{
+		return;
+	}
+
+	FlushBlock();
+	bEnded = true;
+
+	if (VoicedStart != INDEX_NONE)
+	{
+		Labels += FString::Printf(TEXT("%.3f\t%.3f\tspeech\n"), (double)VoicedStart / SampleRate, (double)NumSamples / SampleRate);
+		VoicedStart = INDEX_NONE;
+	}
+
+	FDeepSpeechCaptureWriter::FCommand Close;
+	Close.Type = FDeepSpeechCaptureWriter::ECommand::Close;
+	Close.Path = BasePath + TEXT(".wav");
+	Writer.Queue(MoveTemp(Close));
+
+	FDeepSpeechCaptureWriter::FCommand WriteLabels;
+	WriteLabels.Type = FDeepSpeechCaptureWriter::ECommand::WriteText;
+	WriteLabels.Path = BasePath + TEXT(".lab");
+	FTCHARToUTF8 Utf8(*Labels);
+	WriteLabels.Data.Append((const uint8*)Utf8.Get(), Utf8.Length());
+	Writer.Queue(MoveTemp(WriteLabels));
+}
+
+void FDeepSpeechCaptureUtterance::WriteTranscript(const FString& Transcript)
+{
+	FDeepSpeechCaptureWriter::FCommand Command;
+	Command.Type = FDeepSpeechCaptureWriter::ECommand::WriteText;
+	Command.Path = BasePath + TEXT(".txt");
+	FTCHARToUTF8 Utf8(*Transcript);
+	Command.Data.Append((const uint8*)Utf8.Get(), Utf8.Length());
+	Writer.Queue(MoveTemp(Command));
+}
+
+/**
+* FDeepSpeechCaptureWriter Implementation
+*/
+
+FDeepSpeechCaptureWriter::FDeepSpeechCaptureWriter()
+	: NumBufferedBytes(0), NumTruncated(0), Thread(nullptr), WorkEvent(FPlatformProcess::GetSynchEventFromPool()), bRunning(true)
+{
+	Directory = FPaths::ProjectSavedDir() / TEXT("TensorVoxCapture") / FDateTime::Now().ToString();
+}
+
+FDeepSpeechCaptureWriter::~FDeepSpeechCaptureWriter()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(WorkEvent);
+	WorkEvent = nullptr;
+}
+
+FDeepSpeechCaptureWriter& FDeepSpeechCaptureWriter::Get()
+{
+	return FUETensorVoxModule::Get().GetCaptureWriter();
+}
+
+bool FDeepSpeechCaptureWriter::IsEnabled()
+{
+	return GTensorVoxCapture;
+}
+
+FDeepSpeechCaptureUtterancePtr FDeepSpeechCaptureWriter::BeginUtterance(int32 SessionId, int32 UtteranceId, int32 SampleRate)
+{
+	const FString BasePath = Directory / FString::Printf(TEXT("Session%i_Utterance%i"), SessionId, UtteranceId);
+
+	FCommand Open;
+	Open.Type = ECommand::Open;
+	Open.Path = BasePath + TEXT(".wav");
+	Open.SampleRate = SampleRate;
+	Queue(MoveTemp(Open));
+
+	return MakeShared<FDeepSpeechCaptureUtterance, ESPMode::ThreadSafe>(*this, BasePath, SampleRate);
+}
+
+bool FDeepSpeechCaptureWriter::TryQueueBlock(const FString& Path, TArray<uint8>&& Data)
+{
+	const int64 MaxBufferedBytes = (int64)FMath::Max(GTensorVoxCaptureMaxBufferedKilobytes, 1) * 1024;
+	const int64 NumBytes = Data.Num();
+	if (NumBufferedBytes.fetch_add(NumBytes, std::memory_order_relaxed) + NumBytes > MaxBufferedBytes)
+	{
+		NumBufferedBytes.fetch_sub(NumBytes, std::memory_order_relaxed);
+		return false;
+	}
+
+	FCommand Write;
+	Write.Type = ECommand::Write;
+	Write.Path = Path;
+	Write.Data = MoveTemp(Data);
+	Queue(MoveTemp(Write));
+	return true;
+}
+
+void FDeepSpeechCaptureWriter::Queue(FCommand&& Command)
+{
+	if (!bRunning)
+	{
+		return;
+	}
+
+	{
+		FScopeLock Lock(&ThreadCritical);
+		if (!Thread)
+		{
+			Runnable = MakeUnique<FWriterThread>(*this);
+			Thread = FRunnableThread::Create(Runnable.Get(), TEXT("TensorVoxCaptureWriter"), 0, TPri_BelowNormal);
+		}
+	}
+
+	Commands.Enqueue(MoveTemp(Command));
+	WorkEvent->Trigger();
+}
+
+uint32 FDeepSpeechCaptureWriter::FWriterThread::Run()
+{
+	for (;;)
+	{
+		FCommand Command;
+		while (Writer.Commands.Dequeue(Command))
+		{
+			Writer.Execute(Command);
+		}
+
+		if (!Writer.bRunning)
+		{
+			break;
+		}
+		Writer.WorkEvent->Wait();
+	}
+	return 0;
+}
+
+void FDeepSpeechCaptureWriter::Execute(FCommand& Command)
+{
+	switch (Command.Type)
+	{
+	case ECommand::Open:
+	{
+		IFileManager::Get().MakeDirectory(*FPaths::GetPath(Command.Path), true);
+		IFileHandle* File = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Command.Path);
+		if (!File)
+		{
+			UE_LOG(LogUETensorVox, Warning, TEXT("Couldn't open %s to capture an utterance to."), *Command.Path);
+			break;
+		}
+
+		// Filled in with the real sizes once the utterance is closed.
+		TArray<uint8> Header;
+		WriteWaveHeader(Header, Command.SampleRate, 0);
+		File->Write(Header.GetData(), Header.Num());
+		OpenFiles.Add(Command.Path, {File, Command.SampleRate});
+		break;
+	}
+	case ECommand::Write:
+	{
+		NumBufferedBytes.fetch_sub(Command.Data.Num(), std::memory_order_relaxed);
+		if (const FOpenFile* OpenFile = OpenFiles.Find(Command.Path))
+		{
+			OpenFile->File->Write(Command.Data.GetData(), Command.Data.Num());
+		}
+		break;
+	}
+	case ECommand::Close:
+	{
+		FOpenFile OpenFile;
+		if (OpenFiles.RemoveAndCopyValue(Command.Path, OpenFile))
+		{
+			TArray<uint8> Header;
+			WriteWaveHeader(Header, OpenFile.SampleRate, (uint32)(OpenFile.File->Size() - WaveHeaderBytes));
+			OpenFile.File->Seek(0);
+			OpenFile.File->Write(Header.GetData(), Header.Num());
+			delete OpenFile.File;
+		}
+		break;
+	}
+	case ECommand::WriteText:
+	{
+		IFileManager::Get().MakeDirectory(*FPaths::GetPath(Command.Path), true);
+		FFileHelper::SaveArrayToFile(Command.Data, *Command.Path);
+		break;
+	}
+	}
+}
+
+void FDeepSpeechCaptureWriter::Shutdown()
+{
+	bRunning = false;
+	if (Thread)
+	{
+		WorkEvent->Trigger();
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+		Runnable.Reset();
+	}
+
+	// Utterances still going when the module went away, their headers just say how far they got.
+	TArray<FString> Unclosed;
+	OpenFiles.GetKeys(Unclosed);
+	for (const FString& Path : Unclosed)
+	{
+		FCommand Close;
+		Close.Type = ECommand::Close;
+		Close.Path = Path;
+		Execute(Close);
+	}
+}
+
+#if WITH_EDITOR
+static void ImportCapture(const TArray<FString>& Args)
+{
+	if (Args.Num() < 1)
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.ImportCapture <Capture directory> [Package path]"));
+		return;
+	}
+
+	const FString PackagePath = Args.Num() > 1 ? Args[1] : TEXT("/Game/TranscriberAudio");
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *(Args[0] / TEXT("*.wav")), true, false);
+
+	int32 NumImported = 0;
+	for (const FString& File : Files)
+	{
+		TArray<uint8> RawWave;
+		FWaveModInfo WaveInfo;
+		if (!FFileHelper::LoadFileToArray(RawWave, *(Args[0] / File)) || !WaveInfo.ReadWaveInfo(RawWave.GetData(), RawWave.Num()) || *WaveInfo.pChannels != 1 ||
+			*WaveInfo.pBitsPerSample != 16)
+		{
+			UE_LOG(LogUETensorVox, Warning, TEXT("%s isn't a 16 bit mono capture, skipped."), *File);
+			continue;
+		}
+
+		TAlignedSignedInt16Array Samples;
+		Samples.SetNumUninitialized(WaveInfo.SampleDataSize / sizeof(int16));
+		FMemory::Memcpy(Samples.GetData(), WaveInfo.SampleDataStart, Samples.Num() * sizeof(int16));
+		if (FDeepSpeechMicrophoneRecorder::SaveAsWavMono(Samples, PackagePath, FPaths::GetBaseFilename(File), *WaveInfo.pSamplesPerSec))
+		{
+			NumImported++;
+		}
+	}
+	UE_LOG(LogUETensorVox, Display, TEXT("Imported %i of %i captured utterances into %s."), NumImported, Files.Num(), *PackagePath);
+}
+
+static FAutoConsoleCommand GTensorVoxImportCaptureCommand(
+	TEXT("TensorVox.ImportCapture"),
+	TEXT("Turns every utterance captured with TensorVox.Capture in a directory into a sound wave asset. Editor only. ")
+	TEXT("Usage: TensorVox.ImportCapture <Capture directory> [Package path=/Game/TranscriberAudio]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&ImportCapture));
+#endif
@@ -0,0 +1,319 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechCommandSpotter.h"
+#include "Algo/BinarySearch.h"
+#include "UETensorVox.h"
+
+namespace
+{
+	/** Letters to change, add or drop to turn A into B, or MaxEdits + 1 once it's clear there are more. */
+	int32 EditDistance(const FString& A, const FString& B, int32 MaxEdits)
+	{
+		if (FMath::Abs(A.Len() - B.Len()) > MaxEdits)
+		{
+			return MaxEdits + 1;
+		}
+
+		TArray<int32, TInlineAllocator<32>> Previous, Current;
+		Previous.SetNumUninitialized(B.Len() + 1);
+		Current.SetNumUninitialized(B.Len() + 1);
+		for (int32 Column = 0; Column <= B.Len(); ++Column)
+		{
+			Previous[Column] = Column;
+		}
+		for (int32 Row = 1; Row <= A.Len(); ++Row)
+		{
+			Current[0] = Row;
+			int32 RowMin = Row;
+			for (int32 Column = 1; Column <= B.Len(); ++Column)
+			{
+				const int32 Substitution = Previous[Column - 1] + (A[Row - 1] == B[Column - 1] ? 0 : 1);
+				Current[Column] = FMath::Min3(Previous[Column] + 1, Current[Column - 1] + 1, Substitution);
+				RowMin = FMath::Min(RowMin, Current[Column]);
+			}
+			if (RowMin > MaxEdits)
+			{
+				return MaxEdits + 1;
+			}
+			Swap(Previous, Current);
+		}
+		return Previous[B.Len()];
+	}
+}
+
+void FDeepSpeechCommandGrammar::SplitWords(FStringView Text, TArray<FString>& OutWords)
+{
+	OutWords.Reset();
+	FString Word;
+	for (const TCHAR Char : Text)
+	{
+		if (FChar::IsAlpha(Char) || Char == TEXT('\''))
+		{
+			Word.AppendChar(FChar::ToLower(Char));
+		}
+		else if (Word.Len() > 0)
+		{
+			OutWords.Add(MoveTemp(Word));
+			Word.Reset();
+		}
+	}
+	if (Word.Len() > 0)
+	{
+		OutWords.Add(MoveTemp(Word));
+	}
+}
+
+TSharedRef<const FDeepSpeechCommandGrammar, ESPMode::ThreadSafe> FDeepSpeechCommandGrammar::Compile(const TMap<FString, FName>& PhrasesToCommands)
+{
+	struct FBuildNode
+	{
+		TMap<FString, int32> Children;
+		FName Command;
+		FName OnlyCommand;
+		bool bSeveralCommands = false;
+	};
+	TArray<FBuildNode> Build;
+	Build.AddDefaulted();
+
+	const TSharedRef<FDeepSpeechCommandGrammar, ESPMode::ThreadSafe> Grammar = MakeShared<FDeepSpeechCommandGrammar, ESPMode::ThreadSafe>();
+	TArray<FString> Words;
+	for (const TPair<FString, FName>& Phrase : PhrasesToCommands)
+	{
+		SplitWords(Phrase.Key, Words);
+		if (Words.Num() == 0 || Phrase.Value.IsNone())
+		{
+			continue;
+		}
+
+		const auto Visit = [&Build, Command = Phrase.Value](int32 NodeIndex)
+		{
+			FBuildNode& Node = Build[NodeIndex];
+			if (Node.OnlyCommand.IsNone() && !Node.bSeveralCommands)
+			{
+				Node.OnlyCommand = Command;
+			}
+			else if (Node.OnlyCommand != Command)
+			{
+				Node.OnlyCommand = NAME_None;
+				Node.bSeveralCommands = true;
+			}
+		};
+
+		int32 NodeIndex = 0;
+		Visit(NodeIndex);
+		for (FString& Word : Words)
+		{
+			int32* Child = Build[NodeIndex].Children.Find(Word);
+			if (!Child)
+			{
+				const int32 NewIndex = Build.AddDefaulted();
+				Child = &Build[NodeIndex].Children.Add(MoveTemp(Word), NewIndex);
+			}
+			NodeIndex = *Child;
+			Visit(NodeIndex);
+		}
+
+		if (!Build[NodeIndex].Command.IsNone() && Build[NodeIndex].Command != Phrase.Value)
+		{
+			UE_LOG(LogUETensorVox, Warning, TEXT("Command phrase \"%s\" spells the same as one of %s, keeping it for %s."), *Phrase.Key,
+			       *Build[NodeIndex].Command.ToString(), *Phrase.Value.ToString());
+		}
+		Build[NodeIndex].Command = Phrase.Value;
+		Grammar->NumPhrases++;
+	}
+
+	// Same node indices, children flattened into sorted runs of edges so lookups are a binary search.
+	Grammar->Nodes.SetNum(Build.Num());
+	for (int32 NodeIndex = 0; NodeIndex < Build.Num(); ++NodeIndex)
+	{
+		FBuildNode& BuildNode = Build[NodeIndex];
+		FNode& Node = Grammar->Nodes[NodeIndex];
+		Node.Command = BuildNode.Command;
+		Node.OnlyCommand = BuildNode.OnlyCommand;
+		Node.FirstEdge = Grammar->Edges.Num();
+		Node.NumEdges = BuildNode.Children.Num();
+		BuildNode.Children.KeySort(TLess<FString>());
+		for (TPair<FString, int32>& Child : BuildNode.Children)
+		{
+			Grammar->Edges.Add({MoveTemp(Child.Key), Child.Value});
+		}
+	}
+	return Grammar;
+}
+
+void FDeepSpeechCommandSpotter::Reset(const FDeepSpeechCommandGrammarPtr& InGrammar, const FDeepSpeechCommandSpotterSettings& InSettings)
+{
+	Grammar = InGrammar && InGrammar->GetNumPhrases() > 0 ? InGrammar : nullptr;
+	Settings = InSettings;
+	Settings.StabilityDecodes = FMath::Max(Settings.StabilityDecodes, 1);
+	Words.Reset();
+	WordAges.Reset();
+	FirstUnmatchedWord = 0;
+	PrefixNode = INDEX_NONE;
+	NumFired = 0;
+}
+
+int32 FDeepSpeechCommandSpotter::OnHypothesis(FStringView Hypothesis, TArray<FDeepSpeechCommandMatch>& OutMatches)
+{
+	if (!Grammar)
+	{
+		return 0;
+	}
+
+	FDeepSpeechCommandGrammar::SplitWords(Hypothesis, NewWords);
+	int32 NumSame = 0;
+	while (NumSame < NewWords.Num() && NumSame < Words.Num() && NewWords[NumSame] == Words[NumSame])
+	{
+		NumSame++;
+	}
+	WordAges.SetNum(NewWords.Num());
+	for (int32 Index = 0; Index < NewWords.Num(); ++Index)
+	{
+		WordAges[Index] = Index < NumSame ? WordAges[Index] + 1 : 1;
+	}
+	Swap(Words, NewWords);
+
+	// A revision of words a command was already fired on doesn't take it back, matching carries on after them.
+	FirstUnmatchedWord = FMath::Min(FirstUnmatchedWord, Words.Num());
+	return Match(false, OutMatches);
+}
+
+int32 FDeepSpeechCommandSpotter::Finish(TArray<FDeepSpeechCommandMatch>& OutMatches)
+{
+	return Grammar ? Match(true, OutMatches) : 0;
+}
+
+int32 FDeepSpeechCommandSpotter::FindChild(const FDeepSpeechCommandGrammar::FNode& Node, const FString& Word, int32& OutNumEdits) const
+{
+	const TArrayView<const FDeepSpeechCommandGrammar::FEdge> Edges = Grammar->GetEdges(Node);
+	const int32 Exact = Algo::BinarySearchBy(Edges, Word, &FDeepSpeechCommandGrammar::FEdge::Word, TLess<FString>());
+	OutNumEdits = 0;
+	if (Exact != INDEX_NONE)
+	{
+		return Edges[Exact].Node;
+	}
+	if (Settings.FuzzyTolerance <= 0.0f)
+	{
+		return INDEX_NONE;
+	}
+
+	int32 Best = INDEX_NONE;
+	int32 BestEdits = MAX_int32;
+	bool bTied = false;
+	for (const FDeepSpeechCommandGrammar::FEdge& Edge : Edges)
+	{
+		const int32 MaxEdits = FMath::FloorToInt(Edge.Word.Len() * Settings.FuzzyTolerance);
+		const int32 Edits = MaxEdits > 0 ? EditDistance(Word, Edge.Word, MaxEdits) : MaxEdits + 1;
+		if (Edits > MaxEdits)
+		{
+			continue;
+		}
+		if (Edits < BestEdits)
+		{
+			Best = Edge.Node;
+			BestEdits = Edits;
+			bTied = false;
+		}
+		else if (Edits == BestEdits)
+		{
+			bTied = true;
+		}
+	}
+	if (bTied)
+	{
+		return INDEX_NONE;
+	}
+	OutNumEdits = Best != INDEX_NONE ? BestEdits : 0;
+	return Best;
+}
+
+int32 FDeepSpeechCommandSpotter::Match(bool bFinal, TArray<FDeepSpeechCommandMatch>& OutMatches)
+{
+	int32 NumStable = Words.Num();
+	if (!bFinal)
+	{
+		NumStable = 0;
+		while (NumStable < Words.Num() && WordAges[NumStable] >= Settings.StabilityDecodes)
+		{
+			NumStable++;
+		}
+	}
+
+	// The rest of a phrase whose command already fired on its first words belongs to it, not to the next command.
+	while (PrefixNode != INDEX_NONE && FirstUnmatchedWord < NumStable)
+	{
+		int32 NumEdits;
+		const int32 Child = FindChild(Grammar->GetNode(PrefixNode), Words[FirstUnmatchedWord], NumEdits);
+		PrefixNode = Child != INDEX_NONE && Grammar->GetNode(Child).NumEdges > 0 ? Child : INDEX_NONE;
+		FirstUnmatchedWord += Child != INDEX_NONE ? 1 : 0;
+	}
+
+	const int32 NumBefore = OutMatches.Num();
+	for (int32 First = FirstUnmatchedWord; First < NumStable && PrefixNode == INDEX_NONE;)
+	{
+		int32 NodeIndex = 0;
+		int32 End = First;
+		int32 NumEdits = 0;
+		// The longest phrase the walk went through, fired if nothing longer can follow.
+		FName Command;
+		int32 CommandEnd = INDEX_NONE;
+		int32 CommandEdits = 0;
+		bool bBlocked = false;
+		while (End < NumStable)
+		{
+			int32 WordEdits;
+			const int32 Child = FindChild(Grammar->GetNode(NodeIndex), Words[End], WordEdits);
+			if (Child == INDEX_NONE)
+			{
+				bBlocked = true;
+				break;
+			}
+			NodeIndex = Child;
+			NumEdits += WordEdits;
+			End++;
+			if (!Grammar->GetNode(NodeIndex).Command.IsNone())
+			{
+				Command = Grammar->GetNode(NodeIndex).Command;
+				CommandEnd = End;
+				CommandEdits = NumEdits;
+			}
+		}
+
+		const FDeepSpeechCommandGrammar::FNode& Node = Grammar->GetNode(NodeIndex);
+		// Words still to come may carry the walk on.
+		const bool bOpen = !bBlocked && !bFinal && Node.NumEdges > 0;
+		if (CommandEnd != INDEX_NONE && !bOpen)
+		{
+			AddMatch(Command, First, CommandEnd, CommandEdits, false, OutMatches);
+			First = FirstUnmatchedWord = CommandEnd;
+		}
+		else if (bOpen && Settings.bFireOnUniquePrefix && End > First && !Node.OnlyCommand.IsNone())
+		{
+			AddMatch(Node.OnlyCommand, First, End, NumEdits, true, OutMatches);
+			FirstUnmatchedWord = End;
+			PrefixNode = NodeIndex;
+		}
+		else if (bOpen)
+		{
+			// Commands are fired in the order they were said, later ones wait for this one to be decided.
+			break;
+		}
+		else
+		{
+			First++;
+		}
+	}
+	return OutMatches.Num() - NumBefore;
+}
+
+void FDeepSpeechCommandSpotter::AddMatch(FName Command, int32 FirstWord, int32 EndWord, int32 NumEdits, bool bPrefix,
+                                         TArray<FDeepSpeechCommandMatch>& OutMatches)
+{
+	FDeepSpeechCommandMatch& Match = OutMatches.AddDefaulted_GetRef();
+	Match.Command = Command;
+	Match.Heard = FString::Join(MakeArrayView(Words.GetData() + FirstWord, EndWord - FirstWord), TEXT(" "));
+	Match.bPrefix = bPrefix;
+	Match.NumEdits = NumEdits;
+	Match.TriggerTime = FPlatformTime::Seconds();
+	NumFired++;
+}
@@ -0,0 +1,113 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechCpuFeatures.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+
+#if PLATFORM_CPU_X86_FAMILY
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if PLATFORM_CPU_X86_FAMILY
+static void ReadCpuId(uint32 Leaf, uint32 SubLeaf, uint32 (&OutRegisters)[4])
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	int32 Registers[4];
+	__cpuidex(Registers, (int32)Leaf, (int32)SubLeaf);
+	FMemory::Memcpy(OutRegisters, Registers, sizeof(Registers));
+#else
+	__cpuid_count(Leaf, SubLeaf, OutRegisters[0], OutRegisters[1], OutRegisters[2], OutRegisters[3]);
+#endif
+}
+
+// Which register states the OS saves on context switches, only valid once cpuid reported OSXSAVE.
+static uint64 ReadXcr0()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+	return _xgetbv(0);
+#else
+	uint32 Low, High;
+	__asm__ volatile("xgetbv" : "=a"(Low), "=d"(High) : "c"(0));
+	return ((uint64)High << 32) | Low;
+#endif
+}
+#endif
+
+const TCHAR* LexToString(EDeepSpeechCpuLevel Level)
+{
+	switch (Level)
+	{
+	case EDeepSpeechCpuLevel::Sse41:
+		return TEXT("SSE4.1");
+	case EDeepSpeechCpuLevel::Avx:
+		return TEXT("AVX");
+	case EDeepSpeechCpuLevel::Avx2:
+		return TEXT("AVX2");
+	case EDeepSpeechCpuLevel::Avx512:
+		return TEXT("AVX-512");
+	default:
+		return TEXT("Generic");
+	}
+}
+
+const FDeepSpeechCpuFeatures& FDeepSpeechCpuFeatures::Get()
+{
+	// Function local statics are initialized exactly once, even with several threads asking at the same time.
+	static const FDeepSpeechCpuFeatures Features = Detect();
+	return Features;
+}
+
+FDeepSpeechCpuFeatures FDeepSpeechCpuFeatures::Detect()
+{
+	FDeepSpeechCpuFeatures Features;
+
+#if PLATFORM_CPU_X86_FAMILY
+	uint32 Registers[4];
+	ReadCpuId(0, 0, Registers);
+	const uint32 MaxLeaf = Registers[0];
+
+	ReadCpuId(1, 0, Registers);
+	const uint32 Leaf1Ecx = Registers[2];
+	const bool bOsXsave = (Leaf1Ecx & (1u << 27)) != 0;
+	const uint64 Xcr0 = bOsXsave ? ReadXcr0() : 0;
+	// SSE and AVX register state, then the three AVX-512 ones: opmask, low and high ZMM halves.
+	const bool bOsSavesYmm = (Xcr0 & 0x6) == 0x6;
+	const bool bOsSavesZmm = bOsSavesYmm && (Xcr0 & 0xE0) == 0xE0;
+
+	Features.bSse41 = (Leaf1Ecx & (1u << 19)) != 0;
+	Features.bAvx = bOsSavesYmm && (Leaf1Ecx & (1u << 28)) != 0;
+	Features.bFma = Features.bAvx && (Leaf1Ecx & (1u << 12)) != 0;
+
+	if (MaxLeaf >= 7)
+	{
+		ReadCpuId(7, 0, Registers);
+		const uint32 Leaf7Ebx = Registers[1];
+		Features.bAvx2 = Features.bAvx && (Leaf7Ebx & (1u << 5)) != 0;
+		Features.bAvx512 = Features.bAvx2 && bOsSavesZmm && (Leaf7Ebx & (1u << 16)) != 0;
+	}
+
+	Features.Level = Features.bAvx512 && Features.bFma ? EDeepSpeechCpuLevel::Avx512
+		: Features.bAvx2 && Features.bFma ? EDeepSpeechCpuLevel::Avx2
+		: Features.bAvx ? EDeepSpeechCpuLevel::Avx
+		: Features.bSse41 ? EDeepSpeechCpuLevel::Sse41
+		: EDeepSpeechCpuLevel::Generic;
+#endif
+
+	FString Cap;
+	if (FParse::Value(FCommandLine::Get(), TEXT("TensorVoxCpuLevel="), Cap))
+	{
+		for (uint8 Level = (uint8)EDeepSpeechCpuLevel::Generic; Level <= (uint8)EDeepSpeechCpuLevel::Avx512; ++Level)
+		{
+			if (Cap.Equals(LexToString((EDeepSpeechCpuLevel)Level), ESearchCase::IgnoreCase))
+			{
+				Features.Level = FMath::Min(Features.Level, (EDeepSpeechCpuLevel)Level);
+			}
+		}
+	}
+
+	return Features;
+}
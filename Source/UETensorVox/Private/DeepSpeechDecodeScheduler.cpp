@@ -0,0 +1,78 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechDecodeScheduler.h"
+
+// Weight of the newest decode in the cost estimate.
+static const double DecodeCostSmoothing = 0.5;
+
+FDeepSpeechDecodeScheduler::FDeepSpeechDecodeScheduler()
+	: RateScale(1.0f)
+{
+	Reset(0.0f, 1.0f, false);
+}
+
+void FDeepSpeechDecodeScheduler::Reset(float InTargetIntervalSeconds, float InCpuBudget, bool bInRecordTimings)
+{
+	TargetIntervalSeconds = FMath::Max(InTargetIntervalSeconds, 0.0f);
+	CpuBudget = FMath::Clamp(InCpuBudget, 0.0f, 1.0f);
+	bRecordTimings = bInRecordTimings;
+
+	StreamSeconds = 0.0;
+	SecondsSinceDecode = 0.0;
+	DecodeCostEstimate = 0.0;
+	LastHypothesis.Reset();
+
+	NumDecodes = 0;
+	NumSuppressed = 0;
+	TotalDecodeSeconds = 0.0;
+	MaxDecodeSeconds = 0.0;
+	Timings.Reset();
+}
+
+void FDeepSpeechDecodeScheduler::OnAudioFed(double Seconds)
+{
+	StreamSeconds += Seconds;
+	SecondsSinceDecode += Seconds;
+}
+
+double FDeepSpeechDecodeScheduler::GetCurrentIntervalSeconds() const
+{
+	if (CpuBudget <= 0.0f)
+	{
+		return TNumericLimits<double>::Max();
+	}
+	return FMath::Max((double)TargetIntervalSeconds, DecodeCostEstimate / CpuBudget) / RateScale;
+}
+
+bool FDeepSpeechDecodeScheduler::ShouldDecode() const
+{
+	return SecondsSinceDecode > 0.0 && SecondsSinceDecode >= GetCurrentIntervalSeconds();
+}
+
+bool FDeepSpeechDecodeScheduler::OnDecoded(double DecodeSeconds, FStringView Hypothesis)
+{
+	DecodeCostEstimate = NumDecodes == 0 ? DecodeSeconds : FMath::Lerp(DecodeCostEstimate, DecodeSeconds, DecodeCostSmoothing);
+	NumDecodes++;
+	TotalDecodeSeconds += DecodeSeconds;
+	MaxDecodeSeconds = FMath::Max(MaxDecodeSeconds, DecodeSeconds);
+
+	const bool bChanged = !Hypothesis.Equals(LastHypothesis, ESearchCase::CaseSensitive);
+	if (bChanged)
+	{
+		// Keeps the allocation, hypotheses only grow within an utterance.
+		LastHypothesis.Reset();
+		LastHypothesis.AppendChars(Hypothesis.GetData(), Hypothesis.Len());
+	}
+	else
+	{
+		NumSuppressed++;
+	}
+
+	if (bRecordTimings)
+	{
+		Timings.Add({StreamSeconds, DecodeSeconds, SecondsSinceDecode, bChanged});
+	}
+
+	SecondsSinceDecode = 0.0;
+	return bChanged;
+}
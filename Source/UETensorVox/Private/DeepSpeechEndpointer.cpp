@@ -0,0 +1,51 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechEndpointer.h"
+
+FDeepSpeechEndpointer::FDeepSpeechEndpointer()
+{
+	Reset(1, 1, 0);
+}
+
+void FDeepSpeechEndpointer::Reset(int32 InOnsetFrames, int32 InHangoverFrames, int32 InMaxSpeechFrames)
+{
+	OnsetFrames = FMath::Max(InOnsetFrames, 1);
+	HangoverFrames = FMath::Max(InHangoverFrames, 1);
+	MaxSpeechFrames = FMath::Max(InMaxSpeechFrames, 0);
+	bInSpeech = false;
+	NumVoicedInRow = 0;
+	NumSilentInRow = 0;
+	NumSpeechFrames = 0;
+}
+
+FDeepSpeechEndpointer::EEvent FDeepSpeechEndpointer::ProcessFrame(bool bVoiced)
+{
+	if (!bInSpeech)
+	{
+		NumVoicedInRow = bVoiced ? NumVoicedInRow + 1 : 0;
+		if (NumVoicedInRow < OnsetFrames)
+		{
+			return EEvent::None;
+		}
+
+		bInSpeech = true;
+		NumSilentInRow = 0;
+		NumSpeechFrames = NumVoicedInRow;
+		NumVoicedInRow = 0;
+		return EEvent::SpeechStarted;
+	}
+
+	NumSpeechFrames++;
+	NumSilentInRow = bVoiced ? 0 : NumSilentInRow + 1;
+	if (NumSilentInRow >= HangoverFrames)
+	{
+		bInSpeech = false;
+		return EEvent::SpeechEnded;
+	}
+	if (MaxSpeechFrames > 0 && NumSpeechFrames >= MaxSpeechFrames)
+	{
+		bInSpeech = false;
+		return EEvent::MaxLengthReached;
+	}
+	return EEvent::None;
+}
@@ -0,0 +1,373 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechFinalizationPool.h"
+#include "DeepSpeechSessionManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "UETensorVox.h"
+#include "DeepSpeechStats.h"
+
+#if TENSORVOX_VALID_PLATFORM
+#include "DeepSpeechLibrary.h"
+#endif
+
+static int32 GTensorVoxNumFinalizeWorkers = 2;
+static FAutoConsoleVariableRef CVarTensorVoxNumFinalizeWorkers(
+	TEXT("TensorVox.NumFinalizeWorkers"),
+	GTensorVoxNumFinalizeWorkers,
+	TEXT("Number of threads finishing utterances for every session. Read when the first utterance ends."),
+	ECVF_Default);
+
+static int32 GTensorVoxFinalizeQueueSize = 4;
+static FAutoConsoleVariableRef CVarTensorVoxFinalizeQueueSize(
+	TEXT("TensorVox.FinalizeQueueSize"),
+	GTensorVoxFinalizeQueueSize,
+	TEXT("Most utterances waiting for a finalization thread before TensorVox.FinalizeOverloadPolicy kicks in."),
+	ECVF_Default);
+
+static int32 GTensorVoxFinalizeOverloadPolicy = (int32)EDeepSpeechFinalizeOverloadPolicy::Merge;
+static FAutoConsoleVariableRef CVarTensorVoxFinalizeOverloadPolicy(
+	TEXT("TensorVox.FinalizeOverloadPolicy"),
+	GTensorVoxFinalizeOverloadPolicy,
+	TEXT("What to do with an utterance when the finalization queue is full.\n")
+	TEXT(" 0: block the session until there is room\n")
+	TEXT(" 1: drop the oldest queued utterance\n")
+	TEXT(" 2: keep the stream open and merge it with the session's next utterance (default)"),
+	ECVF_Default);
+
+static FAutoConsoleCommand GTensorVoxFinalizeStatsCommand(
+	TEXT("TensorVox.FinalizeStats"),
+	TEXT("Logs the finalization queue depth, drops, merges and latency percentiles."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FDeepSpeechSessionManager::Get().GetFinalizationPool().DumpToLog();
+	}));
+
+static const int32 LatencyHistorySize = 256;
+
+FDeepSpeechFinalizationPool::FDeepSpeechFinalizationPool()
+	: JobEvent(FPlatformProcess::GetSynchEventFromPool()), SpaceEvent(FPlatformProcess::GetSynchEventFromPool()), NumRunningWorkers(0),
+	  bRunning(false), MaxQueueDepth(0), NumDropped(0), NumMerged(0), NextLatencyIndex(0)
+{
+	Latencies.Reserve(LatencyHistorySize);
+}
+
+FDeepSpeechFinalizationPool::~FDeepSpeechFinalizationPool()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(JobEvent);
+	FPlatformProcess::ReturnSynchEventToPool(SpaceEvent);
+	JobEvent = nullptr;
+	SpaceEvent = nullptr;
+}
+
+bool FDeepSpeechFinalizationPool::Enqueue(FJob&& Job, FSimpleDelegate OnSlotFreed)
+{
+	check(Job.Stream);
+	const int32 QueueSize = GetQueueSize();
+	const EDeepSpeechFinalizeOverloadPolicy Policy = (EDeepSpeechFinalizeOverloadPolicy)FMath::Clamp(GTensorVoxFinalizeOverloadPolicy, 0, 2);
+
+	FJob Dropped;
+	{
+		FScopeLock Lock(&QueueCritical);
+		StartWorkers();
+
+		while (Queue.Num() >= QueueSize && Policy == EDeepSpeechFinalizeOverloadPolicy::Block && bRunning)
+		{
+			FScopeUnlock Unlock(&QueueCritical);
+			SpaceEvent->Wait();
+		}
+
+		// Shut down while we waited for room, nothing takes jobs off the queue anymore.
+		if (!bRunning)
+		{
+			FScopeUnlock Unlock(&QueueCritical);
+			FreeJob(Job);
+			return true;
+		}
+
+		if (Queue.Num() >= QueueSize)
+		{
+			if (Policy == EDeepSpeechFinalizeOverloadPolicy::Merge)
+			{
+				NumMerged++;
+				if (OnSlotFreed.IsBound())
+				{
+					SlotWaiters.Add(MoveTemp(OnSlotFreed));
+				}
+				return false;
+			}
+
+			if (Policy == EDeepSpeechFinalizeOverloadPolicy::DropOldest)
+			{
+				NumDropped++;
+				Dropped = MoveTemp(Queue[0]);
+				Queue.RemoveAt(0, 1, false);
+			}
+		}
+
+		Job.EnqueueTime = FPlatformTime::Seconds();
+		Queue.Add(MoveTemp(Job));
+		MaxQueueDepth.store(FMath::Max(MaxQueueDepth.load(std::memory_order_relaxed), Queue.Num()), std::memory_order_relaxed);
+	}
+	JobEvent->Trigger();
+
+	if (Dropped.Stream)
+	{
+		UE_LOG(LogUETensorVox, Warning, TEXT("Finalization queue full, dropped an utterance of session %i."), Dropped.SessionId);
+		FreeJob(Dropped);
+	}
+	return true;
+}
+
+void FDeepSpeechFinalizationPool::StartWorkers()
+{
+	if (bRunning || Workers.Num() > 0)
+	{
+		return;
+	}
+
+	bRunning = true;
+	const int32 NumWorkers = FMath::Clamp(GTensorVoxNumFinalizeWorkers, 1, 16);
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; ++WorkerIndex)
+	{
+		TUniquePtr<FWorker>& Worker = Workers.Emplace_GetRef(MakeUnique<FWorker>(*this));
+		NumRunningWorkers++;
+		WorkerThreads.Add(FRunnableThread::Create(Worker.Get(), *FString::Printf(TEXT("TensorVoxFinalize%i"), WorkerIndex), 0, TPri_Normal));
+	}
+	UE_LOG(LogUETensorVox, Log, TEXT("Started %i finalization workers."), NumWorkers);
+}
+
+uint32 FDeepSpeechFinalizationPool::FWorker::Run()
+{
+	Pool.WorkerLoop();
+	Pool.NumRunningWorkers--;
+	return 0;
+}
+
+void FDeepSpeechFinalizationPool::WorkerLoop()
+{
+	while (bRunning)
+	{
+		FJob Job;
+		TArray<FSimpleDelegate> Waiters;
+		bool bMoreQueued = false;
+		{
+			FScopeLock Lock(&QueueCritical);
+			if (Queue.Num() > 0)
+			{
+				Job = MoveTemp(Queue[0]);
+				Queue.RemoveAt(0, 1, false);
+				bMoreQueued = Queue.Num() > 0;
+				Waiters = MoveTemp(SlotWaiters);
+			}
+		}
+
+		if (!Job.Stream)
+		{
+			JobEvent->Wait();
+			continue;
+		}
+
+		// Events are auto reset, pass the wakeup on if there's more for the other workers.
+		if (bMoreQueued)
+		{
+			JobEvent->Trigger();
+		}
+		SpaceEvent->Trigger();
+		for (const FSimpleDelegate& Waiter : Waiters)
+		{
+			Waiter.ExecuteIfBound();
+		}
+
+#if TENSORVOX_VALID_PLATFORM
+		FDeepSpeechUtteranceTimings& Timings = Job.Timings;
+		Timings.FinishStartTime = FPlatformTime::Seconds();
+		Timings.FinishQueueMs = (Timings.FinishStartTime - Job.EnqueueTime) * 1000.0;
+
+		if (Job.OnResult.IsBound())
+		{
+			FinishWithMetadata(Job);
+		}
+		else
+		{
+			char* TranscriptionChar;
+			{
+				FDeepSpeechInferenceScope InferenceScope(*Job.Model);
+				TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxFinishStream);
+				TranscriptionChar = DS_FinishStream(Job.Stream);
+			}
+			OnFinished(Timings);
+
+			// Empty results are delivered too, so listeners always see the utterance complete.
+			const FString Word = TranscriptionChar ? FString(TranscriptionChar) : FString();
+			if (TranscriptionChar)
+			{
+				DS_FreeString(TranscriptionChar);
+			}
+			if (Job.Journal)
+			{
+				Job.Journal->AddResult(Word, true);
+			}
+			Job.OnTranscribed.ExecuteIfBound(Word, true, Timings);
+			if (Job.Capture)
+			{
+				Job.Capture->WriteTranscript(Word);
+			}
+		}
+		FDeepSpeechPipelineStats::NumActiveStreams.fetch_sub(1, std::memory_order_relaxed);
+#endif
+
+		const float Latency = FPlatformTime::Seconds() - Job.EnqueueTime;
+		FScopeLock Lock(&LatencyCritical);
+		if (Latencies.Num() < LatencyHistorySize)
+		{
+			Latencies.Add(Latency);
+		}
+		else
+		{
+			Latencies[NextLatencyIndex] = Latency;
+		}
+		NextLatencyIndex = (NextLatencyIndex + 1) % LatencyHistorySize;
+	}
+}
+
+void FDeepSpeechFinalizationPool::OnFinished(FDeepSpeechUtteranceTimings& Timings)
+{
+	Timings.DispatchTime = FPlatformTime::Seconds();
+	Timings.FinishMs = (Timings.DispatchTime - Timings.FinishStartTime) * 1000.0;
+	Timings.RealTimeFactor = Timings.AudioSeconds > 0.0f ? (Timings.FeedMs + Timings.DecodeMs + Timings.FinishMs) * 0.001f / Timings.AudioSeconds : 0.0f;
+	if (Timings.CommandTime > 0.0)
+	{
+		Timings.EndToCommandMs = (Timings.CommandTime - Timings.LastCaptureTime) * 1000.0;
+		Timings.CommandLeadMs = (Timings.DispatchTime - Timings.CommandTime) * 1000.0;
+	}
+	FDeepSpeechSessionManager::Get().GetLoadGovernor().ReportUtterance(Timings);
+}
+
+void FDeepSpeechFinalizationPool::FinishWithMetadata(FJob& Job)
+{
+#if TENSORVOX_VALID_PLATFORM
+	Metadata* FinalMetadata;
+	{
+		FDeepSpeechInferenceScope InferenceScope(*Job.Model);
+		TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxFinishStream);
+		FinalMetadata = DS_FinishStreamWithMetadata(Job.Stream, Job.NumCandidates);
+	}
+	OnFinished(Job.Timings);
+
+	const TSharedRef<FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe> Result = Job.ResultPool->Acquire();
+	if (FinalMetadata)
+	{
+		Result->Fill(*FinalMetadata, true);
+		DS_FreeMetadata(FinalMetadata);
+	}
+	else
+	{
+		Result->Reset(true);
+	}
+	Result->Timings = Job.Timings;
+
+	if (Job.Journal)
+	{
+		Job.Journal->AddResult(Result->GetBestText(), true);
+	}
+	Job.OnResult.Execute(Result);
+	if (Job.OnTranscribed.IsBound())
+	{
+		Job.OnTranscribed.Execute(FString(Result->GetBestText()), true, Job.Timings);
+	}
+	if (Job.Capture)
+	{
+		Job.Capture->WriteTranscript(FString(Result->GetBestText()));
+	}
+#endif
+}
+
+void FDeepSpeechFinalizationPool::FreeJob(FJob& Job)
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (Job.Stream)
+	{
+		DS_FreeStream(Job.Stream);
+		Job.Stream = nullptr;
+		FDeepSpeechPipelineStats::NumActiveStreams.fetch_sub(1, std::memory_order_relaxed);
+	}
+#endif
+	Job.Model.Reset();
+}
+
+void FDeepSpeechFinalizationPool::Shutdown()
+{
+	TArray<FJob> Abandoned;
+	{
+		FScopeLock Lock(&QueueCritical);
+		Abandoned = MoveTemp(Queue);
+		SlotWaiters.Empty();
+		bRunning = false;
+	}
+
+	// Nobody is listening for these anymore.
+	for (FJob& Job : Abandoned)
+	{
+		FreeJob(Job);
+	}
+
+	while (NumRunningWorkers > 0)
+	{
+		JobEvent->Trigger();
+		SpaceEvent->Trigger();
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	for (FRunnableThread* Thread : WorkerThreads)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+	}
+	WorkerThreads.Empty();
+	Workers.Empty();
+}
+
+int32 FDeepSpeechFinalizationPool::GetQueueDepth() const
+{
+	FScopeLock Lock(&QueueCritical);
+	return Queue.Num();
+}
+
+int32 FDeepSpeechFinalizationPool::GetQueueSize() const
+{
+	return FMath::Max(GTensorVoxFinalizeQueueSize, 1);
+}
+
+void FDeepSpeechFinalizationPool::GetLatencyPercentiles(double& OutP50, double& OutP95, double& OutP99) const
+{
+	TArray<float> Sorted;
+	{
+		FScopeLock Lock(&LatencyCritical);
+		Sorted = Latencies;
+	}
+
+	if (Sorted.Num() == 0)
+	{
+		OutP50 = OutP95 = OutP99 = 0.0;
+		return;
+	}
+
+	Sorted.Sort();
+	const auto Percentile = [&Sorted](double Fraction)
+	{
+		return (double)Sorted[FMath::Min(FMath::FloorToInt(Fraction * Sorted.Num()), Sorted.Num() - 1)];
+	};
+	OutP50 = Percentile(0.50);
+	OutP95 = Percentile(0.95);
+	OutP99 = Percentile(0.99);
+}
+
+void FDeepSpeechFinalizationPool::DumpToLog() const
+{
+	double P50, P95, P99;
+	GetLatencyPercentiles(P50, P95, P99);
+	UE_LOG(LogUETensorVox, Display, TEXT("Finalization: %i queued (max %i of %i), %i dropped, %i merged, latency p50 %.1f ms, p95 %.1f ms, p99 %.1f ms."),
+	       GetQueueDepth(), GetMaxQueueDepth(), GetQueueSize(), GetNumDropped(), GetNumMerged(), P50 * 1000.0, P95 * 1000.0, P99 * 1000.0);
+}
@@ -0,0 +1,132 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechFrontEnd.h"
+#include "DeepSpeechSimd.h"
+#include "UETensorVox.h"
+
+// Seconds the DC estimate takes to follow a change in offset.
+static constexpr float GFrontEndDCTimeConstant = 1.0f;
+
+FDeepSpeechFrontEnd::FDeepSpeechFrontEnd()
+	: InputSampleRate(0), MaxBlockFrames(0), BytesPerFrame(0), DCEstimate(0.0f), bHasDCEstimate(false), DCAdaptRate(0.0f), MixToInt16(nullptr),
+	  MixToFloat(nullptr), KernelName(TEXT("None"))
+{
+}
+
+void FDeepSpeechFrontEnd::Initialize(const FDeepSpeechFrontEndSettings& InSettings, int32 InInputSampleRate, int32 InOutputSampleRate,
+                                     int32 InMaxBlockFrames)
+{
+	check(InSettings.NumChannels > 0 && InInputSampleRate > 0 && InMaxBlockFrames > 0);
+
+	Settings = InSettings;
+	InputSampleRate = InInputSampleRate;
+	MaxBlockFrames = InMaxBlockFrames;
+	BytesPerFrame = Settings.NumChannels * (Settings.Format == EDeepSpeechSampleFormat::Float ? sizeof(float) : sizeof(int16));
+
+	const bool bSelectChannel = Settings.Channel != INDEX_NONE && Settings.Channel >= 0 && Settings.Channel < Settings.NumChannels;
+	if (Settings.Channel != INDEX_NONE && !bSelectChannel)
+	{
+		UE_LOG(LogUETensorVox, Warning, TEXT("Input channel %i asked for, but there are only %i. Mixing all of them instead."), Settings.Channel,
+		       Settings.NumChannels);
+	}
+
+	// Float samples are scaled up to int16 along with the gain, so the kernels only ever multiply once per sample.
+	const float Scale = Settings.Gain * (Settings.Format == EDeepSpeechSampleFormat::Float ? 32767.0f : 1.0f);
+	Weights.SetNumUninitialized(Settings.NumChannels);
+	for (int32 Channel = 0; Channel < Settings.NumChannels; ++Channel)
+	{
+		Weights[Channel] = bSelectChannel ? (Channel == Settings.Channel ? Scale : 0.0f) : Scale / Settings.NumChannels;
+	}
+	DCAdaptRate = 1.0f / (GFrontEndDCTimeConstant * InputSampleRate);
+
+	const DeepSpeechSimd::EKernel Kernel = DeepSpeechSimd::GetBestKernel();
+	MixToInt16 = DeepSpeechSimd::GetMix(Kernel, Settings.Format, EDeepSpeechSampleFormat::Int16);
+	MixToFloat = DeepSpeechSimd::GetMix(Kernel, Settings.Format, EDeepSpeechSampleFormat::Float);
+	KernelName = DeepSpeechSimd::LexToString(Kernel);
+
+	Resampler.Initialize(InputSampleRate, InOutputSampleRate, MaxBlockFrames);
+	Reset();
+}
+
+void FDeepSpeechFrontEnd::Reset()
+{
+	Resampler.Reset();
+	DCEstimate = 0.0f;
+	bHasDCEstimate = false;
+}
+
+bool FDeepSpeechFrontEnd::IsPassthrough() const
+{
+	return Resampler.IsPassthrough() && Settings.NumChannels == 1 && Settings.Format == EDeepSpeechSampleFormat::Int16 && Settings.Gain == 1.0f &&
+		!Settings.bRemoveDC;
+}
+
+int32 FDeepSpeechFrontEnd::GetMaxOutputSamples(int32 NumFrames) const
+{
+	if (Resampler.IsPassthrough())
+	{
+		return NumFrames;
+	}
+	// Every block handed to the resampler can round up by its own.
+	return Resampler.GetMaxOutputSamples(NumFrames) + 2 * FMath::DivideAndRoundUp(NumFrames, MaxBlockFrames);
+}
+
+int32 FDeepSpeechFrontEnd::Process(const void* Interleaved, int32 NumFrames, int16* OutSamples)
+{
+	const uint8* Frames = static_cast<const uint8*>(Interleaved);
+	int32 NumOutput = 0;
+	for (int32 Offset = 0; Offset < NumFrames; Offset += MaxBlockFrames)
+	{
+		NumOutput += ProcessBlock(Frames + (int64)Offset * BytesPerFrame, FMath::Min(MaxBlockFrames, NumFrames - Offset), OutSamples + NumOutput);
+	}
+	return NumOutput;
+}
+
+int32 FDeepSpeechFrontEnd::ProcessBlock(const void* Interleaved, int32 NumFrames, int16* OutSamples)
+{
+	const float Offset = Settings.bRemoveDC ? -DCEstimate : 0.0f;
+	if (Resampler.IsPassthrough())
+	{
+		UpdateDC(MixToInt16(Interleaved, NumFrames, Settings.NumChannels, Weights.GetData(), Offset, OutSamples), NumFrames);
+		return NumFrames;
+	}
+
+	UpdateDC(MixToFloat(Interleaved, NumFrames, Settings.NumChannels, Weights.GetData(), Offset, Resampler.GetInputBuffer(NumFrames)), NumFrames);
+	return Resampler.ProcessInput(NumFrames, OutSamples);
+}
+
+void FDeepSpeechFrontEnd::UpdateDC(float MixSum, int32 NumFrames)
+{
+	if (!Settings.bRemoveDC || NumFrames == 0)
+	{
+		return;
+	}
+
+	// The first block sets the estimate outright, so a large offset is gone from the start instead of fading out over the first second.
+	const float BlockMean = MixSum / NumFrames;
+	if (!bHasDCEstimate)
+	{
+		DCEstimate = BlockMean;
+		bHasDCEstimate = true;
+		return;
+	}
+	DCEstimate += (BlockMean - DCEstimate) * FMath::Min(NumFrames * DCAdaptRate, 1.0f);
+}
+
+int32 FDeepSpeechFrontEnd::Flush(int16* OutSamples)
+{
+	if (Resampler.IsPassthrough())
+	{
+		return 0;
+	}
+
+	int32 NumOutput = 0;
+	for (int32 NumLeft = GetFlushFrames(); NumLeft > 0;)
+	{
+		const int32 NumFrames = FMath::Min(NumLeft, MaxBlockFrames);
+		FMemory::Memzero(Resampler.GetInputBuffer(NumFrames), NumFrames * sizeof(float));
+		NumOutput += Resampler.ProcessInput(NumFrames, OutSamples + NumOutput);
+		NumLeft -= NumFrames;
+	}
+	return NumOutput;
+}
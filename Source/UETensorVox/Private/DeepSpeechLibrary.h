@@ -0,0 +1,77 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "deepspeech.h"
+
+/**
+ * Include this rather than deepspeech.h. Windows delay loads the library, so the first build of it loaded is the one every DS_ call goes to.
+ * Everywhere else the module has no link time dependency on it, the calls go through pointers bound to whichever build StartupModule picked
+ * for the CPU, so the dynamic loader can't pick one of its own.
+ */
+#define TENSORVOX_BIND_LIBRARY_AT_RUNTIME !PLATFORM_WINDOWS
+
+#if TENSORVOX_BIND_LIBRARY_AT_RUNTIME
+
+#define TENSORVOX_LIBRARY_FUNCTIONS(Function) \
+	Function(AddHotWord) \
+	Function(ClearHotWords) \
+	Function(CreateModel) \
+	Function(CreateStream) \
+	Function(EnableExternalScorer) \
+	Function(EraseHotWord) \
+	Function(ErrorCodeToErrorMessage) \
+	Function(FeedAudioContent) \
+	Function(FinishStream) \
+	Function(FinishStreamWithMetadata) \
+	Function(FreeMetadata) \
+	Function(FreeModel) \
+	Function(FreeStream) \
+	Function(FreeString) \
+	Function(GetModelBeamWidth) \
+	Function(GetModelSampleRate) \
+	Function(IntermediateDecode) \
+	Function(IntermediateDecodeWithMetadata) \
+	Function(SetModelBeamWidth) \
+	Function(SetScorerAlphaBeta) \
+	Function(Version)
+
+struct FDeepSpeechLibraryFunctions
+{
+#define TENSORVOX_DECLARE_LIBRARY_FUNCTION(Name) decltype(&::DS_##Name) Name = nullptr;
+	TENSORVOX_LIBRARY_FUNCTIONS(TENSORVOX_DECLARE_LIBRARY_FUNCTION)
+#undef TENSORVOX_DECLARE_LIBRARY_FUNCTION
+};
+
+extern FDeepSpeechLibraryFunctions GDeepSpeechLibrary;
+
+/**
+ * Points every DS_ call at the library Handle was loaded from.
+ * @return false, with an error naming it, if the library doesn't export one of them. Nothing is bound then.
+ */
+bool BindDeepSpeechLibrary(void* Handle);
+
+#define DS_AddHotWord GDeepSpeechLibrary.AddHotWord
+#define DS_ClearHotWords GDeepSpeechLibrary.ClearHotWords
+#define DS_CreateModel GDeepSpeechLibrary.CreateModel
+#define DS_CreateStream GDeepSpeechLibrary.CreateStream
+#define DS_EnableExternalScorer GDeepSpeechLibrary.EnableExternalScorer
+#define DS_EraseHotWord GDeepSpeechLibrary.EraseHotWord
+#define DS_ErrorCodeToErrorMessage GDeepSpeechLibrary.ErrorCodeToErrorMessage
+#define DS_FeedAudioContent GDeepSpeechLibrary.FeedAudioContent
+#define DS_FinishStream GDeepSpeechLibrary.FinishStream
+#define DS_FinishStreamWithMetadata GDeepSpeechLibrary.FinishStreamWithMetadata
+#define DS_FreeMetadata GDeepSpeechLibrary.FreeMetadata
+#define DS_FreeModel GDeepSpeechLibrary.FreeModel
+#define DS_FreeStream GDeepSpeechLibrary.FreeStream
+#define DS_FreeString GDeepSpeechLibrary.FreeString
+#define DS_GetModelBeamWidth GDeepSpeechLibrary.GetModelBeamWidth
+#define DS_GetModelSampleRate GDeepSpeechLibrary.GetModelSampleRate
+#define DS_IntermediateDecode GDeepSpeechLibrary.IntermediateDecode
+#define DS_IntermediateDecodeWithMetadata GDeepSpeechLibrary.IntermediateDecodeWithMetadata
+#define DS_SetModelBeamWidth GDeepSpeechLibrary.SetModelBeamWidth
+#define DS_SetScorerAlphaBeta GDeepSpeechLibrary.SetScorerAlphaBeta
+#define DS_Version GDeepSpeechLibrary.Version
+
+#endif
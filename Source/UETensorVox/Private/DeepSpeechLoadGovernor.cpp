@@ -0,0 +1,222 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechLoadGovernor.h"
+#include "CoreGlobals.h"
+#include "HAL/IConsoleManager.h"
+#include "UETensorVox.h"
+
+static bool GTensorVoxGovernorEnable = false;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorEnable(
+	TEXT("TensorVox.Governor.Enable"),
+	GTensorVoxGovernorEnable,
+	TEXT("Narrows the decoder beam and spaces out intermediate decodes when final results miss TensorVox.Governor.TargetLatencyMs, the ")
+	TEXT("game thread misses TensorVox.Governor.TargetFrameMs or speech costs more CPU than TensorVox.Governor.MaxWorkerLoad or ")
+	TEXT("TensorVox.Governor.MaxRealTimeFactor allow, and widens them again when there's room."),
+	ECVF_Default);
+
+static float GTensorVoxGovernorIntervalSeconds = 1.0f;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorIntervalSeconds(
+	TEXT("TensorVox.Governor.IntervalSeconds"),
+	GTensorVoxGovernorIntervalSeconds,
+	TEXT("Time between two governor decisions, long enough for the last one to show in new streams."),
+	ECVF_Default);
+
+static float GTensorVoxGovernorTargetLatencyMs = 500.0f;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorTargetLatencyMs(
+	TEXT("TensorVox.Governor.TargetLatencyMs"),
+	GTensorVoxGovernorTargetLatencyMs,
+	TEXT("End of speech to final result the governor keeps utterances under."),
+	ECVF_Default);
+
+static float GTensorVoxGovernorTargetFrameMs = 0.0f;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorTargetFrameMs(
+	TEXT("TensorVox.Governor.TargetFrameMs"),
+	GTensorVoxGovernorTargetFrameMs,
+	TEXT("Game thread time the governor keeps frames under. 0 takes it from t.MaxFPS when that's set, negative leaves the frame out."),
+	ECVF_Default);
+
+static float GTensorVoxGovernorTargetUtilization = 0.85f;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorTargetUtilization(
+	TEXT("TensorVox.Governor.TargetUtilization"),
+	GTensorVoxGovernorTargetUtilization,
+	TEXT("Share of the latency and frame targets the governor aims for, the rest is headroom for spikes."),
+	ECVF_Default);
+
+static float GTensorVoxGovernorMaxWorkerLoad = 0.75f;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorMaxWorkerLoad(
+	TEXT("TensorVox.Governor.MaxWorkerLoad"),
+	GTensorVoxGovernorMaxWorkerLoad,
+	TEXT("Share of the session workers' time speech may take. Decoding is made cheaper while it takes more, even with latency to spare. 0 leaves it out."),
+	ECVF_Default);
+
+static float GTensorVoxGovernorMaxRealTimeFactor = 0.5f;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorMaxRealTimeFactor(
+	TEXT("TensorVox.Governor.MaxRealTimeFactor"),
+	GTensorVoxGovernorMaxRealTimeFactor,
+	TEXT("Feed, decode and finish time an utterance may cost per second of its audio. Decoding is made cheaper while it costs more, even ")
+	TEXT("with latency to spare. 0 leaves it out."),
+	ECVF_Default);
+
+static int32 GTensorVoxGovernorMinBeamWidth = 64;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorMinBeamWidth(
+	TEXT("TensorVox.Governor.MinBeamWidth"),
+	GTensorVoxGovernorMinBeamWidth,
+	TEXT("Narrowest beam the governor takes the decoder down to."),
+	ECVF_Default);
+
+static float GTensorVoxGovernorMinDecodeRate = 0.25f;
+static FAutoConsoleVariableRef CVarTensorVoxGovernorMinDecodeRate(
+	TEXT("TensorVox.Governor.MinDecodeRate"),
+	GTensorVoxGovernorMinDecodeRate,
+	TEXT("Least share of the configured intermediate decode rate the governor goes down to."),
+	ECVF_Default);
+
+// Level moved per unit of pressure off target. Backs off harder than it comes back, a missed target costs more than unused room.
+static const float GovernorDownGain = 0.5f;
+static const float GovernorUpGain = 0.2f;
+
+FDeepSpeechGovernorSettings FDeepSpeechGovernorSettings::FromConsoleVariables()
+{
+	FDeepSpeechGovernorSettings Settings;
+	Settings.TargetLatencyMs = GTensorVoxGovernorTargetLatencyMs;
+	Settings.TargetFrameMs = FMath::Max(GTensorVoxGovernorTargetFrameMs, 0.0f);
+	if (GTensorVoxGovernorTargetFrameMs == 0.0f)
+	{
+		static const IConsoleVariable* MaxFpsVariable = IConsoleManager::Get().FindConsoleVariable(TEXT("t.MaxFPS"));
+		const float MaxFps = MaxFpsVariable ? MaxFpsVariable->GetFloat() : 0.0f;
+		Settings.TargetFrameMs = MaxFps > 0.0f ? 1000.0f / MaxFps : 0.0f;
+	}
+	Settings.TargetUtilization = FMath::Clamp(GTensorVoxGovernorTargetUtilization, 0.1f, 1.0f);
+	Settings.MaxWorkerLoad = FMath::Max(GTensorVoxGovernorMaxWorkerLoad, 0.0f);
+	Settings.MaxRealTimeFactor = FMath::Max(GTensorVoxGovernorMaxRealTimeFactor, 0.0f);
+	Settings.MinBeamWidth = FMath::Max(GTensorVoxGovernorMinBeamWidth, 1);
+	Settings.MinDecodeRate = FMath::Clamp(GTensorVoxGovernorMinDecodeRate, 0.0f, 1.0f);
+	return Settings;
+}
+
+FDeepSpeechLoadGovernor::FDeepSpeechLoadGovernor()
+	: Level(1.0f), DecodeRateScale(1.0f), MinBeamWidth(1), LastBeamWidth(0), ReportedLatencyMs(0.0f), ReportedRealTimeFactorSum(0.0f), NumReported(0),
+	  SecondsSinceDecision(0.0), FrameMsSum(0.0), NumFrames(0), LastBusyCycles(0), LastPressure(0.0f), NumDecisions(0), bWasEnabled(false)
+{
+}
+
+void FDeepSpeechLoadGovernor::ReportUtterance(const FDeepSpeechUtteranceTimings& Timings)
+{
+	if (Timings.LastCaptureTime <= 0.0 || Timings.DispatchTime <= 0.0)
+	{
+		return;
+	}
+
+	const float LatencyMs = (Timings.DispatchTime - Timings.LastCaptureTime) * 1000.0;
+	FScopeLock Lock(&ReportCritical);
+	ReportedLatencyMs = FMath::Max(ReportedLatencyMs, LatencyMs);
+	ReportedRealTimeFactorSum += Timings.RealTimeFactor;
+	NumReported++;
+}
+
+void FDeepSpeechLoadGovernor::Tick(float DeltaSeconds, uint64 BusyCycles, int32 NumWorkers)
+{
+	if (!GTensorVoxGovernorEnable)
+	{
+		if (bWasEnabled)
+		{
+			Reset();
+			bWasEnabled = false;
+		}
+		return;
+	}
+	if (!bWasEnabled)
+	{
+		// Load is measured from here on, not since the workers started.
+		Reset();
+		LastBusyCycles = BusyCycles;
+		bWasEnabled = true;
+	}
+
+	// Stats builds time the game thread's own work, elsewhere the whole frame has to do.
+	FrameMsSum += GGameThreadTime > 0 ? FPlatformTime::ToMilliseconds(GGameThreadTime) : DeltaSeconds * 1000.0;
+	NumFrames++;
+	SecondsSinceDecision += DeltaSeconds;
+	if (SecondsSinceDecision < GTensorVoxGovernorIntervalSeconds)
+	{
+		return;
+	}
+
+	FDeepSpeechLoadSample Sample;
+	Sample.FrameMs = FrameMsSum / NumFrames;
+	Sample.WorkerLoad = NumWorkers > 0 ? FPlatformTime::ToSeconds64(BusyCycles - LastBusyCycles) / (SecondsSinceDecision * NumWorkers) : 0.0f;
+	{
+		FScopeLock Lock(&ReportCritical);
+		Sample.LatencyMs = ReportedLatencyMs;
+		Sample.RealTimeFactor = NumReported > 0 ? ReportedRealTimeFactorSum / NumReported : 0.0f;
+		ReportedLatencyMs = 0.0f;
+		ReportedRealTimeFactorSum = 0.0f;
+		NumReported = 0;
+	}
+	LastBusyCycles = BusyCycles;
+	SecondsSinceDecision = 0.0;
+	FrameMsSum = 0.0;
+	NumFrames = 0;
+
+	Decide(Sample, FDeepSpeechGovernorSettings::FromConsoleVariables());
+}
+
+void FDeepSpeechLoadGovernor::Decide(const FDeepSpeechLoadSample& Sample, const FDeepSpeechGovernorSettings& Settings)
+{
+	// An interval without finished utterances says nothing about latency or their cost, only the frame and the workers can push back then.
+	const auto Ratio = [](float Measured, float Target) { return Measured > 0.0f && Target > 0.0f ? Measured / Target : 0.0f; };
+	const float LatencyPressure = Ratio(Sample.LatencyMs, Settings.TargetLatencyMs);
+	const float FramePressure = Ratio(Sample.FrameMs, Settings.TargetFrameMs);
+	// Cost counts like a missed target, so speech gets cheaper while it's over budget however much latency is left.
+	const float CostPressure = FMath::Max(Ratio(Sample.WorkerLoad, Settings.MaxWorkerLoad), Ratio(Sample.RealTimeFactor, Settings.MaxRealTimeFactor));
+	const float Pressure = FMath::Max3(LatencyPressure, FramePressure, CostPressure);
+
+	const float Error = Settings.TargetUtilization - Pressure;
+	const float OldLevel = Level.load(std::memory_order_relaxed);
+	const float NewLevel = FMath::Clamp(OldLevel + Error * (Error < 0.0f ? GovernorDownGain : GovernorUpGain), 0.0f, 1.0f);
+
+	Level.store(NewLevel, std::memory_order_relaxed);
+	DecodeRateScale.store(FMath::Lerp(Settings.MinDecodeRate, 1.0f, NewLevel), std::memory_order_relaxed);
+	MinBeamWidth.store(Settings.MinBeamWidth, std::memory_order_relaxed);
+	LastSample = Sample;
+	LastPressure = Pressure;
+	NumDecisions++;
+
+	UE_LOG(LogUETensorVox, Verbose,
+	       TEXT("Governor: latency %.0f ms, frame %.1f ms, RTF %.2f, worker load %.0f%%, pressure %.2f (latency %.2f, frame %.2f, cost %.2f) -> level %.2f (from %.2f), decode rate x%.2f."),
+	       Sample.LatencyMs, Sample.FrameMs, Sample.RealTimeFactor, Sample.WorkerLoad * 100.0f, Pressure, LatencyPressure, FramePressure, CostPressure, NewLevel,
+	       OldLevel, GetDecodeRateScale());
+}
+
+void FDeepSpeechLoadGovernor::Reset()
+{
+	Level.store(1.0f, std::memory_order_relaxed);
+	DecodeRateScale.store(1.0f, std::memory_order_relaxed);
+	LastBeamWidth.store(0, std::memory_order_relaxed);
+	{
+		FScopeLock Lock(&ReportCritical);
+		ReportedLatencyMs = 0.0f;
+		ReportedRealTimeFactorSum = 0.0f;
+		NumReported = 0;
+	}
+	SecondsSinceDecision = 0.0;
+	FrameMsSum = 0.0;
+	NumFrames = 0;
+	LastSample = FDeepSpeechLoadSample();
+	LastPressure = 0.0f;
+}
+
+int32 FDeepSpeechLoadGovernor::GetBeamWidth(int32 ModelBeamWidth) const
+{
+	const float CurrentLevel = GetLevel();
+	if (CurrentLevel >= 1.0f || ModelBeamWidth <= 0)
+	{
+		LastBeamWidth.store(0, std::memory_order_relaxed);
+		return 0;
+	}
+
+	const int32 Narrowest = FMath::Min(MinBeamWidth.load(std::memory_order_relaxed), ModelBeamWidth);
+	const int32 Width = FMath::RoundToInt(FMath::Lerp((float)Narrowest, (float)ModelBeamWidth, CurrentLevel));
+	LastBeamWidth.store(Width, std::memory_order_relaxed);
+	return Width;
+}
@@ -4,57 +4,55 @@
 #include "Logging/LogMacros.h"
 #include "AudioDeviceManager.h"
 #include "UETensorVox.h"
+#include "DeepSpeechStats.h"
+#if WITH_EDITOR
 #include "AssetRegistry/AssetRegistryModule.h"
 #include "Components/AudioComponent.h"
+#endif
 
 
-/**
-* Callback Function For the Microphone Capture for RtAudio
-*/
-#if TENSORVOX_VALID_PLATFORM
-static int32 OnAudioCaptureCallback(void* OutBuffer, void* InBuffer, uint32 InBufferFrames, double StreamTime,
-                                    RtAudioStreamStatus AudioStreamStatus, void* InUserData)
-{
-	// Check for stream overflow (i.e. we're feeding audio faster than we're consuming)
-
-
-	// Cast the user data to the singleton mic recorder
-	FDeepSpeechMicrophoneRecorder* AudioRecordingManager = (FDeepSpeechMicrophoneRecorder*)InUserData;
-
-	// Call the mic capture callback function
-	return AudioRecordingManager->OnAudioCapture(InBuffer, InBufferFrames, StreamTime, AudioStreamStatus == RTAUDIO_INPUT_OVERFLOW);
-}
-#endif 
-
 /**
 * FDeepSpeechMicrophoneRecorder Implementation
 */
 
-FDeepSpeechMicrophoneRecorder::FDeepSpeechMicrophoneRecorder()
+FDeepSpeechMicrophoneRecorder::FDeepSpeechMicrophoneRecorder(TUniquePtr<IDeepSpeechAudioSource> InSource)
+	: Source(MoveTemp(InSource))
 {
+	RecordingSampleRate = 0;
 	TargetSampleRate = 16000;
 	bRecording = false;
-	bSplitChannels = false;
-	bError = false;
-	NumInputChannels.Set(1);
-	NumOverflowsDetected = 0;
+	NumOverflowsDetected.Reset();
+	CaptureStride = 1;
+	NumConvertedSamples = 0;
+	NumPendingConsume = 0;
+	LastFrameArrivalTime = 0.0;
+	WakeIntervalSeconds = 0.0f;
+	WakeIntervalSamples = 0;
+	NumSamplesSinceWake = 0;
+	bGated = false;
+	bGateOpen = false;
+	LookbackSamples = 0;
+	IdleWakeSamples = 0;
 }
 
 FDeepSpeechMicrophoneRecorder::~FDeepSpeechMicrophoneRecorder()
 {
-#if TENSORVOX_VALID_PLATFORM
+	StopRecording();
+}
 
-	if (ADCInstance.isStreamOpen())
-	{
-		ADCInstance.abortStream();
-	}
-#endif
+bool FDeepSpeechMicrophoneRecorder::StartRecording(int32 InTargetSampleRate, int32 RecordingBlockSize, float CaptureBufferSeconds)
+{
+	return BeginRecording(InTargetSampleRate, RecordingBlockSize, CaptureBufferSeconds, -1.0f);
+}
+
+bool FDeepSpeechMicrophoneRecorder::StartGatedRecording(int32 InTargetSampleRate, int32 RecordingBlockSize, float CaptureBufferSeconds, float LookbackSeconds)
+{
+	return BeginRecording(InTargetSampleRate, RecordingBlockSize, CaptureBufferSeconds, FMath::Max(LookbackSeconds, 0.0f));
 }
 
-bool FDeepSpeechMicrophoneRecorder::StartRecording(int32 InTargetSampleRate, int32 RecordingBlockSize)
+bool FDeepSpeechMicrophoneRecorder::BeginRecording(int32 InTargetSampleRate, int32 RecordingBlockSize, float CaptureBufferSeconds, float LookbackSeconds)
 {
-#if TENSORVOX_VALID_PLATFORM
-	if (bError)
+	if (!Source)
 	{
 		return false;
 	}
@@ -65,217 +63,109 @@ bool FDeepSpeechMicrophoneRecorder::StartRecording(int32 InTargetSampleRate, int
 	}
 
 	TargetSampleRate = InTargetSampleRate;
-
-
-	// If we have a stream open close it (reusing streams can cause a blip of previous recordings audio)
-	if (ADCInstance.isStreamOpen())
+	if (!Source->Open(TargetSampleRate, RecordingBlockSize))
 	{
-		try
-		{
-			ADCInstance.stopStream();
-			ADCInstance.closeStream();
-		}
-		catch (RtAudioError& e)
-		{
-			FString ErrorMessage = FString(e.what());
-			bError = true;
-			UE_LOG(LogUETensorVox, Error, TEXT("Failed to close the mic capture device stream: %s"), *ErrorMessage);
-			return false;
-		}
-	}
-
-	// Get the default mic input device info
-	RtAudio::DeviceInfo Info = ADCInstance.getDeviceInfo(StreamParams.deviceId);
-	NumInputChannels.Set(Info.inputChannels);
-	
-	bool bSampleRateFound = false;
-
-
-	for (auto SampleRate : Info.sampleRates)
-	{
-		if (static_cast<int32>(SampleRate) == TargetSampleRate)
-		{
-			RecordingSampleRate = SampleRate;
-			bSampleRateFound = true;
-			break;
-		}
-	}
-
-	if (!bSampleRateFound)
-	{
-		UE_LOG(LogUETensorVox, Warning, TEXT("Sample %i rate not found. Selecting nearest."), TargetSampleRate);
-
-		auto GetClosests = [](std::vector<unsigned> const& Vec, unsigned Value) -> int32
-		{
-			auto const It = std::lower_bound(Vec.begin(), Vec.end(), Value);
-			if (It == Vec.end())
-			{
-				return INDEX_NONE;
-			}
-
-			return *It;
-		};
-
-
-		const int32 ClosestSampleRate = GetClosests(Info.sampleRates, TargetSampleRate);
-		if (ClosestSampleRate != INDEX_NONE)
-		{
-			RecordingSampleRate = ClosestSampleRate;
-		}
-		else
-		{
-			UE_LOG(LogUETensorVox, Error, TEXT("Nearest sample rate not found"));
-			return false;
-		}
+		return false;
 	}
-
-
-	if (RecordingSampleRate < 0)
+	RecordingSampleRate = Source->GetSampleRate();
+	// Doesn't allocate again for the same device, rates and block size.
+	FrontEnd.Initialize(Source->GetFrameLayout(), RecordingSampleRate, TargetSampleRate, RecordingBlockSize);
+	CaptureStride = FrontEnd.GetBytesPerFrame() / sizeof(int16);
+
+	bGated = LookbackSeconds >= 0.0f;
+	bGateOpen = !bGated;
+	const int32 LookbackFrames = bGated ? FMath::RoundToInt(LookbackSeconds * RecordingSampleRate) : 0;
+	LookbackSamples = LookbackFrames * CaptureStride;
+
+	// The source isn't delivering yet so we're the only one touching the buffer, it's only reallocated if the size changed.
+	const int32 CaptureBufferFrames = FMath::Max(FMath::CeilToInt(CaptureBufferSeconds * RecordingSampleRate), RecordingBlockSize * 2) + LookbackFrames;
+	IdleWakeSamples = FMath::Max((CaptureBufferFrames - LookbackFrames) / 2, 1);
+	CaptureBuffer.Initialize(CaptureBufferFrames * CaptureStride);
+	// One stamp per block, with headroom for devices that deliver smaller blocks than asked for.
+	CaptureStamps.Initialize(FMath::DivideAndRoundUp(CaptureBufferFrames, FMath::Max(RecordingBlockSize / 4, 1)) + 1);
+	if (Journal)
 	{
-		UE_LOG(LogUETensorVox, Warning, TEXT("Invalid sample rate provided %i."), TargetSampleRate);
-		return false;
+		JournalBlocks.Initialize(CaptureStamps.Max());
 	}
-
-
-	RawRecordingBlocks.Empty();
-	NumOverflowsDetected = 0;
-	// Publish to the mic input thread that we're ready to record...
+	NumOverflowsDetected.Reset();
+	WakeIntervalSamples = FMath::Max(FMath::CeilToInt(WakeIntervalSeconds * RecordingSampleRate), 1);
+	NumSamplesSinceWake = 0;
+	LastFrameArrivalTime = 0.0;
+
+	NumConvertedSamples = 0;
+	NumPendingConsume = 0;
+	// Publish to the capture thread that we're ready to record...
 	bRecording = true;
 
-	StreamParams.deviceId = ADCInstance.getDefaultInputDevice(); // Only use the default input device for now
-	StreamParams.nChannels = 1;
-	StreamParams.firstChannel = 0;
-	uint32 BufferFrames = FMath::Max(RecordingBlockSize, 256);
-
-
-	UE_LOG(LogUETensorVox, Log,
-	       TEXT("Started microphone recording at %d hz sample rate, %d channels, and %d frame size."),
-	       RecordingSampleRate, StreamParams.nChannels, BufferFrames);
-
-	// RtAudio uses exceptions for error handling... 
-	try
-	{
-		// Open up new audio stream
-		ADCInstance.openStream(nullptr, &StreamParams, RTAUDIO_SINT16, RecordingSampleRate, &BufferFrames, &OnAudioCaptureCallback,
-		                       this);
-	}
-	catch (RtAudioError& e)
-	{
-		FString ErrorMessage = FString(e.what());
-		bError = true;
-		UE_LOG(LogUETensorVox, Error, TEXT("Failed to open the mic capture device: %s"), *ErrorMessage);
-		return false;
-	}
-	catch (const std::exception& e)
+	if (!Source->Start(*this))
 	{
-		FString ErrorMessage = FString(e.what());
-		bError = true;
-		UE_LOG(LogUETensorVox, Error, TEXT("Failed to open the mic capture device: %s"), *ErrorMessage);
-		return false;
-	}
-	catch (...)
-	{
-		UE_LOG(LogUETensorVox, Error, TEXT("Failed to open the mic capture device: unknown error"));
-		bError = true;
+		bRecording = false;
 		return false;
 	}
 
-	ADCInstance.startStream();
+	UE_LOG(LogUETensorVox, Log, TEXT("Started %srecording from %s at %d hz, %d %s channels, converting to %d hz mono (%s kernel)."),
+	       bGated ? TEXT("gated ") : TEXT(""), Source->GetName(), RecordingSampleRate, FrontEnd.GetSettings().NumChannels,
+	       FrontEnd.GetSettings().Format == EDeepSpeechSampleFormat::Float ? TEXT("float") : TEXT("int16"), TargetSampleRate, FrontEnd.GetKernelName());
 	return true;
-#endif
-	return false;
 }
 
-// TArray<int16> FDeepSpeechMicrophoneRecorder::DownmixStereoToMono(const TArray<int16>& FirstChannel, const TArray<int16>& SecondChannel)
-// {
-// 	TArray<int16> OutMixed;
-// 	check(FirstChannel.Num() == SecondChannel.Num());
-// 	OutMixed.SetNumZeroed(FirstChannel.Num());
-// 	for (int32 FrameIndex = 0; FrameIndex < FirstChannel.Num(); FrameIndex++)
-// 	{
-// 		OutMixed[FrameIndex] = ( (FirstChannel[FrameIndex] + SecondChannel[FrameIndex]) / 2.0f);
-// 	}
-//
-// 	return OutMixed;
-// }
-
-
-static void SampleRateConvert(float CurrentSR, float TargetSR, int32 NumChannels, const TArray<int16>& InSamples,
-                              int32 NumSamplesToConvert, TArray<int16>& OutConverted)
+float FDeepSpeechMicrophoneRecorder::OpenGate()
 {
-	int32 NumInputSamples = InSamples.Num();
-	int32 NumOutputSamples = NumInputSamples * TargetSR / CurrentSR;
-
-	OutConverted.Reset(NumOutputSamples);
-
-	float SrFactor = (double)CurrentSR / TargetSR;
-	float CurrentFrameIndexInterpolated = 0.0f;
-	checkf(NumSamplesToConvert <= InSamples.Num(), TEXT("Desample frame length mismatch! NumSamplesToConvert %i, InSamples Num %i"),
-	       NumSamplesToConvert, InSamples.Num());
-	int32 NumFramesToConvert = NumSamplesToConvert / NumChannels;
-	int32 CurrentFrameIndex = 0;
-
-	for (;;)
+	check(bGated);
+	if (bGateOpen)
 	{
-		int32 NextFrameIndex = CurrentFrameIndex + 1;
-		if (CurrentFrameIndex >= NumFramesToConvert || NextFrameIndex >= NumFramesToConvert)
-		{
-			break;
-		}
-
-		for (int32 Channel = 0; Channel < NumChannels; ++Channel)
-		{
-			int32 CurrentSampleIndex = CurrentFrameIndex * NumChannels + Channel;
-			int32 NextSampleIndex = CurrentSampleIndex + NumChannels;
-
-			int16 CurrentSampleValue = InSamples[CurrentSampleIndex];
-			int16 NextSampleValue = InSamples[NextSampleIndex];
-
-			int16 NewSampleValue = FMath::Lerp(CurrentSampleValue, NextSampleValue, CurrentFrameIndexInterpolated);
-
-			OutConverted.Add(NewSampleValue);
-		}
-
-		CurrentFrameIndexInterpolated += SrFactor;
-
-		// Wrap the interpolated frame between 0.0 and 1.0 to maintain float precision
-		while (CurrentFrameIndexInterpolated >= 1.0f)
-		{
-			CurrentFrameIndexInterpolated -= 1.0f;
-
-			// Every time it wraps, we increment the frame index
-			++CurrentFrameIndex;
-		}
+		return 0.0f;
 	}
+	TrimToLookback();
+	bGateOpen = true;
+	return (float)(CaptureBuffer.Num() / CaptureStride) / FMath::Max(RecordingSampleRate, 1);
 }
 
-TArray<FDeinterleavedAudio> FDeepSpeechMicrophoneRecorder::ProcessSamples(
-	TArray<int16> InSamples)
+void FDeepSpeechMicrophoneRecorder::CloseGate()
 {
-	const int32 InputChannelCount = NumInputChannels.GetValue();
-	TArray<FDeinterleavedAudio> OutResampled;
+	check(bGated);
+	bGateOpen = false;
+}
 
-	if (InSamples.Num() > 0)
+void FDeepSpeechMicrophoneRecorder::TrimToLookback()
+{
+	// Whatever the last frame was read from goes as well, the next one starts over from the lookback.
+	if (FrontEnd.IsPassthrough() && NumPendingConsume > 0)
 	{
-		if (RecordingSampleRate != TargetSampleRate)
-		{
-			TArray<int16> Resampled;
-			SampleRateConvert((float)RecordingSampleRate, (float)TargetSampleRate, InputChannelCount, InSamples, InSamples.Num(),
-			                  Resampled);
-			InSamples = Resampled;
-		}
-
+		CaptureBuffer.Consume(NumPendingConsume);
+	}
+	NumPendingConsume = 0;
+	NumConvertedSamples = 0;
+	FrontEnd.Reset();
 
-		FDeinterleavedAudio SingleChannel;
-		SingleChannel.PCMData = InSamples;
+	const int32 NumStale = CaptureBuffer.Num() - LookbackSamples;
+	if (NumStale > 0)
+	{
+		CaptureBuffer.Consume(NumStale);
+	}
 
-		OutResampled.Add(SingleChannel);
+	const uint64 ReadPosition = CaptureBuffer.GetTotalRead();
+	UpdateFrameArrivalTime(ReadPosition);
+	// Blocks that are gone entirely aren't journaled, the one the lookback starts in is journaled from there.
+	for (TArrayView<const FJournalBlock> Blocks = Journal ? JournalBlocks.PeekContiguous() : TArrayView<const FJournalBlock>(); Blocks.Num() > 0;
+	     Blocks = JournalBlocks.PeekContiguous())
+	{
+		int32 NumStaleBlocks = 0;
+		while (NumStaleBlocks < Blocks.Num() && Blocks[NumStaleBlocks].EndPosition <= ReadPosition)
+		{
+			++NumStaleBlocks;
+		}
+		JournalBlocks.Consume(NumStaleBlocks);
+		if (NumStaleBlocks < Blocks.Num())
+		{
+			break;
+		}
 	}
-	return OutResampled;
 }
 
+#if WITH_EDITOR
 USoundWave* FDeepSpeechMicrophoneRecorder::SaveAsWavMono(const TAlignedSignedInt16Array& Samples, const FString& Path,
-                                                         const FString& AssetName, const int16& RecordedSampleRate)
+                                                         const FString& AssetName, int32 RecordedSampleRate)
 {
 	if (Samples.Num() > 0)
 	{
@@ -325,7 +215,6 @@ USoundWave* FDeepSpeechMicrophoneRecorder::SaveAsWavMono(const TAlignedSignedInt
 			FMemory::Memcpy(NewSoundWave->RawPCMData, Samples.GetData(), NumBytes);
 
 			// Calculate the duration of the sound wave
-			// Note: We use the NumInputChannels for duration calculation since NumChannelsToSerialize may be 1 channel while NumInputChannels is 2 for the "split stereo" feature.
 			NewSoundWave->Duration = (float)Samples.Num() / (float)RecordedSampleRate;
 			NewSoundWave->SetSampleRate((float)RecordedSampleRate);
 			NewSoundWave->NumChannels = 1;
@@ -348,35 +237,191 @@ USoundWave* FDeepSpeechMicrophoneRecorder::SaveAsWavMono(const TAlignedSignedInt
 	}
 	return nullptr;
 }
+#endif
+
+void FDeepSpeechMicrophoneRecorder::SetJournal(const FDeepSpeechSessionJournalPtr& InJournal)
+{
+	check(!bRecording);
+	Journal = InJournal;
+}
 
-void FDeepSpeechMicrophoneRecorder::StopRecording()
+void FDeepSpeechMicrophoneRecorder::FlushJournal()
 {
-#if TENSORVOX_VALID_PLATFORM
-	UE_LOG(LogUETensorVox, Log, TEXT("Stopped recording microphone."));
+	for (TArrayView<const FJournalBlock> Blocks = JournalBlocks.PeekContiguous(); Blocks.Num() > 0; Blocks = JournalBlocks.PeekContiguous())
+	{
+		for (const FJournalBlock& Block : Blocks)
+		{
+			TArrayView<const int16> First, Second;
+			CaptureBuffer.PeekAt(Block.EndPosition - Block.NumWritten, Block.NumWritten, First, Second);
+			Journal->AddBlock(Block.ArrivalTime, First, Second, Block.bDeviceOverflow, Block.NumDropped / CaptureStride);
+		}
+		JournalBlocks.Consume(Blocks.Num());
+	}
+}
 
+void FDeepSpeechMicrophoneRecorder::SetOnSamplesAvailable(FSimpleDelegate InOnSamplesAvailable, float InWakeIntervalSeconds)
+{
+	check(!bRecording);
+	OnSamplesAvailable = MoveTemp(InOnSamplesAvailable);
+	WakeIntervalSeconds = InWakeIntervalSeconds;
+}
+
+void FDeepSpeechMicrophoneRecorder::StopRecording()
+{
 	if (bRecording)
 	{
+		UE_LOG(LogUETensorVox, Log, TEXT("Stopped recording from %s."), Source->GetName());
 		bRecording = false;
-		ADCInstance.stopStream();
-		ADCInstance.closeStream();
+		Source->Stop();
 	}
-#endif
 }
 
-int32 FDeepSpeechMicrophoneRecorder::OnAudioCapture(void* InBuffer, uint32 InBufferFrames, double StreamTime, bool bOverflow)
+void FDeepSpeechMicrophoneRecorder::OnAudioCaptured(const void* Frames, int32 NumFrames, bool bDeviceOverflow)
 {
-	if (bRecording)
+	// Device threads can't flush stats, so the callback only shows up in Insights.
+	TRACE_CPUPROFILER_EVENT_SCOPE(TensorVoxCaptureCallback);
+
+	if (!bRecording)
+	{
+		return;
+	}
+
+	if (bDeviceOverflow)
+	{
+		NumOverflowsDetected.Increment();
+		FDeepSpeechPipelineStats::NumCaptureOverflows.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// Whole frames fit whenever any do, the capacity and everything read and written being whole frames.
+	const int32 NumSamples = NumFrames * CaptureStride;
+	const int32 NumWritten = CaptureBuffer.Write(static_cast<const int16*>(Frames), NumSamples);
+	if (NumWritten < NumSamples)
+	{
+		FDeepSpeechPipelineStats::NumCaptureOverflows.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	if (NumWritten > 0)
+	{
+		const FCaptureStamp Stamp = {CaptureBuffer.GetTotalWritten(), FPlatformTime::Seconds()};
+		CaptureStamps.Write(&Stamp, 1);
+	}
+
+	if (Journal)
+	{
+		const FJournalBlock Block = {CaptureBuffer.GetTotalWritten(), NumWritten, NumSamples - NumWritten, FPlatformTime::Seconds(), bDeviceOverflow};
+		JournalBlocks.Write(&Block, 1);
+	}
+
+	// Wake the consumer once per interval instead of letting it poll.
+	NumSamplesSinceWake += NumFrames;
+	if (NumSamplesSinceWake >= (bGateOpen ? WakeIntervalSamples : IdleWakeSamples))
 	{
-		if (bOverflow)
+		NumSamplesSinceWake = 0;
+		OnSamplesAvailable.ExecuteIfBound();
+	}
+}
+
+TArrayView<const int16> FDeepSpeechMicrophoneRecorder::ReadFrame(int32 FrameSamples)
+{
+	if (!bGateOpen)
+	{
+		TrimToLookback();
+		return TArrayView<const int16>();
+	}
+
+	// Journal what came in before any of it is consumed.
+	if (Journal)
+	{
+		FlushJournal();
+	}
+
+	if (FrontEnd.IsPassthrough())
+	{
+		if (NumPendingConsume > 0)
 		{
-			++NumOverflowsDetected;
+			CaptureBuffer.Consume(NumPendingConsume);
+			NumPendingConsume = 0;
 		}
 
-		TAlignedSignedInt16Array Block;
-		Block.Append((int16*)InBuffer, InBufferFrames);
-		RawRecordingBlocks.Enqueue(FDeinterleavedAudio{Block});
-		return 0;
+		if (CaptureBuffer.Num() < FrameSamples)
+		{
+			return TArrayView<const int16>();
+		}
+
+		// Read straight out of the ring buffer when we can, only copy when the frame wraps around.
+		UpdateFrameArrivalTime(CaptureBuffer.GetTotalRead() + FrameSamples);
+		const TArrayView<const int16> Span = CaptureBuffer.PeekContiguous();
+		if (Span.Num() >= FrameSamples)
+		{
+			NumPendingConsume = FrameSamples;
+			return Span.Left(FrameSamples);
+		}
+
+		ConvertedFrames.SetNumUninitialized(FrameSamples, false);
+		if (Journal)
+		{
+			FlushJournal();
+		}
+		CaptureBuffer.Read(ConvertedFrames.GetData(), FrameSamples);
+		return ConvertedFrames;
+	}
+
+	if (NumPendingConsume > 0)
+	{
+		NumConvertedSamples -= NumPendingConsume;
+		FMemory::Memmove(ConvertedFrames.GetData(), ConvertedFrames.GetData() + NumPendingConsume, NumConvertedSamples * sizeof(int16));
+		NumPendingConsume = 0;
 	}
 
-	return 1;
+	// Only grows on the first frame after the frame size or device rate changed.
+	const int32 MaxInputFrames = FrontEnd.GetMaxBlockFrames();
+	const int32 RequiredCapacity = FrameSamples + FrontEnd.GetMaxOutputSamples(MaxInputFrames);
+	if (ConvertedFrames.Num() < RequiredCapacity)
+	{
+		ConvertedFrames.SetNumUninitialized(RequiredCapacity, false);
+	}
+
+	// Channels mixed or picked, gain, DC and resampling, in one pass straight out of the capture buffer.
+	TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxResample);
+	while (NumConvertedSamples < FrameSamples)
+	{
+		const TArrayView<const int16> Span = CaptureBuffer.PeekContiguous();
+		const int32 NumInputFrames = FMath::Min(Span.Num() / CaptureStride, MaxInputFrames);
+		if (NumInputFrames == 0)
+		{
+			return TArrayView<const int16>();
+		}
+
+		NumConvertedSamples += FrontEnd.Process(Span.GetData(), NumInputFrames, ConvertedFrames.GetData() + NumConvertedSamples);
+		if (Journal)
+		{
+			FlushJournal();
+		}
+		CaptureBuffer.Consume(NumInputFrames * CaptureStride);
+	}
+
+	UpdateFrameArrivalTime(CaptureBuffer.GetTotalRead());
+	NumPendingConsume = FrameSamples;
+	return TArrayView<const int16>(ConvertedFrames.GetData(), FrameSamples);
+}
+
+void FDeepSpeechMicrophoneRecorder::UpdateFrameArrivalTime(uint64 SourcePosition)
+{
+	// Drop the stamps of blocks that were read completely, the first one left holds the sample just before SourcePosition.
+	for (TArrayView<const FCaptureStamp> Stamps = CaptureStamps.PeekContiguous(); Stamps.Num() > 0; Stamps = CaptureStamps.PeekContiguous())
+	{
+		int32 NumRead = 0;
+		while (NumRead < Stamps.Num() && Stamps[NumRead].EndPosition < SourcePosition)
+		{
+			++NumRead;
+		}
+
+		if (NumRead < Stamps.Num())
+		{
+			CaptureStamps.Consume(NumRead);
+			LastFrameArrivalTime = Stamps[NumRead].ArrivalTime;
+			return;
+		}
+		CaptureStamps.Consume(NumRead);
+	}
 }
@@ -0,0 +1,180 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechModel.h"
+#include "HAL/FileManager.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Misc/Paths.h"
+#include "UETensorVox.h"
+#include "DeepSpeechLibrary.h"
+
+LLM_DEFINE_TAG(TensorVox);
+LLM_DEFINE_TAG(TensorVox_Model);
+LLM_DEFINE_TAG(TensorVox_Scorer);
+
+namespace
+{
+	/**
+	 * What loading a file cost. A memory mapped .pbmm or lazily loaded scorer barely moves the process footprint up front but ends up
+	 * resident once it's used, so never count less than the file itself.
+	 */
+	int64 GetLoadedBytes(const FString& FullPath, uint64 UsedPhysicalBefore)
+	{
+		const int64 Grown = (int64)FPlatformMemory::GetStats().UsedPhysical - (int64)UsedPhysicalBefore;
+		return FMath::Max(IFileManager::Get().FileSize(*FullPath), Grown);
+	}
+}
+
+FDeepSpeechModel::FDeepSpeechModel()
+	: Model(nullptr), SampleRate(16000), BeamWidth(0), ModelBytes(0), ScorerBytes(0), bSerializeInference(true), AppliedBeamWidth(0)
+{
+}
+
+FDeepSpeechModel::~FDeepSpeechModel()
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (Model)
+	{
+		DS_FreeModel(Model);
+		Model = nullptr;
+
+		// Tracked under our own members' addresses, DeepSpeech's allocations aren't ours to name.
+		LLM_IF_ENABLED(FLowLevelMemTracker::Get().OnLowLevelFree(ELLMTracker::Default, &ModelBytes));
+		if (ScorerBytes > 0)
+		{
+			LLM_IF_ENABLED(FLowLevelMemTracker::Get().OnLowLevelFree(ELLMTracker::Default, &ScorerBytes));
+		}
+		UE_LOG(LogUETensorVox, Log, TEXT("Freed model %s."), *Key);
+	}
+#endif
+}
+
+FString FDeepSpeechModel::MakeKey(const FDeepSpeechConfiguration& Config)
+{
+	return FString::Printf(TEXT("%s|%s|%g|%g|%i"), *Config.ModelPath, *Config.ScorerPath, Config.ModelAlphaBeta.X, Config.ModelAlphaBeta.Y,
+	                       Config.BeamWidth);
+}
+
+FDeepSpeechModelPtr FDeepSpeechModel::Load(const FDeepSpeechConfiguration& Config)
+{
+#if TENSORVOX_VALID_PLATFORM
+	const FString& ModelFullPath = FPaths::ProjectContentDir() + Config.ModelPath;
+	const FString& ScorerFullPath = FPaths::ProjectContentDir() + Config.ScorerPath;
+
+	FDeepSpeechModelPtr Loaded = MakeShareable(new FDeepSpeechModel());
+	Loaded->Key = MakeKey(Config);
+	Loaded->bSerializeInference = FPaths::GetExtension(Config.ModelPath).Equals(TEXT("tflite"), ESearchCase::IgnoreCase);
+
+	uint64 UsedPhysicalBefore = FPlatformMemory::GetStats().UsedPhysical;
+	if (CheckForError(TEXT("Model"), DS_CreateModel(TCHAR_TO_UTF8(*ModelFullPath), &Loaded->Model)))
+	{
+		Loaded->Model = nullptr;
+		return nullptr;
+	}
+
+	// From here on the destructor frees the model on failure.
+	Loaded->ModelBytes = GetLoadedBytes(ModelFullPath, UsedPhysicalBefore);
+	{
+		LLM_SCOPE_BYTAG(TensorVox_Model);
+		LLM_IF_ENABLED(FLowLevelMemTracker::Get().OnLowLevelAlloc(ELLMTracker::Default, &Loaded->ModelBytes, Loaded->ModelBytes));
+	}
+
+	if (!Config.ScorerPath.IsEmpty())
+	{
+		UsedPhysicalBefore = FPlatformMemory::GetStats().UsedPhysical;
+		if (CheckForError(TEXT("EnableExternalScorer"), DS_EnableExternalScorer(Loaded->Model, TCHAR_TO_UTF8(*ScorerFullPath))))
+		{
+			return nullptr;
+		}
+
+		Loaded->ScorerBytes = GetLoadedBytes(ScorerFullPath, UsedPhysicalBefore);
+		{
+			LLM_SCOPE_BYTAG(TensorVox_Scorer);
+			LLM_IF_ENABLED(FLowLevelMemTracker::Get().OnLowLevelAlloc(ELLMTracker::Default, &Loaded->ScorerBytes, Loaded->ScorerBytes));
+		}
+
+		if (Config.ModelAlphaBeta.X != INDEX_NONE || Config.ModelAlphaBeta.Y != INDEX_NONE)
+		{
+			if (CheckForError(TEXT("SetAlphaBeta"), DS_SetScorerAlphaBeta(Loaded->Model, Config.ModelAlphaBeta.X, Config.ModelAlphaBeta.Y)))
+			{
+				return nullptr;
+			}
+		}
+	}
+
+	if (Config.BeamWidth != 0)
+	{
+		if (CheckForError(TEXT("SetModelBeamWidth"), DS_SetModelBeamWidth(Loaded->Model, Config.BeamWidth)))
+		{
+			return nullptr;
+		}
+	}
+
+	Loaded->SampleRate = DS_GetModelSampleRate(Loaded->Model);
+	Loaded->BeamWidth = DS_GetModelBeamWidth(Loaded->Model);
+	Loaded->AppliedBeamWidth = Loaded->BeamWidth;
+	UE_LOG(LogUETensorVox, Log, TEXT("Loaded model %s, %i hz%s."), *Loaded->Key, Loaded->SampleRate,
+	       Loaded->bSerializeInference ? TEXT(", inference serialized between streams") : TEXT(""));
+	return Loaded;
+#else
+	return nullptr;
+#endif
+}
+
+int32 FDeepSpeechModel::CreateStream(StreamingState*& OutStream, const FDeepSpeechHotWords& HotWords, int32 StreamBeamWidth)
+{
+#if TENSORVOX_VALID_PLATFORM
+	FScopeLock Lock(&StreamCreationCritical);
+
+	const int32 Width = StreamBeamWidth > 0 ? StreamBeamWidth : BeamWidth;
+	if (Width != AppliedBeamWidth && !CheckForError(TEXT("SetModelBeamWidth"), DS_SetModelBeamWidth(Model, Width)))
+	{
+		AppliedBeamWidth = Width;
+	}
+
+	if (HotWords.Num() == 0 && AppliedHotWords.Num() > 0)
+	{
+		DS_ClearHotWords(Model);
+		AppliedHotWords.Reset();
+	}
+	else
+	{
+		for (auto It = AppliedHotWords.CreateIterator(); It; ++It)
+		{
+			const float* Boost = HotWords.Find(It.Key());
+			if (!Boost || *Boost != It.Value())
+			{
+				DS_EraseHotWord(Model, TCHAR_TO_UTF8(*It.Key()));
+				It.RemoveCurrent();
+			}
+		}
+		for (const TPair<FString, float>& HotWord : HotWords)
+		{
+			if (!AppliedHotWords.Contains(HotWord.Key) &&
+				!CheckForError(FString::Printf(TEXT("AddHotWord %s"), *HotWord.Key), DS_AddHotWord(Model, TCHAR_TO_UTF8(*HotWord.Key), HotWord.Value)))
+			{
+				AppliedHotWords.Add(HotWord.Key, HotWord.Value);
+			}
+		}
+	}
+
+	return DS_CreateStream(Model, &OutStream);
+#else
+	OutStream = nullptr;
+	return -1;
+#endif
+}
+
+bool FDeepSpeechModel::CheckForError(const FString& Name, int32 Error)
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (Error != 0)
+	{
+		char* Buffer = DS_ErrorCodeToErrorMessage(Error);
+		const FString& ErrorString = FString(Buffer);
+		UE_LOG(LogUETensorVox, Error, TEXT("%s DeepSpeech Error: %s"), *Name, *ErrorString);
+		DS_FreeString(Buffer);
+		return true;
+	}
+#endif
+	return false;
+}
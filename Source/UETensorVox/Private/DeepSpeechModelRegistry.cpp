@@ -0,0 +1,191 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechModelRegistry.h"
+#include "HAL/IConsoleManager.h"
+#include "UETensorVox.h"
+
+static int32 GTensorVoxIdleModelBudgetMB = 1024;
+static FAutoConsoleVariableRef CVarTensorVoxIdleModelBudgetMB(
+	TEXT("TensorVox.IdleModelBudgetMB"),
+	GTensorVoxIdleModelBudgetMB,
+	TEXT("Memory budget for models no session is using anymore. Idle models over budget are freed least recently used first, 0 frees them right away."),
+	ECVF_Default);
+
+static FAutoConsoleCommand GTensorVoxDumpModelsCommand(
+	TEXT("TensorVox.Models"),
+	TEXT("Lists every loaded DeepSpeech model with its resident size and whether it's in use."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FDeepSpeechModelRegistry::Get().DumpToLog();
+	}));
+
+static FAutoConsoleCommand GTensorVoxTrimModelsCommand(
+	TEXT("TensorVox.TrimModels"),
+	TEXT("Frees every DeepSpeech model no session is using."),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		FDeepSpeechModelRegistry::Get().TrimIdle();
+	}));
+
+FDeepSpeechModelRegistry::~FDeepSpeechModelRegistry()
+{
+	FScopeLock Lock(&Critical);
+	for (const TPair<FString, FEntry>& Pair : Entries)
+	{
+		ensureMsgf(Pair.Value.bIdle, TEXT("Model %s still in use while the registry shuts down."), *Pair.Key);
+	}
+	Entries.Empty();
+}
+
+FDeepSpeechModelRegistry& FDeepSpeechModelRegistry::Get()
+{
+	return FUETensorVoxModule::Get().GetModelRegistry();
+}
+
+FDeepSpeechModelPtr FDeepSpeechModelRegistry::Acquire(const FDeepSpeechConfiguration& Config)
+{
+	const FString Key = FDeepSpeechModel::MakeKey(Config);
+	{
+		FScopeLock Lock(&Critical);
+		if (FEntry* Entry = Entries.Find(Key))
+		{
+			return MakeHandle(Key, *Entry);
+		}
+	}
+
+	FScopeLock LoadLock(&LoadCritical);
+	{
+		// Someone else might have loaded it while we waited.
+		FScopeLock Lock(&Critical);
+		if (FEntry* Entry = Entries.Find(Key))
+		{
+			return MakeHandle(Key, *Entry);
+		}
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FDeepSpeechModelPtr Loaded = FDeepSpeechModel::Load(Config);
+	if (!Loaded)
+	{
+		return nullptr;
+	}
+	UE_LOG(LogUETensorVox, Log, TEXT("Loaded %s in %.2fs, model %.1f MB, scorer %.1f MB."), *Key, FPlatformTime::Seconds() - StartTime,
+	       Loaded->GetModelBytes() / (1024.0 * 1024.0), Loaded->GetScorerBytes() / (1024.0 * 1024.0));
+
+	FScopeLock Lock(&Critical);
+	FEntry& Entry = Entries.Add(Key);
+	Entry.Model = Loaded;
+	return MakeHandle(Key, Entry);
+}
+
+FDeepSpeechModelPtr FDeepSpeechModelRegistry::MakeHandle(const FString& Key, FEntry& Entry)
+{
+	if (FDeepSpeechModelPtr Existing = Entry.Handle.Pin())
+	{
+		return Existing;
+	}
+
+	// The deleter doesn't free anything, the entry owns the model. It only tells us the last session let go of it.
+	FDeepSpeechModelPtr Handle = MakeShareable(Entry.Model.Get(), [this, Key](FDeepSpeechModel*)
+	{
+		OnHandleReleased(Key);
+	});
+	Entry.Handle = Handle;
+	Entry.bIdle = false;
+	Entry.LastUsedTime = FPlatformTime::Seconds();
+	return Handle;
+}
+
+void FDeepSpeechModelRegistry::OnHandleReleased(const FString& Key)
+{
+	FScopeLock Lock(&Critical);
+	FEntry* Entry = Entries.Find(Key);
+	// A new handle may have been made between the old one expiring and us getting the lock.
+	if (Entry && !Entry->Handle.IsValid())
+	{
+		Entry->bIdle = true;
+		Entry->LastUsedTime = FPlatformTime::Seconds();
+		EvictIdle((int64)FMath::Max(GTensorVoxIdleModelBudgetMB, 0) * 1024 * 1024);
+	}
+}
+
+void FDeepSpeechModelRegistry::EvictIdle(int64 BudgetBytes)
+{
+	int64 IdleBytes = 0;
+	for (const TPair<FString, FEntry>& Pair : Entries)
+	{
+		if (Pair.Value.bIdle)
+		{
+			IdleBytes += Pair.Value.Model->GetResidentBytes();
+		}
+	}
+
+	while (IdleBytes > BudgetBytes || (BudgetBytes == 0 && IdleBytes > 0))
+	{
+		const FString* OldestKey = nullptr;
+		double OldestTime = TNumericLimits<double>::Max();
+		for (const TPair<FString, FEntry>& Pair : Entries)
+		{
+			if (Pair.Value.bIdle && Pair.Value.LastUsedTime < OldestTime)
+			{
+				OldestTime = Pair.Value.LastUsedTime;
+				OldestKey = &Pair.Key;
+			}
+		}
+
+		if (!OldestKey)
+		{
+			break;
+		}
+
+		const FString EvictedKey = *OldestKey;
+		IdleBytes -= Entries[EvictedKey].Model->GetResidentBytes();
+		UE_LOG(LogUETensorVox, Log, TEXT("Evicting idle model %s, %.1f MB idle left."), *EvictedKey, IdleBytes / (1024.0 * 1024.0));
+		Entries.Remove(EvictedKey);
+	}
+}
+
+void FDeepSpeechModelRegistry::TrimIdle()
+{
+	FScopeLock Lock(&Critical);
+	EvictIdle(0);
+}
+
+int64 FDeepSpeechModelRegistry::GetResidentBytes() const
+{
+	FScopeLock Lock(&Critical);
+	int64 Bytes = 0;
+	for (const TPair<FString, FEntry>& Pair : Entries)
+	{
+		Bytes += Pair.Value.Model->GetResidentBytes();
+	}
+	return Bytes;
+}
+
+int64 FDeepSpeechModelRegistry::GetIdleBytes() const
+{
+	FScopeLock Lock(&Critical);
+	int64 Bytes = 0;
+	for (const TPair<FString, FEntry>& Pair : Entries)
+	{
+		if (Pair.Value.bIdle)
+		{
+			Bytes += Pair.Value.Model->GetResidentBytes();
+		}
+	}
+	return Bytes;
+}
+
+void FDeepSpeechModelRegistry::DumpToLog() const
+{
+	FScopeLock Lock(&Critical);
+	const double Now = FPlatformTime::Seconds();
+	UE_LOG(LogUETensorVox, Display, TEXT("%i loaded models, idle budget %i MB:"), Entries.Num(), GTensorVoxIdleModelBudgetMB);
+	for (const TPair<FString, FEntry>& Pair : Entries)
+	{
+		const FDeepSpeechModelPtr& Model = Pair.Value.Model;
+		UE_LOG(LogUETensorVox, Display, TEXT("  %s: model %.1f MB, scorer %.1f MB, %s"), *Pair.Key, Model->GetModelBytes() / (1024.0 * 1024.0),
+		       Model->GetScorerBytes() / (1024.0 * 1024.0),
+		       Pair.Value.bIdle ? *FString::Printf(TEXT("idle for %.0fs"), Now - Pair.Value.LastUsedTime) : TEXT("in use"));
+	}
+}
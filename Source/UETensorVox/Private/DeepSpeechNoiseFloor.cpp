@@ -0,0 +1,60 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechNoiseFloor.h"
+#include "UETensorVox.h"
+#include "DeepSpeechStats.h"
+
+#if TENSORVOX_VALID_PLATFORM
+#include "DeepSpeechLibrary.h"
+#endif
+
+void FDeepSpeechNoiseFloor::Initialize(int32 CapacitySamples)
+{
+	Ring.Initialize(FMath::Max(CapacitySamples, 1));
+	Zeros.SetNumZeroed(Ring.Max());
+}
+
+void FDeepSpeechNoiseFloor::Add(const int16* Samples, int32 NumSamples)
+{
+	if (NumSamples > Ring.Max())
+	{
+		Samples += NumSamples - Ring.Max();
+		NumSamples = Ring.Max();
+	}
+
+	const int32 NumFree = Ring.Max() - Ring.Num();
+	if (NumFree < NumSamples)
+	{
+		Ring.Consume(NumSamples - NumFree);
+	}
+	Ring.Write(Samples, NumSamples);
+}
+
+void FDeepSpeechNoiseFloor::Feed(StreamingState* Stream, int32 NumSamples) const
+{
+#if TENSORVOX_VALID_PLATFORM
+	TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxFeed);
+	NumSamples = FMath::Min(NumSamples, Ring.Max());
+	if (NumSamples <= 0)
+	{
+		return;
+	}
+
+	TArrayView<const int16> First, Second;
+	Ring.PeekNewest(NumSamples, First, Second);
+
+	const int32 NumMissing = NumSamples - First.Num() - Second.Num();
+	if (NumMissing > 0)
+	{
+		DS_FeedAudioContent(Stream, Zeros.GetData(), NumMissing);
+	}
+	if (First.Num() > 0)
+	{
+		DS_FeedAudioContent(Stream, First.GetData(), First.Num());
+	}
+	if (Second.Num() > 0)
+	{
+		DS_FeedAudioContent(Stream, Second.GetData(), Second.Num());
+	}
+#endif
+}
@@ -0,0 +1,193 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechResampler.h"
+#include "DeepSpeechSimd.h"
+#include "UETensorVox.h"
+
+// Taps per phase when not decimating, scaled up by the decimation ratio so the transition band stays the same width at the output rate.
+static constexpr int32 GResamplerBaseTaps = 32;
+// Fraction of the output Nyquist frequency that is kept.
+static constexpr double GResamplerCutoff = 0.92;
+// Kaiser window beta, ~80dB stopband.
+static constexpr double GResamplerKaiserBeta = 8.0;
+static constexpr int32 GResamplerMaxPhases = 256;
+
+static double BesselI0(double X)
+{
+	double Sum = 1.0;
+	double Term = 1.0;
+	for (int32 K = 1; K < 32; ++K)
+	{
+		const double Factor = X / (2.0 * K);
+		Term *= Factor * Factor;
+		Sum += Term;
+		if (Term < Sum * 1e-12)
+		{
+			break;
+		}
+	}
+	return Sum;
+}
+
+FDeepSpeechResampler::FDeepSpeechResampler()
+	: InputSampleRate(0), OutputSampleRate(0), InterpolationFactor(1), DecimationFactor(1), NumPhases(1), NumTapsPerPhase(0),
+	  MaxInputBlockSize(0), NumBuffered(0), InputIndex(0), Phase(0), DotProduct(nullptr), KernelName(TEXT("None"))
+{
+}
+
+void FDeepSpeechResampler::Initialize(int32 InInputSampleRate, int32 InOutputSampleRate, int32 InMaxInputBlockSize)
+{
+	check(InInputSampleRate > 0 && InOutputSampleRate > 0 && InMaxInputBlockSize > 0);
+
+	const DeepSpeechSimd::EKernel Kernel = DeepSpeechSimd::GetBestKernel();
+	DotProduct = DeepSpeechSimd::GetDotProduct(Kernel);
+	KernelName = DeepSpeechSimd::LexToString(Kernel);
+
+	const bool bSameConfiguration = InputSampleRate == InInputSampleRate && OutputSampleRate == InOutputSampleRate && MaxInputBlockSize ==
+		InMaxInputBlockSize;
+	InputSampleRate = InInputSampleRate;
+	OutputSampleRate = InOutputSampleRate;
+	MaxInputBlockSize = InMaxInputBlockSize;
+
+	if (bSameConfiguration || IsPassthrough())
+	{
+		Reset();
+		return;
+	}
+
+	int32 A = InputSampleRate, B = OutputSampleRate;
+	while (B != 0)
+	{
+		const int32 Remainder = A % B;
+		A = B;
+		B = Remainder;
+	}
+	InterpolationFactor = OutputSampleRate / A;
+	DecimationFactor = InputSampleRate / A;
+	NumPhases = FMath::Min(InterpolationFactor, GResamplerMaxPhases);
+
+	const double Ratio = (double)OutputSampleRate / (double)InputSampleRate;
+	NumTapsPerPhase = FMath::CeilToInt(GResamplerBaseTaps * FMath::Max(1.0, 1.0 / Ratio));
+	NumTapsPerPhase = Align(NumTapsPerPhase, DeepSpeechSimd::KernelWidth);
+
+	// Prototype low pass runs at NumPhases times the input rate, cutoff is in cycles per input sample.
+	const double Cutoff = 0.5 * FMath::Min(1.0, Ratio) * GResamplerCutoff;
+	const int32 PrototypeLength = NumPhases * NumTapsPerPhase;
+	const double Center = (PrototypeLength - 1) * 0.5;
+	const double WindowNormalization = 1.0 / BesselI0(GResamplerKaiserBeta);
+
+	FilterBank.SetNumUninitialized(PrototypeLength);
+	TArray<double, TInlineAllocator<256>> PhaseCoefficients;
+	PhaseCoefficients.SetNumUninitialized(NumTapsPerPhase);
+	for (int32 PhaseIndex = 0; PhaseIndex < NumPhases; ++PhaseIndex)
+	{
+		double Sum = 0.0;
+		for (int32 Tap = 0; Tap < NumTapsPerPhase; ++Tap)
+		{
+			// Stored reversed, Tap 0 multiplies the oldest sample in the history window.
+			const int32 PrototypeIndex = PhaseIndex + (NumTapsPerPhase - 1 - Tap) * NumPhases;
+			const double Time = (PrototypeIndex - Center) / NumPhases;
+			const double Sinc = Time == 0.0 ? 2.0 * Cutoff : FMath::Sin(2.0 * UE_DOUBLE_PI * Cutoff * Time) / (UE_DOUBLE_PI * Time);
+			const double WindowPosition = (PrototypeIndex - Center) / (PrototypeLength * 0.5);
+			const double Window = FMath::Abs(WindowPosition) <= 1.0
+				                      ? BesselI0(GResamplerKaiserBeta * FMath::Sqrt(1.0 - WindowPosition * WindowPosition)) * WindowNormalization
+				                      : 0.0;
+			PhaseCoefficients[Tap] = Sinc * Window;
+			Sum += PhaseCoefficients[Tap];
+		}
+
+		// Unity DC gain per phase, otherwise the phases ripple against each other.
+		for (int32 Tap = 0; Tap < NumTapsPerPhase; ++Tap)
+		{
+			FilterBank[PhaseIndex * NumTapsPerPhase + Tap] = static_cast<float>(PhaseCoefficients[Tap] / Sum);
+		}
+	}
+
+	History.SetNumUninitialized(NumTapsPerPhase - 1 + MaxInputBlockSize);
+	Reset();
+
+	UE_LOG(LogUETensorVox, Log, TEXT("Resampling %i hz to %i hz, %i phases, %i taps per phase, %s kernel."), InputSampleRate, OutputSampleRate,
+	       NumPhases, NumTapsPerPhase, KernelName);
+}
+
+void FDeepSpeechResampler::Reset()
+{
+	Phase = 0;
+	if (NumTapsPerPhase > 0)
+	{
+		FMemory::Memzero(History.GetData(), History.Num() * sizeof(float));
+		NumBuffered = NumTapsPerPhase - 1;
+		InputIndex = NumTapsPerPhase - 1;
+	}
+}
+
+int32 FDeepSpeechResampler::GetMaxOutputSamples(int32 NumInput) const
+{
+	if (IsPassthrough())
+	{
+		return NumInput;
+	}
+	return static_cast<int32>(((int64)NumInput * InterpolationFactor) / DecimationFactor) + 2;
+}
+
+float FDeepSpeechResampler::GetGroupDelay() const
+{
+	if (IsPassthrough())
+	{
+		return 0.0f;
+	}
+	// Center of the prototype filter, in input samples.
+	return (NumPhases * NumTapsPerPhase - 1) * 0.5f / NumPhases;
+}
+
+int32 FDeepSpeechResampler::Process(const int16* InSamples, int32 NumInput, int16* OutSamples)
+{
+	checkf(NumInput <= MaxInputBlockSize, TEXT("Resampler block too large, %i > %i"), NumInput, MaxInputBlockSize);
+	if (IsPassthrough())
+	{
+		FMemory::Memcpy(OutSamples, InSamples, NumInput * sizeof(int16));
+		return NumInput;
+	}
+
+	float* RESTRICT Input = GetInputBuffer(NumInput);
+	for (int32 Index = 0; Index < NumInput; ++Index)
+	{
+		Input[Index] = InSamples[Index];
+	}
+	return ProcessInput(NumInput, OutSamples);
+}
+
+float* FDeepSpeechResampler::GetInputBuffer(int32 NumInput)
+{
+	checkf(NumInput <= MaxInputBlockSize && !IsPassthrough(), TEXT("Resampler block too large, %i > %i"), NumInput, MaxInputBlockSize);
+	return History.GetData() + NumBuffered;
+}
+
+int32 FDeepSpeechResampler::ProcessInput(int32 NumInput, int16* OutSamples)
+{
+	float* RESTRICT HistoryData = History.GetData();
+	NumBuffered += NumInput;
+
+	const float* RESTRICT Filters = FilterBank.GetData();
+	const bool bExactPhases = NumPhases == InterpolationFactor;
+	int32 NumOutput = 0;
+	while (InputIndex < NumBuffered)
+	{
+		const int32 PhaseIndex = bExactPhases ? Phase : static_cast<int32>(((int64)Phase * NumPhases) / InterpolationFactor);
+		const float Value = DotProduct(HistoryData + InputIndex - NumTapsPerPhase + 1, Filters + PhaseIndex * NumTapsPerPhase, NumTapsPerPhase);
+		OutSamples[NumOutput++] = static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Value), -32768, 32767));
+
+		Phase += DecimationFactor;
+		InputIndex += Phase / InterpolationFactor;
+		Phase %= InterpolationFactor;
+	}
+
+	// Keep only what the next output still needs.
+	const int32 FirstNeeded = InputIndex - NumTapsPerPhase + 1;
+	const int32 NumRemaining = NumBuffered - FirstNeeded;
+	FMemory::Memmove(HistoryData, HistoryData + FirstNeeded, NumRemaining * sizeof(float));
+	NumBuffered = NumRemaining;
+	InputIndex -= FirstNeeded;
+
+	return NumOutput;
+}
@@ -0,0 +1,81 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechResultMailbox.h"
+#include "DeepSpeechStats.h"
+
+FDeepSpeechResultMailbox::FDeepSpeechResultMailbox()
+	: Middle(1), Back(0), Front(2), LastFinalUtteranceId(0), NumCoalesced(0)
+{
+}
+
+void FDeepSpeechResultMailbox::PostPartial(const FString& Text, const FDeepSpeechUtteranceTimings& Timings, const FDeepSpeechResultPtr& Result)
+{
+	FDeepSpeechMailboxEntry& Entry = Slots[Back];
+	Entry.Text = Text;
+	Entry.bFinal = false;
+	Entry.Timings = Timings;
+	Entry.Result = Result;
+
+	const uint8 Previous = Middle.exchange(Back | FreshBit, std::memory_order_acq_rel);
+	Back = Previous & IndexMask;
+	if (Previous & FreshBit)
+	{
+		NumCoalesced.fetch_add(1, std::memory_order_relaxed);
+		FDeepSpeechPipelineStats::NumCoalescedPartials.fetch_add(1, std::memory_order_relaxed);
+	}
+	// Let go of the pooled result the slot we got back held, so the pool can hand it out again.
+	Slots[Back].Result.Reset();
+}
+
+void FDeepSpeechResultMailbox::PostFinal(const FString& Text, const FDeepSpeechUtteranceTimings& Timings, const FDeepSpeechResultPtr& Result)
+{
+	FDeepSpeechMailboxEntry Entry;
+	Entry.Text = Text;
+	Entry.bFinal = true;
+	Entry.Timings = Timings;
+	Entry.Result = Result;
+	Finals.Enqueue(MoveTemp(Entry));
+}
+
+void FDeepSpeechResultMailbox::PostCommand(const FDeepSpeechCommandMatch& Match)
+{
+	Commands.Enqueue(Match);
+}
+
+int32 FDeepSpeechResultMailbox::DrainCommands(TFunctionRef<void(const FDeepSpeechCommandMatch&)> Visitor)
+{
+	int32 NumVisited = 0;
+	FDeepSpeechCommandMatch Match;
+	while (Commands.Dequeue(Match))
+	{
+		Visitor(Match);
+		++NumVisited;
+	}
+	return NumVisited;
+}
+
+int32 FDeepSpeechResultMailbox::Drain(TFunctionRef<void(FDeepSpeechMailboxEntry&)> Visitor)
+{
+	int32 NumVisited = 0;
+	FDeepSpeechMailboxEntry Final;
+	while (Finals.Dequeue(Final))
+	{
+		LastFinalUtteranceId = FMath::Max(LastFinalUtteranceId, Final.Timings.UtteranceId);
+		Visitor(Final);
+		++NumVisited;
+	}
+
+	if (Middle.load(std::memory_order_relaxed) & FreshBit)
+	{
+		Front = Middle.exchange(Front, std::memory_order_acq_rel) & IndexMask;
+		FDeepSpeechMailboxEntry& Partial = Slots[Front];
+		// Partials are posted before their utterance's final, but may be drained after it.
+		if (Partial.Timings.UtteranceId > LastFinalUtteranceId)
+		{
+			Visitor(Partial);
+			++NumVisited;
+		}
+		Partial.Result.Reset();
+	}
+	return NumVisited;
+}
@@ -0,0 +1,194 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechRtAudioSource.h"
+
+#if TENSORVOX_VALID_PLATFORM && TENSORVOX_WITH_RTAUDIO
+
+/**
+* Callback Function For the Microphone Capture for RtAudio
+*/
+static int32 OnAudioCaptureCallback(void* OutBuffer, void* InBuffer, uint32 InBufferFrames, double StreamTime,
+                                    RtAudioStreamStatus AudioStreamStatus, void* InUserData)
+{
+	FDeepSpeechRtAudioSource* Source = (FDeepSpeechRtAudioSource*)InUserData;
+	return Source->OnAudioCapture(InBuffer, InBufferFrames, StreamTime, AudioStreamStatus == RTAUDIO_INPUT_OVERFLOW);
+}
+
+FDeepSpeechRtAudioSource::FDeepSpeechRtAudioSource()
+	: RecordingSampleRate(0), BufferFrames(0), NumInputChannels(1), bFloat(false), Sink(nullptr), bError(false)
+{
+}
+
+FDeepSpeechRtAudioSource::~FDeepSpeechRtAudioSource()
+{
+	if (ADCInstance.isStreamOpen())
+	{
+		ADCInstance.abortStream();
+	}
+}
+
+bool FDeepSpeechRtAudioSource::Open(int32 PreferredSampleRate, int32 BlockSize)
+{
+	if (bError)
+	{
+		return false;
+	}
+
+	// If we have a stream open close it (reusing streams can cause a blip of previous recordings audio)
+	try
+	{
+		CloseStream();
+	}
+	catch (RtAudioError& e)
+	{
+		FString ErrorMessage = FString(e.what());
+		bError = true;
+		UE_LOG(LogUETensorVox, Error, TEXT("Failed to close the mic capture device stream: %s"), *ErrorMessage);
+		return false;
+	}
+
+	StreamParams.deviceId = ADCInstance.getDefaultInputDevice(); // Only use the default input device for now
+
+	// Get the default mic input device info
+	RtAudio::DeviceInfo Info = ADCInstance.getDeviceInfo(StreamParams.deviceId);
+	NumInputChannels = Info.inputChannels;
+	if (NumInputChannels <= 0)
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Default input device %s has no input channels."), UTF8_TO_TCHAR(Info.name.c_str()));
+		return false;
+	}
+
+	// Every channel, the front end picks or mixes them. Interfaces that only run in float are taken as is instead of having RtAudio convert.
+	StreamParams.nChannels = NumInputChannels;
+	StreamParams.firstChannel = 0;
+	bFloat = (Info.nativeFormats & RTAUDIO_SINT16) == 0 && (Info.nativeFormats & RTAUDIO_FLOAT32) != 0;
+
+	bool bSampleRateFound = false;
+	for (auto SampleRate : Info.sampleRates)
+	{
+		if (static_cast<int32>(SampleRate) == PreferredSampleRate)
+		{
+			RecordingSampleRate = SampleRate;
+			bSampleRateFound = true;
+			break;
+		}
+	}
+
+	if (!bSampleRateFound)
+	{
+		// Anything works since we resample, but prefer what the device runs at natively so it doesn't resample as well.
+		if (Info.preferredSampleRate > 0)
+		{
+			RecordingSampleRate = Info.preferredSampleRate;
+		}
+		else if (Info.sampleRates.size() > 0)
+		{
+			// The closest rate above the target, or the highest rate the device has.
+			auto const It = std::lower_bound(Info.sampleRates.begin(), Info.sampleRates.end(), static_cast<unsigned int>(PreferredSampleRate));
+			RecordingSampleRate = It != Info.sampleRates.end() ? *It : Info.sampleRates.back();
+		}
+		else
+		{
+			UE_LOG(LogUETensorVox, Error, TEXT("Input device reports no sample rates."));
+			return false;
+		}
+		UE_LOG(LogUETensorVox, Warning, TEXT("Sample rate %i not supported by the input device, recording at %i and resampling."), PreferredSampleRate,
+		       RecordingSampleRate);
+	}
+
+	if (RecordingSampleRate < 0)
+	{
+		UE_LOG(LogUETensorVox, Warning, TEXT("Invalid sample rate provided %i."), PreferredSampleRate);
+		return false;
+	}
+
+	BufferFrames = FMath::Max(BlockSize, 256);
+
+	// RtAudio uses exceptions for error handling...
+	try
+	{
+		// Open up new audio stream
+		ADCInstance.openStream(nullptr, &StreamParams, bFloat ? RTAUDIO_FLOAT32 : RTAUDIO_SINT16, RecordingSampleRate, &BufferFrames, &OnAudioCaptureCallback,
+		                       this);
+	}
+	catch (RtAudioError& e)
+	{
+		FString ErrorMessage = FString(e.what());
+		bError = true;
+		UE_LOG(LogUETensorVox, Error, TEXT("Failed to open the mic capture device: %s"), *ErrorMessage);
+		return false;
+	}
+	catch (const std::exception& e)
+	{
+		FString ErrorMessage = FString(e.what());
+		bError = true;
+		UE_LOG(LogUETensorVox, Error, TEXT("Failed to open the mic capture device: %s"), *ErrorMessage);
+		return false;
+	}
+	catch (...)
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Failed to open the mic capture device: unknown error"));
+		bError = true;
+		return false;
+	}
+
+	UE_LOG(LogUETensorVox, Log, TEXT("Opened microphone at %d hz sample rate, %d %s channels, and %d frame size."), RecordingSampleRate, NumInputChannels,
+	       bFloat ? TEXT("float") : TEXT("int16"), BufferFrames);
+	return true;
+}
+
+FDeepSpeechFrontEndSettings FDeepSpeechRtAudioSource::GetFrameLayout() const
+{
+	return FDeepSpeechAudioSources::GetCaptureFrontEnd(NumInputChannels, bFloat ? EDeepSpeechSampleFormat::Float : EDeepSpeechSampleFormat::Int16);
+}
+
+bool FDeepSpeechRtAudioSource::Start(IDeepSpeechAudioSink& InSink)
+{
+	Sink = &InSink;
+	try
+	{
+		ADCInstance.startStream();
+	}
+	catch (RtAudioError& e)
+	{
+		FString ErrorMessage = FString(e.what());
+		bError = true;
+		UE_LOG(LogUETensorVox, Error, TEXT("Failed to start the mic capture device: %s"), *ErrorMessage);
+		return false;
+	}
+	return true;
+}
+
+void FDeepSpeechRtAudioSource::Stop()
+{
+	try
+	{
+		CloseStream();
+	}
+	catch (RtAudioError& e)
+	{
+		FString ErrorMessage = FString(e.what());
+		UE_LOG(LogUETensorVox, Error, TEXT("Failed to stop the mic capture device: %s"), *ErrorMessage);
+	}
+}
+
+void FDeepSpeechRtAudioSource::CloseStream()
+{
+	if (ADCInstance.isStreamRunning())
+	{
+		ADCInstance.stopStream();
+	}
+	if (ADCInstance.isStreamOpen())
+	{
+		ADCInstance.closeStream();
+	}
+}
+
+int32 FDeepSpeechRtAudioSource::OnAudioCapture(void* InBuffer, uint32 InBufferFrames, double StreamTime, bool bOverflow)
+{
+	// The device's frames as they are, converting them is left to the reading thread so the callback never misses its deadline.
+	Sink->OnAudioCaptured(InBuffer, InBufferFrames, bOverflow);
+	return 0;
+}
+
+#endif
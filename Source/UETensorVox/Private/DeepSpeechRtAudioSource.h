@@ -0,0 +1,56 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechAudioSource.h"
+#include "DeepSpeechFrontEnd.h"
+#include "UETensorVox.h"
+
+#if TENSORVOX_VALID_PLATFORM && TENSORVOX_WITH_RTAUDIO
+#if PLATFORM_WINDOWS
+#include "Windows/WindowsHWrapper.h"
+#endif
+THIRD_PARTY_INCLUDES_START
+#include "RtAudio.h"
+THIRD_PARTY_INCLUDES_END
+
+/**
+ * The default input device through RtAudio. Records every channel the device has, in its native format, at the requested rate when the
+ * device has it and otherwise at the rate it prefers. Blocks are handed on as the device delivers them, the recorder's front end mixes or
+ * picks their channels as the TensorVox.Input.* console variables say and resamples them on the reading thread.
+ */
+class FDeepSpeechRtAudioSource : public IDeepSpeechAudioSource
+{
+public:
+	FDeepSpeechRtAudioSource();
+	virtual ~FDeepSpeechRtAudioSource() override;
+
+	virtual bool Open(int32 PreferredSampleRate, int32 BlockSize) override;
+	virtual bool Start(IDeepSpeechAudioSink& InSink) override;
+	virtual void Stop() override;
+	virtual int32 GetSampleRate() const override { return RecordingSampleRate; }
+	virtual FDeepSpeechFrontEndSettings GetFrameLayout() const override;
+	virtual const TCHAR* GetName() const override { return TEXT("RtAudio"); }
+
+	// Called by RtAudio when a new audio buffer is ready to be supplied.
+	int32 OnAudioCapture(void* InBuffer, uint32 InBufferFrames, double StreamTime, bool bOverflow);
+
+private:
+	void CloseStream();
+
+	RtAudio ADCInstance;
+	// Stream parameters to initialize the ADCInstance
+	RtAudio::StreamParameters StreamParams;
+
+	int32 RecordingSampleRate;
+	uint32 BufferFrames;
+	int32 NumInputChannels;
+	bool bFloat;
+
+	IDeepSpeechAudioSink* Sink;
+
+	// Set once the device failed, so we don't keep poking a broken driver.
+	bool bError;
+};
+#endif
@@ -0,0 +1,761 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechSessionJournal.h"
+#include "DeepSpeechSessionManager.h"
+#include "Async/Async.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "JsonObjectConverter.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UETensorVox.h"
+
+#if PLATFORM_WINDOWS
+#include "Windows/AllowWindowsPlatformTypes.h"
+#include <windows.h>
+#include "Windows/HideWindowsPlatformTypes.h"
+#define TENSORVOX_JOURNAL_MAPPED 1
+#elif PLATFORM_UNIX || PLATFORM_APPLE || PLATFORM_ANDROID
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define TENSORVOX_JOURNAL_MAPPED 1
+#else
+#define TENSORVOX_JOURNAL_MAPPED 0
+#endif
+
+static bool GTensorVoxJournal = false;
+static FAutoConsoleVariableRef CVarTensorVoxJournal(
+	TEXT("TensorVox.Journal"),
+	GTensorVoxJournal,
+	TEXT("Keeps a rolling journal of every new session's capture blocks, voice detection, transcription events and results in ")
+	TEXT("Saved/TensorVoxJournal, to replay with TensorVox.ReplayJournal."),
+	ECVF_Default);
+
+static int32 GTensorVoxJournalKilobytes = 32768;
+static FAutoConsoleVariableRef CVarTensorVoxJournalKilobytes(
+	TEXT("TensorVox.Journal.Kilobytes"),
+	GTensorVoxJournalKilobytes,
+	TEXT("Disk every session's journal takes, the oldest records are overwritten once it's full. 32 MB keeps about 5 minutes of 48 kHz capture."),
+	ECVF_Default);
+
+static int32 GTensorVoxJournalMaxTotalMB = 256;
+static FAutoConsoleVariableRef CVarTensorVoxJournalMaxTotalMB(
+	TEXT("TensorVox.Journal.MaxTotalMB"),
+	GTensorVoxJournalMaxTotalMB,
+	TEXT("Disk all journals in Saved/TensorVoxJournal take together. The oldest ones are deleted to make room for a new session's, ")
+	TEXT("a session gets none if the open ones already fill it."),
+	ECVF_Default);
+
+static const uint32 JournalMagic = 0x314A5654; // "TVJ1"
+// 2 keeps capture blocks as the device delivered them, with their layout in every start.
+static const uint32 JournalVersion = 2;
+// Room for the header and the configuration the session ran with.
+static const int64 JournalHeaderBytes = 64 * 1024;
+
+// Start payload, the capture rate and the front end the recorder turned blocks into mono with.
+struct FJournalStart
+{
+	int32 SampleRate;
+	int32 NumChannels;
+	int32 Format;
+	int32 Channel;
+	float Gain;
+	int32 bRemoveDC;
+};
+
+struct FJournalHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	uint64 RingBytes;
+	// Positions only ever grow, the offset into the ring is Position % RingBytes.
+	uint64 Head;
+	uint64 Tail;
+	int32 SessionId;
+	uint32 ConfigBytes;
+	// Whether transcription was requested when the oldest record left was written, and how blocks came in.
+	uint32 bStartedAtTail;
+	FJournalStart StartAtTail;
+};
+
+struct FJournalRecordHeader
+{
+	uint16 Type;
+	uint16 Flags;
+	uint32 PayloadBytes;
+	// Seconds since the session started.
+	double Time;
+};
+
+static const uint16 JournalFlagDeviceOverflow = 1;
+static const uint16 JournalFlagVoiced = 1;
+static const uint16 JournalFlagFinal = 1;
+
+static uint64 GetRecordBytes(uint32 PayloadBytes)
+{
+	return Align(sizeof(FJournalRecordHeader) + (uint64)PayloadBytes, 8);
+}
+
+// Journals this process has mapped, left alone when making room. Guards making room and opening, so two sessions can't both count on it.
+static FCriticalSection GJournalFilesCritical;
+static TSet<FString> GOpenJournalPaths;
+
+/** Deletes the oldest journals not open in this process until NewFileBytes more fit in BudgetBytes, false if they still don't. */
+static bool MakeJournalRoom(const FString& Directory, int64 NewFileBytes, int64 BudgetBytes)
+{
+	struct FJournalFile
+	{
+		FString Path;
+		FDateTime ModificationTime;
+		int64 Bytes;
+	};
+	TArray<FJournalFile> Files;
+	int64 TotalBytes = 0;
+	IFileManager::Get().IterateDirectoryStat(*Directory, [&Files, &TotalBytes](const TCHAR* FilenameOrDirectory, const FFileStatData& StatData)
+	{
+		if (!StatData.bIsDirectory && FPaths::GetExtension(FilenameOrDirectory) == TEXT("tvj"))
+		{
+			Files.Add({FPaths::ConvertRelativePathToFull(FilenameOrDirectory), StatData.ModificationTime, StatData.FileSize});
+			TotalBytes += StatData.FileSize;
+		}
+		return true;
+	});
+	Files.Sort([](const FJournalFile& A, const FJournalFile& B) { return A.ModificationTime < B.ModificationTime; });
+
+	for (const FJournalFile& File : Files)
+	{
+		if (TotalBytes + NewFileBytes <= BudgetBytes)
+		{
+			break;
+		}
+		if (!GOpenJournalPaths.Contains(File.Path) && IFileManager::Get().Delete(*File.Path, false, false, true))
+		{
+			UE_LOG(LogUETensorVox, Log, TEXT("Deleted journal %s to stay within TensorVox.Journal.MaxTotalMB."), *File.Path);
+			TotalBytes -= File.Bytes;
+		}
+	}
+	return TotalBytes + NewFileBytes <= BudgetBytes;
+}
+
+/**
+* FDeepSpeechSessionJournal Implementation
+*/
+
+FDeepSpeechSessionJournal::FDeepSpeechSessionJournal()
+	: StartTime(FPlatformTime::Seconds()), Memory(nullptr), FileBytes(0), FileHandle(nullptr), MappingHandle(nullptr)
+{
+}
+
+FDeepSpeechSessionJournal::~FDeepSpeechSessionJournal()
+{
+	Close();
+	FScopeLock Lock(&GJournalFilesCritical);
+	GOpenJournalPaths.Remove(Path);
+}
+
+bool FDeepSpeechSessionJournal::IsEnabled()
+{
+	return GTensorVoxJournal;
+}
+
+TSharedPtr<FDeepSpeechSessionJournal, ESPMode::ThreadSafe> FDeepSpeechSessionJournal::Create(int32 SessionId, const FDeepSpeechConfiguration& Config)
+{
+	const FString JournalDirectory = FPaths::ConvertRelativePathToFull(FPaths::ProjectSavedDir() / TEXT("TensorVoxJournal"));
+	const FString JournalPath = JournalDirectory / FString::Printf(TEXT("%s_Session%i.tvj"), *FDateTime::Now().ToString(), SessionId);
+	// A single journal never takes more than the whole budget.
+	const int64 BudgetBytes = (int64)FMath::Max(GTensorVoxJournalMaxTotalMB, 1) * 1024 * 1024;
+	const int64 RingBytes = Align(FMath::Max(FMath::Min((int64)GTensorVoxJournalKilobytes * 1024, BudgetBytes - JournalHeaderBytes), (int64)256 * 1024), 8);
+
+	FScopeLock Lock(&GJournalFilesCritical);
+	if (!MakeJournalRoom(JournalDirectory, JournalHeaderBytes + RingBytes, BudgetBytes))
+	{
+		UE_LOG(LogUETensorVox, Warning, TEXT("Session %i has no journal, open journals already fill TensorVox.Journal.MaxTotalMB (%i MB)."), SessionId,
+		       GTensorVoxJournalMaxTotalMB);
+		return nullptr;
+	}
+
+	TSharedPtr<FDeepSpeechSessionJournal, ESPMode::ThreadSafe> Journal = MakeShareable(new FDeepSpeechSessionJournal());
+	if (!Journal->Open(JournalPath, RingBytes, SessionId, Config))
+	{
+		UE_LOG(LogUETensorVox, Warning, TEXT("Couldn't create session journal %s."), *JournalPath);
+		return nullptr;
+	}
+	GOpenJournalPaths.Add(JournalPath);
+	UE_LOG(LogUETensorVox, Log, TEXT("Session %i journals to %s (%lld KB)."), SessionId, *JournalPath, RingBytes / 1024);
+	return Journal;
+}
+
+bool FDeepSpeechSessionJournal::Open(const FString& InPath, int64 RingBytes, int32 SessionId, const FDeepSpeechConfiguration& Config)
+{
+	Path = InPath;
+	FileBytes = JournalHeaderBytes + RingBytes;
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Path), true);
+
+#if PLATFORM_WINDOWS
+	HANDLE File = CreateFileW(*Path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (File == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	// Sizes the file as it's mapped.
+	HANDLE Mapping = CreateFileMappingW(File, nullptr, PAGE_READWRITE, (DWORD)(FileBytes >> 32), (DWORD)FileBytes, nullptr);
+	void* View = Mapping ? MapViewOfFile(Mapping, FILE_MAP_WRITE, 0, 0, FileBytes) : nullptr;
+	if (!View)
+	{
+		if (Mapping)
+		{
+			CloseHandle(Mapping);
+		}
+		CloseHandle(File);
+		return false;
+	}
+	FileHandle = File;
+	MappingHandle = Mapping;
+	Memory = (uint8*)View;
+#elif TENSORVOX_JOURNAL_MAPPED
+	const int File = open(TCHAR_TO_UTF8(*Path), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (File < 0)
+	{
+		return false;
+	}
+	void* View = ftruncate(File, FileBytes) == 0 ? mmap(nullptr, FileBytes, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0) : MAP_FAILED;
+	// The mapping keeps the file open.
+	close(File);
+	if (View == MAP_FAILED)
+	{
+		return false;
+	}
+	Memory = (uint8*)View;
+#else
+	FallbackMemory.SetNumZeroed(FileBytes);
+	Memory = FallbackMemory.GetData();
+#endif
+
+	FString ConfigJson;
+	FJsonObjectConverter::UStructToJsonObjectString(Config, ConfigJson);
+	const FTCHARToUTF8 ConfigUtf8(*ConfigJson);
+
+	FJournalHeader& Header = *(FJournalHeader*)Memory;
+	Header = FJournalHeader();
+	Header.Magic = JournalMagic;
+	Header.Version = JournalVersion;
+	Header.RingBytes = RingBytes;
+	Header.SessionId = SessionId;
+	Header.ConfigBytes = FMath::Min<int32>(ConfigUtf8.Length(), JournalHeaderBytes - sizeof(FJournalHeader));
+	FMemory::Memcpy(Memory + sizeof(FJournalHeader), ConfigUtf8.Get(), Header.ConfigBytes);
+	return true;
+}
+
+void FDeepSpeechSessionJournal::Close()
+{
+	if (!Memory)
+	{
+		return;
+	}
+
+#if PLATFORM_WINDOWS
+	UnmapViewOfFile(Memory);
+	CloseHandle((HANDLE)MappingHandle);
+	CloseHandle((HANDLE)FileHandle);
+#elif TENSORVOX_JOURNAL_MAPPED
+	munmap(Memory, FileBytes);
+#else
+	FFileHelper::SaveArrayToFile(FallbackMemory, *Path);
+	FallbackMemory.Empty();
+#endif
+	Memory = nullptr;
+}
+
+void FDeepSpeechSessionJournal::TrimTo(uint64 NewHead)
+{
+	FJournalHeader& Header = *(FJournalHeader*)Memory;
+	uint8* Ring = Memory + JournalHeaderBytes;
+	while (NewHead - Header.Tail > Header.RingBytes)
+	{
+		const uint64 Offset = Header.Tail % Header.RingBytes;
+		// Too close to the end for a record, the writer skipped it.
+		if (Header.RingBytes - Offset < sizeof(FJournalRecordHeader))
+		{
+			Header.Tail += Header.RingBytes - Offset;
+			continue;
+		}
+
+		const FJournalRecordHeader& Record = *(const FJournalRecordHeader*)(Ring + Offset);
+		if (Record.Type == (uint16)EDeepSpeechJournalRecord::Start)
+		{
+			Header.bStartedAtTail = 1;
+			FMemory::Memcpy(&Header.StartAtTail, Ring + Offset + sizeof(FJournalRecordHeader), sizeof(FJournalStart));
+		}
+		else if (Record.Type == (uint16)EDeepSpeechJournalRecord::End)
+		{
+			Header.bStartedAtTail = 0;
+		}
+		Header.Tail += GetRecordBytes(Record.PayloadBytes);
+	}
+}
+
+void FDeepSpeechSessionJournal::Append(EDeepSpeechJournalRecord Type, uint16 Flags, double Time, TArrayView<const uint8> Payload,
+                                       TArrayView<const uint8> Payload2, TArrayView<const uint8> Payload3)
+{
+	if (!Memory)
+	{
+		return;
+	}
+
+	FJournalHeader& Header = *(FJournalHeader*)Memory;
+	uint8* Ring = Memory + JournalHeaderBytes;
+	const uint32 PayloadBytes = Payload.Num() + Payload2.Num() + Payload3.Num();
+	const uint64 RecordBytes = GetRecordBytes(PayloadBytes);
+	if (RecordBytes > Header.RingBytes / 2)
+	{
+		return;
+	}
+
+	uint64 Head = Header.Head;
+	const uint64 Remaining = Header.RingBytes - Head % Header.RingBytes;
+	if (Remaining < RecordBytes)
+	{
+		// Records never straddle the end, fill it and start over at the beginning.
+		TrimTo(Head + Remaining);
+		if (Remaining >= sizeof(FJournalRecordHeader))
+		{
+			FJournalRecordHeader Filler = {(uint16)EDeepSpeechJournalRecord::Wrap, 0, (uint32)(Remaining - sizeof(FJournalRecordHeader)), Time};
+			FMemory::Memcpy(Ring + Head % Header.RingBytes, &Filler, sizeof(Filler));
+		}
+		Head += Remaining;
+	}
+
+	TrimTo(Head + RecordBytes);
+	uint8* Destination = Ring + Head % Header.RingBytes;
+	const FJournalRecordHeader Record = {(uint16)Type, Flags, PayloadBytes, Time};
+	FMemory::Memcpy(Destination, &Record, sizeof(Record));
+	Destination += sizeof(Record);
+	for (const TArrayView<const uint8>& Part : {Payload, Payload2, Payload3})
+	{
+		FMemory::Memcpy(Destination, Part.GetData(), Part.Num());
+		Destination += Part.Num();
+	}
+
+	// The record is complete before the header says so, a crash in between loses only this record.
+	FPlatformMisc::MemoryBarrier();
+	Header.Head = Head + RecordBytes;
+}
+
+void FDeepSpeechSessionJournal::AddBlock(double ArrivalTime, TArrayView<const int16> First, TArrayView<const int16> Second, bool bDeviceOverflow,
+                                         int32 NumDropped)
+{
+	const int32 Counts[2] = {NumDropped, (int32)((First.Num() + Second.Num()) * sizeof(int16))};
+	FScopeLock Lock(&Critical);
+	Append(EDeepSpeechJournalRecord::Block, bDeviceOverflow ? JournalFlagDeviceOverflow : 0, ArrivalTime - StartTime,
+	       TArrayView<const uint8>((const uint8*)Counts, sizeof(Counts)),
+	       TArrayView<const uint8>((const uint8*)First.GetData(), First.Num() * sizeof(int16)),
+	       TArrayView<const uint8>((const uint8*)Second.GetData(), Second.Num() * sizeof(int16)));
+}
+
+void FDeepSpeechSessionJournal::AddVad(bool bVoiced)
+{
+	FScopeLock Lock(&Critical);
+	Append(EDeepSpeechJournalRecord::Vad, bVoiced ? JournalFlagVoiced : 0, FPlatformTime::Seconds() - StartTime, {});
+}
+
+void FDeepSpeechSessionJournal::AddStart(int32 SampleRate, const FDeepSpeechFrontEndSettings& FrameLayout)
+{
+	const FJournalStart Start = {SampleRate, FrameLayout.NumChannels, (int32)FrameLayout.Format, FrameLayout.Channel, FrameLayout.Gain, FrameLayout.bRemoveDC};
+	FScopeLock Lock(&Critical);
+	Append(EDeepSpeechJournalRecord::Start, 0, FPlatformTime::Seconds() - StartTime, TArrayView<const uint8>((const uint8*)&Start, sizeof(Start)));
+}
+
+static void ReadJournalStart(const FJournalStart& Start, FDeepSpeechJournalContents::FUtterance& OutUtterance)
+{
+	OutUtterance.SampleRate = Start.SampleRate;
+	OutUtterance.FrameLayout.NumChannels = FMath::Max(Start.NumChannels, 1);
+	OutUtterance.FrameLayout.Format = (EDeepSpeechSampleFormat)Start.Format;
+	OutUtterance.FrameLayout.Channel = Start.Channel;
+	OutUtterance.FrameLayout.Gain = Start.Gain;
+	OutUtterance.FrameLayout.bRemoveDC = Start.bRemoveDC != 0;
+}
+
+void FDeepSpeechSessionJournal::AddEnd()
+{
+	FScopeLock Lock(&Critical);
+	Append(EDeepSpeechJournalRecord::End, 0, FPlatformTime::Seconds() - StartTime, {});
+}
+
+void FDeepSpeechSessionJournal::AddResult(FStringView Text, bool bFinal)
+{
+	const FTCHARToUTF8 Utf8(Text.GetData(), Text.Len());
+	FScopeLock Lock(&Critical);
+	Append(EDeepSpeechJournalRecord::Result, bFinal ? JournalFlagFinal : 0, FPlatformTime::Seconds() - StartTime,
+	       TArrayView<const uint8>((const uint8*)Utf8.Get(), Utf8.Length()));
+}
+
+/**
+* FDeepSpeechJournalContents Implementation
+*/
+
+bool FDeepSpeechJournalContents::Load(const FString& Path, FDeepSpeechJournalContents& OutContents, FString& OutError)
+{
+	TArray<uint8> File;
+	if (!FFileHelper::LoadFileToArray(File, *Path))
+	{
+		OutError = TEXT("couldn't read the file");
+		return false;
+	}
+
+	if (File.Num() < JournalHeaderBytes)
+	{
+		OutError = TEXT("not a session journal");
+		return false;
+	}
+
+	// A ring that's a multiple of the records' 8 byte alignment keeps every record header aligned.
+	const FJournalHeader& Header = *(const FJournalHeader*)File.GetData();
+	if (Header.Magic != JournalMagic || Header.RingBytes == 0 || Header.RingBytes % 8 != 0 || (uint64)(File.Num() - JournalHeaderBytes) < Header.RingBytes ||
+		Header.Head - Header.Tail > Header.RingBytes || Header.ConfigBytes > JournalHeaderBytes - sizeof(FJournalHeader))
+	{
+		OutError = TEXT("not a session journal");
+		return false;
+	}
+	if (Header.Version != JournalVersion)
+	{
+		OutError = FString::Printf(TEXT("journal version %u, only %u can be replayed"), Header.Version, JournalVersion);
+		return false;
+	}
+
+	OutContents = FDeepSpeechJournalContents();
+	OutContents.SessionId = Header.SessionId;
+	const FUTF8ToTCHAR ConfigJson((const ANSICHAR*)File.GetData() + sizeof(FJournalHeader), Header.ConfigBytes);
+	if (!FJsonObjectConverter::JsonObjectStringToUStruct(FString(ConfigJson.Length(), ConfigJson.Get()), &OutContents.Config))
+	{
+		OutError = TEXT("couldn't read the session's configuration");
+		return false;
+	}
+
+	const uint8* Ring = File.GetData() + JournalHeaderBytes;
+	FUtterance* Current = nullptr;
+	if (Header.bStartedAtTail)
+	{
+		Current = &OutContents.Utterances.AddDefaulted_GetRef();
+		ReadJournalStart(Header.StartAtTail, *Current);
+	}
+
+	for (uint64 Position = Header.Tail; Position < Header.Head;)
+	{
+		const uint64 Offset = Position % Header.RingBytes;
+		if (Header.RingBytes - Offset < sizeof(FJournalRecordHeader))
+		{
+			Position += Header.RingBytes - Offset;
+			continue;
+		}
+
+		// Records never straddle the end of the ring, and the last one ends at the head.
+		const FJournalRecordHeader& Record = *(const FJournalRecordHeader*)(Ring + Offset);
+		const uint8* Payload = Ring + Offset + sizeof(FJournalRecordHeader);
+		const uint64 RecordBytes = GetRecordBytes(Record.PayloadBytes);
+		if (RecordBytes > Header.RingBytes - Offset || RecordBytes > Header.Head - Position)
+		{
+			OutError = FString::Printf(TEXT("the record at %llu runs past the %s"), Position, RecordBytes > Header.RingBytes - Offset ? TEXT("ring") : TEXT("head"));
+			return false;
+		}
+		const uint64 RecordPosition = Position;
+		Position += RecordBytes;
+
+		switch ((EDeepSpeechJournalRecord)Record.Type)
+		{
+		case EDeepSpeechJournalRecord::Start:
+			if (Record.PayloadBytes < sizeof(FJournalStart))
+			{
+				OutError = FString::Printf(TEXT("the start at %llu is %u bytes, too short"), RecordPosition, Record.PayloadBytes);
+				return false;
+			}
+			Current = &OutContents.Utterances.AddDefaulted_GetRef();
+			Current->StartTime = Record.Time;
+			{
+				FJournalStart Start;
+				FMemory::Memcpy(&Start, Payload, sizeof(Start));
+				ReadJournalStart(Start, *Current);
+			}
+			break;
+		case EDeepSpeechJournalRecord::End:
+			if (Current)
+			{
+				Current->EndTime = Record.Time;
+			}
+			Current = nullptr;
+			break;
+		case EDeepSpeechJournalRecord::Block:
+			if (Current)
+			{
+				int32 Counts[2] = {0, 0};
+				if (Record.PayloadBytes >= sizeof(Counts))
+				{
+					FMemory::Memcpy(Counts, Payload, sizeof(Counts));
+				}
+				if (Record.PayloadBytes < sizeof(Counts) || Counts[0] < 0 || Counts[1] < 0 || (uint32)Counts[1] > Record.PayloadBytes - sizeof(Counts))
+				{
+					OutError = FString::Printf(TEXT("the block at %llu says it has %i bytes of audio in a %u byte record"), RecordPosition, Counts[1],
+					                           Record.PayloadBytes);
+					return false;
+				}
+				FBlock& Block = Current->Blocks.AddDefaulted_GetRef();
+				Block.StreamTime = Record.Time;
+				Block.bDeviceOverflow = (Record.Flags & JournalFlagDeviceOverflow) != 0;
+				Block.NumDropped = Counts[0];
+				Block.Frames.SetNumUninitialized(Counts[1]);
+				FMemory::Memcpy(Block.Frames.GetData(), Payload + sizeof(Counts), Counts[1]);
+				const int32 BytesPerFrame = Current->FrameLayout.NumChannels *
+					(Current->FrameLayout.Format == EDeepSpeechSampleFormat::Float ? sizeof(float) : sizeof(int16));
+				Block.NumFrames = Counts[1] / BytesPerFrame;
+			}
+			break;
+		case EDeepSpeechJournalRecord::Vad:
+			if (Current)
+			{
+				Current->NumVadFrames++;
+				Current->NumVoicedFrames += (Record.Flags & JournalFlagVoiced) ? 1 : 0;
+			}
+			break;
+		case EDeepSpeechJournalRecord::Result:
+		{
+			// Finals of an utterance that ended come in after its end.
+			FUtterance* Owner = Current ? Current : OutContents.Utterances.Num() > 0 ? &OutContents.Utterances.Last() : nullptr;
+			if (!Owner)
+			{
+				break;
+			}
+			if (Record.Flags & JournalFlagFinal)
+			{
+				const FUTF8ToTCHAR Text((const ANSICHAR*)Payload, Record.PayloadBytes);
+				Owner->Finals.Emplace(Text.Length(), Text.Get());
+			}
+			else
+			{
+				Owner->NumIntermediates++;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	return true;
+}
+
+/**
+* FDeepSpeechJournalAudioSource Implementation
+*/
+
+FDeepSpeechJournalAudioSource::FDeepSpeechJournalAudioSource(const TSharedRef<const FDeepSpeechJournalContents, ESPMode::ThreadSafe>& InContents)
+	: Contents(InContents), UtteranceIndex(INDEX_NONE), SampleRate(0), Sink(nullptr), Thread(nullptr), bRunning(false), bFinished(false), NumDelivered(0)
+{
+}
+
+FDeepSpeechJournalAudioSource::~FDeepSpeechJournalAudioSource()
+{
+	Stop();
+}
+
+bool FDeepSpeechJournalAudioSource::Open(int32 PreferredSampleRate, int32 BlockSize)
+{
+	const int32 NextIndex = UtteranceIndex + 1;
+	if (!Contents->Utterances.IsValidIndex(NextIndex) || Contents->Utterances[NextIndex].SampleRate <= 0)
+	{
+		return false;
+	}
+	UtteranceIndex = NextIndex;
+	SampleRate = Contents->Utterances[NextIndex].SampleRate;
+	return true;
+}
+
+FDeepSpeechFrontEndSettings FDeepSpeechJournalAudioSource::GetFrameLayout() const
+{
+	return Contents->Utterances.IsValidIndex(UtteranceIndex) ? Contents->Utterances[UtteranceIndex].FrameLayout : FDeepSpeechFrontEndSettings();
+}
+
+bool FDeepSpeechJournalAudioSource::Start(IDeepSpeechAudioSink& InSink)
+{
+	check(!Thread);
+	Sink = &InSink;
+	bFinished = false;
+	NumDelivered = 0;
+	bRunning = true;
+	Thread = FRunnableThread::Create(this, TEXT("TensorVoxJournalSource"), 0, TPri_AboveNormal);
+	return Thread != nullptr;
+}
+
+void FDeepSpeechJournalAudioSource::Stop()
+{
+	bRunning = false;
+	if (Thread)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+		Thread = nullptr;
+	}
+}
+
+uint32 FDeepSpeechJournalAudioSource::Run()
+{
+	for (const FDeepSpeechJournalContents::FBlock& Block : Contents->Utterances[UtteranceIndex].Blocks)
+	{
+		// Unthrottled, but never faster than the sink drains, so only the drops that happened back then happen again.
+		while (bRunning && Sink->GetNumFreeFrames() < Block.NumFrames)
+		{
+			FPlatformProcess::SleepNoStats(0.0f);
+		}
+		if (!bRunning)
+		{
+			return 0;
+		}
+
+		Sink->OnAudioCaptured(Block.Frames.GetData(), Block.NumFrames, Block.bDeviceOverflow);
+		NumDelivered.fetch_add(Block.NumFrames, std::memory_order_relaxed);
+	}
+	bFinished = true;
+	return 0;
+}
+
+// Everything a replay collects, shared with the session's callback.
+struct FJournalReplayRun
+{
+	FCriticalSection Critical;
+	TArray<FString> Finals;
+	int32 NumIntermediates = 0;
+	std::atomic<FDeepSpeechJournalAudioSource*> Source{nullptr};
+};
+
+static void RunJournalReplay(const FString& Path, const FString& ModelPath, const FString& ScorerPath)
+{
+	const TSharedRef<FDeepSpeechJournalContents, ESPMode::ThreadSafe> Contents = MakeShared<FDeepSpeechJournalContents, ESPMode::ThreadSafe>();
+	FString Error;
+	if (!FDeepSpeechJournalContents::Load(Path, *Contents, Error))
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Couldn't replay %s: %s."), *Path, *Error);
+		return;
+	}
+
+	// Models live somewhere else on the machine the journal was recorded on.
+	FDeepSpeechConfiguration Config = Contents->Config;
+	if (!ModelPath.IsEmpty())
+	{
+		Config.ModelPath = ModelPath;
+	}
+	if (!ScorerPath.IsEmpty())
+	{
+		Config.ScorerPath = ScorerPath;
+	}
+
+	const TSharedRef<FJournalReplayRun, ESPMode::ThreadSafe> Run = MakeShared<FJournalReplayRun, ESPMode::ThreadSafe>();
+	const FDeepSpeechSessionPtr Session = FDeepSpeechSessionManager::Get().OpenSession(Config, FOnDeepSpeechTranscribed::CreateLambda(
+		[Run](const FString& Transcription, bool bFinal, const FDeepSpeechUtteranceTimings& Timings)
+		{
+			FScopeLock Lock(&Run->Critical);
+			if (bFinal)
+			{
+				Run->Finals.Add(Transcription);
+			}
+			else
+			{
+				Run->NumIntermediates++;
+			}
+		}), [Run, Contents]()
+		{
+			TUniquePtr<FDeepSpeechJournalAudioSource> Source = MakeUnique<FDeepSpeechJournalAudioSource>(Contents);
+			Run->Source = Source.Get();
+			return Source;
+		});
+
+	const auto GetNumFinals = [&Run]()
+	{
+		FScopeLock Lock(&Run->Critical);
+		return Run->Finals.Num();
+	};
+	const auto WaitFor = [&Session](double TimeoutSeconds, const TFunctionRef<bool()>& Condition)
+	{
+		const double Deadline = FPlatformTime::Seconds() + TimeoutSeconds;
+		while (!Session->HasFailed() && !Condition() && FPlatformTime::Seconds() < Deadline)
+		{
+			FPlatformProcess::Sleep(0.001f);
+		}
+		return Condition();
+	};
+
+	const double StartTime = FPlatformTime::Seconds();
+	double AudioSeconds = 0.0;
+	int32 NumExpectedFinals = 0, NumMatched = 0, NumUnfinished = 0;
+	for (int32 Index = 0; Index < Contents->Utterances.Num() && !Session->HasFailed(); ++Index)
+	{
+		const FDeepSpeechJournalContents::FUtterance& Utterance = Contents->Utterances[Index];
+		const int32 NumFinalsBefore = GetNumFinals();
+
+		// Hold transcription for exactly as long as the utterance's audio takes to go through the session.
+		Session->SetTranscriptionRequested(true);
+		const bool bPlayed = WaitFor(600.0, [&Run, &Session, Index]()
+		{
+			const FDeepSpeechJournalAudioSource* Source = Run->Source;
+			return Source && Source->GetUtteranceIndex() == Index && Source->IsFinished() && Session->GetNumSamplesHandled() >= Source->GetNumDelivered();
+		});
+		Session->SetTranscriptionRequested(false);
+
+		// Finals may come after the end, and there may be several with automatic endpointing.
+		WaitFor(30.0, [&GetNumFinals, NumFinalsBefore, &Utterance]() { return GetNumFinals() >= NumFinalsBefore + Utterance.Finals.Num(); });
+		NumUnfinished += bPlayed ? 0 : 1;
+
+		TArray<FString> Replayed;
+		{
+			FScopeLock Lock(&Run->Critical);
+			Replayed = TArray<FString>(Run->Finals.GetData() + NumFinalsBefore, Run->Finals.Num() - NumFinalsBefore);
+		}
+
+		int32 NumSamples = 0, NumDropped = 0, NumDeviceOverflows = 0;
+		for (const FDeepSpeechJournalContents::FBlock& Block : Utterance.Blocks)
+		{
+			NumSamples += Block.NumFrames;
+			NumDropped += Block.NumDropped;
+			NumDeviceOverflows += Block.bDeviceOverflow ? 1 : 0;
+		}
+		AudioSeconds += Utterance.SampleRate > 0 ? (double)NumSamples / Utterance.SampleRate : 0.0;
+
+		const FString Journaled = FString::Join(Utterance.Finals, TEXT(" | "));
+		const FString Replay = FString::Join(Replayed, TEXT(" | "));
+		const bool bMatched = Journaled == Replay;
+		NumExpectedFinals += Utterance.Finals.Num();
+		NumMatched += bMatched ? 1 : 0;
+		UE_LOG(LogUETensorVox, Display, TEXT("Utterance %i at %.2fs: %i blocks, %.2fs at %i hz, %i of %i frames voiced, %i device overflows, %i frames dropped."),
+		       Index, Utterance.StartTime, Utterance.Blocks.Num(), Utterance.SampleRate > 0 ? (double)NumSamples / Utterance.SampleRate : 0.0,
+		       Utterance.SampleRate, Utterance.NumVoicedFrames, Utterance.NumVadFrames, NumDeviceOverflows, NumDropped);
+		UE_LOG(LogUETensorVox, Display, TEXT("  %s journaled: \"%s\""), bMatched ? TEXT("   ") : TEXT("(!)"), *Journaled);
+		UE_LOG(LogUETensorVox, Display, TEXT("  %s replayed:  \"%s\""), bMatched ? TEXT("   ") : TEXT("(!)"), *Replay);
+	}
+
+	const double WallSeconds = FPlatformTime::Seconds() - StartTime;
+	FDeepSpeechSessionManager::Get().CloseSession(Session);
+	UE_LOG(LogUETensorVox, Display, TEXT("Replayed %s: %i utterances, %i match the journal, %i didn't finish, %.1fs of audio in %.1fs (%.1fx real time)."),
+	       *FPaths::GetCleanFilename(Path), Contents->Utterances.Num(), NumMatched, NumUnfinished, AudioSeconds, WallSeconds,
+	       WallSeconds > 0.0 ? AudioSeconds / WallSeconds : 0.0);
+}
+
+static void ReplayJournal(const TArray<FString>& Args)
+{
+	if (Args.Num() < 1)
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("Usage: TensorVox.ReplayJournal <Journal> [ModelPath] [ScorerPath]"));
+		return;
+	}
+
+	const FString Path = Args[0];
+	const FString ModelPath = Args.Num() > 1 ? Args[1] : FString();
+	const FString ScorerPath = Args.Num() > 2 ? Args[2] : FString();
+	Async(EAsyncExecution::Thread, [Path, ModelPath, ScorerPath]()
+	{
+		RunJournalReplay(Path, ModelPath, ScorerPath);
+	});
+}
+
+static FAutoConsoleCommand GTensorVoxReplayJournalCommand(
+	TEXT("TensorVox.ReplayJournal"),
+	TEXT("Feeds a session journal back through a session as fast as it goes, with the configuration it was recorded with, and compares the ")
+	TEXT("transcriptions with the journaled ones. Usage: TensorVox.ReplayJournal <Journal> [ModelPath] [ScorerPath]"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&ReplayJournal));
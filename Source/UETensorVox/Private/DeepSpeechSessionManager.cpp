@@ -0,0 +1,207 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechSessionManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/RunnableThread.h"
+#include "UETensorVox.h"
+
+static int32 GTensorVoxNumWorkers = 2;
+static FAutoConsoleVariableRef CVarTensorVoxNumWorkers(
+	TEXT("TensorVox.NumWorkers"),
+	GTensorVoxNumWorkers,
+	TEXT("Number of worker threads shared by every transcription session. Read when the first session opens."),
+	ECVF_Default);
+
+FDeepSpeechSessionManager::FDeepSpeechSessionManager()
+	: NextSessionIndex(0), NextSessionId(1), NumRunningWorkers(0), bRunning(false), BusyCycles(0), WakeEvent(FPlatformProcess::GetSynchEventFromPool())
+{
+}
+
+FDeepSpeechSessionManager::~FDeepSpeechSessionManager()
+{
+	Shutdown();
+	FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+	WakeEvent = nullptr;
+}
+
+FDeepSpeechSessionManager& FDeepSpeechSessionManager::Get()
+{
+	return FUETensorVoxModule::Get().GetSessionManager();
+}
+
+FDeepSpeechSessionPtr FDeepSpeechSessionManager::OpenSession(const FDeepSpeechConfiguration& Config, FOnDeepSpeechTranscribed OnTranscribed,
+                                                             FDeepSpeechAudioSourceFactory SourceFactory, FOnDeepSpeechResult OnResult)
+{
+	FDeepSpeechSessionPtr Session;
+	{
+		FScopeLock Lock(&SessionsCritical);
+		Session = MakeShared<FDeepSpeechTranscriptionSession, ESPMode::ThreadSafe>(*this, NextSessionId++, Config, MoveTemp(OnTranscribed),
+		                                                                            MoveTemp(SourceFactory), MoveTemp(OnResult));
+		Sessions.Add(Session);
+		StartWorkers();
+	}
+
+	WakeEvent->Trigger();
+	return Session;
+}
+
+void FDeepSpeechSessionManager::CloseSession(const FDeepSpeechSessionPtr& Session)
+{
+	if (Session)
+	{
+		Session->RequestClose();
+	}
+}
+
+void FDeepSpeechSessionManager::WakeSession(FDeepSpeechTranscriptionSession& Session)
+{
+	if (!Session.bWakeRequested.exchange(true))
+	{
+		WakeEvent->Trigger();
+	}
+}
+
+int32 FDeepSpeechSessionManager::GetNumSessions() const
+{
+	FScopeLock Lock(&SessionsCritical);
+	return Sessions.Num();
+}
+
+void FDeepSpeechSessionManager::StartWorkers()
+{
+	if (bRunning)
+	{
+		return;
+	}
+
+	bRunning = true;
+	const int32 NumWorkers = FMath::Clamp(GTensorVoxNumWorkers, 1, 64);
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; ++WorkerIndex)
+	{
+		TUniquePtr<FWorker>& Worker = Workers.Emplace_GetRef(MakeUnique<FWorker>(*this));
+		NumRunningWorkers++;
+		WorkerThreads.Add(FRunnableThread::Create(Worker.Get(), *FString::Printf(TEXT("TensorVoxWorker%i"), WorkerIndex), 0, TPri_Normal));
+	}
+	UE_LOG(LogUETensorVox, Log, TEXT("Started %i transcription workers."), NumWorkers);
+}
+
+void FDeepSpeechSessionManager::Shutdown()
+{
+	{
+		FScopeLock Lock(&SessionsCritical);
+		for (const FDeepSpeechSessionPtr& Session : Sessions)
+		{
+			Session->bCloseRequested = true;
+			Session->bWakeRequested = true;
+		}
+	}
+
+	// Let the workers close every session, then stop them.
+	while (bRunning && GetNumSessions() > 0)
+	{
+		WakeEvent->Trigger();
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	bRunning = false;
+	while (NumRunningWorkers > 0)
+	{
+		WakeEvent->Trigger();
+		FPlatformProcess::Sleep(0.001f);
+	}
+
+	for (FRunnableThread* Thread : WorkerThreads)
+	{
+		Thread->WaitForCompletion();
+		delete Thread;
+	}
+	WorkerThreads.Empty();
+	Workers.Empty();
+
+	// Sessions are gone, whatever they queued last can still hold on to models.
+	FinalizationPool.Shutdown();
+}
+
+uint32 FDeepSpeechSessionManager::FWorker::Run()
+{
+	Manager.WorkerLoop();
+	Manager.NumRunningWorkers--;
+	return 0;
+}
+
+void FDeepSpeechSessionManager::WorkerLoop()
+{
+	while (bRunning)
+	{
+		// Nothing ticks on a timer, sessions are woken by captured audio, requests and shutdown.
+		const FDeepSpeechSessionPtr Session = ClaimNextSession();
+		if (!Session)
+		{
+			WakeEvent->Wait();
+			continue;
+		}
+
+		if (Session->bCloseRequested)
+		{
+			Session->Shutdown();
+			FScopeLock Lock(&SessionsCritical);
+			Sessions.Remove(Session);
+			continue;
+		}
+
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		Session->Tick();
+		BusyCycles.fetch_add(FPlatformTime::Cycles64() - StartCycles, std::memory_order_relaxed);
+		ReleaseSession(Session);
+	}
+}
+
+FDeepSpeechSessionPtr FDeepSpeechSessionManager::ClaimNextSession()
+{
+	FScopeLock Lock(&SessionsCritical);
+
+	FDeepSpeechSessionPtr Claimed;
+	bool bMoreDue = false;
+	for (int32 Offset = 0; Offset < Sessions.Num(); ++Offset)
+	{
+		const int32 Index = (NextSessionIndex + Offset) % Sessions.Num();
+		const FDeepSpeechSessionPtr& Session = Sessions[Index];
+		if (Session->bClaimed)
+		{
+			continue;
+		}
+
+		if (!Session->bWakeRequested && !Session->bCloseRequested)
+		{
+			continue;
+		}
+
+		if (Claimed)
+		{
+			bMoreDue = true;
+			break;
+		}
+
+		Claimed = Session;
+		Session->bClaimed = true;
+		Session->bWakeRequested = false;
+		NextSessionIndex = Index + 1;
+	}
+
+	// Hand the rest of the due sessions to another worker.
+	if (bMoreDue)
+	{
+		WakeEvent->Trigger();
+	}
+
+	return Claimed;
+}
+
+void FDeepSpeechSessionManager::ReleaseSession(const FDeepSpeechSessionPtr& Session)
+{
+	Session->bClaimed = false;
+	if (Session->bWakeRequested)
+	{
+		WakeEvent->Trigger();
+	}
+}
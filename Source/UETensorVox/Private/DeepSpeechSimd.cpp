@@ -0,0 +1,253 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechSimd.h"
+#include "DeepSpeechCpuFeatures.h"
+
+#if TENSORVOX_WITH_AVX2_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace DeepSpeechSimd
+{
+	static float DotProductScalar(const float* RESTRICT A, const float* RESTRICT B, int32 Num)
+	{
+		float Sum = 0.0f;
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Sum += A[Index] * B[Index];
+		}
+		return Sum;
+	}
+
+	static float DotProductVector(const float* RESTRICT A, const float* RESTRICT B, int32 Num)
+	{
+		VectorRegister4Float Accumulator = VectorZeroFloat();
+		for (int32 Index = 0; Index < Num; Index += 4)
+		{
+			Accumulator = VectorMultiplyAdd(VectorLoad(A + Index), VectorLoad(B + Index), Accumulator);
+		}
+
+		float Lanes[4];
+		VectorStore(Accumulator, Lanes);
+		return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+
+#if TENSORVOX_WITH_AVX2_KERNELS
+	TENSORVOX_AVX2_TARGET static float DotProductAvx2(const float* RESTRICT A, const float* RESTRICT B, int32 Num)
+	{
+		__m256 Accumulator = _mm256_setzero_ps();
+		for (int32 Index = 0; Index < Num; Index += 8)
+		{
+			Accumulator = _mm256_fmadd_ps(_mm256_loadu_ps(A + Index), _mm256_loadu_ps(B + Index), Accumulator);
+		}
+
+		const __m128 Half = _mm_add_ps(_mm256_castps256_ps128(Accumulator), _mm256_extractf128_ps(Accumulator, 1));
+		float Lanes[4];
+		_mm_storeu_ps(Lanes, Half);
+		return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+	}
+#endif
+
+	static FORCEINLINE void StoreSample(float* Out, float Value)
+	{
+		*Out = Value;
+	}
+
+	static FORCEINLINE void StoreSample(int16* Out, float Value)
+	{
+		*Out = static_cast<int16>(FMath::Clamp(FMath::RoundToInt(Value), -32768, 32767));
+	}
+
+	// The fixed channel counts are split out so the compiler can vectorize them, which is all the 128 bit level gets.
+	template <typename InType, typename OutType>
+	static float MixScalar(const void* RESTRICT InData, int32 NumFrames, int32 NumChannels, const float* RESTRICT Weights, float Offset,
+	                       void* RESTRICT OutData)
+	{
+		const InType* RESTRICT In = static_cast<const InType*>(InData);
+		OutType* RESTRICT Out = static_cast<OutType*>(OutData);
+		float Sum = 0.0f;
+		if (NumChannels == 1)
+		{
+			const float Weight = Weights[0];
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+			{
+				const float Mixed = In[Frame] * Weight;
+				Sum += Mixed;
+				StoreSample(Out + Frame, Mixed + Offset);
+			}
+		}
+		else if (NumChannels == 2)
+		{
+			const float Left = Weights[0], Right = Weights[1];
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+			{
+				const float Mixed = In[Frame * 2] * Left + In[Frame * 2 + 1] * Right;
+				Sum += Mixed;
+				StoreSample(Out + Frame, Mixed + Offset);
+			}
+		}
+		else
+		{
+			for (int32 Frame = 0; Frame < NumFrames; ++Frame)
+			{
+				const InType* RESTRICT Samples = In + (int64)Frame * NumChannels;
+				float Mixed = 0.0f;
+				for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+				{
+					Mixed += Samples[Channel] * Weights[Channel];
+				}
+				Sum += Mixed;
+				StoreSample(Out + Frame, Mixed + Offset);
+			}
+		}
+		return Sum;
+	}
+
+#if TENSORVOX_WITH_AVX2_KERNELS
+	TENSORVOX_AVX2_TARGET static FORCEINLINE __m256 LoadContiguousAvx2(const int16* In)
+	{
+		return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(In))));
+	}
+
+	TENSORVOX_AVX2_TARGET static FORCEINLINE __m256 LoadContiguousAvx2(const float* In)
+	{
+		return _mm256_loadu_ps(In);
+	}
+
+	// Gathers 32 bits at every int16 and keeps the low half, which reads one sample past the last one.
+	TENSORVOX_AVX2_TARGET static FORCEINLINE __m256 GatherAvx2(const int16* In, __m256i Indices)
+	{
+		const __m256i Gathered = _mm256_i32gather_epi32(reinterpret_cast<const int*>(In), Indices, 2);
+		return _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(Gathered, 16), 16));
+	}
+
+	TENSORVOX_AVX2_TARGET static FORCEINLINE __m256 GatherAvx2(const float* In, __m256i Indices)
+	{
+		return _mm256_i32gather_ps(In, Indices, 4);
+	}
+
+	TENSORVOX_AVX2_TARGET static FORCEINLINE void StoreAvx2(float* Out, __m256 Values)
+	{
+		_mm256_storeu_ps(Out, Values);
+	}
+
+	TENSORVOX_AVX2_TARGET static FORCEINLINE void StoreAvx2(int16* Out, __m256 Values)
+	{
+		// Clamped first, out of range floats convert to INT_MIN whatever their sign. Packing works per 128 bit lane, so the halves are put back together after.
+		Values = _mm256_min_ps(_mm256_max_ps(Values, _mm256_set1_ps(-32768.0f)), _mm256_set1_ps(32767.0f));
+		const __m256i Integers = _mm256_cvtps_epi32(Values);
+		const __m256i Packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(Integers, Integers), 0x08);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(Out), _mm256_castsi256_si128(Packed));
+	}
+
+	template <typename InType, typename OutType>
+	TENSORVOX_AVX2_TARGET static float MixAvx2(const void* RESTRICT InData, int32 NumFrames, int32 NumChannels, const float* RESTRICT Weights, float Offset,
+	                                           void* RESTRICT OutData)
+	{
+		const InType* RESTRICT In = static_cast<const InType*>(InData);
+		OutType* RESTRICT Out = static_cast<OutType*>(OutData);
+		const __m256 OffsetVector = _mm256_set1_ps(Offset);
+		__m256 Accumulator = _mm256_setzero_ps();
+		int32 Frame = 0;
+		if (NumChannels == 1)
+		{
+			const __m256 Weight = _mm256_set1_ps(Weights[0]);
+			for (; Frame + 8 <= NumFrames; Frame += 8)
+			{
+				const __m256 Mixed = _mm256_mul_ps(LoadContiguousAvx2(In + Frame), Weight);
+				Accumulator = _mm256_add_ps(Accumulator, Mixed);
+				StoreAvx2(Out + Frame, _mm256_add_ps(Mixed, OffsetVector));
+			}
+		}
+		else
+		{
+			// Eight frames at a time, one gather per channel deinterleaves it. The last frame is left to the tail so the gather never reads past the block.
+			const __m256i FrameIndices = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(NumChannels));
+			for (; Frame + 8 < NumFrames; Frame += 8)
+			{
+				const InType* RESTRICT Samples = In + (int64)Frame * NumChannels;
+				__m256 Mixed = _mm256_setzero_ps();
+				for (int32 Channel = 0; Channel < NumChannels; ++Channel)
+				{
+					if (Weights[Channel] != 0.0f)
+					{
+						Mixed = _mm256_fmadd_ps(GatherAvx2(Samples + Channel, FrameIndices), _mm256_set1_ps(Weights[Channel]), Mixed);
+					}
+				}
+				Accumulator = _mm256_add_ps(Accumulator, Mixed);
+				StoreAvx2(Out + Frame, _mm256_add_ps(Mixed, OffsetVector));
+			}
+		}
+
+		const __m128 Half = _mm_add_ps(_mm256_castps256_ps128(Accumulator), _mm256_extractf128_ps(Accumulator, 1));
+		float Lanes[4];
+		_mm_storeu_ps(Lanes, Half);
+		const float Sum = (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+		return Sum + MixScalar<InType, OutType>(In + (int64)Frame * NumChannels, NumFrames - Frame, NumChannels, Weights, Offset, Out + Frame);
+	}
+#endif
+
+	template <typename InType, typename OutType>
+	static FMixFunction GetMix(EKernel Kernel)
+	{
+#if TENSORVOX_WITH_AVX2_KERNELS
+		if (Kernel == EKernel::Avx2)
+		{
+			return &MixAvx2<InType, OutType>;
+		}
+#endif
+		return &MixScalar<InType, OutType>;
+	}
+
+	EKernel GetBestKernel()
+	{
+#if TENSORVOX_WITH_AVX2_KERNELS
+		if (FDeepSpeechCpuFeatures::Get().GetLevel() >= EDeepSpeechCpuLevel::Avx2)
+		{
+			return EKernel::Avx2;
+		}
+#endif
+#if PLATFORM_ENABLE_VECTORINTRINSICS || PLATFORM_ENABLE_VECTORINTRINSICS_NEON
+		return EKernel::Vector;
+#else
+		return EKernel::Scalar;
+#endif
+	}
+
+	const TCHAR* LexToString(EKernel Kernel)
+	{
+		switch (Kernel)
+		{
+		case EKernel::Avx2:
+			return TEXT("AVX2");
+		case EKernel::Vector:
+			return PLATFORM_ENABLE_VECTORINTRINSICS_NEON ? TEXT("NEON") : TEXT("SSE");
+		default:
+			return TEXT("Scalar");
+		}
+	}
+
+	FDotProductFunction GetDotProduct(EKernel Kernel)
+	{
+		switch (Kernel)
+		{
+#if TENSORVOX_WITH_AVX2_KERNELS
+		case EKernel::Avx2:
+			return &DotProductAvx2;
+#endif
+		case EKernel::Vector:
+			return &DotProductVector;
+		default:
+			return &DotProductScalar;
+		}
+	}
+
+	FMixFunction GetMix(EKernel Kernel, EDeepSpeechSampleFormat InFormat, EDeepSpeechSampleFormat OutFormat)
+	{
+		if (InFormat == EDeepSpeechSampleFormat::Float)
+		{
+			return OutFormat == EDeepSpeechSampleFormat::Float ? GetMix<float, float>(Kernel) : GetMix<float, int16>(Kernel);
+		}
+		return OutFormat == EDeepSpeechSampleFormat::Float ? GetMix<int16, float>(Kernel) : GetMix<int16, int16>(Kernel);
+	}
+}
@@ -0,0 +1,51 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechFrontEnd.h"
+
+// AVX2 kernels are compiled into every x86 build and only picked at runtime, so they need a per function target on clang/gcc.
+#if PLATFORM_CPU_X86_FAMILY && (PLATFORM_WINDOWS || PLATFORM_LINUX || PLATFORM_MAC)
+#define TENSORVOX_WITH_AVX2_KERNELS 1
+#if defined(__clang__) || defined(__GNUC__)
+#define TENSORVOX_AVX2_TARGET __attribute__((target("avx2,fma")))
+#else
+#define TENSORVOX_AVX2_TARGET
+#endif
+#else
+#define TENSORVOX_WITH_AVX2_KERNELS 0
+#define TENSORVOX_AVX2_TARGET
+#endif
+
+namespace DeepSpeechSimd
+{
+	/** Alignment, in floats, every kernel input length is padded to. */
+	static constexpr int32 KernelWidth = 8;
+
+	typedef float (*FDotProductFunction)(const float* RESTRICT A, const float* RESTRICT B, int32 Num);
+
+	enum class EKernel : uint8
+	{
+		Scalar,
+		// 128 bit SSE or NEON, through the engine's VectorRegister abstraction.
+		Vector,
+		Avx2
+	};
+
+	/** Best kernel the running CPU supports, up to the level FDeepSpeechCpuFeatures settled on. */
+	EKernel GetBestKernel();
+	const TCHAR* LexToString(EKernel Kernel);
+
+	/** Dot product of two float arrays, Num must be a multiple of KernelWidth. */
+	FDotProductFunction GetDotProduct(EKernel Kernel);
+
+	/**
+	 * Mixes NumFrames interleaved frames of NumChannels into one channel: Out[Frame] = Offset + the sum of In[Frame * NumChannels + Channel] * Weights[Channel],
+	 * with channels weighted 0 skipped. Int16 output is rounded and saturated. Any frame count, no alignment needed.
+	 * @return The sum of the mixed samples, before Offset.
+	 */
+	typedef float (*FMixFunction)(const void* RESTRICT In, int32 NumFrames, int32 NumChannels, const float* RESTRICT Weights, float Offset, void* RESTRICT Out);
+
+	FMixFunction GetMix(EKernel Kernel, EDeepSpeechSampleFormat InFormat, EDeepSpeechSampleFormat OutFormat);
+}
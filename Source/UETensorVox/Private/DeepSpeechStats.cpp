@@ -0,0 +1,85 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechStats.h"
+#include "DeepSpeechSessionManager.h"
+
+DEFINE_STAT(STAT_TensorVoxResample);
+DEFINE_STAT(STAT_TensorVoxVad);
+DEFINE_STAT(STAT_TensorVoxFeed);
+DEFINE_STAT(STAT_TensorVoxIntermediateDecode);
+DEFINE_STAT(STAT_TensorVoxFinishStream);
+DEFINE_STAT(STAT_TensorVoxBroadcast);
+
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Sessions"), STAT_TensorVoxSessions, STATGROUP_TensorVox);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Active streams"), STAT_TensorVoxActiveStreams, STATGROUP_TensorVox);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Finalization queue depth"), STAT_TensorVoxFinalizeQueueDepth, STATGROUP_TensorVox);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Queued capture samples"), STAT_TensorVoxQueuedSamples, STATGROUP_TensorVox);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Capture overflows"), STAT_TensorVoxCaptureOverflows, STATGROUP_TensorVox);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Coalesced partials"), STAT_TensorVoxCoalescedPartials, STATGROUP_TensorVox);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Voiced ratio"), STAT_TensorVoxVoicedRatio, STATGROUP_TensorVox);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Governor level"), STAT_TensorVoxGovernorLevel, STATGROUP_TensorVox);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Governor pressure"), STAT_TensorVoxGovernorPressure, STATGROUP_TensorVox);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Governor beam width"), STAT_TensorVoxGovernorBeamWidth, STATGROUP_TensorVox);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Governor decode rate"), STAT_TensorVoxGovernorDecodeRate, STATGROUP_TensorVox);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Worker load"), STAT_TensorVoxWorkerLoad, STATGROUP_TensorVox);
+
+CSV_DEFINE_CATEGORY(TensorVox, true);
+
+std::atomic<int32> FDeepSpeechPipelineStats::NumActiveStreams(0);
+std::atomic<int32> FDeepSpeechPipelineStats::NumQueuedSamples(0);
+std::atomic<int32> FDeepSpeechPipelineStats::NumCaptureOverflows(0);
+std::atomic<int32> FDeepSpeechPipelineStats::NumCoalescedPartials(0);
+std::atomic<int32> FDeepSpeechPipelineStats::NumVadFrames(0);
+std::atomic<int32> FDeepSpeechPipelineStats::NumVoicedFrames(0);
+
+void FDeepSpeechPipelineStats::Publish(FDeepSpeechSessionManager& SessionManager)
+{
+	const int32 NumSessions = SessionManager.GetNumSessions();
+	const int32 FinalizeQueueDepth = SessionManager.GetFinalizationPool().GetQueueDepth();
+	const int32 ActiveStreams = NumActiveStreams.load(std::memory_order_relaxed);
+	const int32 QueuedSamples = NumQueuedSamples.load(std::memory_order_relaxed);
+	const int32 CaptureOverflows = NumCaptureOverflows.load(std::memory_order_relaxed);
+	const int32 CoalescedPartials = NumCoalescedPartials.load(std::memory_order_relaxed);
+
+	const FDeepSpeechLoadGovernor& Governor = SessionManager.GetLoadGovernor();
+	const float GovernorLevel = Governor.GetLevel();
+	const float GovernorPressure = Governor.GetLastPressure();
+	const int32 GovernorBeamWidth = Governor.GetLastBeamWidth();
+	const float GovernorDecodeRate = Governor.GetDecodeRateScale();
+	const float WorkerLoad = Governor.GetLastSample().WorkerLoad;
+
+	// Frames seen since the last publish, a frame with none keeps the last ratio.
+	static float VoicedRatio = 0.0f;
+	const int32 VadFrames = NumVadFrames.exchange(0, std::memory_order_relaxed);
+	const int32 VoicedFrames = NumVoicedFrames.exchange(0, std::memory_order_relaxed);
+	if (VadFrames > 0)
+	{
+		VoicedRatio = (float)VoicedFrames / VadFrames;
+	}
+
+	SET_DWORD_STAT(STAT_TensorVoxSessions, NumSessions);
+	SET_DWORD_STAT(STAT_TensorVoxActiveStreams, ActiveStreams);
+	SET_DWORD_STAT(STAT_TensorVoxFinalizeQueueDepth, FinalizeQueueDepth);
+	SET_DWORD_STAT(STAT_TensorVoxQueuedSamples, QueuedSamples);
+	SET_DWORD_STAT(STAT_TensorVoxCaptureOverflows, CaptureOverflows);
+	SET_DWORD_STAT(STAT_TensorVoxCoalescedPartials, CoalescedPartials);
+	SET_FLOAT_STAT(STAT_TensorVoxVoicedRatio, VoicedRatio);
+	SET_FLOAT_STAT(STAT_TensorVoxGovernorLevel, GovernorLevel);
+	SET_FLOAT_STAT(STAT_TensorVoxGovernorPressure, GovernorPressure);
+	SET_DWORD_STAT(STAT_TensorVoxGovernorBeamWidth, GovernorBeamWidth);
+	SET_FLOAT_STAT(STAT_TensorVoxGovernorDecodeRate, GovernorDecodeRate);
+	SET_FLOAT_STAT(STAT_TensorVoxWorkerLoad, WorkerLoad);
+
+	CSV_CUSTOM_STAT(TensorVox, Sessions, NumSessions, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, ActiveStreams, ActiveStreams, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, FinalizeQueueDepth, FinalizeQueueDepth, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, QueuedSamples, QueuedSamples, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, CaptureOverflows, CaptureOverflows, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, CoalescedPartials, CoalescedPartials, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, VoicedRatio, VoicedRatio, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, GovernorLevel, GovernorLevel, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, GovernorPressure, GovernorPressure, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, GovernorBeamWidth, GovernorBeamWidth, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, GovernorDecodeRate, GovernorDecodeRate, ECsvCustomStatOp::Set);
+	CSV_CUSTOM_STAT(TensorVox, WorkerLoad, WorkerLoad, ECsvCustomStatOp::Set);
+}
@@ -0,0 +1,49 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "UETensorVox.h"
+#include <atomic>
+
+class FDeepSpeechSessionManager;
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Resample"), STAT_TensorVoxResample, STATGROUP_TensorVox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("VAD"), STAT_TensorVoxVad, STATGROUP_TensorVox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DS_FeedAudioContent"), STAT_TensorVoxFeed, STATGROUP_TensorVox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DS_IntermediateDecode"), STAT_TensorVoxIntermediateDecode, STATGROUP_TensorVox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DS_FinishStream"), STAT_TensorVoxFinishStream, STATGROUP_TensorVox, );
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Broadcast (game thread)"), STAT_TensorVoxBroadcast, STATGROUP_TensorVox, );
+
+CSV_DECLARE_CATEGORY_EXTERN(TensorVox);
+
+// A cycle stat where stats are compiled in, which Insights shows too, and a plain Insights scope everywhere else.
+#if STATS
+#define TENSORVOX_SCOPE_CYCLE_COUNTER(Stat) SCOPE_CYCLE_COUNTER(Stat)
+#else
+#define TENSORVOX_SCOPE_CYCLE_COUNTER(Stat) TRACE_CPUPROFILER_EVENT_SCOPE(Stat)
+#endif
+
+/**
+ * Pipeline wide counters, bumped from whichever thread sees the event and published once a frame from the game thread as stats and
+ * CSV profiler columns. Device threads only ever touch the atomics, stats can't be flushed from threads the engine didn't start.
+ */
+struct FDeepSpeechPipelineStats
+{
+	// Streams created and not finished or freed yet, in sessions and the finalization queue.
+	static std::atomic<int32> NumActiveStreams;
+	// Captured samples waiting to be read by their sessions, as of each session's last tick.
+	static std::atomic<int32> NumQueuedSamples;
+	// Device overflows and capture blocks that didn't fit in the capture buffer, since startup.
+	static std::atomic<int32> NumCaptureOverflows;
+	// Partials replaced in a result mailbox before the game thread got to them, since startup.
+	static std::atomic<int32> NumCoalescedPartials;
+	// Frames the VAD looked at, and those it heard a voice in, since the last publish.
+	static std::atomic<int32> NumVadFrames;
+	static std::atomic<int32> NumVoicedFrames;
+
+	static void Publish(FDeepSpeechSessionManager& SessionManager);
+};
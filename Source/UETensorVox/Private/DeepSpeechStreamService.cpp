@@ -0,0 +1,202 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechStreamService.h"
+#include "HAL/IConsoleManager.h"
+#include "UETensorVox.h"
+
+static int32 GTensorVoxServiceMaxStreams = 0;
+static FAutoConsoleVariableRef CVarTensorVoxServiceMaxStreams(
+	TEXT("TensorVox.Service.MaxStreams"),
+	GTensorVoxServiceMaxStreams,
+	TEXT("Most streams a stream service transcribes at once, 0 doesn't limit them."),
+	ECVF_Default);
+
+static float GTensorVoxServiceMaxUtilization = 0.85f;
+static FAutoConsoleVariableRef CVarTensorVoxServiceMaxUtilization(
+	TEXT("TensorVox.Service.MaxUtilization"),
+	GTensorVoxServiceMaxUtilization,
+	TEXT("New streams are turned away while the transcription workers are busier than this share of the time."),
+	ECVF_Default);
+
+static float GTensorVoxServiceMaxLagSeconds = 1.0f;
+static FAutoConsoleVariableRef CVarTensorVoxServiceMaxLagSeconds(
+	TEXT("TensorVox.Service.MaxLagSeconds"),
+	GTensorVoxServiceMaxLagSeconds,
+	TEXT("New streams are turned away while any stream is this far behind the audio pushed to it."),
+	ECVF_Default);
+
+static const double UtilizationSampleSeconds = 0.25;
+
+/**
+* FDeepSpeechServiceStream Implementation
+*/
+
+FDeepSpeechServiceStream::FDeepSpeechServiceStream(const FDeepSpeechSessionPtr& InSession, const TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe>& InSource)
+	: Session(InSession), Source(InSource), NumPushed(0)
+{
+}
+
+void FDeepSpeechServiceStream::PushAudio(const int16* Samples, int32 NumSamples)
+{
+	Source->PushAudio(Samples, NumSamples);
+	NumPushed.fetch_add(NumSamples, std::memory_order_relaxed);
+}
+
+float FDeepSpeechServiceStream::GetLagSeconds() const
+{
+	const int64 NumBehind = Source->GetNumDelivered() - Session->GetNumSamplesHandled();
+	return FMath::Max<int64>(NumBehind, 0) / (float)Source->GetSampleRate();
+}
+
+/**
+* FDeepSpeechStreamService Implementation
+*/
+
+FDeepSpeechStreamService::FDeepSpeechStreamService(const FDeepSpeechConfiguration& InConfig)
+	: Config(InConfig), NumRejected(0), LastBusyCycles(FDeepSpeechSessionManager::Get().GetBusyCycles()), LastSampleTime(FPlatformTime::Seconds()),
+	  Utilization(0.0f)
+{
+	Config.bAutomaticEndpointing = true;
+}
+
+FDeepSpeechStreamService::~FDeepSpeechStreamService()
+{
+	CloseAllStreams();
+}
+
+FDeepSpeechServiceStreamPtr FDeepSpeechStreamService::OpenStream(int32 SampleRate, FOnDeepSpeechTranscribed OnTranscribed, FOnDeepSpeechResult OnResult)
+{
+	if (const TCHAR* Refusal = GetAdmissionRefusal())
+	{
+		NumRejected++;
+		UE_LOG(LogUETensorVox, Warning, TEXT("Stream service turned a new stream away: %s."), Refusal);
+		return nullptr;
+	}
+
+	const TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe> Source = MakeShared<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe>(SampleRate);
+	const FDeepSpeechSessionPtr Session = FDeepSpeechSessionManager::Get().OpenSession(Config, MoveTemp(OnTranscribed), [Source]()
+	{
+		return FDeepSpeechPushAudioSource::CreateProxy(Source);
+	}, MoveTemp(OnResult));
+	// Listens from the start, the voice detector decides where utterances are.
+	Session->SetTranscriptionRequested(true);
+
+	const FDeepSpeechServiceStreamPtr Stream = MakeShared<FDeepSpeechServiceStream, ESPMode::ThreadSafe>(Session, Source);
+	FScopeLock Lock(&StreamsCritical);
+	Streams.Add(Stream);
+	return Stream;
+}
+
+void FDeepSpeechStreamService::CloseStream(const FDeepSpeechServiceStreamPtr& Stream)
+{
+	if (!Stream)
+	{
+		return;
+	}
+
+	{
+		FScopeLock Lock(&StreamsCritical);
+		Streams.Remove(Stream);
+	}
+	FDeepSpeechSessionManager::Get().CloseSession(Stream->Session);
+}
+
+void FDeepSpeechStreamService::CloseAllStreams()
+{
+	TArray<FDeepSpeechServiceStreamPtr> Closing;
+	{
+		FScopeLock Lock(&StreamsCritical);
+		Closing = MoveTemp(Streams);
+	}
+	for (const FDeepSpeechServiceStreamPtr& Stream : Closing)
+	{
+		FDeepSpeechSessionManager::Get().CloseSession(Stream->Session);
+	}
+}
+
+void FDeepSpeechStreamService::UpdateUtilization()
+{
+	const double Now = FPlatformTime::Seconds();
+	const double Elapsed = Now - LastSampleTime;
+	if (Elapsed < UtilizationSampleSeconds)
+	{
+		return;
+	}
+
+	FDeepSpeechSessionManager& Manager = FDeepSpeechSessionManager::Get();
+	const uint64 BusyCycles = Manager.GetBusyCycles();
+	const double BusySeconds = FPlatformTime::ToSeconds64(BusyCycles - LastBusyCycles);
+	const float Sample = Manager.GetNumWorkers() > 0 ? BusySeconds / (Elapsed * Manager.GetNumWorkers()) : 0.0f;
+	Utilization = FMath::Lerp(Utilization, FMath::Clamp(Sample, 0.0f, 1.0f), 0.5f);
+	LastBusyCycles = BusyCycles;
+	LastSampleTime = Now;
+}
+
+float FDeepSpeechStreamService::GetUtilization()
+{
+	FScopeLock Lock(&StreamsCritical);
+	UpdateUtilization();
+	return Utilization;
+}
+
+const TCHAR* FDeepSpeechStreamService::GetAdmissionRefusal()
+{
+	FScopeLock Lock(&StreamsCritical);
+	UpdateUtilization();
+
+	if (GTensorVoxServiceMaxStreams > 0 && Streams.Num() >= GTensorVoxServiceMaxStreams)
+	{
+		return TEXT("too many streams");
+	}
+	if (Utilization > GTensorVoxServiceMaxUtilization)
+	{
+		return TEXT("transcription workers saturated");
+	}
+
+	FDeepSpeechFinalizationPool& FinalizationPool = FDeepSpeechSessionManager::Get().GetFinalizationPool();
+	if (FinalizationPool.GetQueueDepth() >= FinalizationPool.GetQueueSize())
+	{
+		return TEXT("finalization queue full");
+	}
+
+	for (const FDeepSpeechServiceStreamPtr& Stream : Streams)
+	{
+		if (Stream->GetLagSeconds() > GTensorVoxServiceMaxLagSeconds)
+		{
+			return TEXT("streams falling behind");
+		}
+	}
+	return nullptr;
+}
+
+int32 FDeepSpeechStreamService::GetNumStreams() const
+{
+	FScopeLock Lock(&StreamsCritical);
+	return Streams.Num();
+}
+
+void FDeepSpeechStreamService::GetStreamStats(TArray<FDeepSpeechServiceStreamStats>& OutStats) const
+{
+	FScopeLock Lock(&StreamsCritical);
+	OutStats.Reset(Streams.Num());
+	for (const FDeepSpeechServiceStreamPtr& Stream : Streams)
+	{
+		FDeepSpeechServiceStreamStats& Stats = OutStats.AddDefaulted_GetRef();
+		Stats.SessionId = Stream->GetSessionId();
+		Stats.LagSeconds = Stream->GetLagSeconds();
+		Stats.PushedSeconds = (double)Stream->GetNumPushed() / Stream->GetSampleRate();
+	}
+}
+
+void FDeepSpeechStreamService::DumpToLog()
+{
+	TArray<FDeepSpeechServiceStreamStats> Stats;
+	GetStreamStats(Stats);
+	const float CurrentUtilization = GetUtilization();
+
+	UE_LOG(LogUETensorVox, Display, TEXT("Stream service: %i streams, %i turned away, workers %.0f%% busy."), Stats.Num(), GetNumRejected(), CurrentUtilization * 100.0f);
+	for (const FDeepSpeechServiceStreamStats& Stream : Stats)
+	{
+		UE_LOG(LogUETensorVox, Display, TEXT("  Session %i: %.2f s behind, %.1f s pushed."), Stream.SessionId, Stream.LagSeconds, Stream.PushedSeconds);
+	}
+}
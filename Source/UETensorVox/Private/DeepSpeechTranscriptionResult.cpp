@@ -0,0 +1,69 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechTranscriptionResult.h"
+#include "UETensorVox.h"
+
+#if TENSORVOX_VALID_PLATFORM
+#include "DeepSpeechLibrary.h"
+#endif
+
+void FDeepSpeechTranscriptionResult::Reset(bool bInFinal)
+{
+	bFinal = bInFinal;
+	Text.Reset();
+	Tokens.Reset();
+	Candidates.Reset();
+	Timings = FDeepSpeechUtteranceTimings();
+}
+
+void FDeepSpeechTranscriptionResult::Fill(const Metadata& InMetadata, bool bInFinal)
+{
+	Reset(bInFinal);
+
+#if TENSORVOX_VALID_PLATFORM
+	for (uint32 CandidateIndex = 0; CandidateIndex < InMetadata.num_transcripts; ++CandidateIndex)
+	{
+		const CandidateTranscript& Transcript = InMetadata.transcripts[CandidateIndex];
+		FDeepSpeechCandidate& Candidate = Candidates.AddDefaulted_GetRef();
+		Candidate.TextOffset = Text.Len();
+		Candidate.FirstToken = Tokens.Num();
+		Candidate.NumTokens = Transcript.num_tokens;
+		Candidate.Confidence = Transcript.confidence;
+
+		for (uint32 TokenIndex = 0; TokenIndex < Transcript.num_tokens; ++TokenIndex)
+		{
+			const TokenMetadata& Source = Transcript.tokens[TokenIndex];
+			// Tokens are a character or two of UTF-8, converted on the stack.
+			const FUTF8ToTCHAR Converted(Source.text);
+
+			FDeepSpeechToken& Token = Tokens.AddDefaulted_GetRef();
+			Token.TextOffset = Text.Len() - Candidate.TextOffset;
+			Token.TextLength = Converted.Length();
+			Token.Timestep = Source.timestep;
+			Token.StartTime = Source.start_time;
+			Text.AppendChars(Converted.Get(), Converted.Length());
+		}
+		Candidate.TextLength = Text.Len() - Candidate.TextOffset;
+	}
+#endif
+}
+
+TSharedRef<FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe> FDeepSpeechResultPool::Acquire()
+{
+	FScopeLock Lock(&Critical);
+	for (const TSharedRef<FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe>& Result : Results)
+	{
+		// Only the pool holds it, and only the pool hands out new references under this lock.
+		if (Result.IsUnique())
+		{
+			return Result;
+		}
+	}
+	return Results.Add_GetRef(MakeShared<FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe>());
+}
+
+int32 FDeepSpeechResultPool::GetNumResults() const
+{
+	FScopeLock Lock(&Critical);
+	return Results.Num();
+}
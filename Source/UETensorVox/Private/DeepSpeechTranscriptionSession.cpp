@@ -0,0 +1,770 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechTranscriptionSession.h"
+#include "DeepSpeechSessionManager.h"
+#include "DeepSpeechModelRegistry.h"
+#include "DeepSpeechMicrophoneRecorder.h"
+#include "DeepSpeechStats.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if TENSORVOX_VALID_PLATFORM
+#include "DeepSpeechLibrary.h"
+#endif
+
+// DeepSpeech runs its acoustic model every 20 ms, and WebRTC vad takes 10, 20 or 30 ms frames. Reading, detecting and feeding
+// in steps of exactly one model step keeps every feed aligned to the model's windows.
+static const float ModelStepSeconds = 0.02f;
+
+static bool GTensorVoxExportDecodeTimings = false;
+static FAutoConsoleVariableRef CVarTensorVoxExportDecodeTimings(
+	TEXT("TensorVox.ExportDecodeTimings"),
+	GTensorVoxExportDecodeTimings,
+	TEXT("Appends every intermediate decode of every utterance to TensorVoxDecodeTimings.csv in the log directory, to tune the decode interval and CPU budget."),
+	ECVF_Default);
+
+static float GTensorVoxTimeSliceMilliseconds = 20.0f;
+static FAutoConsoleVariableRef CVarTensorVoxTimeSliceMilliseconds(
+	TEXT("TensorVox.TimeSliceMilliseconds"),
+	GTensorVoxTimeSliceMilliseconds,
+	TEXT("Longest a worker spends on one session's audio before moving on to the next session that's due, the rest waits for the session's next turn. ")
+	TEXT("Keeps a backlogged session from starving the others. 0 doesn't limit it."),
+	ECVF_Default);
+
+FDeepSpeechTranscriptionSession::FDeepSpeechTranscriptionSession(FDeepSpeechSessionManager& InManager, int32 InSessionId,
+                                                                 const FDeepSpeechConfiguration& InConfig, FOnDeepSpeechTranscribed InOnTranscribed,
+                                                                 FDeepSpeechAudioSourceFactory InSourceFactory, FOnDeepSpeechResult InOnResult)
+	: Manager(InManager), SessionId(InSessionId), Config(InConfig), OnTranscribed(MoveTemp(InOnTranscribed)), SourceFactory(MoveTemp(InSourceFactory)),
+	  OnResult(MoveTemp(InOnResult)), ResultPool(OnResult.IsBound() ? MakeShared<FDeepSpeechResultPool, ESPMode::ThreadSafe>() : nullptr),
+	  RequestTime(0.0), bLastRequestTranscribe(false), bInitialized(false), bPersistentCapture(false), GateOpenTime(0.0), bAwaitingFirstSample(false),
+	  LookbackSeconds(0.0f), StreamState(nullptr), bStreamCarried(false), FrameSamples(0),
+	  FeedChunkSamples(0), PendingFeedArrivalTime(0.0), NumFeeds(0), QueueWaitSum(0.0), bHotWordsChanged(false), bCommandsChanged(false), LeadPaddingSamples(0), TrailPaddingSamples(0),
+	  NumReportedQueuedSamples(0), NumSamplesHandled(0), NumUtterances(0), bClaimed(false), bWakeRequested(true), bCloseRequested(false)
+{
+}
+
+FDeepSpeechTranscriptionSession::~FDeepSpeechTranscriptionSession()
+{
+	checkf(!StreamState && !VoiceDetector.IsInitialized(), TEXT("Transcription session %i destroyed without being shut down."), SessionId);
+}
+
+void FDeepSpeechTranscriptionSession::SetTranscriptionRequested(bool bRequested)
+{
+	if (bRequested)
+	{
+		RequestTime.store(FPlatformTime::Seconds(), std::memory_order_relaxed);
+	}
+	bTranscribeRequested = bRequested;
+	Manager.WakeSession(*this);
+}
+
+void FDeepSpeechTranscriptionSession::RequestClose()
+{
+	bCloseRequested = true;
+	Manager.WakeSession(*this);
+}
+
+void FDeepSpeechTranscriptionSession::SetHotWords(FDeepSpeechHotWords InHotWords)
+{
+	FScopeLock Lock(&HotWordsCritical);
+	PendingHotWords = MoveTemp(InHotWords);
+	bHotWordsChanged = true;
+}
+
+void FDeepSpeechTranscriptionSession::UpdateHotWords(const FDeepSpeechHotWords& Add, const TArray<FString>& Remove)
+{
+	FScopeLock Lock(&HotWordsCritical);
+	for (const FString& Word : Remove)
+	{
+		PendingHotWords.Remove(Word);
+	}
+	PendingHotWords.Append(Add);
+	bHotWordsChanged = true;
+}
+
+void FDeepSpeechTranscriptionSession::SetCommands(FDeepSpeechCommandGrammarPtr Grammar, FOnDeepSpeechCommand InOnCommand)
+{
+	FScopeLock Lock(&HotWordsCritical);
+	PendingCommandGrammar = MoveTemp(Grammar);
+	PendingOnCommand = MoveTemp(InOnCommand);
+	bCommandsChanged = true;
+}
+
+bool FDeepSpeechTranscriptionSession::Initialize()
+{
+#if TENSORVOX_VALID_PLATFORM
+	bInitialized = true;
+
+	Model = FDeepSpeechModelRegistry::Get().Acquire(Config);
+	if (!Model)
+	{
+		bFailed = true;
+		return false;
+	}
+
+	const int32 SampleRate = Model->GetSampleRate();
+	LeadPaddingSamples = FMath::RoundToInt(Config.LeadPaddingMilliseconds * 0.001f * SampleRate);
+	TrailPaddingSamples = FMath::RoundToInt(Config.TrailPaddingMilliseconds * 0.001f * SampleRate);
+	NoiseFloor.Initialize(FMath::Max(LeadPaddingSamples, TrailPaddingSamples));
+
+	FrameSamples = FMath::RoundToInt(ModelStepSeconds * SampleRate);
+	FeedChunkSamples = FMath::Max(FMath::CeilToInt(Config.FeedIntervalMilliseconds * 0.001f / ModelStepSeconds), 1) * FrameSamples;
+	PendingFeed.Reserve(FeedChunkSamples);
+
+	Recorder = MakeUnique<FDeepSpeechMicrophoneRecorder>(SourceFactory ? SourceFactory() : FDeepSpeechAudioSources::CreateDefault());
+	if (FDeepSpeechSessionJournal::IsEnabled())
+	{
+		Journal = FDeepSpeechSessionJournal::Create(SessionId, Config);
+		Recorder->SetJournal(Journal);
+	}
+	Recorder->SetOnSamplesAvailable(FSimpleDelegate::CreateLambda([this]()
+	{
+		Manager.WakeSession(*this);
+	}), (float)FeedChunkSamples / SampleRate);
+
+	if (Config.bPersistentCapture)
+	{
+		bPersistentCapture = Recorder->StartGatedRecording(SampleRate, FrameSamples, Config.CaptureBufferSeconds, Config.LookbackMilliseconds * 0.001f);
+		if (!bPersistentCapture)
+		{
+			UE_LOG(LogUETensorVox, Warning, TEXT("Session %i couldn't keep its audio source open, it's opened every time transcription starts instead."), SessionId);
+		}
+	}
+
+	VoiceDetector.Initialize(Config.VoiceDetector, Config.VoiceDetectorAggressiveness, SampleRate, FrameSamples);
+
+	UE_LOG(LogUETensorVox, Log, TEXT("Started transcription session %i with %s vad. Model (alpha, beta): %s"), SessionId,
+	       *StaticEnum<EDeepSpeechVoiceDetector>()->GetNameStringByValue((int64)VoiceDetector.GetDetector()), *Config.ModelAlphaBeta.ToString());
+	return true;
+#else
+	return false;
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::Tick()
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (bFailed || (!bInitialized && !Initialize()))
+	{
+		return;
+	}
+
+	const double SliceEndTime = GTensorVoxTimeSliceMilliseconds > 0.0f ? FPlatformTime::Seconds() + GTensorVoxTimeSliceMilliseconds * 0.001 : 0.0;
+	bool bFeedVoiceData = false;
+	bool bYielded = false;
+	ProcessCapturedAudio(SliceEndTime, bFeedVoiceData, bYielded);
+
+	DecodeScheduler.SetRateScale(Manager.GetLoadGovernor().GetDecodeRateScale());
+	if (StreamState && bFeedVoiceData && DecodeScheduler.ShouldDecode())
+	{
+		IntermediateDecode();
+	}
+
+	// Handle transcriptions state.
+	const bool bRequested = bTranscribeRequested;
+	if (bLastRequestTranscribe != bRequested)
+	{
+		// What was handled, a release that came in while the utterance was starting ends it next tick. Only the game thread writes the request,
+		// so a failed start leaves it alone and the release always wins.
+		if (bRequested)
+		{
+			bLastRequestTranscribe = BeginUtterance();
+		}
+		else
+		{
+			EndUtterance();
+			bLastRequestTranscribe = false;
+		}
+	}
+	else if (bStreamCarried && !Endpointer.IsInSpeech())
+	{
+		// Woken because the finalization queue has room again.
+		FinalizeStream();
+	}
+
+	// Our turn is up but there's audio left, get back in line behind the other sessions that are due.
+	if (bYielded)
+	{
+		Manager.WakeSession(*this);
+	}
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::ProcessCapturedAudio(double SliceEndTime, bool& bOutFedVoiceData, bool& bOutYielded)
+{
+#if TENSORVOX_VALID_PLATFORM
+	int32 NumVadFrames = 0;
+	int32 NumVoicedFrames = 0;
+
+	// Frames come out of the recorder already converted to the model's sample rate.
+	for (TArrayView<const int16> FrameView = Recorder->ReadFrame(FrameSamples); FrameView.Num() > 0; FrameView = Recorder->ReadFrame(FrameSamples))
+	{
+		const int16* Frame = FrameView.GetData();
+		if (bAwaitingFirstSample)
+		{
+			// The first audio is there to read once it arrived and the gate was open. Lookback arrived before the request, so only the gate counts then.
+			bAwaitingFirstSample = false;
+			const float PressToFirstSampleMs = (FMath::Max(Recorder->GetLastFrameArrivalTime(), GateOpenTime) - RequestTime.load(std::memory_order_relaxed)) * 1000.0;
+			if (!Config.bAutomaticEndpointing)
+			{
+				Timings.PressToFirstSampleMs = PressToFirstSampleMs;
+			}
+			UE_LOG(LogUETensorVox, Log, TEXT("Session %i press to first sample %.1f ms (%s), starting with %.0f ms of lookback."), SessionId,
+			       PressToFirstSampleMs, bPersistentCapture ? TEXT("persistent capture") : TEXT("source opened"), LookbackSeconds * 1000.0f);
+		}
+
+		bool bVoiceDetected;
+		{
+			TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxVad);
+			bVoiceDetected = VoiceDetector.ProcessFrame(Frame);
+		}
+		NumVadFrames++;
+		NumVoicedFrames += bVoiceDetected ? 1 : 0;
+		if (Journal)
+		{
+			Journal->AddVad(bVoiceDetected);
+		}
+
+		if (Config.bAutomaticEndpointing)
+		{
+			ProcessEndpointingFrame(Frame, bVoiceDetected, bOutFedVoiceData);
+		}
+		else if (bVoiceDetected)
+		{
+			if (StreamState)
+			{
+				QueueFrame(Frame, true, bOutFedVoiceData);
+			}
+		}
+		else
+		{
+			// Voice stopped, whatever we have is a whole utterance piece.
+			FlushPendingFeed(bOutFedVoiceData);
+		}
+
+		if (!bVoiceDetected)
+		{
+			NoiseFloor.Add(Frame, FrameSamples);
+		}
+
+		if (SliceEndTime > 0.0 && FPlatformTime::Seconds() >= SliceEndTime)
+		{
+			bOutYielded = true;
+			break;
+		}
+	}
+
+	// Don't hold a partial chunk until the next wakeup, it's still a whole number of model steps.
+	FlushPendingFeed(bOutFedVoiceData);
+
+	FDeepSpeechPipelineStats::NumVadFrames.fetch_add(NumVadFrames, std::memory_order_relaxed);
+	FDeepSpeechPipelineStats::NumVoicedFrames.fetch_add(NumVoicedFrames, std::memory_order_relaxed);
+	const int32 NumQueuedSamples = Recorder->GetNumAvailableSamples();
+	FDeepSpeechPipelineStats::NumQueuedSamples.fetch_add(NumQueuedSamples - NumReportedQueuedSamples, std::memory_order_relaxed);
+	NumReportedQueuedSamples = NumQueuedSamples;
+	NumSamplesHandled.store(Recorder->GetNumReadSamples() + Recorder->GetNumDroppedSamples(), std::memory_order_relaxed);
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::ProcessEndpointingFrame(const int16* Frame, bool bVoiced, bool& bOutFedVoiceData)
+{
+	const FDeepSpeechEndpointer::EEvent Event = Endpointer.ProcessFrame(bVoiced);
+	if (Event == FDeepSpeechEndpointer::EEvent::None && !Endpointer.IsInSpeech())
+	{
+		// Waiting for speech, only the most recent audio is worth keeping.
+		if (PreRoll.Max() - PreRoll.Num() < FrameSamples)
+		{
+			PreRoll.Consume(FrameSamples);
+		}
+		PreRoll.Write(Frame, FrameSamples);
+		return;
+	}
+
+	if (Event == FDeepSpeechEndpointer::EEvent::SpeechStarted)
+	{
+		OpenStream();
+		if (StreamState)
+		{
+			// The onset and what came before it, this frame follows.
+			PendingFeedArrivalTime = Recorder->GetLastFrameArrivalTime();
+			int32 NumBeforeOnset = FMath::Max(PreRoll.Num() - Endpointer.GetOnsetFrames() * FrameSamples, 0);
+			for (TArrayView<const int16> Span = PreRoll.PeekContiguous(); Span.Num() > 0; Span = PreRoll.PeekContiguous())
+			{
+				PendingFeed.Append(Span.GetData(), Span.Num());
+				if (Capture)
+				{
+					const int32 NumSpanBeforeOnset = FMath::Min(NumBeforeOnset, Span.Num());
+					Capture->AppendFrame(Span.GetData(), NumSpanBeforeOnset, false);
+					Capture->AppendFrame(Span.GetData() + NumSpanBeforeOnset, Span.Num() - NumSpanBeforeOnset, true);
+					NumBeforeOnset -= NumSpanBeforeOnset;
+				}
+				PreRoll.Consume(Span.Num());
+			}
+		}
+		PreRoll.Reset();
+	}
+
+	// Pauses inside the hangover are part of the utterance, the model needs them between words.
+	if (StreamState)
+	{
+		QueueFrame(Frame, bVoiced, bOutFedVoiceData);
+	}
+
+	if (Event == FDeepSpeechEndpointer::EEvent::SpeechEnded || Event == FDeepSpeechEndpointer::EEvent::MaxLengthReached)
+	{
+		FlushPendingFeed(bOutFedVoiceData);
+		UE_LOG(LogUETensorVox, Verbose, TEXT("Session %i endpointed after %.2fs of speech (%s)."), SessionId, Endpointer.GetNumSpeechFrames() * ModelStepSeconds,
+		       Event == FDeepSpeechEndpointer::EEvent::SpeechEnded ? TEXT("trailing silence") : TEXT("max length"));
+		EndStream();
+	}
+}
+
+void FDeepSpeechTranscriptionSession::QueueFrame(const int16* Frame, bool bVoiced, bool& bOutFedVoiceData)
+{
+	const double FrameArrivalTime = Recorder->GetLastFrameArrivalTime();
+	if (PendingFeed.Num() == 0)
+	{
+		PendingFeedArrivalTime = FrameArrivalTime;
+	}
+	if (bVoiced)
+	{
+		if (Timings.FirstCaptureTime == 0.0)
+		{
+			Timings.FirstCaptureTime = FrameArrivalTime;
+		}
+		Timings.LastCaptureTime = FrameArrivalTime;
+	}
+	PendingFeed.Append(Frame, FrameSamples);
+	if (Capture)
+	{
+		Capture->AppendFrame(Frame, FrameSamples, bVoiced);
+	}
+	if (PendingFeed.Num() >= FeedChunkSamples)
+	{
+		FlushPendingFeed(bOutFedVoiceData);
+	}
+}
+
+void FDeepSpeechTranscriptionSession::FlushPendingFeed(bool& bOutFedVoiceData)
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (PendingFeed.Num() == 0 || !StreamState)
+	{
+		PendingFeed.Reset();
+		return;
+	}
+
+	// Measured from the oldest block in the chunk, the worst any sample in it waited.
+	const double StartTime = FPlatformTime::Seconds();
+	const double QueueWait = StartTime - PendingFeedArrivalTime;
+	{
+		FDeepSpeechInferenceScope InferenceScope(*Model);
+		TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxFeed);
+		DS_FeedAudioContent(StreamState, PendingFeed.GetData(), PendingFeed.Num());
+	}
+	const double AudioSeconds = (double)PendingFeed.Num() / Model->GetSampleRate();
+	DecodeScheduler.OnAudioFed(AudioSeconds);
+	PendingFeed.Reset();
+	bOutFedVoiceData = true;
+
+	NumFeeds++;
+	QueueWaitSum += QueueWait;
+	Timings.AudioSeconds += AudioSeconds;
+	Timings.QueueWaitAverageMs = QueueWaitSum / NumFeeds * 1000.0;
+	Timings.QueueWaitMaxMs = FMath::Max<double>(Timings.QueueWaitMaxMs, QueueWait * 1000.0);
+	Timings.FeedMs += (FPlatformTime::Seconds() - StartTime) * 1000.0;
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::IntermediateDecode()
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (OnResult.IsBound())
+	{
+		IntermediateDecodeWithMetadata();
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	char* IntermediateResult;
+	{
+		TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxIntermediateDecode);
+		IntermediateResult = DS_IntermediateDecode(StreamState);
+	}
+	const double DecodeSeconds = FPlatformTime::Seconds() - StartTime;
+	Timings.DecodeMs += DecodeSeconds * 1000.0;
+
+	const FString IntermediateTranscribe = IntermediateResult ? FString(IntermediateResult) : FString();
+	if (IntermediateResult)
+	{
+		DS_FreeString(IntermediateResult);
+	}
+
+	// Partials that didn't change since the last one aren't worth a trip to the game thread.
+	if (DecodeScheduler.OnDecoded(DecodeSeconds, IntermediateTranscribe) && !IntermediateTranscribe.IsEmpty())
+	{
+		if (Journal)
+		{
+			Journal->AddResult(IntermediateTranscribe, false);
+		}
+		OnTranscribed.ExecuteIfBound(IntermediateTranscribe, false, Timings);
+	}
+	SpotCommands(IntermediateTranscribe, false);
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::IntermediateDecodeWithMetadata()
+{
+#if TENSORVOX_VALID_PLATFORM
+	const double StartTime = FPlatformTime::Seconds();
+	Metadata* IntermediateMetadata;
+	{
+		TENSORVOX_SCOPE_CYCLE_COUNTER(STAT_TensorVoxIntermediateDecode);
+		IntermediateMetadata = DS_IntermediateDecodeWithMetadata(StreamState, FMath::Clamp(Config.NumCandidates, 1, 16));
+	}
+	const double DecodeSeconds = FPlatformTime::Seconds() - StartTime;
+	Timings.DecodeMs += DecodeSeconds * 1000.0;
+	if (!IntermediateMetadata)
+	{
+		return;
+	}
+
+	const TSharedRef<FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe> Result = ResultPool->Acquire();
+	Result->Fill(*IntermediateMetadata, false);
+	Result->Timings = Timings;
+	DS_FreeMetadata(IntermediateMetadata);
+
+	if (DecodeScheduler.OnDecoded(DecodeSeconds, Result->GetBestText()) && !Result->GetBestText().IsEmpty())
+	{
+		if (Journal)
+		{
+			Journal->AddResult(Result->GetBestText(), false);
+		}
+		OnResult.Execute(Result);
+		if (OnTranscribed.IsBound())
+		{
+			OnTranscribed.Execute(FString(Result->GetBestText()), false, Timings);
+		}
+	}
+	SpotCommands(Result->GetBestText(), false);
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::SpotCommands(FStringView Hypothesis, bool bUtteranceEnded)
+{
+	if (!CommandSpotter.IsActive())
+	{
+		return;
+	}
+
+	CommandMatches.Reset();
+	const int32 NumMatches = bUtteranceEnded ? CommandSpotter.Finish(CommandMatches) : CommandSpotter.OnHypothesis(Hypothesis, CommandMatches);
+	for (FDeepSpeechCommandMatch& Match : CommandMatches)
+	{
+		Match.UtteranceId = Timings.UtteranceId;
+		Match.TriggerMs = Timings.LastCaptureTime > 0.0 ? (Match.TriggerTime - Timings.LastCaptureTime) * 1000.0 : 0.0f;
+		if (Timings.CommandTime == 0.0)
+		{
+			Timings.CommandTime = Match.TriggerTime;
+		}
+		UE_LOG(LogUETensorVox, Verbose, TEXT("Session %i heard command %s as \"%s\"%s, %i edits, %.1f ms after the audio it was decided on."), SessionId,
+		       *Match.Command.ToString(), *Match.Heard, Match.bPrefix ? TEXT(" (prefix)") : TEXT(""), Match.NumEdits, Match.TriggerMs);
+		OnCommand.ExecuteIfBound(Match);
+	}
+
+	// What's left of the utterance would only delay the next one.
+	if (NumMatches > 0 && !bUtteranceEnded && Config.bEndUtteranceOnCommand)
+	{
+		EndStream();
+	}
+}
+
+void FDeepSpeechTranscriptionSession::ReportDecodeTimings()
+{
+	if (DecodeScheduler.GetNumDecodes() == 0)
+	{
+		return;
+	}
+
+	UE_LOG(LogUETensorVox, Log, TEXT("Session %i ran %i intermediate decodes over %.2fs of speech (%i unchanged), avg %.1f ms, max %.1f ms, %.1f%% of real time."),
+	       SessionId, DecodeScheduler.GetNumDecodes(), DecodeScheduler.GetStreamSeconds(), DecodeScheduler.GetNumSuppressed(),
+	       DecodeScheduler.GetTotalDecodeSeconds() / DecodeScheduler.GetNumDecodes() * 1000.0, DecodeScheduler.GetMaxDecodeSeconds() * 1000.0,
+	       DecodeScheduler.GetTotalDecodeSeconds() / FMath::Max(DecodeScheduler.GetStreamSeconds(), SMALL_NUMBER) * 100.0);
+
+	if (DecodeScheduler.GetTimings().Num() > 0)
+	{
+		// Several sessions may finish at once.
+		static FCriticalSection ExportCritical;
+		FScopeLock Lock(&ExportCritical);
+
+		const FString Path = FPaths::ProjectLogDir() / TEXT("TensorVoxDecodeTimings.csv");
+		FString Csv;
+		if (!IFileManager::Get().FileExists(*Path))
+		{
+			Csv += TEXT("Session,StreamSeconds,IntervalSeconds,DecodeMs,Changed\n");
+		}
+		for (const FDeepSpeechDecodeTiming& Timing : DecodeScheduler.GetTimings())
+		{
+			Csv += FString::Printf(TEXT("%i,%.3f,%.3f,%.3f,%i\n"), SessionId, Timing.StreamSeconds, Timing.IntervalSeconds, Timing.DecodeSeconds * 1000.0,
+			                       Timing.bChanged ? 1 : 0);
+		}
+		FFileHelper::SaveStringToFile(Csv, *Path, FFileHelper::EEncodingOptions::ForceUTF8WithoutBOM, &IFileManager::Get(), FILEWRITE_Append);
+	}
+}
+
+bool FDeepSpeechTranscriptionSession::BeginUtterance()
+{
+#if TENSORVOX_VALID_PLATFORM
+	const int32 SampleRate = Model->GetSampleRate();
+
+	// Start recording, or only open the gate when the source is kept open.
+	PendingFeed.Reset();
+	LookbackSeconds = 0.0f;
+	if (bPersistentCapture)
+	{
+		LookbackSeconds = Recorder->OpenGate();
+	}
+	else
+	{
+		if (!Recorder->StartRecording(SampleRate, FrameSamples, Config.CaptureBufferSeconds))
+		{
+			return false;
+		}
+	}
+	GateOpenTime = FPlatformTime::Seconds();
+	bAwaitingFirstSample = true;
+	if (Journal)
+	{
+		Journal->AddStart(Recorder->RecordingSampleRate, Recorder->GetFrameLayout());
+	}
+
+	if (Config.bAutomaticEndpointing)
+	{
+		// Listen, streams are opened as speech is heard.
+		const auto ToFrames = [](float Milliseconds) { return FMath::CeilToInt(Milliseconds * 0.001f / ModelStepSeconds); };
+		Endpointer.Reset(ToFrames(Config.SpeechOnsetMilliseconds), ToFrames(Config.EndpointHangoverMilliseconds), ToFrames(Config.MaxUtteranceSeconds * 1000.0f));
+		PreRoll.Initialize(FMath::Max(ToFrames(Config.PreRollMilliseconds), Endpointer.GetOnsetFrames()) * FrameSamples);
+		PendingFeed.Reserve(FeedChunkSamples + PreRoll.Max());
+	}
+	else
+	{
+		OpenStream();
+		Timings.LookbackMs = LookbackSeconds * 1000.0f;
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::OpenStream()
+{
+#if TENSORVOX_VALID_PLATFORM
+	DecodeScheduler.Reset(Config.IntermediateDecodeIntervalMilliseconds * 0.001f, Config.IntermediateDecodeCpuBudget, GTensorVoxExportDecodeTimings);
+
+	if (bStreamCarried)
+	{
+		// Carry on in the stream the last utterance couldn't be finished in, its timings cover both.
+		bStreamCarried = false;
+	}
+	else
+	{
+		Timings = FDeepSpeechUtteranceTimings();
+		NumFeeds = 0;
+		QueueWaitSum = 0.0;
+
+		NumUtterances++;
+		Timings.UtteranceId = NumUtterances;
+		Capture = FDeepSpeechCaptureWriter::IsEnabled() ? FDeepSpeechCaptureWriter::Get().BeginUtterance(SessionId, NumUtterances, Model->GetSampleRate()) : nullptr;
+
+		{
+			FScopeLock Lock(&HotWordsCritical);
+			if (bHotWordsChanged)
+			{
+				HotWords = PendingHotWords;
+				bHotWordsChanged = false;
+			}
+			if (bCommandsChanged)
+			{
+				CommandGrammar = PendingCommandGrammar;
+				OnCommand = PendingOnCommand;
+				bCommandsChanged = false;
+			}
+		}
+
+		// Reset either way, a new utterance has heard nothing yet.
+		FDeepSpeechCommandSpotterSettings SpotterSettings;
+		SpotterSettings.StabilityDecodes = Config.CommandStabilityDecodes;
+		SpotterSettings.FuzzyTolerance = Config.CommandFuzzyTolerance;
+		SpotterSettings.bFireOnUniquePrefix = Config.bCommandsFireOnUniquePrefix;
+		CommandSpotter.Reset(OnCommand.IsBound() ? CommandGrammar : nullptr, SpotterSettings);
+
+		// The governor narrows the beam of new streams when the machine can't keep up with the configured one.
+		const int32 StreamBeamWidth = Manager.GetLoadGovernor().GetBeamWidth(Model->GetBeamWidth());
+		Timings.BeamWidth = StreamBeamWidth > 0 ? StreamBeamWidth : Model->GetBeamWidth();
+
+		FDeepSpeechInferenceScope InferenceScope(*Model);
+		if (!FDeepSpeechModel::CheckForError(TEXT("StreamingState Init"), Model->CreateStream(StreamState, HotWords, StreamBeamWidth)))
+		{
+			FDeepSpeechPipelineStats::NumActiveStreams.fetch_add(1, std::memory_order_relaxed);
+			const double StartTime = FPlatformTime::Seconds();
+			NoiseFloor.Feed(StreamState, LeadPaddingSamples);
+			Timings.PaddingMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+			Timings.FeedMs += Timings.PaddingMs;
+		}
+		else
+		{
+			StreamState = nullptr;
+		}
+	}
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::EndUtterance()
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (bStreamCarried)
+	{
+		// Only possible while listening for speech, there's nothing new in it.
+		FinalizeStream();
+	}
+	else
+	{
+		EndStream();
+	}
+
+	// Finish recording
+	if (Journal)
+	{
+		Journal->AddEnd();
+	}
+	bAwaitingFirstSample = false;
+	if (bPersistentCapture)
+	{
+		Recorder->CloseGate();
+	}
+	else
+	{
+		Recorder->StopRecording();
+	}
+	if (Recorder->GetNumDeviceOverflows() > 0 || Recorder->GetNumBufferOverflows() > 0)
+	{
+		UE_LOG(LogUETensorVox, Warning, TEXT("Session %i recording overflowed, device overflows: %i, capture buffer overflows: %i (%lld samples dropped)."),
+		       SessionId, Recorder->GetNumDeviceOverflows(), Recorder->GetNumBufferOverflows(), Recorder->GetNumDroppedSamples());
+	}
+#endif
+}
+
+void FDeepSpeechTranscriptionSession::EndStream()
+{
+	if (!StreamState)
+	{
+		return;
+	}
+	SpotCommands(FStringView(), true);
+
+	if (TrailPaddingSamples > 0)
+	{
+		const double StartTime = FPlatformTime::Seconds();
+		{
+			FDeepSpeechInferenceScope InferenceScope(*Model);
+			NoiseFloor.Feed(StreamState, TrailPaddingSamples);
+		}
+		const double PaddingMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		Timings.PaddingMs += PaddingMs;
+		Timings.FeedMs += PaddingMs;
+	}
+
+	FinalizeStream();
+	if (NumFeeds > 0)
+	{
+		UE_LOG(LogUETensorVox, Log, TEXT("Session %i fed %i chunks (%.2fs), capture to feed latency avg %.1f ms, max %.1f ms, feeding took %.1f ms."),
+		       SessionId, NumFeeds, Timings.AudioSeconds, Timings.QueueWaitAverageMs, Timings.QueueWaitMaxMs, Timings.FeedMs);
+	}
+	ReportDecodeTimings();
+}
+
+void FDeepSpeechTranscriptionSession::FinalizeStream()
+{
+	if (!StreamState)
+	{
+		return;
+	}
+
+	Timings.EndpointTime = FPlatformTime::Seconds();
+	Timings.EndpointMs = Timings.LastCaptureTime > 0.0 ? (Timings.EndpointTime - Timings.LastCaptureTime) * 1000.0 : 0.0;
+
+	FDeepSpeechFinalizationPool::FJob Job;
+	Job.Model = Model;
+	Job.Stream = StreamState;
+	Job.OnTranscribed = OnTranscribed;
+	Job.OnResult = OnResult;
+	Job.ResultPool = ResultPool;
+	Job.NumCandidates = FMath::Clamp(Config.NumCandidates, 1, 16);
+	Job.Timings = Timings;
+	Job.SessionId = SessionId;
+	Job.Capture = Capture;
+	Job.Journal = Journal;
+
+	const TWeakPtr<FDeepSpeechTranscriptionSession, ESPMode::ThreadSafe> WeakSession = AsShared();
+	if (Manager.GetFinalizationPool().Enqueue(MoveTemp(Job), FSimpleDelegate::CreateLambda([WeakSession]()
+	{
+		if (const TSharedPtr<FDeepSpeechTranscriptionSession, ESPMode::ThreadSafe> Session = WeakSession.Pin())
+		{
+			Session->Manager.WakeSession(*Session);
+		}
+	})))
+	{
+		StreamState = nullptr;
+		bStreamCarried = false;
+		if (Capture)
+		{
+			Capture->End();
+			Capture.Reset();
+		}
+	}
+	else
+	{
+		UE_LOG(LogUETensorVox, Verbose, TEXT("Session %i finalization queue full, merging into the next utterance."), SessionId);
+		bStreamCarried = true;
+	}
+}
+
+void FDeepSpeechTranscriptionSession::Shutdown()
+{
+#if TENSORVOX_VALID_PLATFORM
+	if (StreamState)
+	{
+		// Nobody is listening for the result anymore.
+		DS_FreeStream(StreamState);
+		StreamState = nullptr;
+		FDeepSpeechPipelineStats::NumActiveStreams.fetch_sub(1, std::memory_order_relaxed);
+	}
+	if (Capture)
+	{
+		Capture->End();
+		Capture.Reset();
+	}
+
+	FDeepSpeechPipelineStats::NumQueuedSamples.fetch_sub(NumReportedQueuedSamples, std::memory_order_relaxed);
+	NumReportedQueuedSamples = 0;
+
+	if (Recorder)
+	{
+		Recorder->StopRecording();
+		Recorder.Reset();
+	}
+	// Queued finalizations hold on to it until their results are in.
+	Journal.Reset();
+
+	VoiceDetector.Shutdown();
+
+	// Queued finalizations hold their own reference to the model.
+	bStreamCarried = false;
+	Model.Reset();
+
+	UE_LOG(LogUETensorVox, Log, TEXT("Stopped transcription session %i."), SessionId);
+#endif
+}
@@ -0,0 +1,364 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "DeepSpeechVoiceDetector.h"
+#include "UETensorVox.h"
+
+#if TENSORVOX_VALID_PLATFORM
+#include "WebRtcCommonAudioIncludes.h"
+#endif
+
+// Speech band the spectral flatness is measured over, where voiced speech has its harmonics.
+static const float SpeechBandLowHz = 300.0f;
+static const float SpeechBandHighHz = 4000.0f;
+// Quieter than this is silence no matter the noise floor, so digital silence doesn't count as speech over a -inf floor.
+static const float MinSpeechEnergyDb = -65.0f;
+// The noise floor is the quietest frame heard in the first frames, then follows the energy: quickly down, slowly up, and barely at
+// all during speech, so a step up in background noise that's mistaken for speech is still taken in within seconds.
+static const int32 WarmupFrames = 10;
+static const float NoiseFloorFallRate = 0.2f;
+static const float NoiseFloorRiseRate = 0.02f;
+static const float NoiseFloorSpeechRiseRate = 0.002f;
+
+struct FBuiltinVadMode
+{
+	float MarginDb;
+	float FlatnessThresholdLog2;
+	float ZeroCrossingThreshold;
+	float HangoverMilliseconds;
+};
+
+// By aggressiveness, more aggressive wants louder speech, vetoes more noise like frames and holds on to speech for less long.
+static const FBuiltinVadMode BuiltinVadModes[] =
+{
+	{6.0f, -1.0f, 0.35f, 120.0f},
+	{9.0f, -1.3f, 0.30f, 80.0f},
+	{12.0f, -1.6f, 0.25f, 60.0f},
+	{15.0f, -2.0f, 0.20f, 40.0f},
+};
+
+// Mitchell's log2, exact at powers of two and within 0.09 in between. Worked out from the float's bits in integers, so it rounds
+// the same on every platform, unlike the C library's.
+static float Log2FromBits(float Value)
+{
+	int32 Bits;
+	FMemory::Memcpy(&Bits, &Value, sizeof(Bits));
+	return (float)(Bits - 0x3F800000) * (1.0f / 8388608.0f);
+}
+
+// Lanes are added in the same order on every platform.
+static float HorizontalSum(const VectorRegister4Float& Vector)
+{
+	float Lanes[4];
+	VectorStore(Vector, Lanes);
+	return (Lanes[0] + Lanes[1]) + (Lanes[2] + Lanes[3]);
+}
+
+/**
+* FDeepSpeechBuiltinVad Implementation
+*/
+
+FDeepSpeechBuiltinVad::FDeepSpeechBuiltinVad()
+	: SampleRate(0), FrameSamples(0), FftSize(0), FirstBin(0), NumBins(0), MarginDb(0.0f), FlatnessThresholdLog2(0.0f), ZeroCrossingThreshold(0.0f),
+	  HangoverFrames(0), NumFrames(0), HangoverLeft(0)
+{
+}
+
+void FDeepSpeechBuiltinVad::Initialize(int32 InSampleRate, int32 InFrameSamples, int32 Aggressiveness)
+{
+	SampleRate = InSampleRate;
+	FrameSamples = InFrameSamples;
+	FftSize = FMath::Max((int32)FMath::RoundUpToPowerOfTwo(FrameSamples), 8);
+
+	const FBuiltinVadMode& Mode = BuiltinVadModes[FMath::Clamp(Aggressiveness, 0, (int32)UE_ARRAY_COUNT(BuiltinVadModes) - 1)];
+	MarginDb = Mode.MarginDb;
+	FlatnessThresholdLog2 = Mode.FlatnessThresholdLog2;
+	ZeroCrossingThreshold = Mode.ZeroCrossingThreshold;
+	HangoverFrames = FMath::RoundToInt(Mode.HangoverMilliseconds * 0.001f * SampleRate / FrameSamples);
+
+	Samples.SetNumZeroed(FftSize + 4);
+
+	// Tables are worked out in double and rounded once, which comes out the same everywhere.
+	Window.SetNumUninitialized(FrameSamples);
+	for (int32 Index = 0; Index < FrameSamples; ++Index)
+	{
+		Window[Index] = (float)(0.5 - 0.5 * FMath::Cos(2.0 * UE_DOUBLE_PI * Index / FMath::Max(FrameSamples - 1, 1)));
+	}
+
+	const int32 NumBits = FMath::FloorLog2(FftSize);
+	BitReverse.SetNumUninitialized(FftSize);
+	for (int32 Index = 0; Index < FftSize; ++Index)
+	{
+		int32 Reversed = 0;
+		for (int32 Bit = 0; Bit < NumBits; ++Bit)
+		{
+			Reversed |= ((Index >> Bit) & 1) << (NumBits - 1 - Bit);
+		}
+		BitReverse[Index] = Reversed;
+	}
+
+	Real.SetNumZeroed(FftSize);
+	Imag.SetNumZeroed(FftSize);
+	TwiddleReal.SetNumZeroed(FftSize);
+	TwiddleImag.SetNumZeroed(FftSize);
+	for (int32 Half = 1; Half < FftSize; Half *= 2)
+	{
+		for (int32 Index = 0; Index < Half; ++Index)
+		{
+			const double Angle = -UE_DOUBLE_PI * Index / Half;
+			TwiddleReal[Half + Index] = (float)FMath::Cos(Angle);
+			TwiddleImag[Half + Index] = (float)FMath::Sin(Angle);
+		}
+	}
+
+	const int32 NumUsableBins = FftSize / 2;
+	FirstBin = FMath::Clamp(FMath::FloorToInt(SpeechBandLowHz * FftSize / SampleRate), 0, NumUsableBins - 4) & ~3;
+	const int32 LastBin = FMath::Clamp(FMath::CeilToInt(SpeechBandHighHz * FftSize / SampleRate), FirstBin + 4, NumUsableBins);
+	NumBins = FMath::Min(Align(LastBin - FirstBin, 4), NumUsableBins - FirstBin);
+	Power.SetNumZeroed(NumBins);
+
+	Reset();
+}
+
+void FDeepSpeechBuiltinVad::Reset()
+{
+	NumFrames = 0;
+	HangoverLeft = 0;
+	Features = FFeatures();
+}
+
+bool FDeepSpeechBuiltinVad::ProcessFrame(const int16* Frame)
+{
+	// Scaling by a power of two is exact.
+	for (int32 Index = 0; Index < FrameSamples; ++Index)
+	{
+		Samples[Index] = Frame[Index] * (1.0f / 32768.0f);
+	}
+
+	// Energy and sign changes, the zeros after the frame add nothing to either.
+	const VectorRegister4Float Zero = VectorZeroFloat();
+	const VectorRegister4Float One = VectorOneFloat();
+	VectorRegister4Float Energy = Zero;
+	VectorRegister4Float Crossings = Zero;
+	const int32 NumVectorSamples = Align(FrameSamples, 4);
+	for (int32 Index = 0; Index < NumVectorSamples; Index += 4)
+	{
+		const VectorRegister4Float Current = VectorLoadAligned(Samples.GetData() + Index);
+		const VectorRegister4Float Next = VectorLoad(Samples.GetData() + Index + 1);
+		Energy = VectorAdd(Energy, VectorMultiply(Current, Current));
+		Crossings = VectorAdd(Crossings, VectorSelect(VectorCompareLT(VectorMultiply(Current, Next), Zero), One, Zero));
+	}
+
+	const float MeanSquare = HorizontalSum(Energy) / FrameSamples + 1e-10f;
+	Features.EnergyDb = 3.0103f * Log2FromBits(MeanSquare);
+	Features.ZeroCrossingRate = HorizontalSum(Crossings) / FMath::Max(FrameSamples - 1, 1);
+
+	ComputeSpectrum();
+	VectorRegister4Float PowerSum = Zero;
+	float LogSum = 0.0f;
+	for (int32 Bin = 0; Bin < NumBins; Bin += 4)
+	{
+		PowerSum = VectorAdd(PowerSum, VectorLoadAligned(Power.GetData() + Bin));
+	}
+	for (int32 Bin = 0; Bin < NumBins; ++Bin)
+	{
+		LogSum += Log2FromBits(Power[Bin]);
+	}
+	Features.SpectralFlatnessLog2 = LogSum / NumBins - Log2FromBits(HorizontalSum(PowerSum) / NumBins);
+
+	if (NumFrames == 0)
+	{
+		Features.NoiseFloorDb = Features.EnergyDb;
+	}
+
+	// Loud enough over the noise, unless it's barely over and sounds like hiss or rumble rather than a voice.
+	const float AboveFloorDb = Features.EnergyDb - Features.NoiseFloorDb;
+	const bool bLoud = AboveFloorDb > MarginDb && Features.EnergyDb > MinSpeechEnergyDb;
+	const bool bNoiseLike = Features.SpectralFlatnessLog2 > FlatnessThresholdLog2 && Features.ZeroCrossingRate > ZeroCrossingThreshold;
+	const bool bVoiced = bLoud && !(bNoiseLike && AboveFloorDb < MarginDb * 2.0f);
+
+	if (NumFrames < WarmupFrames)
+	{
+		Features.NoiseFloorDb = FMath::Min(Features.NoiseFloorDb, Features.EnergyDb);
+		++NumFrames;
+	}
+	else
+	{
+		const float Rate = Features.EnergyDb < Features.NoiseFloorDb ? NoiseFloorFallRate : bVoiced ? NoiseFloorSpeechRiseRate : NoiseFloorRiseRate;
+		const float Step = (Features.EnergyDb - Features.NoiseFloorDb) * Rate;
+		Features.NoiseFloorDb += Step;
+	}
+
+	// Hold on to speech for a little while, the ends of words are quieter than their middles.
+	if (bVoiced)
+	{
+		HangoverLeft = HangoverFrames;
+		return true;
+	}
+	if (HangoverLeft > 0)
+	{
+		--HangoverLeft;
+		return true;
+	}
+	return false;
+}
+
+void FDeepSpeechBuiltinVad::ComputeSpectrum()
+{
+	for (int32 Index = 0; Index < FrameSamples; ++Index)
+	{
+		Real[BitReverse[Index]] = Samples[Index] * Window[Index];
+	}
+	for (int32 Index = FrameSamples; Index < FftSize; ++Index)
+	{
+		Real[BitReverse[Index]] = 0.0f;
+	}
+	FMemory::Memzero(Imag.GetData(), FftSize * sizeof(float));
+
+	float* RESTRICT Re = Real.GetData();
+	float* RESTRICT Im = Imag.GetData();
+	const float* RESTRICT Wr = TwiddleReal.GetData();
+	const float* RESTRICT Wi = TwiddleImag.GetData();
+
+	// The first two stages are too narrow for a register.
+	for (int32 Half = 1; Half < FMath::Min(FftSize, 4); Half *= 2)
+	{
+		for (int32 Start = 0; Start < FftSize; Start += Half * 2)
+		{
+			for (int32 Index = 0; Index < Half; ++Index)
+			{
+				const int32 Top = Start + Index;
+				const int32 Bottom = Top + Half;
+				const float RealByReal = Re[Bottom] * Wr[Half + Index];
+				const float ImagByImag = Im[Bottom] * Wi[Half + Index];
+				const float RealByImag = Re[Bottom] * Wi[Half + Index];
+				const float ImagByReal = Im[Bottom] * Wr[Half + Index];
+				const float TwiddledReal = RealByReal - ImagByImag;
+				const float TwiddledImag = RealByImag + ImagByReal;
+				Re[Bottom] = Re[Top] - TwiddledReal;
+				Im[Bottom] = Im[Top] - TwiddledImag;
+				Re[Top] = Re[Top] + TwiddledReal;
+				Im[Top] = Im[Top] + TwiddledImag;
+			}
+		}
+	}
+
+	for (int32 Half = 4; Half < FftSize; Half *= 2)
+	{
+		for (int32 Start = 0; Start < FftSize; Start += Half * 2)
+		{
+			for (int32 Index = 0; Index < Half; Index += 4)
+			{
+				const int32 Top = Start + Index;
+				const int32 Bottom = Top + Half;
+				const VectorRegister4Float TwiddleR = VectorLoadAligned(Wr + Half + Index);
+				const VectorRegister4Float TwiddleI = VectorLoadAligned(Wi + Half + Index);
+				const VectorRegister4Float BottomR = VectorLoadAligned(Re + Bottom);
+				const VectorRegister4Float BottomI = VectorLoadAligned(Im + Bottom);
+				const VectorRegister4Float TopR = VectorLoadAligned(Re + Top);
+				const VectorRegister4Float TopI = VectorLoadAligned(Im + Top);
+				const VectorRegister4Float TwiddledR = VectorSubtract(VectorMultiply(BottomR, TwiddleR), VectorMultiply(BottomI, TwiddleI));
+				const VectorRegister4Float TwiddledI = VectorAdd(VectorMultiply(BottomR, TwiddleI), VectorMultiply(BottomI, TwiddleR));
+				VectorStoreAligned(VectorSubtract(TopR, TwiddledR), Re + Bottom);
+				VectorStoreAligned(VectorSubtract(TopI, TwiddledI), Im + Bottom);
+				VectorStoreAligned(VectorAdd(TopR, TwiddledR), Re + Top);
+				VectorStoreAligned(VectorAdd(TopI, TwiddledI), Im + Top);
+			}
+		}
+	}
+
+	const VectorRegister4Float Epsilon = VectorSetFloat1(1e-12f);
+	for (int32 Bin = 0; Bin < NumBins; Bin += 4)
+	{
+		const VectorRegister4Float BinR = VectorLoadAligned(Re + FirstBin + Bin);
+		const VectorRegister4Float BinI = VectorLoadAligned(Im + FirstBin + Bin);
+		const VectorRegister4Float BinPower = VectorAdd(VectorAdd(VectorMultiply(BinR, BinR), VectorMultiply(BinI, BinI)), Epsilon);
+		VectorStoreAligned(BinPower, Power.GetData() + Bin);
+	}
+}
+
+/**
+* FDeepSpeechVoiceDetector Implementation
+*/
+
+FDeepSpeechVoiceDetector::FDeepSpeechVoiceDetector()
+	: bInitialized(false), Detector(EDeepSpeechVoiceDetector::Off), SampleRate(0), FrameSamples(0), WebRtcInstance(nullptr)
+{
+}
+
+FDeepSpeechVoiceDetector::~FDeepSpeechVoiceDetector()
+{
+	Shutdown();
+}
+
+EDeepSpeechVoiceDetector FDeepSpeechVoiceDetector::Resolve(EDeepSpeechVoiceDetector Detector)
+{
+	if (Detector == EDeepSpeechVoiceDetector::Automatic || Detector == EDeepSpeechVoiceDetector::WebRtc)
+	{
+#if WITH_WEBRTC
+		return EDeepSpeechVoiceDetector::WebRtc;
+#else
+		return EDeepSpeechVoiceDetector::Builtin;
+#endif
+	}
+	return Detector;
+}
+
+void FDeepSpeechVoiceDetector::Initialize(EDeepSpeechVoiceDetector InDetector, int32 Aggressiveness, int32 InSampleRate, int32 InFrameSamples)
+{
+	Shutdown();
+
+	Detector = Resolve(InDetector);
+	SampleRate = InSampleRate;
+	FrameSamples = InFrameSamples;
+	Aggressiveness = FMath::Clamp(Aggressiveness, 0, 3);
+
+#if WITH_WEBRTC
+	if (Detector == EDeepSpeechVoiceDetector::WebRtc)
+	{
+		if (WebRtcVad_ValidRateAndFrameLength(SampleRate, FrameSamples) == 0)
+		{
+			WebRtcInstance = WebRtcVad_Create();
+			WebRtcVad_Init(WebRtcInstance);
+			WebRtcVad_set_mode(WebRtcInstance, Aggressiveness);
+		}
+		else
+		{
+			UE_LOG(LogUETensorVox, Warning, TEXT("WebRTC vad can't take %i sample frames at %i hz, using the built in one instead."), FrameSamples, SampleRate);
+			Detector = EDeepSpeechVoiceDetector::Builtin;
+		}
+	}
+#endif
+
+	if (Detector == EDeepSpeechVoiceDetector::Builtin)
+	{
+		Builtin.Initialize(SampleRate, FrameSamples, Aggressiveness);
+	}
+	bInitialized = true;
+}
+
+void FDeepSpeechVoiceDetector::Shutdown()
+{
+#if WITH_WEBRTC
+	if (WebRtcInstance)
+	{
+		WebRtcVad_Free(WebRtcInstance);
+		WebRtcInstance = nullptr;
+	}
+#endif
+	bInitialized = false;
+}
+
+bool FDeepSpeechVoiceDetector::ProcessFrame(const int16* Frame)
+{
+	switch (Detector)
+	{
+#if WITH_WEBRTC
+	case EDeepSpeechVoiceDetector::WebRtc:
+		return WebRtcVad_Process(WebRtcInstance, SampleRate, Frame, FrameSamples) != 0;
+#endif
+	case EDeepSpeechVoiceDetector::Builtin:
+		return Builtin.ProcessFrame(Frame);
+	default:
+		return true;
+	}
+}
@@ -0,0 +1,80 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "Misc/AutomationTest.h"
+#include "DeepSpeechBenchmarks.h"
+#include "DeepSpeechLoadGovernor.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeepSpeechLoadGovernorConvergesTest, "TensorVox.Governor.Converges",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDeepSpeechLoadGovernorConvergesTest::RunTest(const FString& Parameters)
+{
+	// A light load, and the benchmark's default, whose doubled half leaves the level nothing more to give.
+	for (const float Load : {0.5f, 1.5f})
+	{
+		DeepSpeechBenchmarks::FGovernorReport Report;
+		DeepSpeechBenchmarks::RunGovernor(40, Load, Report);
+		for (const DeepSpeechBenchmarks::FGovernorPhase& Phase : Report.Phases)
+		{
+			TestTrue(FString::Printf(TEXT("Load %.2f converged: level %.2f to %.2f, worst latency %.1f of %.0f ms, frame %.1f of %.1f ms, RTF %.2f of %.2f"),
+			                         Phase.Load, Phase.MinLevel, Phase.MaxLevel, Phase.WorstLatencyMs, Report.Settings.TargetLatencyMs, Phase.WorstFrameMs,
+			                         Report.Settings.TargetFrameMs, Phase.WorstRealTimeFactor, Report.Settings.MaxRealTimeFactor),
+			         Phase.bConverged);
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeepSpeechLoadGovernorCostPressureTest, "TensorVox.Governor.CostPressure",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDeepSpeechLoadGovernorCostPressureTest::RunTest(const FString& Parameters)
+{
+	// No frame target, latency at a fifth of its target throughout: only cost can bring the level down.
+	FDeepSpeechGovernorSettings Settings;
+	Settings.TargetLatencyMs = 500.0f;
+	Settings.TargetFrameMs = 0.0f;
+	Settings.MaxWorkerLoad = 0.75f;
+	Settings.MaxRealTimeFactor = 0.5f;
+	const int32 ModelBeamWidth = 500;
+
+	FDeepSpeechLoadSample WithinBudget;
+	WithinBudget.LatencyMs = 100.0f;
+	WithinBudget.RealTimeFactor = 0.2f;
+	WithinBudget.WorkerLoad = 0.3f;
+	{
+		FDeepSpeechLoadGovernor Governor;
+		Governor.Decide(WithinBudget, Settings);
+		TestEqual(TEXT("Level within budget"), Governor.GetLevel(), 1.0f);
+		TestEqual(TEXT("Beam width within budget"), Governor.GetBeamWidth(ModelBeamWidth), 0);
+	}
+
+	FDeepSpeechLoadSample OverRealTimeFactor = WithinBudget;
+	OverRealTimeFactor.RealTimeFactor = 1.0f;
+	FDeepSpeechLoadSample OverWorkerLoad = WithinBudget;
+	OverWorkerLoad.WorkerLoad = 1.0f;
+
+	for (const FDeepSpeechLoadSample& Sample : {OverRealTimeFactor, OverWorkerLoad})
+	{
+		const FString Name = Sample.WorkerLoad > Settings.MaxWorkerLoad ? TEXT("Over the worker load budget") : TEXT("Over the real time factor budget");
+		FDeepSpeechLoadGovernor Governor;
+		Governor.Decide(Sample, Settings);
+		const int32 BeamWidth = Governor.GetBeamWidth(ModelBeamWidth);
+		AddInfo(FString::Printf(TEXT("%s: pressure %.2f, level %.2f, beam %i, decode rate x%.2f."), *Name, Governor.GetLastPressure(), Governor.GetLevel(),
+		                        BeamWidth, Governor.GetDecodeRateScale()));
+
+		TestTrue(FString::Printf(TEXT("%s, the level drops below 1"), *Name), Governor.GetLevel() < 1.0f);
+		TestTrue(FString::Printf(TEXT("%s, the beam narrows"), *Name), BeamWidth > 0 && BeamWidth < ModelBeamWidth);
+		TestTrue(FString::Printf(TEXT("%s, intermediate decodes slow down"), *Name), Governor.GetDecodeRateScale() < 1.0f);
+
+		// Staying over budget keeps bringing it down, it doesn't wait for latency to suffer.
+		const float FirstLevel = Governor.GetLevel();
+		Governor.Decide(Sample, Settings);
+		TestTrue(FString::Printf(TEXT("%s for another interval, the level keeps dropping"), *Name), Governor.GetLevel() < FirstLevel);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,133 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "Misc/AutomationTest.h"
+#include "DeepSpeechBenchmarks.h"
+#include "DeepSpeechTestData.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+/**
+ * Whole sessions played from reference utterances, see DeepSpeechTestData.h for pointing them at a model and corpus. They run in real time, so
+ * they're performance tests rather than product ones.
+ */
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeepSpeechPipelineLatencyTest, "TensorVox.Pipeline.Latency",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FDeepSpeechPipelineLatencyTest::RunTest(const FString& Parameters)
+{
+	FDeepSpeechConfiguration Config;
+	TArray<FString> Files;
+	if (!DeepSpeechTestData::Get(*this, Config, Files))
+	{
+		return true;
+	}
+
+	// A push to talk game waits on the final after the key comes up, a second is where players start pressing it again.
+	const double MaxEndToFinalMs = 1000.0;
+	const double MaxRealTimeFactor = 1.0;
+
+	DeepSpeechBenchmarks::FLatencyReport Report;
+	if (!TestTrue(TEXT("Model loaded"), DeepSpeechBenchmarks::MeasureLatency(Config, Files, 1.0f, Report)))
+	{
+		return true;
+	}
+
+	const double P50 = DeepSpeechBenchmarks::Percentile(Report.EndToFinal, 0.5);
+	const double P95 = DeepSpeechBenchmarks::Percentile(Report.EndToFinal, 0.95);
+	AddInfo(FString::Printf(TEXT("%i utterances, %.1fs voiced, end to final p50 %.1f ms, p95 %.1f ms, real time factor %.3f."), Report.EndToFinal.Num(),
+	                        Report.AudioSeconds, P50, P95, Report.GetRealTimeFactor()));
+
+	TestEqual(TEXT("Utterances without a final"), Report.NumFailed, 0);
+	TestTrue(FString::Printf(TEXT("Real time factor of %.3f is below %.1f"), Report.GetRealTimeFactor(), MaxRealTimeFactor),
+	         Report.GetRealTimeFactor() < MaxRealTimeFactor);
+	TestTrue(FString::Printf(TEXT("p95 end to final of %.1f ms is at most %.0f ms"), P95, MaxEndToFinalMs), P95 <= MaxEndToFinalMs);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeepSpeechPipelineCommandsTest, "TensorVox.Pipeline.Commands",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FDeepSpeechPipelineCommandsTest::RunTest(const FString& Parameters)
+{
+	FDeepSpeechConfiguration Config;
+	TArray<FString> AllFiles;
+	if (!DeepSpeechTestData::Get(*this, Config, AllFiles))
+	{
+		return true;
+	}
+
+	TArray<FString> Files;
+	TArray<FName> Expected;
+	FDeepSpeechCommandGrammarPtr Grammar;
+	if (!TestTrue(TEXT("Some utterance has a transcript to use as its command"), DeepSpeechBenchmarks::MakeCommandCorpus(AllFiles, Files, Expected, Grammar)))
+	{
+		return true;
+	}
+
+	// A wrong command does something the player didn't ask for, a missed one only makes them say it again.
+	const double MinCorrectFraction = 0.9;
+
+	DeepSpeechBenchmarks::FCommandReport Report;
+	if (!TestTrue(TEXT("Model loaded"), DeepSpeechBenchmarks::MeasureCommands(Config, Files, Expected, Grammar, Report)))
+	{
+		return true;
+	}
+
+	const int32 NumDelivered = Report.EndToFinal.Num();
+	const double CorrectFraction = (double)Report.NumCorrect / FMath::Max(NumDelivered, 1);
+	const double LeadP50 = DeepSpeechBenchmarks::Percentile(Report.Lead, 0.5);
+	AddInfo(FString::Printf(TEXT("%i utterances: %i right, %i wrong, %i missed, end to command p50 %.1f ms, command ahead of final p50 %.1f ms."),
+	                        NumDelivered, Report.NumCorrect, Report.NumWrong, Report.NumMissed, DeepSpeechBenchmarks::Percentile(Report.EndToCommand, 0.5),
+	                        LeadP50));
+
+	TestEqual(TEXT("Utterances without a final"), Report.NumFailed, 0);
+	TestEqual(TEXT("Commands spotted wrong"), Report.NumWrong, 0);
+	TestTrue(FString::Printf(TEXT("%.0f%% of commands spotted right, at least %.0f%%"), CorrectFraction * 100.0, MinCorrectFraction * 100.0),
+	         CorrectFraction >= MinCorrectFraction);
+	TestTrue(FString::Printf(TEXT("Commands arrive ahead of the final, p50 %.1f ms"), LeadP50), LeadP50 > 0.0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeepSpeechPipelinePaddingTest, "TensorVox.Pipeline.Padding",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FDeepSpeechPipelinePaddingTest::RunTest(const FString& Parameters)
+{
+	FDeepSpeechConfiguration Config;
+	TArray<FString> Files;
+	if (!DeepSpeechTestData::Get(*this, Config, Files))
+	{
+		return true;
+	}
+
+	// The same half a point the sweep allows its cheapest padding.
+	const double MaxWordErrorRateLoss = 0.005;
+
+	DeepSpeechBenchmarks::FPaddingReport Report;
+	if (!TestTrue(TEXT("Model loaded"), DeepSpeechBenchmarks::MeasurePadding(Config, Files, Report)) ||
+		!TestTrue(TEXT("Some utterance loaded"), Report.NumUtterances > 0))
+	{
+		return true;
+	}
+
+	const int32 LeadMs = FMath::RoundToInt(Config.LeadPaddingMilliseconds);
+	const int32 TrailMs = FMath::RoundToInt(Config.TrailPaddingMilliseconds);
+	const DeepSpeechBenchmarks::FPaddingResult* Default = Report.Find(LeadMs, TrailMs);
+	if (!TestNotNull(FString::Printf(TEXT("The sweep covers the default lead %i / trail %i ms"), LeadMs, TrailMs), Default))
+	{
+		return true;
+	}
+
+	const DeepSpeechBenchmarks::FPaddingResult& Widest = Report.Results.Last();
+	AddInfo(FString::Printf(TEXT("%i utterances: default WER %.1f%% in %.1f ms, widest %.1f%% in %.1f ms, cheapest lead %i / trail %i ms %.1f%% in %.1f ms."),
+	                        Report.NumUtterances, Default->WordErrorRate * 100.0, Default->InferenceMs, Widest.WordErrorRate * 100.0, Widest.InferenceMs,
+	                        Report.Best.LeadMs, Report.Best.TrailMs, Report.Best.WordErrorRate * 100.0, Report.Best.InferenceMs));
+
+	TestTrue(FString::Printf(TEXT("Default padding WER of %.1f%% is within %.1f%% of the widest's %.1f%%"), Default->WordErrorRate * 100.0,
+	                         MaxWordErrorRateLoss * 100.0, Widest.WordErrorRate * 100.0),
+	         Default->WordErrorRate <= Widest.WordErrorRate + MaxWordErrorRateLoss);
+	return true;
+}
+
+#endif
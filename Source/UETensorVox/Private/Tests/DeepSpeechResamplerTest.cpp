@@ -0,0 +1,35 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "Misc/AutomationTest.h"
+#include "DeepSpeechBenchmarks.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeepSpeechResamplerTest, "TensorVox.Resampler",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FDeepSpeechResamplerTest::RunTest(const FString& Parameters)
+{
+	// 22050 hz snaps its 320 phases to 256 and comes out around 60 dB, the others around 80.
+	const double MinSnr = 50.0;
+	// Better than the lerp by this much, which manages 5 to 20 dB.
+	const double MinSnrGain = 20.0;
+	// Converting on the reading thread shouldn't take more than a twentieth of a core, even in debug builds.
+	const double MinRealTimeMultiple = 20.0;
+
+	for (const int32 InputRate : {8000, 22050, 44100, 48000})
+	{
+		const DeepSpeechBenchmarks::FResamplerMeasurement Measurement = DeepSpeechBenchmarks::MeasureResampler(InputRate, 16000, 2);
+		AddInfo(FString::Printf(TEXT("%i -> %i hz, %s kernel: SNR %.1f dB (lerp %.1f dB), %.1f Msamples/s."), InputRate, Measurement.OutputRate,
+		                        Measurement.KernelName, Measurement.Snr, Measurement.LerpSnr, Measurement.SamplesPerSecond / 1e6));
+
+		TestTrue(FString::Printf(TEXT("%i hz SNR of %.1f dB is at least %.0f dB"), InputRate, Measurement.Snr, MinSnr), Measurement.Snr >= MinSnr);
+		TestTrue(FString::Printf(TEXT("%i hz SNR of %.1f dB beats the lerp's %.1f dB by %.0f dB"), InputRate, Measurement.Snr, Measurement.LerpSnr, MinSnrGain),
+		         Measurement.Snr >= Measurement.LerpSnr + MinSnrGain);
+		TestTrue(FString::Printf(TEXT("%i hz converts %.0fx faster than real time, at least %.0fx"), InputRate, Measurement.SamplesPerSecond / InputRate,
+		                         MinRealTimeMultiple), Measurement.SamplesPerSecond >= InputRate * MinRealTimeMultiple);
+	}
+	return true;
+}
+
+#endif
@@ -0,0 +1,75 @@
+// Copyright SIA Chemical Heads 2022
+
+#include "Misc/AutomationTest.h"
+#include "HAL/IConsoleManager.h"
+#include "DeepSpeechBenchmarks.h"
+#include "DeepSpeechTestData.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	// Sets a console variable for as long as it's in scope.
+	class FScopedConsoleVariable
+	{
+	public:
+		FScopedConsoleVariable(const TCHAR* Name, const TCHAR* Value)
+			: Variable(IConsoleManager::Get().FindConsoleVariable(Name))
+		{
+			check(Variable);
+			Previous = Variable->GetString();
+			Variable->Set(Value, ECVF_SetByCode);
+		}
+
+		~FScopedConsoleVariable()
+		{
+			Variable->Set(*Previous, ECVF_SetByCode);
+		}
+
+	private:
+		IConsoleVariable* Variable;
+		FString Previous;
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FDeepSpeechStreamServiceAdmissionTest, "TensorVox.StreamService.Admission",
+                                 EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FDeepSpeechStreamServiceAdmissionTest::RunTest(const FString& Parameters)
+{
+	FDeepSpeechConfiguration Config;
+	TArray<FString> Files;
+	if (!DeepSpeechTestData::Get(*this, Config, Files))
+	{
+		return true;
+	}
+
+	const int32 NumStreams = 64;
+	const int32 MaxStreams = 48;
+	const double Seconds = 20.0;
+
+	// Only the stream cap may turn anyone away, how busy the machine running the test is can't change the counts. The finalization queue
+	// still has to be compared against its size: against the deepest it's been, which is 0 in a fresh process, every stream was refused.
+	const FScopedConsoleVariable MaxStreamsOverride(TEXT("TensorVox.Service.MaxStreams"), *LexToString(MaxStreams));
+	const FScopedConsoleVariable MaxUtilizationOverride(TEXT("TensorVox.Service.MaxUtilization"), TEXT("1"));
+	const FScopedConsoleVariable MaxLagOverride(TEXT("TensorVox.Service.MaxLagSeconds"), TEXT("1000"));
+	const FScopedConsoleVariable QueueSizeOverride(TEXT("TensorVox.FinalizeQueueSize"), *LexToString(NumStreams));
+
+	AddExpectedError(TEXT("turned a new stream away: too many streams"), EAutomationExpectedErrorFlags::Contains, NumStreams - MaxStreams);
+
+	DeepSpeechBenchmarks::FServerReport Report;
+	if (!TestTrue(TEXT("Model and audio loaded"), DeepSpeechBenchmarks::MeasureServer(Config, Files, NumStreams, Seconds, Report)))
+	{
+		return true;
+	}
+
+	AddInfo(FString::Printf(TEXT("%i of %i streams admitted, %i turned away, utilization %.0f%% (peak %.0f%%), %i finals, p95 lag %.1f ms."),
+	                        Report.NumAdmitted, NumStreams, Report.NumRejected, Report.Utilization * 100.0f, Report.PeakUtilization * 100.0f,
+	                        Report.NumFinals, DeepSpeechBenchmarks::Percentile(Report.LagMs, 0.95)));
+
+	TestEqual(TEXT("Streams admitted"), Report.NumAdmitted, MaxStreams);
+	TestEqual(TEXT("Streams turned away"), Report.NumRejected, NumStreams - MaxStreams);
+	return true;
+}
+
+#endif
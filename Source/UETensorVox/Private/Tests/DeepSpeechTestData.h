@@ -0,0 +1,42 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "DeepSpeechBatchTranscriber.h"
+#include "DeepSpeechConfiguration.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace DeepSpeechTestData
+{
+	/**
+	 * The model and reference utterances the pipeline tests run against, from -TensorVoxTestModel=, -TensorVoxTestScorer= and
+	 * -TensorVoxTestCorpus= on the command line. Paths are relative to the project's content directory like any configuration's, the corpus is
+	 * a directory or manifest like the benchmarks take.
+	 * @return false if none was given, with a warning so the test is skipped rather than passed, or if the corpus has no utterances.
+	 */
+	inline bool Get(FAutomationTestBase& Test, FDeepSpeechConfiguration& OutConfig, TArray<FString>& OutFiles)
+	{
+		FString Corpus;
+		if (!FParse::Value(FCommandLine::Get(), TEXT("TensorVoxTestModel="), OutConfig.ModelPath) ||
+			!FParse::Value(FCommandLine::Get(), TEXT("TensorVoxTestCorpus="), Corpus))
+		{
+			Test.AddWarning(TEXT("No model or corpus to test with, pass -TensorVoxTestModel= and -TensorVoxTestCorpus=."));
+			return false;
+		}
+		FParse::Value(FCommandLine::Get(), TEXT("TensorVoxTestScorer="), OutConfig.ScorerPath);
+
+		if (!FDeepSpeechBatchTranscriber::GatherFiles(Corpus, OutFiles) || OutFiles.Num() == 0)
+		{
+			Test.AddError(FString::Printf(TEXT("No reference utterances in %s."), *Corpus));
+			return false;
+		}
+		return true;
+	}
+}
+
+#endif
@@ -1,89 +1,183 @@
 // Copyright SIA Chemical Heads 2022
 
 #include "UETensorVox.h"
+#include "DeepSpeechSessionManager.h"
+#include "DeepSpeechModelRegistry.h"
+#include "DeepSpeechCaptureWriter.h"
+#include "DeepSpeechStats.h"
+#include "DeepSpeechCpuFeatures.h"
+#include "DeepSpeechSimd.h"
 #include "Core.h"
 #include "Modules/ModuleManager.h"
-#include "deepspeech.h"
+#include "DeepSpeechLibrary.h"
 #include "Interfaces/IPluginManager.h"
-
+#include <atomic>
 
 #define LOCTEXT_NAMESPACE "FUETensorVoxModule"
 
 DEFINE_LOG_CATEGORY(LogUETensorVox);
 
+static std::atomic<bool> GTensorVoxLibraryLoaded(false);
+
+struct FDeepSpeechLibraryVariant
+{
+	// Next to the stock library, which is the one with an empty directory.
+	const TCHAR* Directory;
+	EDeepSpeechCpuLevel RequiredLevel;
+};
+
+// Best first. The stock TensorFlow build needs AVX on x86.
+static const FDeepSpeechLibraryVariant LibraryVariants[] =
+{
+	{TEXT("avx512"), EDeepSpeechCpuLevel::Avx512},
+	{TEXT("avx2"), EDeepSpeechCpuLevel::Avx2},
+	{TEXT(""), PLATFORM_CPU_X86_FAMILY ? EDeepSpeechCpuLevel::Avx : EDeepSpeechCpuLevel::Generic},
+	{TEXT("sse4.1"), EDeepSpeechCpuLevel::Sse41},
+};
+
+#if TENSORVOX_BIND_LIBRARY_AT_RUNTIME
+FDeepSpeechLibraryFunctions GDeepSpeechLibrary;
+
+bool BindDeepSpeechLibrary(void* Handle)
+{
+	FDeepSpeechLibraryFunctions Bound;
+#define TENSORVOX_BIND_LIBRARY_FUNCTION(Name) \
+	Bound.Name = (decltype(Bound.Name))FPlatformProcess::GetDllExport(Handle, TEXT("DS_") TEXT(#Name)); \
+	if (!Bound.Name) \
+	{ \
+		UE_LOG(LogUETensorVox, Error, TEXT("The DeepSpeech library doesn't export DS_%s."), TEXT(#Name)); \
+		return false; \
+	}
+	TENSORVOX_LIBRARY_FUNCTIONS(TENSORVOX_BIND_LIBRARY_FUNCTION)
+#undef TENSORVOX_BIND_LIBRARY_FUNCTION
+
+	GDeepSpeechLibrary = Bound;
+	return true;
+}
+#endif
+
+/**
+ * The builds to try, best first. The stock one is always last, even if the CPU is below what it was built for: a build that may not run is
+ * better than none at all.
+ */
+static TArray<FString> FindLibraries(const FString& PlatformDirectory, EDeepSpeechCpuLevel Level)
+{
+	TArray<FString> Paths;
+	bool bHasStock = false;
+	for (const FDeepSpeechLibraryVariant& Variant : LibraryVariants)
+	{
+		const FString Path = FPaths::Combine(PlatformDirectory, Variant.Directory, TEXT("libdeepspeech.so"));
+		if (Level >= Variant.RequiredLevel && FPaths::FileExists(Path))
+		{
+			Paths.Add(Path);
+			bHasStock |= *Variant.Directory == TEXT('\0');
+		}
+	}
+
+	if (!bHasStock)
+	{
+		UE_LOG(LogUETensorVox, Warning, TEXT("The stock DeepSpeech build in %s is missing or isn't meant for a %s CPU, trying it last anyway."), *PlatformDirectory,
+		       LexToString(Level));
+		Paths.Add(FPaths::Combine(PlatformDirectory, TEXT("libdeepspeech.so")));
+	}
+	return Paths;
+}
+
 void FUETensorVoxModule::StartupModule()
 {
-#if TENSORVOX_VALID_PLATFORM
-	if (CanRunTranscriber())
+	ModelRegistry = new FDeepSpeechModelRegistry();
+	SessionManager = new FDeepSpeechSessionManager();
+	CaptureWriter = new FDeepSpeechCaptureWriter();
+
+	StatsTickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([this](float DeltaTime)
 	{
-		
-		FString BinaryFullPath = FPaths::Combine(IPluginManager::Get().FindPlugin("UETensorVox")->GetBaseDir(),
-			TEXT("Binaries"), TEXT("ThirdParty"));
+		SessionManager->GetLoadGovernor().Tick(DeltaTime, SessionManager->GetBusyCycles(), SessionManager->GetNumWorkers());
+		FDeepSpeechPipelineStats::Publish(*SessionManager);
+		return true;
+	}));
+
+#if TENSORVOX_VALID_PLATFORM
+	const FDeepSpeechCpuFeatures& Cpu = FDeepSpeechCpuFeatures::Get();
+	UE_LOG(LogUETensorVox, Log, TEXT("CPU level %s (SSE4.1 %i, AVX %i, AVX2 %i, FMA %i, AVX-512 %i), plugin kernels use %s."), LexToString(Cpu.GetLevel()),
+	       Cpu.bSse41, Cpu.bAvx, Cpu.bAvx2, Cpu.bFma, Cpu.bAvx512, DeepSpeechSimd::LexToString(DeepSpeechSimd::GetBestKernel()));
+
+	FString BinaryFullPath = FPaths::Combine(IPluginManager::Get().FindPlugin("UETensorVox")->GetBaseDir(),
+		TEXT("Binaries"), TEXT("ThirdParty"));
 
 #if PLATFORM_WINDOWS
-		BinaryFullPath = FPaths::Combine(BinaryFullPath, TEXT("Win64"));
+	BinaryFullPath = FPaths::Combine(BinaryFullPath, TEXT("Win64"));
 #elif PLATFORM_LINUX
-		BinaryFullPath = FPaths::Combine(BinaryPath, TEXT("Linux64"));
+	BinaryFullPath = FPaths::Combine(BinaryFullPath, TEXT("Linux64"));
 #elif PLATFORM_APPLE
-		BinaryFullPath = FPaths::Combine(BinaryPath, TEXT("Apple64"));
+	BinaryFullPath = FPaths::Combine(BinaryFullPath, TEXT("Apple64"));
 #endif
 
-		DeepSpeechHandle = FPlatformProcess::GetDllHandle(*FPaths::Combine(BinaryFullPath, TEXT("libdeepspeech.so")));
-		if (DeepSpeechHandle)
+	for (const FString& LibraryPath : FindLibraries(BinaryFullPath, Cpu.GetLevel()))
+	{
+		DeepSpeechHandle = FPlatformProcess::GetDllHandle(*LibraryPath);
+		if (!DeepSpeechHandle)
 		{
-			char* VersionBuffer = DS_Version();
-			UE_LOG(LogUETensorVox, Log, TEXT("Successfully loaded Mozilla's DeepSpeech library %s."), *FString(VersionBuffer));
-			DS_FreeString(VersionBuffer);
+			UE_LOG(LogUETensorVox, Warning, TEXT("Failed to load Mozilla's DeepSpeech library %s."), *LibraryPath);
+			continue;
 		}
-		else
+
+#if TENSORVOX_BIND_LIBRARY_AT_RUNTIME
+		if (!BindDeepSpeechLibrary(DeepSpeechHandle))
 		{
-			UE_LOG(LogUETensorVox, Error, TEXT("Failed to load Mozilla's DeepSpeech library."));
+			FPlatformProcess::FreeDllHandle(DeepSpeechHandle);
+			DeepSpeechHandle = nullptr;
+			continue;
 		}
+#endif
+
+		char* VersionBuffer = DS_Version();
+		UE_LOG(LogUETensorVox, Log, TEXT("Successfully loaded Mozilla's DeepSpeech library %s from %s."), *FString(VersionBuffer), *LibraryPath);
+		DS_FreeString(VersionBuffer);
+		GTensorVoxLibraryLoaded = true;
+		break;
+	}
+
+	if (!DeepSpeechHandle)
+	{
+		UE_LOG(LogUETensorVox, Error, TEXT("None of the DeepSpeech libraries in %s could be loaded, transcription is disabled."), *BinaryFullPath);
 	}
 #endif
 }
 
 void FUETensorVoxModule::ShutdownModule()
 {
+	FTSTicker::GetCoreTicker().RemoveTicker(StatsTickerHandle);
+
+	// Sessions use the library, so they have to go first.
+	delete SessionManager;
+	SessionManager = nullptr;
+
+	// After the sessions, whose last utterances may still be on their way to disk.
+	delete CaptureWriter;
+	CaptureWriter = nullptr;
+
+	// Every session let go of its model by now, this frees the idle ones.
+	delete ModelRegistry;
+	ModelRegistry = nullptr;
+
 #if TENSORVOX_VALID_PLATFORM
 	if (DeepSpeechHandle)
 	{
+		GTensorVoxLibraryLoaded = false;
 		FPlatformProcess::FreeDllHandle(DeepSpeechHandle);
+		DeepSpeechHandle = nullptr;
 	}
 #endif
 }
 
-
-bool* GGlobalHasAVX = nullptr;
+bool FUETensorVoxModule::CanRunTranscriber()
+{
+	return GTensorVoxLibraryLoaded;
+}
 
 bool FUETensorVoxModule::HasAvx()
 {
-	// I wanted to use FPlatformMisc here instead but we don't have access to the full cpuId array in any of those functions.
-	// https://stackoverflow.com/questions/6121792/how-to-check-if-a-cpu-supports-the-sse3-instruction-set
-#if PLATFORM_HAS_CPUID && !PLATFORM_UNIX
-	if (GGlobalHasAVX == nullptr)
-	{
-		int CpuInfo[4];
-		__cpuid(CpuInfo, 1);
-
-		const bool bOsUsesXSAVE_XRSTORE = CpuInfo[2] & (1 << 27);
-		const bool bCpuAVXSuport = CpuInfo[2] & (1 << 28);
-		bool bAVXSupported = false;
-		if (bOsUsesXSAVE_XRSTORE && bCpuAVXSuport)
-		{
-			uint64 xcrFeatureMask = _xgetbv(_XCR_XFEATURE_ENABLED_MASK);
-			bAVXSupported = (xcrFeatureMask & 0x6) == 0x6;
-		}
-		// Cache the result.
-		GGlobalHasAVX = new bool(bAVXSupported);
-		return bAVXSupported;
-	}
-	else
-	{
-		return *GGlobalHasAVX;
-	}
-#endif
-	return false;
+	return FDeepSpeechCpuFeatures::Get().bAvx;
 }
 
 #undef LOCTEXT_NAMESPACE
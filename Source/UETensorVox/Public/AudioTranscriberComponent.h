@@ -2,10 +2,20 @@
 
 #include "CoreMinimal.h"
 #include "DeepSpeechConfiguration.h"
+#include "DeepSpeechUtteranceTimings.h"
+#include "DeepSpeechTranscriptionResult.h"
+#include "DeepSpeechResultMailbox.h"
 #include "Components/ActorComponent.h"
 #include "AudioTranscriberComponent.generated.h"
 
+class FDeepSpeechTranscriptionSession;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_ThreeParams(FAudioTranscriptionEvent, FString, Transcribed, bool, bFinalTranscription, int32, TranscriptionId);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FUtteranceTimingsEvent, const FDeepSpeechUtteranceTimings&, Timings);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FAudioCommandEvent, const FDeepSpeechCommandMatch&, Match);
+DECLARE_MULTICAST_DELEGATE_OneParam(FTranscriptionResultEvent, const FDeepSpeechResultPtr& /*Result*/);
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FNativeAudioTranscriptionEvent, const FString& /*Transcribed*/, bool /*bFinal*/,
+                                       const FDeepSpeechUtteranceTimings& /*Timings*/);
 
 UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent), meta=(DisplayName="DeepSpeech Audio Transcriber"))
 class UETENSORVOX_API UAudioTranscriberComponent : public UActorComponent
@@ -21,11 +31,34 @@ public:
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	
-	virtual void PushTranscribeResult(const FString& TrancribedResult, bool bFinal = false);
+	virtual void PushTranscribeResult(const FString& TrancribedResult, bool bFinal = false, int32 TranscriptionId = 0);
+
+	/** Called on the game thread once per finished utterance, with its delivery time filled in. */
+	virtual void PushUtteranceTimings(const FDeepSpeechUtteranceTimings& Timings);
 	
 	virtual void StartRealtimeTranscription();
 
 	virtual void EndRealtimeTranscription();
+
+	/** Replaces the words transcription favours, by boost (10 is a strong push). Applies from the next utterance on. */
+	UFUNCTION(Category="DeepSpeech Audio Transcriber", BlueprintCallable)
+	void SetHotWords(const TMap<FString, float>& InHotWords);
+
+	UFUNCTION(Category="DeepSpeech Audio Transcriber", BlueprintCallable)
+	void AddHotWord(const FString& Word, float Boost);
+
+	UFUNCTION(Category="DeepSpeech Audio Transcriber", BlueprintCallable)
+	void RemoveHotWord(const FString& Word);
+
+	UFUNCTION(Category="DeepSpeech Audio Transcriber", BlueprintCallable)
+	void ClearHotWords();
+
+	/**
+	 * Replaces the voice commands listened for, command by phrase. Phrases are spotted while they're spoken and fire OnCommand well
+	 * ahead of the final transcription. Applies from the next utterance on.
+	 */
+	UFUNCTION(Category="DeepSpeech Audio Transcriber", BlueprintCallable)
+	void SetCommands(const TMap<FString, FName>& InPhrasesToCommands);
 public:
 
 	UPROPERTY(Category="DeepSpeech Audio Transcriber", BlueprintReadOnly, EditAnywhere)
@@ -33,13 +66,60 @@ public:
 
 	UPROPERTY(Category="DeepSpeech Audio Transcriber",BlueprintAssignable)
 	FAudioTranscriptionEvent OnAudioTranscribed;
+
+	/** A command of SetCommands heard, as soon as the words are stable in the intermediate transcriptions. */
+	UPROPERTY(Category="DeepSpeech Audio Transcriber",BlueprintAssignable)
+	FAudioCommandEvent OnCommand;
+
+	/** Where the time of every finished utterance went, capture to this event. */
+	UPROPERTY(Category="DeepSpeech Audio Transcriber",BlueprintAssignable)
+	FUtteranceTimingsEvent OnUtteranceTimings;
+
+	UPROPERTY(Category="DeepSpeech Audio Transcriber", BlueprintReadOnly, VisibleAnywhere, Transient)
+	FDeepSpeechUtteranceTimings LastUtteranceTimings;
+
+	/**
+	 * Every intermediate and final transcription with its candidates and token timings, on the game thread. Bind before the session
+	 * opens (on the first tick) for the session to decode with metadata. Results are pooled, hold on to them only as long as needed.
+	 */
+	FTranscriptionResultEvent OnTranscriptionResult;
+
+	/**
+	 * Every intermediate and final transcription as soon as it's decoded, on the worker that decoded it, for code that can't wait for the
+	 * next tick. Unlike OnAudioTranscribed no partial is skipped. Bind before the session opens (on the first tick), the session keeps a
+	 * copy, and don't block in it: the worker is decoding other sessions too.
+	 */
+	FNativeAudioTranscriptionEvent OnAudioTranscribedNative;
 	
 protected:
 	virtual bool CanLoadModel();
 
-	static void CreateTranscriptionThread(UAudioTranscriberComponent* TranscriberComponent);
-	static void DestroyTranscriptionThread(UAudioTranscriberComponent* TranscriberComponent);
-	static void NotifyTranscriptionThread();
+	/** Opens this component's transcription session if it isn't open yet. */
+	void CreateTranscriptionSession();
+	void DestroyTranscriptionSession();
+
+	/** Hands HotWords to the session if they changed, once per tick however often they were edited. */
+	void PushHotWords();
+
+	/** Hands the commands to the session if they changed, compiled once per tick. */
+	void PushCommands();
+
+	/** Broadcasts what the session posted since the last tick: every final, and the newest partial if its utterance isn't final yet. */
+	void DeliverResults();
+
+	UPROPERTY(Category="DeepSpeech Audio Transcriber", VisibleAnywhere, Transient)
+	TMap<FString, float> HotWords;
+	bool bHotWordsDirty = false;
+
+	UPROPERTY(Category="DeepSpeech Audio Transcriber", VisibleAnywhere, Transient)
+	TMap<FString, FName> PhrasesToCommands;
+	bool bCommandsDirty = false;
+
+	/** This component's own capture, VAD and stream, ticked by the session manager's workers. */
+	TSharedPtr<FDeepSpeechTranscriptionSession, ESPMode::ThreadSafe> TranscriptionSession;
+
+	/** Where the session's workers leave results for DeliverResults, outlives the component as long as the session does. */
+	FDeepSpeechResultMailboxPtr ResultMailbox;
 
 
 	FString TranscribedResult;
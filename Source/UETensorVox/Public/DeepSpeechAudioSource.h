@@ -0,0 +1,213 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Math/RandomStream.h"
+#include "DeepSpeechFrontEnd.h"
+#include <atomic>
+
+/** Receives blocks from an audio source, on the source's own thread, laid out as the source's GetFrameLayout says. */
+class UETENSORVOX_API IDeepSpeechAudioSink
+{
+public:
+	virtual ~IDeepSpeechAudioSink() {}
+
+	/** NumFrames interleaved frames. Must not block or allocate, it runs on realtime device threads. */
+	virtual void OnAudioCaptured(const void* Frames, int32 NumFrames, bool bDeviceOverflow) = 0;
+
+	/** How many frames the next OnAudioCaptured can take without dropping any. */
+	virtual int32 GetNumFreeFrames() const = 0;
+};
+
+/**
+ * Where a FDeepSpeechMicrophoneRecorder gets its audio from: the capture device, a file or a generator.
+ * Open picks the sample rate, Start begins pushing blocks to the sink from the source's thread until Stop.
+ */
+class UETENSORVOX_API IDeepSpeechAudioSource
+{
+public:
+	virtual ~IDeepSpeechAudioSource() {}
+
+	/** Prepares the source, preferring PreferredSampleRate. Blocks are around BlockSize samples. */
+	virtual bool Open(int32 PreferredSampleRate, int32 BlockSize) = 0;
+	virtual bool Start(IDeepSpeechAudioSink& Sink) = 0;
+	virtual void Stop() = 0;
+
+	/** The rate blocks come in at, valid after Open. */
+	virtual int32 GetSampleRate() const = 0;
+
+	/**
+	 * How the frames of its blocks are laid out, and how the recorder's front end turns them into mono on the reading thread, valid after
+	 * Open. Mono int16 taken as is unless the source says otherwise.
+	 */
+	virtual FDeepSpeechFrontEndSettings GetFrameLayout() const { return FDeepSpeechFrontEndSettings(); }
+
+	/** True once a finite source delivered everything it had. */
+	virtual bool IsFinished() const { return false; }
+
+	virtual const TCHAR* GetName() const = 0;
+};
+
+typedef TFunction<TUniquePtr<IDeepSpeechAudioSource>()> FDeepSpeechAudioSourceFactory;
+
+/** How a FDeepSpeechPacedAudioSource hands out its blocks. */
+struct UETENSORVOX_API FDeepSpeechAudioPacing
+{
+	// 1 is real time, 2 twice as fast... 0 is as fast as the sink takes it, without ever dropping samples.
+	float Speed = 1.0f;
+	// Every block is late by a random amount up to this, so blocks arrive in bursts like they do from a real device.
+	float JitterSeconds = 0.0f;
+	// Blocks are BlockSize give or take this fraction.
+	float BlockSizeVariation = 0.0f;
+	// Seeds the jitter and block sizes, and synthetic sources, so runs repeat exactly.
+	int32 Seed = 0;
+};
+
+/**
+ * Base for sources that produce their audio in software. Runs its own thread that delivers blocks on a schedule, or as fast as
+ * the sink keeps up when unthrottled.
+ */
+class UETENSORVOX_API FDeepSpeechPacedAudioSource : public IDeepSpeechAudioSource, public FRunnable
+{
+public:
+	explicit FDeepSpeechPacedAudioSource(const FDeepSpeechAudioPacing& InPacing);
+	virtual ~FDeepSpeechPacedAudioSource() override;
+
+	virtual bool Open(int32 PreferredSampleRate, int32 BlockSize) override;
+	virtual bool Start(IDeepSpeechAudioSink& InSink) override;
+	virtual void Stop() override;
+	virtual int32 GetSampleRate() const override { return SampleRate; }
+	virtual bool IsFinished() const override { return bFinished; }
+
+	// FRunnable
+	virtual uint32 Run() override;
+
+protected:
+	/** Picks the rate the audio is generated at. */
+	virtual int32 OpenSource(int32 PreferredSampleRate) = 0;
+
+	/**
+	 * Fills up to NumSamples of OutSamples.
+	 * @return The number of samples produced, 0 once there's nothing left.
+	 */
+	virtual int32 Generate(int16* OutSamples, int32 NumSamples) = 0;
+
+	FDeepSpeechAudioPacing Pacing;
+	FRandomStream Random;
+	int32 SampleRate;
+
+private:
+	int32 BlockSize;
+	TArray<int16> Block;
+	IDeepSpeechAudioSink* Sink;
+	FRunnableThread* Thread;
+	std::atomic<bool> bRunning;
+	std::atomic<bool> bFinished;
+};
+
+/**
+ * Plays a 16 bit PCM WAV, or headerless 16 bit mono PCM at RawSampleRate, at its own sample rate.
+ */
+class UETENSORVOX_API FDeepSpeechFileAudioSource : public FDeepSpeechPacedAudioSource
+{
+public:
+	FDeepSpeechFileAudioSource(const FString& InPath, const FDeepSpeechAudioPacing& InPacing, bool bInLoop = false, int32 InRawSampleRate = 16000);
+	// The pacing thread calls Generate, it has to be stopped before we're gone.
+	virtual ~FDeepSpeechFileAudioSource() override { Stop(); }
+
+	virtual const TCHAR* GetName() const override { return TEXT("File"); }
+
+protected:
+	virtual int32 OpenSource(int32 PreferredSampleRate) override;
+	virtual int32 Generate(int16* OutSamples, int32 NumSamples) override;
+
+private:
+	FString Path;
+	bool bLoop;
+	int32 RawSampleRate;
+	TArray<int16> Samples;
+	int32 Position;
+};
+
+/**
+ * Speech shaped test signal: voiced bursts (a pitch with formant like harmonics) separated by pauses over a low noise floor.
+ * Fully determined by the pacing seed.
+ */
+class UETENSORVOX_API FDeepSpeechSyntheticAudioSource : public FDeepSpeechPacedAudioSource
+{
+public:
+	explicit FDeepSpeechSyntheticAudioSource(const FDeepSpeechAudioPacing& InPacing, int32 InSampleRate = 0, float InDurationSeconds = 0.0f);
+	virtual ~FDeepSpeechSyntheticAudioSource() override { Stop(); }
+
+	virtual const TCHAR* GetName() const override { return TEXT("Synthetic"); }
+
+protected:
+	virtual int32 OpenSource(int32 PreferredSampleRate) override;
+	virtual int32 Generate(int16* OutSamples, int32 NumSamples) override;
+
+private:
+	int32 FixedSampleRate;
+	float DurationSeconds;
+	int64 NumGenerated;
+
+	bool bVoiced;
+	int32 SegmentLength;
+	int32 SegmentRemaining;
+	float Pitch;
+	double Phase;
+};
+
+/**
+ * Audio handed over from code, such as decoded voice chat packets on a server. Blocks are forwarded to the recorder as they're
+ * pushed, on the pushing thread, so there's no thread of its own. Whoever pushes shares the source with the session's recorder,
+ * which gets a proxy from CreateProxy.
+ */
+class UETENSORVOX_API FDeepSpeechPushAudioSource : public IDeepSpeechAudioSource
+{
+public:
+	explicit FDeepSpeechPushAudioSource(int32 InSampleRate);
+
+	virtual bool Open(int32 PreferredSampleRate, int32 BlockSize) override { return true; }
+	virtual bool Start(IDeepSpeechAudioSink& InSink) override;
+	virtual void Stop() override;
+	virtual int32 GetSampleRate() const override { return SampleRate; }
+	virtual const TCHAR* GetName() const override { return TEXT("Push"); }
+
+	/**
+	 * Thread safe, pushes from several threads are serialized. Audio pushed while the session isn't recording is thrown away, and
+	 * whatever doesn't fit in the capture buffer is dropped and counted as an overflow.
+	 */
+	void PushAudio(const int16* Samples, int32 NumSamples);
+
+	/** Samples handed to the recorder since it last started. */
+	int64 GetNumDelivered() const { return NumDelivered.load(std::memory_order_relaxed); }
+
+	/** A source for the session's recorder that starts and stops Shared. */
+	static TUniquePtr<IDeepSpeechAudioSource> CreateProxy(const TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe>& Shared);
+
+private:
+	const int32 SampleRate;
+	FCriticalSection SinkCritical;
+	IDeepSpeechAudioSink* Sink;
+	std::atomic<int64> NumDelivered;
+};
+
+struct UETENSORVOX_API FDeepSpeechAudioSources
+{
+	/** The capture device, nullptr where RtAudio isn't available. */
+	static TUniquePtr<IDeepSpeechAudioSource> CreateCapture();
+
+	/**
+	 * What sessions record from when they're not given a factory. Normally the capture device, TensorVox.AudioSource swaps it for a file
+	 * or generator so the whole pipeline can run without a microphone.
+	 */
+	static TUniquePtr<IDeepSpeechAudioSource> CreateDefault();
+
+	/** The pacing set through the TensorVox.AudioSource.* console variables. */
+	static FDeepSpeechAudioPacing GetDefaultPacing();
+
+	/** How the capture device's channels become one, set through the TensorVox.Input.* console variables. */
+	static FDeepSpeechFrontEndSettings GetCaptureFrontEnd(int32 NumChannels, EDeepSpeechSampleFormat Format);
+};
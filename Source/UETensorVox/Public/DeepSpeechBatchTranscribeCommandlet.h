@@ -0,0 +1,23 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "DeepSpeechBatchTranscribeCommandlet.generated.h"
+
+/**
+ * Transcribes a directory or manifest of WAV files with FDeepSpeechBatchTranscriber.
+ * -run=DeepSpeechBatchTranscribe -Input=<directory or manifest> -Output=<results .json or .csv> -Model=<content relative path>
+ *     [-Scorer=<content relative path>] [-BeamWidth=N] [-Alpha=A -Beta=B] [-Threads=N]
+ */
+UCLASS()
+class UETENSORVOX_API UDeepSpeechBatchTranscribeCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UDeepSpeechBatchTranscribeCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
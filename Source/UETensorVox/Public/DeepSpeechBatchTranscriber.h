@@ -0,0 +1,83 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechConfiguration.h"
+#include "DeepSpeechModel.h"
+
+/** A word of a batch result, put together from DeepSpeech's per character tokens. */
+struct UETENSORVOX_API FDeepSpeechBatchWord
+{
+	FString Text;
+	float StartTime = 0.0f;
+	float EndTime = 0.0f;
+};
+
+struct UETENSORVOX_API FDeepSpeechBatchResult
+{
+	FString File;
+	FString Transcript;
+	TArray<FDeepSpeechBatchWord> Words;
+	double Confidence = 0.0;
+	double AudioSeconds = 0.0;
+	// Time spent loading, resampling and transcribing the file on its thread.
+	double ProcessSeconds = 0.0;
+	// Empty if the file was transcribed.
+	FString Error;
+};
+
+struct UETENSORVOX_API FDeepSpeechBatchReport
+{
+	TArray<FDeepSpeechBatchResult> Results;
+	double AudioSeconds = 0.0;
+	double ProcessSeconds = 0.0;
+	double WallSeconds = 0.0;
+	int32 NumThreads = 0;
+	int32 NumFailed = 0;
+
+	/** Hours of audio transcribed per hour of wall clock, the batch throughput. */
+	double GetAudioHoursPerWallHour() const { return WallSeconds > 0.0 ? AudioSeconds / WallSeconds : 0.0; }
+
+	/** Processing time per second of audio on a single thread, below 1 is faster than real time. */
+	double GetRealTimeFactor() const { return AudioSeconds > 0.0 ? ProcessSeconds / AudioSeconds : 0.0; }
+};
+
+/**
+ * Transcribes WAV files offline, spread over every core. All threads share one model through FDeepSpeechModelRegistry and each
+ * thread keeps its own buffers and resampler, with a DeepSpeech stream per file.
+ * Models loaded from .tflite serialize inference (see FDeepSpeechInferenceScope), only loading and resampling run in parallel with those.
+ */
+class UETENSORVOX_API FDeepSpeechBatchTranscriber
+{
+public:
+	explicit FDeepSpeechBatchTranscriber(const FDeepSpeechConfiguration& InConfig);
+
+	/**
+	 * Every .wav in a directory (recursively), or every line of a manifest file. Relative manifest entries are relative to the manifest.
+	 * @return false if the path doesn't exist.
+	 */
+	static bool GatherFiles(const FString& DirectoryOrManifest, TArray<FString>& OutFiles);
+
+	/** Reads a 16 bit PCM WAV, downmixes it to mono and resamples it to TargetSampleRate. */
+	static bool LoadWave(const FString& Path, int32 TargetSampleRate, TArray<int16>& OutSamples, double& OutSeconds, FString& OutError);
+
+	/**
+	 * Transcribes every file, blocking until all are done. Results are in the same order as Files.
+	 * @param NumThreads 0 uses every core.
+	 * @return false if the model couldn't be loaded.
+	 */
+	bool Run(const TArray<FString>& Files, FDeepSpeechBatchReport& OutReport, int32 NumThreads = 0);
+
+	static bool WriteJson(const FDeepSpeechBatchReport& Report, const FString& Path);
+	static bool WriteCsv(const FDeepSpeechBatchReport& Report, const FString& Path);
+
+private:
+	struct FThreadContext;
+
+	static bool LoadWave(FThreadContext& Context, const FString& Path, int32 TargetSampleRate, double& OutSeconds, FString& OutError);
+	void TranscribeFile(FThreadContext& Context, FDeepSpeechBatchResult& Result) const;
+
+	FDeepSpeechConfiguration Config;
+	FDeepSpeechModelPtr Model;
+};
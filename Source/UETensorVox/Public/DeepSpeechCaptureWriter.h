@@ -0,0 +1,131 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "Containers/Queue.h"
+#include <atomic>
+
+class FDeepSpeechCaptureWriter;
+class IFileHandle;
+
+/**
+ * Everything captured of one utterance: the audio fed to the model as <Session>_<Utterance>.wav, where the voice detector heard a voice as
+ * .lab segments next to it (the format TensorVox.Benchmark.Vad reads), and the final transcript as .txt. Filled in by the session's worker,
+ * written by the capture writer's thread.
+ */
+class UETENSORVOX_API FDeepSpeechCaptureUtterance
+{
+public:
+	FDeepSpeechCaptureUtterance(FDeepSpeechCaptureWriter& InWriter, const FString& InBasePath, int32 InSampleRate);
+
+	/** Session worker only. Buffers the frame, whole blocks are handed to the writer as they fill up. */
+	void AppendFrame(const int16* Samples, int32 NumSamples, bool bVoiced);
+
+	/** Session worker only. Hands over what's left and closes the audio, nothing can be appended after. */
+	void End();
+
+	/** Any thread. Written once the writer gets to it, which may be after End. */
+	void WriteTranscript(const FString& Transcript);
+
+	const FString& GetBasePath() const { return BasePath; }
+
+private:
+	void FlushBlock();
+
+	FDeepSpeechCaptureWriter& Writer;
+	const FString BasePath;
+	const int32 SampleRate;
+
+	TArray<uint8> Block;
+	int64 NumSamples;
+	// Start of the voiced segment in progress, in samples, INDEX_NONE between segments.
+	int64 VoicedStart;
+	FString Labels;
+	// Set once the writer had no room for a block, the rest of the utterance is skipped so the audio has no holes.
+	bool bTruncated;
+	bool bEnded;
+};
+
+typedef TSharedPtr<FDeepSpeechCaptureUtterance, ESPMode::ThreadSafe> FDeepSpeechCaptureUtterancePtr;
+
+/**
+ * Writes captured utterances to disk from a thread of its own, so capturing training and debug audio costs the session workers a copy.
+ * Audio is streamed to the file a block at a time as the utterance goes, with no more than TensorVox.Capture.MaxBufferedKilobytes waiting
+ * at once: utterances that would go over are cut short instead of stalling anyone. Opt in with TensorVox.Capture 1. Files go to
+ * Saved/TensorVoxCapture/<launch time>/, TensorVox.ImportCapture turns them into sound wave assets in the editor.
+ */
+class UETENSORVOX_API FDeepSpeechCaptureWriter
+{
+public:
+	FDeepSpeechCaptureWriter();
+	~FDeepSpeechCaptureWriter();
+
+	static FDeepSpeechCaptureWriter& Get();
+
+	/** Whether new utterances should be captured, TensorVox.Capture. */
+	static bool IsEnabled();
+
+	/** Starts capturing an utterance, the thread is started on first use. */
+	FDeepSpeechCaptureUtterancePtr BeginUtterance(int32 SessionId, int32 UtteranceId, int32 SampleRate);
+
+	/** Writes everything queued so far and joins the thread. */
+	void Shutdown();
+
+	int32 GetNumTruncated() const { return NumTruncated.load(std::memory_order_relaxed); }
+
+private:
+	friend class FDeepSpeechCaptureUtterance;
+
+	enum class ECommand : uint8
+	{
+		Open,
+		Write,
+		Close,
+		WriteText,
+	};
+
+	struct FCommand
+	{
+		ECommand Type = ECommand::Write;
+		FString Path;
+		int32 SampleRate = 0;
+		TArray<uint8> Data;
+	};
+
+	class FWriterThread : public FRunnable
+	{
+	public:
+		explicit FWriterThread(FDeepSpeechCaptureWriter& InWriter) : Writer(InWriter) {}
+		virtual uint32 Run() override;
+	private:
+		FDeepSpeechCaptureWriter& Writer;
+	};
+
+	/** False if Data doesn't fit in the buffer budget, nothing is queued then. */
+	bool TryQueueBlock(const FString& Path, TArray<uint8>&& Data);
+	void Queue(FCommand&& Command);
+	void Execute(FCommand& Command);
+
+	FString Directory;
+
+	// Filled by sessions and finalization workers, drained by the writer thread.
+	TQueue<FCommand, EQueueMode::Mpsc> Commands;
+	std::atomic<int64> NumBufferedBytes;
+	std::atomic<int32> NumTruncated;
+
+	FCriticalSection ThreadCritical;
+	TUniquePtr<FWriterThread> Runnable;
+	FRunnableThread* Thread;
+	FEvent* WorkEvent;
+	std::atomic<bool> bRunning;
+
+	// Writer thread only. Open wave files by path.
+	struct FOpenFile
+	{
+		IFileHandle* File = nullptr;
+		int32 SampleRate = 0;
+	};
+	TMap<FString, FOpenFile> OpenFiles;
+};
@@ -0,0 +1,140 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechCommandSpotter.generated.h"
+
+/** A command heard in an utterance, ahead of its final transcription. */
+USTRUCT(BlueprintType)
+struct UETENSORVOX_API FDeepSpeechCommandMatch
+{
+	GENERATED_BODY()
+public:
+	UPROPERTY(Category="DeepSpeech Command", BlueprintReadOnly, VisibleAnywhere)
+	FName Command;
+
+	/** The words it was heard as. */
+	UPROPERTY(Category="DeepSpeech Command", BlueprintReadOnly, VisibleAnywhere)
+	FString Heard;
+
+	/** Which utterance of its session it was heard in, as in FDeepSpeechUtteranceTimings::UtteranceId. */
+	UPROPERTY(Category="DeepSpeech Command", BlueprintReadOnly, VisibleAnywhere)
+	int32 UtteranceId = 0;
+
+	/** Fired on the first words only, no other command starting with them. */
+	UPROPERTY(Category="DeepSpeech Command", BlueprintReadOnly, VisibleAnywhere)
+	bool bPrefix = false;
+
+	/** Letters that had to change for the words heard to match the phrase. */
+	UPROPERTY(Category="DeepSpeech Command", BlueprintReadOnly, VisibleAnywhere)
+	int32 NumEdits = 0;
+
+	/** The newest voiced audio the command was decided on being captured to it firing. */
+	UPROPERTY(Category="DeepSpeech Command", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float TriggerMs = 0.0f;
+
+	// FPlatformTime::Seconds() it fired at.
+	double TriggerTime = 0.0;
+};
+
+/**
+ * Command phrases compiled into a trie over words, shared read only by every session spotting them. Phrases are matched on words the
+ * way DeepSpeech spells them: lower case, letters and apostrophes only. Several phrases may name the same command.
+ */
+class UETENSORVOX_API FDeepSpeechCommandGrammar
+{
+public:
+	struct FNode
+	{
+		// Children are Edges[FirstEdge, FirstEdge + NumEdges), sorted by word.
+		int32 FirstEdge = 0;
+		int32 NumEdges = 0;
+		// The command a phrase ending here names, NAME_None if none does.
+		FName Command;
+		// The only command phrases through here name, NAME_None if there are several.
+		FName OnlyCommand;
+	};
+
+	struct FEdge
+	{
+		FString Word;
+		int32 Node;
+	};
+
+	/** Compiles phrases by the command they name. Phrases without a word in them are left out. */
+	static TSharedRef<const FDeepSpeechCommandGrammar, ESPMode::ThreadSafe> Compile(const TMap<FString, FName>& PhrasesToCommands);
+
+	/** Splits text into words spelled like DeepSpeech's output. */
+	static void SplitWords(FStringView Text, TArray<FString>& OutWords);
+
+	const FNode& GetRoot() const { return Nodes[0]; }
+	const FNode& GetNode(int32 Index) const { return Nodes[Index]; }
+	TArrayView<const FEdge> GetEdges(const FNode& Node) const { return MakeArrayView(Edges.GetData() + Node.FirstEdge, Node.NumEdges); }
+	int32 GetNumPhrases() const { return NumPhrases; }
+
+private:
+	TArray<FNode> Nodes;
+	TArray<FEdge> Edges;
+	int32 NumPhrases = 0;
+};
+
+typedef TSharedPtr<const FDeepSpeechCommandGrammar, ESPMode::ThreadSafe> FDeepSpeechCommandGrammarPtr;
+
+DECLARE_DELEGATE_OneParam(FOnDeepSpeechCommand, const FDeepSpeechCommandMatch& /*Match*/);
+
+struct FDeepSpeechCommandSpotterSettings
+{
+	// Intermediate decodes in a row a word has to come out the same in before it's trusted.
+	int32 StabilityDecodes = 2;
+	// Share of a phrase word's letters a heard word may differ by and still match it.
+	float FuzzyTolerance = 0.0f;
+	// Fires as soon as the words so far lead to a single command, instead of waiting for its whole phrase.
+	bool bFireOnUniquePrefix = false;
+};
+
+/**
+ * Finds a grammar's commands in the intermediate hypotheses of one utterance at a time, so they fire while the speaker is still talking
+ * rather than once the stream is finished. Every hypothesis is split into words, and each word counts the decodes in a row it came out
+ * the same in. Only words that held for StabilityDecodes are walked through the trie, from every word after the last command heard.
+ * A phrase fires once its last word is stable and no longer phrase could still follow: its node has no children, or a stable word that
+ * doesn't continue it came after. Finish settles the rest on the last hypothesis, stable or not, when the utterance ends.
+ * Lives on the session's worker, nothing in it is thread safe.
+ */
+class UETENSORVOX_API FDeepSpeechCommandSpotter
+{
+public:
+	/** Starts a new utterance, a null grammar spots nothing. */
+	void Reset(const FDeepSpeechCommandGrammarPtr& InGrammar, const FDeepSpeechCommandSpotterSettings& InSettings);
+
+	/**
+	 * Matches the utterance's newest intermediate hypothesis, changed or not, unchanged ones make words stable.
+	 * @return The number of commands added to OutMatches.
+	 */
+	int32 OnHypothesis(FStringView Hypothesis, TArray<FDeepSpeechCommandMatch>& OutMatches);
+
+	/** The utterance ended, nothing follows the last hypothesis anymore. */
+	int32 Finish(TArray<FDeepSpeechCommandMatch>& OutMatches);
+
+	bool IsActive() const { return Grammar.IsValid(); }
+	int32 GetNumFired() const { return NumFired; }
+
+private:
+	int32 Match(bool bFinal, TArray<FDeepSpeechCommandMatch>& OutMatches);
+	/** The child of Node Word leads to, the closest one within the fuzzy tolerance, INDEX_NONE if none or two are as close. */
+	int32 FindChild(const FDeepSpeechCommandGrammar::FNode& Node, const FString& Word, int32& OutNumEdits) const;
+	void AddMatch(FName Command, int32 FirstWord, int32 EndWord, int32 NumEdits, bool bPrefix, TArray<FDeepSpeechCommandMatch>& OutMatches);
+
+	FDeepSpeechCommandGrammarPtr Grammar;
+	FDeepSpeechCommandSpotterSettings Settings;
+
+	TArray<FString> Words;
+	// Per word, the hypotheses in a row it came out the same in.
+	TArray<int32> WordAges;
+	TArray<FString> NewWords;
+	// Words before this were part of a command already fired.
+	int32 FirstUnmatchedWord = 0;
+	// Where the phrase a command fired on the first words of got to, the words that finish it are skipped.
+	int32 PrefixNode = INDEX_NONE;
+	int32 NumFired = 0;
+};
@@ -3,12 +3,32 @@
 #include "CoreMinimal.h"
 #include "DeepSpeechConfiguration.generated.h"
 
+/** Which voice activity detector decides what audio is fed to the model. */
+UENUM(BlueprintType)
+enum class EDeepSpeechVoiceDetector : uint8
+{
+	/** WebRTC's where the platform has it, the built in one everywhere else. */
+	Automatic,
+	/** WebRTC's GMM detector. Falls back to the built in one where WebRTC isn't available. */
+	WebRtc,
+	/** Energy, zero crossings and spectral flatness against an adaptive noise floor. Decides the same on every platform. */
+	Builtin,
+	/** Every frame is voice, everything heard while transcribing is fed. */
+	Off,
+};
+
 USTRUCT(BlueprintType)
 struct UETENSORVOX_API FDeepSpeechConfiguration
 {
 	GENERATED_BODY()
 public:
-	FDeepSpeechConfiguration() : BeamWidth(0), AsyncTickTranscriptionInterval(1.0)
+	FDeepSpeechConfiguration() : BeamWidth(0), AsyncTickTranscriptionInterval_DEPRECATED(1.0), CaptureBufferSeconds(2.0f), bPersistentCapture(false),
+	                             LookbackMilliseconds(200.0f), FeedIntervalMilliseconds(20.0f),
+	                             IntermediateDecodeIntervalMilliseconds(200.0f), IntermediateDecodeCpuBudget(0.25f), LeadPaddingMilliseconds(300.0f),
+	                             TrailPaddingMilliseconds(100.0f), NumCandidates(1), VoiceDetector(EDeepSpeechVoiceDetector::Automatic),
+	                             VoiceDetectorAggressiveness(0), bAutomaticEndpointing(false),
+	                             SpeechOnsetMilliseconds(60.0f), EndpointHangoverMilliseconds(300.0f), MaxUtteranceSeconds(15.0f), PreRollMilliseconds(250.0f),
+	                             CommandStabilityDecodes(2), CommandFuzzyTolerance(0.0f), bCommandsFireOnUniquePrefix(false), bEndUtteranceOnCommand(false)
 	{
 		ModelAlphaBeta = {INDEX_NONE, INDEX_NONE};
 	}
@@ -22,9 +42,114 @@ public:
 	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere)
 	FString ScorerPath;
 	
-	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere)
-	float AsyncTickTranscriptionInterval;
+	UPROPERTY(meta=(DeprecatedProperty, DeprecationMessage="Sessions are woken by the capture device now, see FeedIntervalMilliseconds."))
+	float AsyncTickTranscriptionInterval_DEPRECATED;
 	
 	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere)
 	FVector2D ModelAlphaBeta;
+
+	/**
+	 * Length of the preallocated capture ring buffer. Audio that arrives while the buffer is full is dropped and counted as an overflow.
+	 */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="0.1", Units="s"))
+	float CaptureBufferSeconds;
+
+	/**
+	 * Keeps the audio source open for as long as the session lives instead of opening it every time transcription starts, so starting is
+	 * instant and the first word isn't lost to the device starting up. The device and its callback keep running while nothing is transcribed.
+	 */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere)
+	bool bPersistentCapture;
+
+	/** With persistent capture, audio from just before transcription started that is transcribed too, for speech that began ahead of the key press. */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(EditCondition="bPersistentCapture", ClampMin="0", ClampMax="2000", Units="ms"))
+	float LookbackMilliseconds;
+
+	/**
+	 * How much captured audio wakes the session to feed it to the model. Rounded up to whole 20 ms model steps.
+	 * Lower means less latency for more wakeups.
+	 */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="20", Units="ms"))
+	float FeedIntervalMilliseconds;
+
+	/**
+	 * Least amount of new audio between two intermediate transcriptions, how stale a partial result can get. 0 decodes after every feed.
+	 */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="0", Units="ms"))
+	float IntermediateDecodeIntervalMilliseconds;
+
+	/**
+	 * Most time intermediate decodes may take relative to the audio they cover. Decodes get slower as the utterance grows,
+	 * so they get spread further apart to stay within this. 0 turns intermediate transcriptions off.
+	 */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="0", ClampMax="1"))
+	float IntermediateDecodeCpuBudget;
+
+	/**
+	 * Recent background noise fed ahead of every utterance so the model doesn't clip its first phonemes. Every millisecond of it costs
+	 * acoustic model time on every utterance, TensorVox.Benchmark.Padding shows how much a model actually needs.
+	 */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="0", ClampMax="1000", Units="ms"))
+	float LeadPaddingMilliseconds;
+
+	/** Recent background noise fed after every utterance before it's finished, so its last phonemes are flushed out of the model. */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="0", ClampMax="1000", Units="ms"))
+	float TrailPaddingMilliseconds;
+
+	/**
+	 * Candidate transcriptions in results delivered with metadata (per token timings and confidence), best first.
+	 * Only used by sessions opened with a result delegate, the rest only get the best candidate's text.
+	 */
+	UPROPERTY(Category="DeepSpeech Audio Configuration", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="1", ClampMax="16"))
+	int32 NumCandidates;
+
+	/** Decides which captured audio has a voice in it, only that is fed to the model. TensorVox.Benchmark.Vad compares them on a labelled corpus. */
+	UPROPERTY(Category="DeepSpeech Voice Detection", BlueprintReadOnly, EditAnywhere)
+	EDeepSpeechVoiceDetector VoiceDetector;
+
+	/** Higher lets less non speech through, at the risk of clipping quiet speech. Same scale as WebRTC's modes. */
+	UPROPERTY(Category="DeepSpeech Voice Detection", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="0", ClampMax="3"))
+	int32 VoiceDetectorAggressiveness;
+
+	/**
+	 * Hands free mode. While transcription is requested the session listens, and every stretch of speech it hears becomes its own
+	 * utterance, finished as soon as the speaker goes quiet instead of when transcription is ended.
+	 */
+	UPROPERTY(Category="DeepSpeech Endpointing", BlueprintReadOnly, EditAnywhere)
+	bool bAutomaticEndpointing;
+
+	/** Voice needed in a row before an utterance starts, so clicks and bumps don't start one. */
+	UPROPERTY(Category="DeepSpeech Endpointing", BlueprintReadOnly, EditAnywhere, meta=(EditCondition="bAutomaticEndpointing", ClampMin="20", Units="ms"))
+	float SpeechOnsetMilliseconds;
+
+	/** Silence after speech before the utterance is finished. Short pauses between words must fit in it. */
+	UPROPERTY(Category="DeepSpeech Endpointing", BlueprintReadOnly, EditAnywhere, meta=(EditCondition="bAutomaticEndpointing", ClampMin="20", Units="ms"))
+	float EndpointHangoverMilliseconds;
+
+	/** Utterances are finished at this length even if the speaker keeps going. 0 doesn't limit them. */
+	UPROPERTY(Category="DeepSpeech Endpointing", BlueprintReadOnly, EditAnywhere, meta=(EditCondition="bAutomaticEndpointing", ClampMin="0", Units="s"))
+	float MaxUtteranceSeconds;
+
+	/** Audio from before the onset fed at the start of every utterance, so its first syllable isn't clipped. At least the onset. */
+	UPROPERTY(Category="DeepSpeech Endpointing", BlueprintReadOnly, EditAnywhere, meta=(EditCondition="bAutomaticEndpointing", ClampMin="0", Units="ms"))
+	float PreRollMilliseconds;
+
+	/**
+	 * Intermediate transcriptions in a row a word has to come out the same in before commands are spotted on it. Higher fires later
+	 * but less often on words the decoder takes back.
+	 */
+	UPROPERTY(Category="DeepSpeech Commands", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="1", ClampMax="10"))
+	int32 CommandStabilityDecodes;
+
+	/** Share of a command word's letters a heard word may differ by and still match it, 0 only takes exact words. */
+	UPROPERTY(Category="DeepSpeech Commands", BlueprintReadOnly, EditAnywhere, meta=(ClampMin="0", ClampMax="0.5"))
+	float CommandFuzzyTolerance;
+
+	/** Fires a command as soon as the words heard so far start no other command's phrase, before the rest of it is said. */
+	UPROPERTY(Category="DeepSpeech Commands", BlueprintReadOnly, EditAnywhere)
+	bool bCommandsFireOnUniquePrefix;
+
+	/** Finishes the utterance as soon as a command is heard in it, without waiting for the speaker to stop. */
+	UPROPERTY(Category="DeepSpeech Commands", BlueprintReadOnly, EditAnywhere)
+	bool bEndUtteranceOnCommand;
 };
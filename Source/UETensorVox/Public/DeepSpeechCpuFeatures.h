@@ -0,0 +1,45 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Instruction set levels, each one implies the ones before it. */
+enum class EDeepSpeechCpuLevel : uint8
+{
+	// Whatever the platform's baseline is, NEON on ARM.
+	Generic,
+	Sse41,
+	Avx,
+	// AVX2 together with FMA, every CPU with one has the other.
+	Avx2,
+	// AVX-512 foundation, with the OS saving the wider registers.
+	Avx512,
+};
+
+const TCHAR* LexToString(EDeepSpeechCpuLevel Level);
+
+/**
+ * What the CPU and OS can run, read once with cpuid/xgetbv on x86. Decides which libdeepspeech build is loaded and which of the
+ * plugin's own kernels run. -TensorVoxCpuLevel=<Generic|SSE4.1|AVX|AVX2|AVX-512> on the command line caps it, to test lower levels
+ * on a fast machine.
+ */
+struct UETENSORVOX_API FDeepSpeechCpuFeatures
+{
+	bool bSse41 = false;
+	bool bAvx = false;
+	bool bAvx2 = false;
+	bool bFma = false;
+	bool bAvx512 = false;
+
+	/** Detected on first use, thread safe. */
+	static const FDeepSpeechCpuFeatures& Get();
+
+	/** Highest level every feature of which is present, after the command line cap. */
+	EDeepSpeechCpuLevel GetLevel() const { return Level; }
+
+private:
+	static FDeepSpeechCpuFeatures Detect();
+
+	EDeepSpeechCpuLevel Level = EDeepSpeechCpuLevel::Generic;
+};
@@ -0,0 +1,72 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** One intermediate decode, kept for tuning when TensorVox.ExportDecodeTimings is on. */
+struct FDeepSpeechDecodeTiming
+{
+	// Audio fed into the stream when the decode ran.
+	double StreamSeconds;
+	double DecodeSeconds;
+	// Audio fed since the decode before it.
+	double IntervalSeconds;
+	bool bChanged;
+};
+
+/**
+ * Decides when a session runs DS_IntermediateDecode. A decode searches the whole stream so far, so it gets slower as the utterance
+ * grows: decodes are spaced by at least the target interval, and stretched further so they never cost more than CpuBudget of the
+ * audio they cover. Also remembers the last hypothesis so unchanged results aren't sent again.
+ */
+class UETENSORVOX_API FDeepSpeechDecodeScheduler
+{
+public:
+	FDeepSpeechDecodeScheduler();
+
+	/** Starts a new utterance. A TargetIntervalSeconds of 0 decodes after every feed, a CpuBudget of 0 never decodes. */
+	void Reset(float InTargetIntervalSeconds, float InCpuBudget, bool bInRecordTimings);
+
+	void OnAudioFed(double Seconds);
+
+	/** Scales the decode rate the target interval and budget give, below 1 decodes less often. Kept across Reset. */
+	void SetRateScale(float InRateScale) { RateScale = FMath::Clamp(InRateScale, 0.01f, 1.0f); }
+
+	bool ShouldDecode() const;
+
+	/**
+	 * Records a decode and its result.
+	 * @return false if the hypothesis is the same as last time and doesn't need to be sent.
+	 */
+	bool OnDecoded(double DecodeSeconds, FStringView Hypothesis);
+
+	/** Audio that has to pile up before the next decode, given what the last decodes cost. */
+	double GetCurrentIntervalSeconds() const;
+
+	int32 GetNumDecodes() const { return NumDecodes; }
+	int32 GetNumSuppressed() const { return NumSuppressed; }
+	double GetTotalDecodeSeconds() const { return TotalDecodeSeconds; }
+	double GetMaxDecodeSeconds() const { return MaxDecodeSeconds; }
+	double GetStreamSeconds() const { return StreamSeconds; }
+	const TArray<FDeepSpeechDecodeTiming>& GetTimings() const { return Timings; }
+
+private:
+	float TargetIntervalSeconds;
+	float CpuBudget;
+	float RateScale;
+	bool bRecordTimings;
+
+	double StreamSeconds;
+	double SecondsSinceDecode;
+	// Smoothed, but quick to follow the cost growing with the utterance.
+	double DecodeCostEstimate;
+
+	FString LastHypothesis;
+
+	int32 NumDecodes;
+	int32 NumSuppressed;
+	double TotalDecodeSeconds;
+	double MaxDecodeSeconds;
+	TArray<FDeepSpeechDecodeTiming> Timings;
+};
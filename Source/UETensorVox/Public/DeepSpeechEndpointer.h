@@ -0,0 +1,50 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Finds where utterances start and end in a stream of per frame VAD decisions, for sessions that endpoint on their own.
+ * Speech starts after a few voiced frames in a row so clicks don't open a stream, and ends once the trailing silence outlasts the
+ * hangover, or the utterance hits its maximum length.
+ */
+class UETENSORVOX_API FDeepSpeechEndpointer
+{
+public:
+	enum class EEvent : uint8
+	{
+		None,
+		// This frame completed the onset, the frames before it belong to the utterance too.
+		SpeechStarted,
+		// The hangover ran out, this frame is the last silent one.
+		SpeechEnded,
+		// The utterance is as long as it may get, this frame is its last.
+		MaxLengthReached,
+	};
+
+	FDeepSpeechEndpointer();
+
+	/** Goes back to waiting for speech. Lengths are in frames, a MaxSpeechFrames of 0 doesn't limit utterances. */
+	void Reset(int32 InOnsetFrames, int32 InHangoverFrames, int32 InMaxSpeechFrames);
+
+	EEvent ProcessFrame(bool bVoiced);
+
+	/** True between SpeechStarted and the frame ending the utterance. */
+	bool IsInSpeech() const { return bInSpeech; }
+
+	int32 GetOnsetFrames() const { return OnsetFrames; }
+
+	/** Frames of the current utterance, the onset included. */
+	int32 GetNumSpeechFrames() const { return NumSpeechFrames; }
+
+private:
+	int32 OnsetFrames;
+	int32 HangoverFrames;
+	int32 MaxSpeechFrames;
+
+	bool bInSpeech;
+	int32 NumVoicedInRow;
+	int32 NumSilentInRow;
+	int32 NumSpeechFrames;
+};
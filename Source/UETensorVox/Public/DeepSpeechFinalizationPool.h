@@ -0,0 +1,114 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "DeepSpeechModel.h"
+#include "DeepSpeechTranscriptionSession.h"
+#include <atomic>
+
+struct StreamingState;
+
+/** What Enqueue does when the finalization queue is full, picked with TensorVox.FinalizeOverloadPolicy. */
+enum class EDeepSpeechFinalizeOverloadPolicy : uint8
+{
+	// The session's worker waits until a finalization worker takes a job.
+	Block,
+	// The oldest queued utterance is thrown away to make room.
+	DropOldest,
+	// The session keeps its stream open and the next utterance carries on in it, so both end up in one result.
+	Merge,
+};
+
+/**
+ * Fixed number of threads running DS_FinishStream for every session, fed from a bounded queue.
+ * Keeps the cost of push to talk spam bounded: no thread per utterance, and no more than TensorVox.FinalizeQueueSize utterances waiting.
+ */
+class UETENSORVOX_API FDeepSpeechFinalizationPool
+{
+public:
+	struct FJob
+	{
+		// Keeps the model alive until the stream is finished.
+		FDeepSpeechModelPtr Model;
+		StreamingState* Stream = nullptr;
+		FOnDeepSpeechTranscribed OnTranscribed;
+		// Finishes with metadata into a result from ResultPool when bound.
+		FOnDeepSpeechResult OnResult;
+		FDeepSpeechResultPoolPtr ResultPool;
+		int32 NumCandidates = 1;
+		// Filled in with the queue wait and finish time, then delivered with the result.
+		FDeepSpeechUtteranceTimings Timings;
+		int32 SessionId = 0;
+		double EnqueueTime = 0.0;
+		// Gets the final transcript written next to the captured audio, if the utterance was captured.
+		FDeepSpeechCaptureUtterancePtr Capture;
+		// Gets the final result added, if the session keeps a journal.
+		FDeepSpeechSessionJournalPtr Journal;
+	};
+
+	FDeepSpeechFinalizationPool();
+	~FDeepSpeechFinalizationPool();
+
+	/**
+	 * Queues the stream to be finished, the pool owns it from then on.
+	 * @param OnSlotFreed Only with the Merge policy: fired once, on a finalization worker, when the queue has room again.
+	 * @return false if the queue is full and the policy is Merge, the caller still owns the stream. A stream the Block policy was still
+	 * waiting to queue when Shutdown came is freed without being finished, like the ones Shutdown finds queued.
+	 */
+	bool Enqueue(FJob&& Job, FSimpleDelegate OnSlotFreed = FSimpleDelegate());
+
+	/** Frees every queued stream without finishing it, waits for the running ones and joins the workers. */
+	void Shutdown();
+
+	int32 GetQueueDepth() const;
+	/** Utterances that may wait at once, TensorVox.FinalizeQueueSize. */
+	int32 GetQueueSize() const;
+	/** Deepest the queue has been. */
+	int32 GetMaxQueueDepth() const { return MaxQueueDepth.load(std::memory_order_relaxed); }
+	int32 GetNumDropped() const { return NumDropped.load(std::memory_order_relaxed); }
+	int32 GetNumMerged() const { return NumMerged.load(std::memory_order_relaxed); }
+
+	/** Time from Enqueue to the result being delivered, over the last few hundred utterances. */
+	void GetLatencyPercentiles(double& OutP50, double& OutP95, double& OutP99) const;
+
+	void DumpToLog() const;
+
+private:
+	class FWorker : public FRunnable
+	{
+	public:
+		explicit FWorker(FDeepSpeechFinalizationPool& InPool) : Pool(InPool) {}
+		virtual uint32 Run() override;
+	private:
+		FDeepSpeechFinalizationPool& Pool;
+	};
+
+	void StartWorkers();
+	void WorkerLoop();
+	static void OnFinished(FDeepSpeechUtteranceTimings& Timings);
+	static void FinishWithMetadata(FJob& Job);
+	static void FreeJob(FJob& Job);
+
+	mutable FCriticalSection QueueCritical;
+	TArray<FJob> Queue;
+	TArray<FSimpleDelegate> SlotWaiters;
+	FEvent* JobEvent;
+	FEvent* SpaceEvent;
+
+	TArray<TUniquePtr<FWorker>> Workers;
+	TArray<FRunnableThread*> WorkerThreads;
+	std::atomic<int32> NumRunningWorkers;
+	std::atomic<bool> bRunning;
+
+	// Written under QueueCritical, read from anywhere.
+	std::atomic<int32> MaxQueueDepth;
+	std::atomic<int32> NumDropped;
+	std::atomic<int32> NumMerged;
+
+	// Last finalize latencies, a ring of LatencyHistorySize.
+	mutable FCriticalSection LatencyCritical;
+	TArray<float> Latencies;
+	int32 NextLatencyIndex;
+};
@@ -0,0 +1,92 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechResampler.h"
+
+enum class EDeepSpeechSampleFormat : uint8
+{
+	Int16,
+	// -1 to 1.
+	Float,
+};
+
+struct UETENSORVOX_API FDeepSpeechFrontEndSettings
+{
+	// Channels per interleaved frame.
+	int32 NumChannels = 1;
+	EDeepSpeechSampleFormat Format = EDeepSpeechSampleFormat::Int16;
+	// Channel that is kept, INDEX_NONE averages all of them.
+	int32 Channel = INDEX_NONE;
+	// Linear gain applied to the mix.
+	float Gain = 1.0f;
+	// Subtracts the mix's running mean, for interfaces and cheap mics with an offset.
+	bool bRemoveDC = false;
+};
+
+/**
+ * Turns interleaved audio as a device or file has it into the mono int16 the model takes, in one pass per block: every frame's channels are
+ * gathered, mixed down or picked, gained and offset in registers and written straight out, or straight into the resampler's history when
+ * the rates differ, so nothing is copied between the steps. The mix runs on the widest kernel the CPU has (DeepSpeechSimd).
+ * DC removal subtracts a running mean that is updated once per block, so it doesn't serialize the mix the way a one pole filter would.
+ */
+class UETENSORVOX_API FDeepSpeechFrontEnd
+{
+public:
+	FDeepSpeechFrontEnd();
+
+	/**
+	 * Takes blocks of up to MaxBlockFrames frames at InputSampleRate and produces OutputSampleRate. Doesn't allocate again for the same
+	 * rates and block size, so it can be reinitialized every time a device is opened.
+	 */
+	void Initialize(const FDeepSpeechFrontEndSettings& InSettings, int32 InInputSampleRate, int32 InOutputSampleRate, int32 InMaxBlockFrames);
+
+	/** Clears the filter history and the DC estimate. */
+	void Reset();
+
+	/**
+	 * Converts NumFrames interleaved frames into OutSamples, which must fit GetMaxOutputSamples(NumFrames). Blocks larger than
+	 * MaxBlockFrames are split up. Never allocates.
+	 * @return The number of samples written.
+	 */
+	int32 Process(const void* Interleaved, int32 NumFrames, int16* OutSamples);
+
+	/** Pushes what's left in the resampler's history out with silence, for the end of a file. Up to GetMaxOutputSamples(GetFlushFrames()). */
+	int32 Flush(int16* OutSamples);
+
+	int32 GetMaxOutputSamples(int32 NumFrames) const;
+	int32 GetMaxBlockFrames() const { return MaxBlockFrames; }
+	int32 GetBytesPerFrame() const { return BytesPerFrame; }
+	/** Mono int16 at the output rate with nothing to apply, so frames can be taken as they are without Process. */
+	bool IsPassthrough() const;
+	/** Frames of silence Flush pushes through. */
+	int32 GetFlushFrames() const { return Resampler.IsPassthrough() ? 0 : Resampler.GetNumTapsPerPhase(); }
+
+	const FDeepSpeechFrontEndSettings& GetSettings() const { return Settings; }
+	const FDeepSpeechResampler& GetResampler() const { return Resampler; }
+	const TCHAR* GetKernelName() const { return KernelName; }
+
+private:
+	int32 ProcessBlock(const void* Interleaved, int32 NumFrames, int16* OutSamples);
+	void UpdateDC(float MixSum, int32 NumFrames);
+
+	FDeepSpeechFrontEndSettings Settings;
+	int32 InputSampleRate;
+	int32 MaxBlockFrames;
+	int32 BytesPerFrame;
+
+	// Per channel, gain and format scale folded in, 0 for channels that are left out.
+	TArray<float, TInlineAllocator<8>> Weights;
+	float DCEstimate;
+	bool bHasDCEstimate;
+	// Share of the gap to a block's mean the estimate moves per frame.
+	float DCAdaptRate;
+
+	FDeepSpeechResampler Resampler;
+
+	// DeepSpeechSimd::FMixFunction for int16 and float output.
+	float (*MixToInt16)(const void* RESTRICT, int32, int32, const float* RESTRICT, float, void* RESTRICT);
+	float (*MixToFloat)(const void* RESTRICT, int32, int32, const float* RESTRICT, float, void* RESTRICT);
+	const TCHAR* KernelName;
+};
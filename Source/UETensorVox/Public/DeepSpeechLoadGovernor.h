@@ -0,0 +1,105 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechUtteranceTimings.h"
+#include <atomic>
+
+/** Bounds and targets of FDeepSpeechLoadGovernor, the TensorVox.Governor.* console variables unless a benchmark says otherwise. */
+struct UETENSORVOX_API FDeepSpeechGovernorSettings
+{
+	// End of speech to the final result being dispatched, the latency SLO.
+	float TargetLatencyMs = 500.0f;
+	// Game thread time per frame, 0 leaves the frame out.
+	float TargetFrameMs = 0.0f;
+	// Share of the targets aimed for, the rest is headroom for spikes.
+	float TargetUtilization = 0.85f;
+	// CPU budget: share of the session workers' time, and feed, decode and finish time per second of audio. 0 leaves either out.
+	float MaxWorkerLoad = 0.75f;
+	float MaxRealTimeFactor = 0.5f;
+	// Narrowest beam the decoder is taken down to.
+	int32 MinBeamWidth = 64;
+	// Least share of the configured intermediate decode rate.
+	float MinDecodeRate = 0.25f;
+
+	static FDeepSpeechGovernorSettings FromConsoleVariables();
+};
+
+/** What the governor saw over one decision interval. */
+struct UETENSORVOX_API FDeepSpeechLoadSample
+{
+	// Worst end of speech to final result of the utterances finished in the interval, 0 if none was.
+	float LatencyMs = 0.0f;
+	// Average feed, decode and finish time over audio length of those utterances.
+	float RealTimeFactor = 0.0f;
+	// Average game thread time.
+	float FrameMs = 0.0f;
+	// Share of the session workers' time spent ticking sessions.
+	float WorkerLoad = 0.0f;
+};
+
+/**
+ * Trades decoding quality for CPU when speech and the game fight over the machine, or speech costs more than its budget. Every decision
+ * interval it compares the worst final latency and the game thread time against their targets, and the workers' load and the utterances'
+ * real time factor against their budget. It moves one level between 0 and 1 to bring the worst of them to TargetUtilization of its target:
+ * down quickly when over, up slowly when there's room. Over budget, the level comes down even while latency has headroom. The level picks
+ * the beam width streams are created with, between MinBeamWidth and the model's own, and how often intermediate decodes run, between
+ * MinDecodeRate and the configured rate. At 1, or with the governor off, sessions decode exactly as configured.
+ */
+class UETENSORVOX_API FDeepSpeechLoadGovernor
+{
+public:
+	FDeepSpeechLoadGovernor();
+
+	/** Any thread, once per finished utterance. */
+	void ReportUtterance(const FDeepSpeechUtteranceTimings& Timings);
+
+	/**
+	 * Game thread, once a frame. Takes a decision every TensorVox.Governor.IntervalSeconds while TensorVox.Governor.Enable is on, and
+	 * goes back to level 1 when it's turned off.
+	 * @param BusyCycles The session workers' busy cycles since they started, FDeepSpeechSessionManager::GetBusyCycles.
+	 */
+	void Tick(float DeltaSeconds, uint64 BusyCycles, int32 NumWorkers);
+
+	/** Moves the level for one interval's sample. Tick does this, benchmarks call it with synthetic load. */
+	void Decide(const FDeepSpeechLoadSample& Sample, const FDeepSpeechGovernorSettings& Settings);
+
+	/** Back to level 1, as configured. */
+	void Reset();
+
+	/** Beam width to create the next stream of a model whose own width is ModelBeamWidth with, 0 for the model's own. */
+	int32 GetBeamWidth(int32 ModelBeamWidth) const;
+	/** Scale of the configured intermediate decode rate, 1 decodes as configured. */
+	float GetDecodeRateScale() const { return DecodeRateScale.load(std::memory_order_relaxed); }
+	float GetLevel() const { return Level.load(std::memory_order_relaxed); }
+
+	/** Game thread. What the last decision was taken on, and the worst of latency, frame and cost against their targets. */
+	const FDeepSpeechLoadSample& GetLastSample() const { return LastSample; }
+	float GetLastPressure() const { return LastPressure; }
+	/** The beam width GetBeamWidth last handed out, for stats. 0 while streams use the model's own. */
+	int32 GetLastBeamWidth() const { return LastBeamWidth.load(std::memory_order_relaxed); }
+	int32 GetNumDecisions() const { return NumDecisions; }
+
+private:
+	std::atomic<float> Level;
+	std::atomic<float> DecodeRateScale;
+	std::atomic<int32> MinBeamWidth;
+	mutable std::atomic<int32> LastBeamWidth;
+
+	// Utterances finished since the last decision, from any thread.
+	FCriticalSection ReportCritical;
+	float ReportedLatencyMs;
+	float ReportedRealTimeFactorSum;
+	int32 NumReported;
+
+	// Game thread.
+	double SecondsSinceDecision;
+	double FrameMsSum;
+	int32 NumFrames;
+	uint64 LastBusyCycles;
+	FDeepSpeechLoadSample LastSample;
+	float LastPressure;
+	int32 NumDecisions;
+	bool bWasEnabled;
+};
@@ -3,71 +3,155 @@
 
 #include "CoreMinimal.h"
 #include "HAL/ThreadSafeBool.h"
-#if PLATFORM_WINDOWS
-#include "Windows/WindowsHWrapper.h"
-#endif
 
 #include "UETensorVox.h"
+#include "DeepSpeechAudioSource.h"
+#include "DeepSpeechRingBuffer.h"
+#include "DeepSpeechFrontEnd.h"
+#include "DeepSpeechSessionJournal.h"
 
-#if TENSORVOX_VALID_PLATFORM 
-THIRD_PARTY_INCLUDES_START
-#include "RtAudio.h"
-THIRD_PARTY_INCLUDES_END
-#endif
-
-
-// Buffers to de-interleave recorded audio
-UETENSORVOX_API struct FDeinterleavedAudio
-{
-	TAlignedSignedInt16Array PCMData;
-};
 /**
  * FDeepSpeechMicrophoneRecorder
- * Singleton Mic Recording Manager -- generates recordings, stores the recorded data and plays them back
+ * Records from an IDeepSpeechAudioSource (the microphone unless told otherwise) into a ring buffer, frames exactly as the source delivers
+ * them, and hands them out converted to mono at the model's sample rate by the front end on the reading thread.
  */
-UETENSORVOX_API class FDeepSpeechMicrophoneRecorder
+UETENSORVOX_API class FDeepSpeechMicrophoneRecorder : public IDeepSpeechAudioSink
 {
 public:
-	// Private Constructor
-	FDeepSpeechMicrophoneRecorder();
-	// Private Destructor
-	~FDeepSpeechMicrophoneRecorder();
+	explicit FDeepSpeechMicrophoneRecorder(TUniquePtr<IDeepSpeechAudioSource> InSource);
+	virtual ~FDeepSpeechMicrophoneRecorder() override;
 	// Starts a new recording with the given name and optional duration. 
 	// If set to -1.0f, a duration won't be used and the recording length will be determined by StopRecording().
-	bool StartRecording(int32 InTargetSampleRate = 16000, int32 RecordingBlockSize = 1024);
+	// CaptureBufferSeconds sizes the preallocated ring buffer the capture callback writes into.
+	bool StartRecording(int32 InTargetSampleRate = 16000, int32 RecordingBlockSize = 1024, float CaptureBufferSeconds = 2.0f);
+	/**
+	 * Starts recording with the gate closed, for callers that keep the source open for good and only open the gate while they need audio.
+	 * While it's closed ReadFrame hands out nothing and only the newest LookbackSeconds are kept, so OpenGate can start from just before it was called.
+	 * The capture buffer holds CaptureBufferSeconds on top of the lookback.
+	 */
+	bool StartGatedRecording(int32 InTargetSampleRate, int32 RecordingBlockSize, float CaptureBufferSeconds, float LookbackSeconds);
+	/**
+	 * Reading thread. Hands out audio again, starting with up to the lookback of what came in before.
+	 * @return Seconds of lookback the first frames start with.
+	 */
+	float OpenGate();
+	/** Reading thread. Stops handing out audio, it's dropped down to the lookback from the next ReadFrame on. */
+	void CloseGate();
+	bool IsGated() const { return bGated; }
+	bool IsGateOpen() const { return bGateOpen; }
+	bool IsRecording() const { return bRecording; }
+	// Fired on the capture thread every time WakeIntervalSeconds of audio came in. Only set it while not recording.
+	void SetOnSamplesAvailable(FSimpleDelegate InOnSamplesAvailable, float InWakeIntervalSeconds);
 	// Stops recording if the recording manager is recording. If not recording but has recorded data (due to set duration), it will just return the generated USoundWave.
 	void StopRecording();
 
-	// Called by RtAudio when a new audio buffer is ready to be supplied.
-	int32 OnAudioCapture(void* InBuffer, uint32 InBufferFrames, double StreamTime, bool bOverflow);
-	TArray<FDeinterleavedAudio> ProcessSamples(TArray<int16> InSamples);
+	// IDeepSpeechAudioSink, called by the source when a new audio buffer is ready. Only copies into CaptureBuffer, never converts or allocates.
+	virtual void OnAudioCaptured(const void* Frames, int32 NumFrames, bool bDeviceOverflow) override;
+	virtual int32 GetNumFreeFrames() const override { return (CaptureBuffer.Max() - CaptureBuffer.Num()) / CaptureStride; }
+
+	IDeepSpeechAudioSource* GetSource() const { return Source.Get(); }
+	/** The source's frame layout and how it's turned into mono, valid while recording. */
+	const FDeepSpeechFrontEndSettings& GetFrameLayout() const { return FrontEnd.GetSettings(); }
+
+	/** Every capture block goes into Journal as well, copied out on the reading thread. Only set it while not recording. */
+	void SetJournal(const FDeepSpeechSessionJournalPtr& InJournal);
 
 	/**
-	 * Save samples with the recorder's settings.
+	 * Returns the next FrameSamples samples converted to mono at the target sample rate, or an empty view if not enough audio has been
+	 * captured yet or the gate is closed.
+	 * Points straight into the capture buffer when no conversion is needed. The view is valid until the next ReadFrame or StartRecording call.
 	 */
-	static USoundWave* SaveAsWavMono(const TAlignedSignedInt16Array& Samples, const FString& Path, const FString& AssetName, const int16& RecordedSampleRate);
+	TArrayView<const int16> ReadFrame(int32 FrameSamples);
+
+	/** FPlatformTime::Seconds() at which the capture block holding the newest sample of the last ReadFrame arrived. */
+	double GetLastFrameArrivalTime() const { return LastFrameArrivalTime; }
+
+	/** Captured frames at the device sample rate that haven't been read yet. */
+	int32 GetNumAvailableSamples() const { return CaptureBuffer.Num() / CaptureStride; }
+
+	/** Captured frames at the device sample rate read so far, since the recording started. Only valid on the reading thread. */
+	int64 GetNumReadSamples() const { return (int64)CaptureBuffer.GetTotalRead() / CaptureStride; }
+
+	/** Number of times the device reported an input overflow since the recording started. */
+	int32 GetNumDeviceOverflows() const { return NumOverflowsDetected.GetValue(); }
+	/** Number of capture blocks that didn't fully fit into the capture buffer since the recording started. */
+	int32 GetNumBufferOverflows() const { return CaptureBuffer.GetNumOverflowedWrites(); }
+	/** Number of frames dropped because the worker fell behind since the recording started. */
+	int64 GetNumDroppedSamples() const { return CaptureBuffer.GetNumDroppedElements() / CaptureStride; }
+
+#if WITH_EDITOR
+	/**
+	 * Save samples as a sound wave asset. Editor only, on the game thread: creates a package and touches the asset registry, which hitches.
+	 * Captures are written with FDeepSpeechCaptureWriter and imported with this afterwards.
+	 */
+	static USoundWave* SaveAsWavMono(const TAlignedSignedInt16Array& Samples, const FString& Path, const FString& AssetName, int32 RecordedSampleRate);
+#endif
 
-	// static TArray<int16> DownmixStereoToMono(const TArray<int16>& FirstChannel, const TArray<int16>& SecondChannel);
 public:
 
-	TQueue<FDeinterleavedAudio> RawRecordingBlocks;
 	int32 RecordingSampleRate;
 
-private:
-#if TENSORVOX_VALID_PLATFORM
-	RtAudio ADCInstance;
-	// Stream parameters to initialize the ADCInstance
-	RtAudio::StreamParameters StreamParams;
-#endif
 protected:
+	TUniquePtr<IDeepSpeechAudioSource> Source;
 
 	int32 TargetSampleRate;
-	
-	int32 NumOverflowsDetected;
-	uint32 bError : 1;
 
-	bool bSplitChannels;
+	// The source's interleaved frames as they came in, CaptureStride int16s each (a float sample takes two). Capacity, writes and reads are
+	// all whole frames, so a frame never straddles the wrap.
+	TDeepSpeechRingBuffer<int16> CaptureBuffer;
+	int32 CaptureStride;
+
+	// When each capture block came in, by CaptureBuffer write position. Written next to CaptureBuffer by the capture callback.
+	struct FCaptureStamp
+	{
+		uint64 EndPosition;
+		double ArrivalTime;
+	};
+	TDeepSpeechRingBuffer<FCaptureStamp> CaptureStamps;
+	double LastFrameArrivalTime;
+	void UpdateFrameArrivalTime(uint64 SourcePosition);
+
+	// Capture blocks waiting to be copied into the journal, the frames are still in CaptureBuffer since they're copied before they're consumed.
+	// Counts are in CaptureBuffer elements.
+	struct FJournalBlock
+	{
+		uint64 EndPosition;
+		int32 NumWritten;
+		int32 NumDropped;
+		double ArrivalTime;
+		bool bDeviceOverflow;
+	};
+	FDeepSpeechSessionJournalPtr Journal;
+	TDeepSpeechRingBuffer<FJournalBlock> JournalBlocks;
+	void FlushJournal();
+
+	FSimpleDelegate OnSamplesAvailable;
+	float WakeIntervalSeconds;
+	// Frames, like the idle interval.
+	int32 WakeIntervalSamples;
+	// Capture thread only.
+	int32 NumSamplesSinceWake;
+
+	// Turns the source's frames into mono at TargetSampleRate between the capture buffer and ReadFrame.
+	FDeepSpeechFrontEnd FrontEnd;
+	TAlignedSignedInt16Array ConvertedFrames;
+	int32 NumConvertedSamples;
+	// Samples handed out by the last ReadFrame, released on the next call.
+	int32 NumPendingConsume;
+	
+	FThreadSafeCounter NumOverflowsDetected;
 
-	FThreadSafeCounter NumInputChannels;
 	FThreadSafeBool bRecording;
+
+	bool BeginRecording(int32 InTargetSampleRate, int32 RecordingBlockSize, float CaptureBufferSeconds, float LookbackSeconds);
+	/** Drops everything but the newest LookbackSamples, along with their stamps and journal blocks. */
+	void TrimToLookback();
+
+	// Set for recordings started with StartGatedRecording. The capture thread reads the gate to wake the reader less often while it's closed.
+	bool bGated;
+	FThreadSafeBool bGateOpen;
+	// In CaptureBuffer elements.
+	int32 LookbackSamples;
+	// While the gate is closed, the reader is only woken to trim the buffer, halfway to full.
+	int32 IdleWakeSamples;
 };
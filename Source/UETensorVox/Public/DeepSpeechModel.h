@@ -0,0 +1,108 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechConfiguration.h"
+
+struct ModelState;
+struct StreamingState;
+
+/** Words the decoder should favour (positive boost) or avoid (negative boost), by word. */
+typedef TMap<FString, float> FDeepSpeechHotWords;
+
+/**
+ * A loaded DeepSpeech model (and optional scorer), shared by every session that uses the same configuration.
+ * Sessions get these through FDeepSpeechModelRegistry, which decides when an unused model is freed.
+ */
+class UETENSORVOX_API FDeepSpeechModel
+{
+public:
+	~FDeepSpeechModel();
+
+	/**
+	 * Loads the model and scorer from the project content directory. Slow, call this off the game thread.
+	 * @return nullptr if DeepSpeech failed to load either of them.
+	 */
+	static TSharedPtr<FDeepSpeechModel, ESPMode::ThreadSafe> Load(const FDeepSpeechConfiguration& Config);
+
+	/** Identifies configurations that can share a loaded model. */
+	static FString MakeKey(const FDeepSpeechConfiguration& Config);
+
+	/** Logs DeepSpeech errors, returns true if there was one. */
+	static bool CheckForError(const FString& Name, int32 Error);
+
+	ModelState* GetModelState() const { return Model; }
+	int32 GetSampleRate() const { return SampleRate; }
+	/** The decoder's beam width as loaded, the configured one or the model's default. */
+	int32 GetBeamWidth() const { return BeamWidth; }
+	const FString& GetKey() const { return Key; }
+
+	/** Memory DeepSpeech holds for the acoustic model and the scorer, the larger of the file size and what the process grew by loading it. */
+	int64 GetModelBytes() const { return ModelBytes; }
+	int64 GetScorerBytes() const { return ScorerBytes; }
+	int64 GetResidentBytes() const { return ModelBytes + ScorerBytes; }
+
+	/**
+	 * DS_CreateStream, decoding with HotWords. Hot words belong to the model and every stream copies them when it's created, so the
+	 * model's set is brought in line with HotWords first, under a lock of its own. Only the difference to the last stream's set is applied.
+	 * The beam width is copied the same way, StreamBeamWidth narrows it for this stream only, 0 keeps the model's.
+	 * Call it inside a FDeepSpeechInferenceScope like DS_CreateStream.
+	 * @return DeepSpeech's error code.
+	 */
+	int32 CreateStream(StreamingState*& OutStream, const FDeepSpeechHotWords& HotWords = FDeepSpeechHotWords(), int32 StreamBeamWidth = 0);
+
+private:
+	friend class FDeepSpeechInferenceScope;
+
+	FDeepSpeechModel();
+
+	ModelState* Model;
+	int32 SampleRate;
+	int32 BeamWidth;
+	FString Key;
+
+	// DeepSpeech allocates outside FMemory, these are reported to LLM by hand under the TensorVox tags.
+	int64 ModelBytes;
+	int64 ScorerBytes;
+
+	// The TFLite runtime shares one interpreter per model, so inference from several streams has to take turns.
+	// The TensorFlow runtime (.pb/.pbmm) runs concurrent sessions fine and skips the lock.
+	bool bSerializeInference;
+	FCriticalSection InferenceCritical;
+
+	// What the model's hot words and beam width are set to, only changed together with creating a stream.
+	FCriticalSection StreamCreationCritical;
+	FDeepSpeechHotWords AppliedHotWords;
+	int32 AppliedBeamWidth;
+};
+
+/**
+ * Held around any call that runs the acoustic model on a shared model (DS_CreateStream, DS_FeedAudioContent, DS_FinishStream...).
+ * Decoding (DS_IntermediateDecode) only touches the stream's own decoder state and doesn't need it.
+ */
+class UETENSORVOX_API FDeepSpeechInferenceScope
+{
+public:
+	explicit FDeepSpeechInferenceScope(FDeepSpeechModel& InModel)
+		: Critical(InModel.bSerializeInference ? &InModel.InferenceCritical : nullptr)
+	{
+		if (Critical)
+		{
+			Critical->Lock();
+		}
+	}
+
+	~FDeepSpeechInferenceScope()
+	{
+		if (Critical)
+		{
+			Critical->Unlock();
+		}
+	}
+
+private:
+	FCriticalSection* Critical;
+};
+
+typedef TSharedPtr<FDeepSpeechModel, ESPMode::ThreadSafe> FDeepSpeechModelPtr;
@@ -0,0 +1,58 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechModel.h"
+
+/**
+ * Module wide cache of loaded models, keyed by FDeepSpeechModel::MakeKey (model, scorer, alpha/beta, beam width).
+ * Hands out reference counted handles. Once the last handle of a model goes away the model stays loaded as idle, and idle models are
+ * freed least recently used first whenever they add up to more than TensorVox.IdleModelBudgetMB.
+ */
+class UETENSORVOX_API FDeepSpeechModelRegistry
+{
+public:
+	~FDeepSpeechModelRegistry();
+
+	/** Shortcut to the module's registry. */
+	static FDeepSpeechModelRegistry& Get();
+
+	/**
+	 * Returns a handle to the model for the configuration, loading it if it isn't cached. Blocks while loading, keep it off the game thread.
+	 * @return nullptr if the model failed to load.
+	 */
+	FDeepSpeechModelPtr Acquire(const FDeepSpeechConfiguration& Config);
+
+	/** Frees every idle model right away. */
+	void TrimIdle();
+
+	/** Bytes of every loaded model and scorer, idle or not. */
+	int64 GetResidentBytes() const;
+	int64 GetIdleBytes() const;
+
+	void DumpToLog() const;
+
+private:
+	struct FEntry
+	{
+		// Keeps the model loaded while it sits in the cache.
+		FDeepSpeechModelPtr Model;
+		// Handle given to sessions, its deleter returns the model to the idle list.
+		TWeakPtr<FDeepSpeechModel, ESPMode::ThreadSafe> Handle;
+		bool bIdle = false;
+		double LastUsedTime = 0.0;
+	};
+
+	FDeepSpeechModelPtr MakeHandle(const FString& Key, FEntry& Entry);
+	void OnHandleReleased(const FString& Key);
+
+	/** Evicts idle models, oldest first, until idle memory fits BudgetBytes. Critical must be held. */
+	void EvictIdle(int64 BudgetBytes);
+
+	mutable FCriticalSection Critical;
+	TMap<FString, FEntry> Entries;
+
+	// Serializes loading without blocking lookups and releases of models that are already loaded.
+	FCriticalSection LoadCritical;
+};
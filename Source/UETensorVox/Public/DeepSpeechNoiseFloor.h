@@ -0,0 +1,37 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechRingBuffer.h"
+
+struct StreamingState;
+
+/**
+ * The most recent audio without voice in it, kept up to date for as long as a session records. Streams are padded with it on both
+ * ends so the model doesn't clip the first and last phonemes, and hears the room it's in rather than digital silence.
+ */
+class UETENSORVOX_API FDeepSpeechNoiseFloor
+{
+public:
+	FDeepSpeechNoiseFloor() {}
+
+	/** Keeps the newest CapacitySamples of noise. */
+	void Initialize(int32 CapacitySamples);
+
+	/** Adds non speech audio, pushing out the oldest once full. */
+	void Add(const int16* Samples, int32 NumSamples);
+
+	int32 Num() const { return Ring.Num(); }
+	int32 Max() const { return Ring.Max(); }
+
+	/**
+	 * Feeds the newest NumSamples of noise straight out of the ring, led by digital silence while less than that was heard yet.
+	 * The caller holds the model's inference scope.
+	 */
+	void Feed(StreamingState* Stream, int32 NumSamples) const;
+
+private:
+	TDeepSpeechRingBuffer<int16> Ring;
+	TArray<int16> Zeros;
+};
@@ -0,0 +1,79 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Streaming polyphase windowed-sinc resampler for mono int16 audio.
+ * The ratio is kept as an exact fraction of the two sample rates, so any pair of integer device/model rates works. Filter state is kept
+ * between Process calls, so blocks of any size can be pushed without clicks at the block boundaries.
+ */
+class UETENSORVOX_API FDeepSpeechResampler
+{
+public:
+	FDeepSpeechResampler();
+
+	/**
+	 * Builds the filter bank and preallocates the history. MaxInputBlockSize is the largest block Process will be called with.
+	 */
+	void Initialize(int32 InInputSampleRate, int32 InOutputSampleRate, int32 InMaxInputBlockSize);
+
+	/** Clears the filter history, keeps the filter bank. */
+	void Reset();
+
+	/**
+	 * Resamples NumInput samples into OutSamples, which must fit GetMaxOutputSamples(NumInput) samples.
+	 * @return The number of samples written.
+	 */
+	int32 Process(const int16* InSamples, int32 NumInput, int16* OutSamples);
+
+	/**
+	 * Where to write the next NumInput samples, as floats at int16 scale, for producers that convert on the way in. Not for passthrough.
+	 * Follow up with ProcessInput.
+	 */
+	float* GetInputBuffer(int32 NumInput);
+
+	/** Resamples the NumInput samples written to GetInputBuffer, like Process. */
+	int32 ProcessInput(int32 NumInput, int16* OutSamples);
+
+	/** Upper bound of the samples Process can produce for NumInput samples. */
+	int32 GetMaxOutputSamples(int32 NumInput) const;
+
+	/** True if the rates match, the caller is expected to skip Process entirely. */
+	bool IsPassthrough() const { return InputSampleRate == OutputSampleRate; }
+
+	int32 GetMaxInputBlockSize() const { return MaxInputBlockSize; }
+
+	/** Delay the filter adds, in input samples. */
+	float GetGroupDelay() const;
+
+	int32 GetNumTapsPerPhase() const { return NumTapsPerPhase; }
+	int32 GetNumPhases() const { return NumPhases; }
+	const TCHAR* GetKernelName() const { return KernelName; }
+
+private:
+	int32 InputSampleRate;
+	int32 OutputSampleRate;
+
+	// Output sample N lands on input position N * DecimationFactor / InterpolationFactor.
+	int32 InterpolationFactor;
+	int32 DecimationFactor;
+
+	// Ratios with a huge interpolation factor (e.g. 44099 -> 16000) snap to the nearest of a limited number of phases.
+	int32 NumPhases;
+	int32 NumTapsPerPhase;
+	int32 MaxInputBlockSize;
+
+	// NumPhases * NumTapsPerPhase coefficients, each phase stored reversed so it's a plain dot product against the history.
+	TArray<float> FilterBank;
+
+	// The last NumTapsPerPhase - 1 input samples of the previous block, followed by the current block.
+	TArray<float> History;
+	int32 NumBuffered;
+	int32 InputIndex;
+	int32 Phase;
+
+	float (*DotProduct)(const float* RESTRICT, const float* RESTRICT, int32);
+	const TCHAR* KernelName;
+};
@@ -0,0 +1,75 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "DeepSpeechTranscriptionResult.h"
+#include "DeepSpeechUtteranceTimings.h"
+#include "DeepSpeechCommandSpotter.h"
+#include <atomic>
+
+/** One transcription waiting in a FDeepSpeechResultMailbox. */
+struct UETENSORVOX_API FDeepSpeechMailboxEntry
+{
+	FString Text;
+	bool bFinal = false;
+	FDeepSpeechUtteranceTimings Timings;
+	// With candidates, for sessions that decode with metadata.
+	FDeepSpeechResultPtr Result;
+};
+
+/**
+ * Hands a session's results to whoever drains it once a frame, without locks and without queueing a task per result. Partials go through
+ * a triple buffer that keeps only the newest, since a partial is stale as soon as the next one is out. Finals are queued and every one
+ * is delivered. Draining delivers finals before the partial, and drops a partial of an utterance whose final was already delivered.
+ */
+class UETENSORVOX_API FDeepSpeechResultMailbox
+{
+public:
+	FDeepSpeechResultMailbox();
+
+	/**
+	 * The session's worker only. Replaces the partial waiting to be drained, if there is one. Reuses the slot's text, so it doesn't allocate
+	 * once the slots grew to fit.
+	 */
+	void PostPartial(const FString& Text, const FDeepSpeechUtteranceTimings& Timings, const FDeepSpeechResultPtr& Result = nullptr);
+
+	/** Any thread. */
+	void PostFinal(const FString& Text, const FDeepSpeechUtteranceTimings& Timings, const FDeepSpeechResultPtr& Result = nullptr);
+
+	/**
+	 * The draining thread only. Calls Visitor with every final posted since the last drain, oldest first, then the newest partial if it's
+	 * still current.
+	 * @return The number of entries visited.
+	 */
+	int32 Drain(TFunctionRef<void(FDeepSpeechMailboxEntry&)> Visitor);
+
+	/** Any thread. Commands are queued like finals, every one is delivered. */
+	void PostCommand(const FDeepSpeechCommandMatch& Match);
+
+	/** The draining thread only. Calls Visitor with every command posted since the last drain, oldest first. */
+	int32 DrainCommands(TFunctionRef<void(const FDeepSpeechCommandMatch&)> Visitor);
+
+	/** Partials replaced before they were drained. */
+	int32 GetNumCoalesced() const { return NumCoalesced.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr uint8 FreshBit = 0x4;
+	static constexpr uint8 IndexMask = 0x3;
+
+	// The producer fills Slots[Back] and swaps it into Middle, marked fresh. The drainer swaps Front with a fresh Middle.
+	FDeepSpeechMailboxEntry Slots[3];
+	std::atomic<uint8> Middle;
+	uint8 Back;
+	uint8 Front;
+
+	TQueue<FDeepSpeechMailboxEntry, EQueueMode::Mpsc> Finals;
+	TQueue<FDeepSpeechCommandMatch, EQueueMode::Mpsc> Commands;
+	// Drainer only. Newest utterance a final was delivered for.
+	int32 LastFinalUtteranceId;
+
+	std::atomic<int32> NumCoalesced;
+};
+
+typedef TSharedPtr<FDeepSpeechResultMailbox, ESPMode::ThreadSafe> FDeepSpeechResultMailboxPtr;
@@ -0,0 +1,223 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+/**
+ * Preallocated, wait-free single producer/single consumer ring buffer.
+ * The producer (the realtime capture callback) only ever advances WritePosition and the consumer (the transcription worker)
+ * only ever advances ReadPosition. Both positions are monotonically increasing element counts, so neither side needs a lock,
+ * and neither side ever allocates once Initialize has been called.
+ */
+template <typename ElementType>
+class TDeepSpeechRingBuffer
+{
+public:
+	TDeepSpeechRingBuffer()
+		: Capacity(0), WritePosition(0), ReadPosition(0), NumOverflowedWrites(0), NumDroppedElements(0)
+	{
+	}
+
+	/**
+	 * (Re)allocates the storage. Not thread safe, only call this while neither the producer nor the consumer are running.
+	 */
+	void Initialize(int32 InCapacity)
+	{
+		check(InCapacity > 0);
+		if (Capacity != InCapacity)
+		{
+			Capacity = InCapacity;
+			Storage.SetNumZeroed(Capacity);
+		}
+		Reset();
+	}
+
+	/**
+	 * Drops all buffered elements and clears the overflow counters. Not thread safe, same rules as Initialize.
+	 */
+	void Reset()
+	{
+		WritePosition.store(0, std::memory_order_relaxed);
+		ReadPosition.store(0, std::memory_order_relaxed);
+		NumOverflowedWrites.store(0, std::memory_order_relaxed);
+		NumDroppedElements.store(0, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Producer side. Copies as much of InData as currently fits, anything that doesn't fit is dropped and counted as an overflow.
+	 * @return The number of elements written.
+	 */
+	int32 Write(const ElementType* InData, int32 InNum)
+	{
+		const uint64 Write = WritePosition.load(std::memory_order_relaxed);
+		const uint64 Read = ReadPosition.load(std::memory_order_acquire);
+		const int32 NumFree = Capacity - static_cast<int32>(Write - Read);
+		const int32 NumToWrite = FMath::Min(InNum, NumFree);
+
+		if (NumToWrite < InNum)
+		{
+			NumOverflowedWrites.fetch_add(1, std::memory_order_relaxed);
+			NumDroppedElements.fetch_add(InNum - NumToWrite, std::memory_order_relaxed);
+		}
+
+		if (NumToWrite > 0)
+		{
+			const int32 Offset = static_cast<int32>(Write % Capacity);
+			const int32 NumBeforeWrap = FMath::Min(NumToWrite, Capacity - Offset);
+			FMemory::Memcpy(Storage.GetData() + Offset, InData, NumBeforeWrap * sizeof(ElementType));
+			if (NumToWrite > NumBeforeWrap)
+			{
+				FMemory::Memcpy(Storage.GetData(), InData + NumBeforeWrap, (NumToWrite - NumBeforeWrap) * sizeof(ElementType));
+			}
+			WritePosition.store(Write + NumToWrite, std::memory_order_release);
+		}
+		return NumToWrite;
+	}
+
+	/**
+	 * Consumer side. Returns the largest span of readable elements that is contiguous in memory, starting at the read position.
+	 * The span stays valid until Consume is called.
+	 */
+	TArrayView<const ElementType> PeekContiguous() const
+	{
+		const uint64 Read = ReadPosition.load(std::memory_order_relaxed);
+		const uint64 Write = WritePosition.load(std::memory_order_acquire);
+		const int32 NumReadable = static_cast<int32>(Write - Read);
+		if (NumReadable <= 0)
+		{
+			return TArrayView<const ElementType>();
+		}
+
+		const int32 Offset = static_cast<int32>(Read % Capacity);
+		return TArrayView<const ElementType>(Storage.GetData() + Offset, FMath::Min(NumReadable, Capacity - Offset));
+	}
+
+	/**
+	 * Consumer side. The newest InNum readable elements (or all of them if there are fewer) as up to two spans, oldest first.
+	 * The spans stay valid until Consume is called.
+	 */
+	void PeekNewest(int32 InNum, TArrayView<const ElementType>& OutFirst, TArrayView<const ElementType>& OutSecond) const
+	{
+		const uint64 Write = WritePosition.load(std::memory_order_acquire);
+		const int32 NumToPeek = FMath::Min(InNum, static_cast<int32>(Write - ReadPosition.load(std::memory_order_relaxed)));
+		OutFirst = OutSecond = TArrayView<const ElementType>();
+		if (NumToPeek <= 0)
+		{
+			return;
+		}
+
+		const int32 Offset = static_cast<int32>((Write - NumToPeek) % Capacity);
+		const int32 NumBeforeWrap = FMath::Min(NumToPeek, Capacity - Offset);
+		OutFirst = TArrayView<const ElementType>(Storage.GetData() + Offset, NumBeforeWrap);
+		if (NumToPeek > NumBeforeWrap)
+		{
+			OutSecond = TArrayView<const ElementType>(Storage.GetData(), NumToPeek - NumBeforeWrap);
+		}
+	}
+
+	/**
+	 * Consumer side. Up to InNum readable elements starting at the absolute write position Position, as up to two spans. Clamped to what's
+	 * readable, so elements already consumed or not written yet are left out. The spans stay valid until Consume is called.
+	 */
+	void PeekAt(uint64 Position, int32 InNum, TArrayView<const ElementType>& OutFirst, TArrayView<const ElementType>& OutSecond) const
+	{
+		const uint64 Read = ReadPosition.load(std::memory_order_relaxed);
+		const uint64 Write = WritePosition.load(std::memory_order_acquire);
+		const uint64 Start = FMath::Max(Position, Read);
+		const uint64 End = FMath::Min(Position + FMath::Max(InNum, 0), Write);
+		OutFirst = OutSecond = TArrayView<const ElementType>();
+		if (End <= Start)
+		{
+			return;
+		}
+
+		const int32 NumToPeek = static_cast<int32>(End - Start);
+		const int32 Offset = static_cast<int32>(Start % Capacity);
+		const int32 NumBeforeWrap = FMath::Min(NumToPeek, Capacity - Offset);
+		OutFirst = TArrayView<const ElementType>(Storage.GetData() + Offset, NumBeforeWrap);
+		if (NumToPeek > NumBeforeWrap)
+		{
+			OutSecond = TArrayView<const ElementType>(Storage.GetData(), NumToPeek - NumBeforeWrap);
+		}
+	}
+
+	/**
+	 * Consumer side. Releases elements previously returned by PeekContiguous back to the producer.
+	 */
+	void Consume(int32 InNum)
+	{
+		const uint64 Read = ReadPosition.load(std::memory_order_relaxed);
+		checkSlow(InNum <= Num());
+		ReadPosition.store(Read + InNum, std::memory_order_release);
+	}
+
+	/**
+	 * Consumer side. Copies up to InNum elements across the wrap point into OutData and consumes them.
+	 * @return The number of elements read.
+	 */
+	int32 Read(ElementType* OutData, int32 InNum)
+	{
+		int32 NumRead = 0;
+		while (NumRead < InNum)
+		{
+			const TArrayView<const ElementType> Span = PeekContiguous();
+			if (Span.Num() == 0)
+			{
+				break;
+			}
+			const int32 NumToCopy = FMath::Min(Span.Num(), InNum - NumRead);
+			FMemory::Memcpy(OutData + NumRead, Span.GetData(), NumToCopy * sizeof(ElementType));
+			Consume(NumToCopy);
+			NumRead += NumToCopy;
+		}
+		return NumRead;
+	}
+
+	/** Number of elements ready to be read. Safe to call from either side. */
+	int32 Num() const
+	{
+		return static_cast<int32>(WritePosition.load(std::memory_order_acquire) - ReadPosition.load(std::memory_order_acquire));
+	}
+
+	int32 Max() const
+	{
+		return Capacity;
+	}
+
+	/** Elements written since the last Reset, the position just past the newest element. */
+	uint64 GetTotalWritten() const
+	{
+		return WritePosition.load(std::memory_order_acquire);
+	}
+
+	/** Elements consumed since the last Reset, the position of the oldest unread element. */
+	uint64 GetTotalRead() const
+	{
+		return ReadPosition.load(std::memory_order_acquire);
+	}
+
+	/** Number of Write calls that couldn't fit all of their data. */
+	int32 GetNumOverflowedWrites() const
+	{
+		return NumOverflowedWrites.load(std::memory_order_relaxed);
+	}
+
+	/** Total number of elements dropped because the consumer fell behind. */
+	int64 GetNumDroppedElements() const
+	{
+		return NumDroppedElements.load(std::memory_order_relaxed);
+	}
+
+private:
+	TArray<ElementType> Storage;
+	int32 Capacity;
+
+	// Kept on separate cache lines so the producer and consumer don't false share.
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> WritePosition;
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<uint64> ReadPosition;
+
+	alignas(PLATFORM_CACHE_LINE_SIZE) std::atomic<int32> NumOverflowedWrites;
+	std::atomic<int64> NumDroppedElements;
+};
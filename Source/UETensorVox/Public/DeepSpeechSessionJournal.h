@@ -0,0 +1,160 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "DeepSpeechConfiguration.h"
+#include "DeepSpeechAudioSource.h"
+#include <atomic>
+
+enum class EDeepSpeechJournalRecord : uint16
+{
+	// Filler up to the end of the file, the next record is at the start.
+	Wrap,
+	// A capture block as the recorder got it.
+	Block,
+	// One frame's voice detector decision.
+	Vad,
+	// Transcription was requested, and the recorder started.
+	Start,
+	// Transcription stopped being requested.
+	End,
+	// An intermediate or final transcription delivered to the session's listeners.
+	Result,
+};
+
+/**
+ * Rolling record of everything that went through one session, to reproduce what it heard offline: every capture block with the time
+ * it came in and whether it overflowed, every voice detector decision, transcription starts and ends, and every result delivered.
+ * Written into a memory mapped file of a fixed size, oldest records first to be overwritten, so it costs a copy per record, never grows,
+ * and survives the process crashing. Opt in with TensorVox.Journal 1, files go to Saved/TensorVoxJournal/, where the oldest are deleted
+ * to keep them all within TensorVox.Journal.MaxTotalMB. Replayed with TensorVox.ReplayJournal.
+ */
+class UETENSORVOX_API FDeepSpeechSessionJournal
+{
+public:
+	~FDeepSpeechSessionJournal();
+
+	/** Whether new sessions should keep a journal, TensorVox.Journal. */
+	static bool IsEnabled();
+
+	/** Maps a new journal for the session, nullptr if the file couldn't be created or doesn't fit the journals' disk budget. */
+	static TSharedPtr<FDeepSpeechSessionJournal, ESPMode::ThreadSafe> Create(int32 SessionId, const FDeepSpeechConfiguration& Config);
+
+	/**
+	 * Thread safe, like every Add. A block of the frames in First and Second, as they sit in the capture buffer, and NumDropped more frames
+	 * that didn't fit in it.
+	 * @param ArrivalTime FPlatformTime::Seconds() the block came in at.
+	 */
+	void AddBlock(double ArrivalTime, TArrayView<const int16> First, TArrayView<const int16> Second, bool bDeviceOverflow, int32 NumDropped);
+	void AddVad(bool bVoiced);
+	/** The recorder started, with blocks coming in at SampleRate laid out as FrameLayout says. */
+	void AddStart(int32 SampleRate, const FDeepSpeechFrontEndSettings& FrameLayout);
+	void AddEnd();
+	void AddResult(FStringView Text, bool bFinal);
+
+	const FString& GetPath() const { return Path; }
+
+private:
+	FDeepSpeechSessionJournal();
+
+	bool Open(const FString& InPath, int64 RingBytes, int32 SessionId, const FDeepSpeechConfiguration& Config);
+	void Close();
+	/** Writes one record out of up to three payload parts, overwriting the oldest records to make room. Call with Critical held. */
+	void Append(EDeepSpeechJournalRecord Type, uint16 Flags, double Time, TArrayView<const uint8> Payload, TArrayView<const uint8> Payload2 = {},
+	            TArrayView<const uint8> Payload3 = {});
+	/** Drops the oldest records until the ring has room up to NewHead. */
+	void TrimTo(uint64 NewHead);
+
+	FString Path;
+	double StartTime;
+
+	FCriticalSection Critical;
+	// The whole file: header, then the ring of records.
+	uint8* Memory;
+	int64 FileBytes;
+	// Mapping handles, whatever the platform needs to undo the mapping.
+	void* FileHandle;
+	void* MappingHandle;
+	// Used instead of a mapping where the platform has none, written out on Close.
+	TArray<uint8> FallbackMemory;
+};
+
+typedef TSharedPtr<FDeepSpeechSessionJournal, ESPMode::ThreadSafe> FDeepSpeechSessionJournalPtr;
+
+/** A journal read back, split into what happened between each transcription start and end. */
+struct UETENSORVOX_API FDeepSpeechJournalContents
+{
+	struct FBlock
+	{
+		// Seconds since the session started.
+		double StreamTime = 0.0;
+		bool bDeviceOverflow = false;
+		int32 NumDropped = 0;
+		// Interleaved as the utterance's FrameLayout says.
+		TArray<uint8> Frames;
+		int32 NumFrames = 0;
+	};
+
+	struct FUtterance
+	{
+		double StartTime = 0.0;
+		double EndTime = 0.0;
+		int32 SampleRate = 0;
+		FDeepSpeechFrontEndSettings FrameLayout;
+		TArray<FBlock> Blocks;
+		int32 NumVadFrames = 0;
+		int32 NumVoicedFrames = 0;
+		int32 NumIntermediates = 0;
+		TArray<FString> Finals;
+	};
+
+	int32 SessionId = 0;
+	FDeepSpeechConfiguration Config;
+	// Oldest first. The first one may have started before the oldest record left in the journal.
+	TArray<FUtterance> Utterances;
+
+	/**
+	 * False with OutError saying why if the file isn't a journal, or as soon as a record runs past the ring or the head or is too short for
+	 * what it says it holds. Nothing past a bad record can be trusted.
+	 */
+	static bool Load(const FString& Path, FDeepSpeechJournalContents& OutContents, FString& OutError);
+};
+
+/**
+ * Plays a journal's capture blocks back exactly as they were captured, block sizes and overflow flags included, as fast as the sink
+ * takes them. Every Start plays the next utterance.
+ */
+class UETENSORVOX_API FDeepSpeechJournalAudioSource : public IDeepSpeechAudioSource, public FRunnable
+{
+public:
+	explicit FDeepSpeechJournalAudioSource(const TSharedRef<const FDeepSpeechJournalContents, ESPMode::ThreadSafe>& InContents);
+	virtual ~FDeepSpeechJournalAudioSource() override;
+
+	virtual bool Open(int32 PreferredSampleRate, int32 BlockSize) override;
+	virtual bool Start(IDeepSpeechAudioSink& InSink) override;
+	virtual void Stop() override;
+	virtual int32 GetSampleRate() const override { return SampleRate; }
+	virtual FDeepSpeechFrontEndSettings GetFrameLayout() const override;
+	virtual bool IsFinished() const override { return bFinished; }
+	virtual const TCHAR* GetName() const override { return TEXT("Journal"); }
+
+	// FRunnable
+	virtual uint32 Run() override;
+
+	/** Utterance the last Start played, INDEX_NONE before the first. */
+	int32 GetUtteranceIndex() const { return UtteranceIndex; }
+	/** Frames of the current utterance handed to the sink so far. */
+	int64 GetNumDelivered() const { return NumDelivered.load(std::memory_order_relaxed); }
+
+private:
+	TSharedRef<const FDeepSpeechJournalContents, ESPMode::ThreadSafe> Contents;
+	std::atomic<int32> UtteranceIndex;
+	int32 SampleRate;
+	IDeepSpeechAudioSink* Sink;
+	FRunnableThread* Thread;
+	std::atomic<bool> bRunning;
+	std::atomic<bool> bFinished;
+	std::atomic<int64> NumDelivered;
+};
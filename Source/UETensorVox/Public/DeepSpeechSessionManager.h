@@ -0,0 +1,88 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "DeepSpeechTranscriptionSession.h"
+#include "DeepSpeechFinalizationPool.h"
+#include "DeepSpeechLoadGovernor.h"
+#include <atomic>
+
+typedef TSharedPtr<FDeepSpeechTranscriptionSession, ESPMode::ThreadSafe> FDeepSpeechSessionPtr;
+
+/**
+ * Multiplexes every transcription session in the process over a small pool of worker threads.
+ * Sessions with the same model configuration share one loaded model, so N sessions cost roughly one model of memory.
+ */
+class UETENSORVOX_API FDeepSpeechSessionManager
+{
+public:
+	FDeepSpeechSessionManager();
+	~FDeepSpeechSessionManager();
+
+	/** Shortcut to the module's manager. */
+	static FDeepSpeechSessionManager& Get();
+
+	/**
+	 * Creates a new session, the model is loaded on a worker the first time the session ticks.
+	 * @param OnTranscribed Fired on a worker thread for every result of the session.
+	 * @param SourceFactory Makes what the session records from, FDeepSpeechAudioSources::CreateDefault if unset.
+	 * @param OnResult If bound, the session decodes with metadata and delivers Config.NumCandidates candidates with token timings through it.
+	 */
+	FDeepSpeechSessionPtr OpenSession(const FDeepSpeechConfiguration& Config, FOnDeepSpeechTranscribed OnTranscribed,
+	                                  FDeepSpeechAudioSourceFactory SourceFactory = nullptr, FOnDeepSpeechResult OnResult = FOnDeepSpeechResult());
+
+	/** Ends any utterance in flight and lets go of the session once a worker shut it down. */
+	void CloseSession(const FDeepSpeechSessionPtr& Session);
+
+	/** Makes a worker tick the session as soon as possible. Cheap enough for the capture thread, only signals if the session wasn't woken yet. */
+	void WakeSession(FDeepSpeechTranscriptionSession& Session);
+
+	/** Shuts down every session and joins the workers. */
+	void Shutdown();
+
+	int32 GetNumSessions() const;
+	int32 GetNumWorkers() const { return WorkerThreads.Num(); }
+
+	/** FPlatformTime cycles the workers spent ticking sessions, all of them together, since they started. */
+	uint64 GetBusyCycles() const { return BusyCycles.load(std::memory_order_relaxed); }
+
+	/** Finishes the utterances of every session. */
+	FDeepSpeechFinalizationPool& GetFinalizationPool() { return FinalizationPool; }
+
+	/** Picks the beam width and intermediate decode rate of every session from the measured load. */
+	FDeepSpeechLoadGovernor& GetLoadGovernor() { return LoadGovernor; }
+
+private:
+	class FWorker : public FRunnable
+	{
+	public:
+		explicit FWorker(FDeepSpeechSessionManager& InManager) : Manager(InManager) {}
+		virtual uint32 Run() override;
+	private:
+		FDeepSpeechSessionManager& Manager;
+	};
+
+	void StartWorkers();
+	void WorkerLoop();
+
+	/** Picks the next session that was woken, round robin so every session gets its turn. */
+	FDeepSpeechSessionPtr ClaimNextSession();
+	void ReleaseSession(const FDeepSpeechSessionPtr& Session);
+
+	mutable FCriticalSection SessionsCritical;
+	TArray<FDeepSpeechSessionPtr> Sessions;
+	int32 NextSessionIndex;
+	int32 NextSessionId;
+
+	TArray<TUniquePtr<FWorker>> Workers;
+	TArray<FRunnableThread*> WorkerThreads;
+	std::atomic<int32> NumRunningWorkers;
+	std::atomic<bool> bRunning;
+	std::atomic<uint64> BusyCycles;
+	FEvent* WakeEvent;
+
+	FDeepSpeechFinalizationPool FinalizationPool;
+	FDeepSpeechLoadGovernor LoadGovernor;
+};
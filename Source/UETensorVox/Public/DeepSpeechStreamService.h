@@ -0,0 +1,93 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechSessionManager.h"
+#include "DeepSpeechAudioSource.h"
+#include <atomic>
+
+/** One stream of a FDeepSpeechStreamService, pushed to by whoever owns the audio. */
+class UETENSORVOX_API FDeepSpeechServiceStream
+{
+public:
+	FDeepSpeechServiceStream(const FDeepSpeechSessionPtr& InSession, const TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe>& InSource);
+
+	/** Thread safe. Mono 16 bit audio at the stream's sample rate, in blocks of any size. */
+	void PushAudio(const int16* Samples, int32 NumSamples);
+
+	/** Thread safe. Seconds of pushed audio the session hasn't got to yet. */
+	float GetLagSeconds() const;
+
+	int32 GetSessionId() const { return Session->GetSessionId(); }
+	int32 GetSampleRate() const { return Source->GetSampleRate(); }
+	int64 GetNumPushed() const { return NumPushed.load(std::memory_order_relaxed); }
+
+private:
+	friend class FDeepSpeechStreamService;
+
+	FDeepSpeechSessionPtr Session;
+	TSharedRef<FDeepSpeechPushAudioSource, ESPMode::ThreadSafe> Source;
+	std::atomic<int64> NumPushed;
+};
+
+typedef TSharedPtr<FDeepSpeechServiceStream, ESPMode::ThreadSafe> FDeepSpeechServiceStreamPtr;
+
+struct FDeepSpeechServiceStreamStats
+{
+	int32 SessionId = 0;
+	float LagSeconds = 0.0f;
+	double PushedSeconds = 0.0;
+};
+
+/**
+ * Transcribes many independent streams of audio pushed from code, like every player's voice chat on a dedicated server.
+ * Every stream is a session of the shared FDeepSpeechSessionManager with its own StreamingState, endpointed by its voice detector,
+ * so they share one loaded model and the worker pool, which takes turns between streams a time slice at a time
+ * (TensorVox.TimeSliceMilliseconds). New streams are turned away while the workers are saturated or streams fall behind.
+ */
+class UETENSORVOX_API FDeepSpeechStreamService
+{
+public:
+	/** Every stream is transcribed with InConfig, with automatic endpointing always on since there's no one to press a button. */
+	explicit FDeepSpeechStreamService(const FDeepSpeechConfiguration& InConfig);
+	~FDeepSpeechStreamService();
+
+	/**
+	 * Starts transcribing a new stream. Audio pushed before the model is loaded on the stream's first tick is thrown away.
+	 * @param SampleRate Rate the audio is pushed at, converted to the model's.
+	 * @param OnTranscribed Fired on a worker thread for every result of the stream.
+	 * @return nullptr if admission control turned the stream away, see GetAdmissionRefusal.
+	 */
+	FDeepSpeechServiceStreamPtr OpenStream(int32 SampleRate, FOnDeepSpeechTranscribed OnTranscribed, FOnDeepSpeechResult OnResult = FOnDeepSpeechResult());
+
+	/** Lets go of the stream, an utterance still in flight is dropped. Audio pushed to it from then on is thrown away. */
+	void CloseStream(const FDeepSpeechServiceStreamPtr& Stream);
+	void CloseAllStreams();
+
+	/** Why a stream opened now would be turned away, nullptr if it would be admitted. */
+	const TCHAR* GetAdmissionRefusal();
+
+	/** Share of the workers' time spent ticking sessions lately, smoothed over a second or so. */
+	float GetUtilization();
+
+	int32 GetNumStreams() const;
+	int32 GetNumRejected() const { return NumRejected; }
+	void GetStreamStats(TArray<FDeepSpeechServiceStreamStats>& OutStats) const;
+
+	void DumpToLog();
+
+private:
+	void UpdateUtilization();
+
+	FDeepSpeechConfiguration Config;
+
+	mutable FCriticalSection StreamsCritical;
+	TArray<FDeepSpeechServiceStreamPtr> Streams;
+	std::atomic<int32> NumRejected;
+
+	// Worker time sampled over at least UtilizationSampleSeconds, guarded by StreamsCritical.
+	uint64 LastBusyCycles;
+	double LastSampleTime;
+	float Utilization;
+};
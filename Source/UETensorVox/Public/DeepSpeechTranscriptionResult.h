@@ -0,0 +1,92 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechUtteranceTimings.h"
+
+struct Metadata;
+
+/** One character, or piece of one, of a candidate with when the model emitted it. */
+struct FDeepSpeechToken
+{
+	// Into the candidate's text.
+	int32 TextOffset;
+	int32 TextLength;
+	// Model step (20 ms) the token was emitted at, and the same in seconds from the start of the stream.
+	int32 Timestep;
+	float StartTime;
+};
+
+struct FDeepSpeechCandidate
+{
+	// Into the result's text arena.
+	int32 TextOffset;
+	int32 TextLength;
+	// Into the result's tokens.
+	int32 FirstToken;
+	int32 NumTokens;
+	// Sum of the acoustic model's logit values for the candidate, higher is better. Only comparable within one result.
+	double Confidence;
+};
+
+/**
+ * N-best transcription of a stream with per token timings. Every candidate's text lives in one arena and its tokens in one flat array,
+ * so refilling a result reuses their allocations. Results come from a FDeepSpeechResultPool and go back to it once released.
+ */
+class UETENSORVOX_API FDeepSpeechTranscriptionResult
+{
+public:
+	/** Replaces the content with DeepSpeech's metadata, keeping the allocations. */
+	void Fill(const Metadata& InMetadata, bool bInFinal);
+
+	/** Empties the result, keeping the allocations. */
+	void Reset(bool bInFinal);
+
+	bool IsFinal() const { return bFinal; }
+	int32 GetNumCandidates() const { return Candidates.Num(); }
+	const FDeepSpeechCandidate& GetCandidate(int32 Index) const { return Candidates[Index]; }
+
+	/** Empty if there are no candidates. */
+	FStringView GetBestText() const { return Candidates.Num() > 0 ? GetText(Candidates[0]) : FStringView(); }
+
+	FStringView GetText(const FDeepSpeechCandidate& Candidate) const { return FStringView(*Text + Candidate.TextOffset, Candidate.TextLength); }
+	TArrayView<const FDeepSpeechToken> GetTokens(const FDeepSpeechCandidate& Candidate) const { return TArrayView<const FDeepSpeechToken>(Tokens).Slice(Candidate.FirstToken, Candidate.NumTokens); }
+	FStringView GetTokenText(const FDeepSpeechCandidate& Candidate, const FDeepSpeechToken& Token) const
+	{
+		return FStringView(*Text + Candidate.TextOffset + Token.TextOffset, Token.TextLength);
+	}
+
+	/** Where the utterance's time went. Complete up to the delivery side on final results. */
+	FDeepSpeechUtteranceTimings Timings;
+
+private:
+	FString Text;
+	TArray<FDeepSpeechToken> Tokens;
+	TArray<FDeepSpeechCandidate> Candidates;
+	bool bFinal = false;
+};
+
+typedef TSharedPtr<const FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe> FDeepSpeechResultPtr;
+
+/**
+ * Recycles results between decodes. A result is free again once every reference handed out is gone, so after the first few decodes
+ * of a session filling and delivering results doesn't allocate. Thread safe.
+ */
+class UETENSORVOX_API FDeepSpeechResultPool
+{
+public:
+	/** A result nobody else references, reused if one is free. */
+	TSharedRef<FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe> Acquire();
+
+	int32 GetNumResults() const;
+
+private:
+	mutable FCriticalSection Critical;
+	TArray<TSharedRef<FDeepSpeechTranscriptionResult, ESPMode::ThreadSafe>> Results;
+};
+
+typedef TSharedPtr<FDeepSpeechResultPool, ESPMode::ThreadSafe> FDeepSpeechResultPoolPtr;
+
+/** Fired on a worker thread with the metadata of every intermediate and final transcription, when a session asks for candidates. */
+DECLARE_DELEGATE_OneParam(FOnDeepSpeechResult, const FDeepSpeechResultPtr& /*Result*/);
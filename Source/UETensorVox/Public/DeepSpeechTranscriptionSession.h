@@ -0,0 +1,189 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "DeepSpeechConfiguration.h"
+#include "DeepSpeechModel.h"
+#include "DeepSpeechDecodeScheduler.h"
+#include "DeepSpeechEndpointer.h"
+#include "DeepSpeechNoiseFloor.h"
+#include "DeepSpeechRingBuffer.h"
+#include "DeepSpeechAudioSource.h"
+#include "DeepSpeechUtteranceTimings.h"
+#include "DeepSpeechVoiceDetector.h"
+#include "DeepSpeechTranscriptionResult.h"
+#include "DeepSpeechCaptureWriter.h"
+#include "DeepSpeechSessionJournal.h"
+#include "DeepSpeechCommandSpotter.h"
+#include "UETensorVox.h"
+#include <atomic>
+
+class FDeepSpeechMicrophoneRecorder;
+class FDeepSpeechSessionManager;
+struct StreamingState;
+
+/**
+ * Fired on a worker thread for every intermediate and final transcription of a session.
+ * Finals are fired for every finished utterance, even ones that came out empty. Timings are complete up to the delivery side on finals,
+ * and cover the utterance so far on intermediates.
+ */
+DECLARE_DELEGATE_ThreeParams(FOnDeepSpeechTranscribed, const FString& /*Transcription*/, bool /*bFinal*/, const FDeepSpeechUtteranceTimings& /*Timings*/);
+
+/**
+ * One independent transcription, usually owned by a UAudioTranscriberComponent.
+ * Owns its own audio source, VAD and StreamingState, and shares the model with every other session using the same configuration.
+ * Sessions are ticked by the FDeepSpeechSessionManager worker pool, never by more than one worker at a time.
+ */
+class UETENSORVOX_API FDeepSpeechTranscriptionSession : public TSharedFromThis<FDeepSpeechTranscriptionSession, ESPMode::ThreadSafe>
+{
+public:
+	FDeepSpeechTranscriptionSession(FDeepSpeechSessionManager& InManager, int32 InSessionId, const FDeepSpeechConfiguration& InConfig,
+	                                FOnDeepSpeechTranscribed InOnTranscribed, FDeepSpeechAudioSourceFactory InSourceFactory = nullptr,
+	                                FOnDeepSpeechResult InOnResult = FOnDeepSpeechResult());
+	~FDeepSpeechTranscriptionSession();
+
+	/** Thread safe. Starts (or ends) an utterance on the session's next tick. */
+	void SetTranscriptionRequested(bool bRequested);
+
+	/** Thread safe. The session is shut down and dropped by the manager on its next tick. */
+	void RequestClose();
+
+	/**
+	 * Thread safe. Replaces the words the decoder favours, by boost. Taken up by the next utterance, the one in progress keeps its set.
+	 * Any number of calls between two utterances costs one update, applied without reloading the model.
+	 */
+	void SetHotWords(FDeepSpeechHotWords InHotWords);
+
+	/** Thread safe. Adds or reboosts Add and drops Remove in one batch, like SetHotWords. */
+	void UpdateHotWords(const FDeepSpeechHotWords& Add, const TArray<FString>& Remove);
+
+	/**
+	 * Thread safe. Spots Grammar's commands in the intermediate transcriptions of every utterance from the next one on, and fires
+	 * OnCommand on the worker for each as soon as it's heard. A null grammar stops spotting.
+	 */
+	void SetCommands(FDeepSpeechCommandGrammarPtr Grammar, FOnDeepSpeechCommand InOnCommand);
+
+	int32 GetSessionId() const { return SessionId; }
+
+	/** True if the model couldn't be loaded, the session won't do anything anymore. */
+	bool HasFailed() const { return bFailed; }
+
+	const FDeepSpeechConfiguration& GetConfiguration() const { return Config; }
+
+	/**
+	 * Thread safe. Samples the audio source delivered since recording started that the session is done with, read or dropped, as of
+	 * its last tick. Behind what the source delivered by however far the session lags.
+	 */
+	int64 GetNumSamplesHandled() const { return NumSamplesHandled.load(std::memory_order_relaxed); }
+
+protected:
+	friend class FDeepSpeechSessionManager;
+
+	// Worker side, only ever called by the worker that claimed the session.
+	void Tick();
+	void Shutdown();
+
+	bool Initialize();
+	void ProcessCapturedAudio(double SliceEndTime, bool& bOutFedVoiceData, bool& bOutYielded);
+	void ProcessEndpointingFrame(const int16* Frame, bool bVoiced, bool& bOutFedVoiceData);
+	void QueueFrame(const int16* Frame, bool bVoiced, bool& bOutFedVoiceData);
+	void FlushPendingFeed(bool& bOutFedVoiceData);
+	void IntermediateDecode();
+	void IntermediateDecodeWithMetadata();
+	/** Fires the commands heard in the newest hypothesis, or settles the rest once the utterance ended. Ends the stream if configured to. */
+	void SpotCommands(FStringView Hypothesis, bool bUtteranceEnded);
+	void ReportDecodeTimings();
+	/** False if the audio source couldn't be started, it's tried again the next time the session ticks with transcription still requested. */
+	bool BeginUtterance();
+	void EndUtterance();
+	void OpenStream();
+	void EndStream();
+	void FinalizeStream();
+
+	FDeepSpeechSessionManager& Manager;
+	const int32 SessionId;
+	const FDeepSpeechConfiguration Config;
+	FOnDeepSpeechTranscribed OnTranscribed;
+	FDeepSpeechAudioSourceFactory SourceFactory;
+	// Set if the session decodes with metadata, results are filled from ResultPool.
+	FOnDeepSpeechResult OnResult;
+	FDeepSpeechResultPoolPtr ResultPool;
+
+	FThreadSafeBool bTranscribeRequested;
+	// FPlatformTime::Seconds() transcription was last requested at.
+	std::atomic<double> RequestTime;
+	bool bLastRequestTranscribe;
+	bool bInitialized;
+	FThreadSafeBool bFailed;
+
+	FDeepSpeechModelPtr Model;
+	TUniquePtr<FDeepSpeechMicrophoneRecorder> Recorder;
+	// The recorder runs for the session's lifetime with its gate opened per utterance, Config.bPersistentCapture if the source could be kept open.
+	bool bPersistentCapture;
+	// When the recorder started or its gate opened, until the first frame after it was read.
+	double GateOpenTime;
+	bool bAwaitingFirstSample;
+	float LookbackSeconds;
+	FDeepSpeechVoiceDetector VoiceDetector;
+	StreamingState* StreamState;
+	// The finalization queue was full, StreamState stays open for the next utterance or until there's room.
+	bool bStreamCarried;
+
+	// One model step, the unit audio is read, voice detected and fed in.
+	int32 FrameSamples;
+	// Voiced frames waiting to be fed in a single call, at most FeedChunkSamples.
+	TAlignedSignedInt16Array PendingFeed;
+	int32 FeedChunkSamples;
+	double PendingFeedArrivalTime;
+
+	// Where the current utterance's time went so far, handed to the finalization pool with its stream.
+	FDeepSpeechUtteranceTimings Timings;
+	int32 NumFeeds;
+	double QueueWaitSum;
+
+	FDeepSpeechDecodeScheduler DecodeScheduler;
+
+	// With automatic endpointing, splits what the session hears into utterances.
+	FDeepSpeechEndpointer Endpointer;
+	// The most recent audio while waiting for speech, fed ahead of the onset.
+	TDeepSpeechRingBuffer<int16> PreRoll;
+
+	// What the next stream decodes with, guarded by HotWordsCritical, and what the current one does.
+	FCriticalSection HotWordsCritical;
+	FDeepSpeechHotWords PendingHotWords;
+	bool bHotWordsChanged;
+	FDeepSpeechHotWords HotWords;
+
+	// The commands the next utterance is spotted for, guarded by HotWordsCritical too, and the current one's.
+	FDeepSpeechCommandGrammarPtr PendingCommandGrammar;
+	FOnDeepSpeechCommand PendingOnCommand;
+	bool bCommandsChanged;
+	FDeepSpeechCommandGrammarPtr CommandGrammar;
+	FOnDeepSpeechCommand OnCommand;
+	FDeepSpeechCommandSpotter CommandSpotter;
+	TArray<FDeepSpeechCommandMatch> CommandMatches;
+
+	// Everything the VAD didn't hear a voice in, streams are padded with it on both ends.
+	FDeepSpeechNoiseFloor NoiseFloor;
+	int32 LeadPaddingSamples;
+	int32 TrailPaddingSamples;
+
+	// This session's share of FDeepSpeechPipelineStats::NumQueuedSamples.
+	int32 NumReportedQueuedSamples;
+	std::atomic<int64> NumSamplesHandled;
+
+	// Everything the session went through, with TensorVox.Journal on when it started.
+	FDeepSpeechSessionJournalPtr Journal;
+
+	// Utterances started so far, numbers the captures.
+	int32 NumUtterances;
+	// What the current utterance was fed, with TensorVox.Capture on. Handed to the finalization pool with the stream for the transcript.
+	FDeepSpeechCaptureUtterancePtr Capture;
+
+	// Scheduling state, owned by the manager.
+	std::atomic<bool> bClaimed;
+	std::atomic<bool> bWakeRequested;
+	std::atomic<bool> bCloseRequested;
+};
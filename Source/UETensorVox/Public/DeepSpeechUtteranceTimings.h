@@ -0,0 +1,107 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechUtteranceTimings.generated.h"
+
+/**
+ * Where the time of one utterance went, from its audio being captured to its final transcription reaching the game thread.
+ * Timestamps are FPlatformTime::Seconds(), taken when each capture block arrived, and carried along with the audio.
+ */
+USTRUCT(BlueprintType)
+struct UETENSORVOX_API FDeepSpeechUtteranceTimings
+{
+	GENERATED_BODY()
+public:
+	/** Which utterance of its session this is, from 1. Partials and the final of one utterance share it. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere)
+	int32 UtteranceId = 0;
+
+	/** Decoder beam width the utterance's stream was created with, narrower than configured when TensorVox.Governor stepped in. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere)
+	int32 BeamWidth = 0;
+
+	/**
+	 * Transcription being requested to the first audio of the utterance being there to read: the device starting up unless capture is
+	 * persistent. 0 with automatic endpointing, where utterances don't start with a request.
+	 */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float PressToFirstSampleMs = 0.0f;
+
+	/** Audio from before the request the utterance starts with, persistent capture's lookback. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float LookbackMs = 0.0f;
+
+	/** Voiced audio fed into the stream. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="s"))
+	float AudioSeconds = 0.0f;
+
+	/** Capture to feed, the average and worst wait of captured audio for a worker. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float QueueWaitAverageMs = 0.0f;
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float QueueWaitMaxMs = 0.0f;
+
+	/** Spent in DS_FeedAudioContent, acoustic model included. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float FeedMs = 0.0f;
+
+	/** The part of FeedMs spent on lead and trail padding. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float PaddingMs = 0.0f;
+
+	/** Spent in intermediate decodes. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float DecodeMs = 0.0f;
+
+	/** The newest voiced audio being captured to the utterance being handed to the finalization pool. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float EndpointMs = 0.0f;
+
+	/** Waiting for a finalization thread. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float FinishQueueMs = 0.0f;
+
+	/** Spent in DS_FinishStream. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float FinishMs = 0.0f;
+
+	/** Finished transcription to it being delivered, the game thread hop for components. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float DeliveryMs = 0.0f;
+
+	/** The newest voiced audio being captured to the final transcription being delivered. What the player waits for after talking. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float EndToFinalMs = 0.0f;
+
+	/**
+	 * The newest voiced audio being captured to the utterance's first command firing, negative if it fired while the speaker was still
+	 * talking. 0 without one. Compare with EndToFinalMs for what spotting commands saves.
+	 */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float EndToCommandMs = 0.0f;
+
+	/** The first command firing to the final transcription being finished. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere, meta=(Units="ms"))
+	float CommandLeadMs = 0.0f;
+
+	/** Feed, decode and finish time over the audio length, below 1 keeps up with real time. */
+	UPROPERTY(Category="DeepSpeech Utterance Timings", BlueprintReadOnly, VisibleAnywhere)
+	float RealTimeFactor = 0.0f;
+
+	// Raw timestamps the durations above come from.
+	double FirstCaptureTime = 0.0;
+	double LastCaptureTime = 0.0;
+	double EndpointTime = 0.0;
+	double FinishStartTime = 0.0;
+	double DispatchTime = 0.0;
+	double CommandTime = 0.0;
+
+	/** Fills in the delivery side once the result arrived where it was going. */
+	void MarkDelivered(double DeliveredTime)
+	{
+		DeliveryMs = (DeliveredTime - DispatchTime) * 1000.0;
+		EndToFinalMs = LastCaptureTime > 0.0 ? (DeliveredTime - LastCaptureTime) * 1000.0 : 0.0f;
+	}
+};
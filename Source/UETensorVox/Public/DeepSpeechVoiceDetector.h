@@ -0,0 +1,100 @@
+// Copyright SIA Chemical Heads 2022
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "DeepSpeechConfiguration.h"
+
+struct WebRtcVadInst;
+
+/**
+ * Voice activity detector that runs anywhere, for platforms without WebRTC and for builds that want the same decisions everywhere.
+ * Looks at the frame's energy over an adaptive noise floor, and vetoes loud frames that look like noise: many zero crossings and a flat
+ * spectrum. Features are computed with the engine's 4 wide vector registers using separate multiplies and adds, and logs come straight
+ * from the float bits, so every platform arrives at the same decision bit for bit.
+ */
+class UETENSORVOX_API FDeepSpeechBuiltinVad
+{
+public:
+	struct FFeatures
+	{
+		float EnergyDb = 0.0f;
+		float NoiseFloorDb = 0.0f;
+		// Sign changes per sample.
+		float ZeroCrossingRate = 0.0f;
+		// Geometric over arithmetic mean of the speech band power spectrum, in log2. 0 is white noise, speech sits well below.
+		float SpectralFlatnessLog2 = 0.0f;
+	};
+
+	FDeepSpeechBuiltinVad();
+
+	/** Aggressiveness 0 to 3, like WebRTC's modes. Frames are always FrameSamples long. */
+	void Initialize(int32 InSampleRate, int32 InFrameSamples, int32 Aggressiveness);
+
+	/** Forgets the noise floor and hangover. */
+	void Reset();
+
+	bool ProcessFrame(const int16* Frame);
+
+	const FFeatures& GetLastFeatures() const { return Features; }
+
+private:
+	void ComputeSpectrum();
+
+	int32 SampleRate;
+	int32 FrameSamples;
+	int32 FftSize;
+	// Speech band, in bins, rounded out to whole vector registers.
+	int32 FirstBin;
+	int32 NumBins;
+
+	float MarginDb;
+	float FlatnessThresholdLog2;
+	float ZeroCrossingThreshold;
+	int32 HangoverFrames;
+
+	// Frame as floats, padded with zeros to FftSize plus a register so neighbours can be loaded past the end.
+	TArray<float, TAlignedHeapAllocator<16>> Samples;
+	TArray<float> Window;
+	TArray<int32> BitReverse;
+	// Split complex FFT buffers and twiddles, stage with half size H uses entries H to 2H - 1.
+	TArray<float, TAlignedHeapAllocator<16>> Real;
+	TArray<float, TAlignedHeapAllocator<16>> Imag;
+	TArray<float, TAlignedHeapAllocator<16>> TwiddleReal;
+	TArray<float, TAlignedHeapAllocator<16>> TwiddleImag;
+	TArray<float, TAlignedHeapAllocator<16>> Power;
+
+	// Frames seen while warming up the noise floor, stops counting after.
+	int32 NumFrames;
+	int32 HangoverLeft;
+	FFeatures Features;
+};
+
+/** Whichever voice activity detector a configuration asks for, behind one interface. */
+class UETENSORVOX_API FDeepSpeechVoiceDetector
+{
+public:
+	FDeepSpeechVoiceDetector();
+	~FDeepSpeechVoiceDetector();
+
+	/** What actually runs for Detector on this platform. */
+	static EDeepSpeechVoiceDetector Resolve(EDeepSpeechVoiceDetector Detector);
+
+	/** Frames must be 10, 20 or 30 ms, which WebRTC needs. */
+	void Initialize(EDeepSpeechVoiceDetector InDetector, int32 Aggressiveness, int32 InSampleRate, int32 InFrameSamples);
+	void Shutdown();
+
+	bool IsInitialized() const { return bInitialized; }
+	EDeepSpeechVoiceDetector GetDetector() const { return Detector; }
+
+	/** True if the frame has a voice in it. Errors count as voice, so a special microphone lets everything through instead of nothing. */
+	bool ProcessFrame(const int16* Frame);
+
+private:
+	bool bInitialized;
+	EDeepSpeechVoiceDetector Detector;
+	int32 SampleRate;
+	int32 FrameSamples;
+	WebRtcVadInst* WebRtcInstance;
+	FDeepSpeechBuiltinVad Builtin;
+};
@@ -2,10 +2,25 @@
 
 #pragma once
 
+#include "Modules/ModuleManager.h"
+#include "Containers/Ticker.h"
+#include "Stats/Stats.h"
+
 UETENSORVOX_API typedef TArray<int16> TAlignedSignedInt16Array;
 DECLARE_LOG_CATEGORY_EXTERN(LogUETensorVox, Log, All);
+DECLARE_STATS_GROUP(TEXT("TensorVox"), STATGROUP_TensorVox, STATCAT_Advanced);
+
+// Dedicated servers transcribe too, they just don't have a microphone.
+#define TENSORVOX_VALID_PLATFORM (PLATFORM_WINDOWS || PLATFORM_LINUX || PLATFORM_APPLE || PLATFORM_ANDROID || PLATFORM_PS4 || PLATFORM_XBOXONE)
 
-#define TENSORVOX_VALID_PLATFORM (PLATFORM_WINDOWS || PLATFORM_APPLE || PLATFORM_ANDROID || PLATFORM_PS4 || PLATFORM_XBOXONE) && !UE_SERVER
+// Set by the build where the engine's RtAudio capture module exists, the only place there's a microphone source.
+#ifndef TENSORVOX_WITH_RTAUDIO
+#define TENSORVOX_WITH_RTAUDIO 0
+#endif
+
+class FDeepSpeechSessionManager;
+class FDeepSpeechModelRegistry;
+class FDeepSpeechCaptureWriter;
 
 class FUETensorVoxModule : public IModuleInterface
 {
@@ -16,12 +31,40 @@ public:
 	virtual void ShutdownModule() override;
 	static bool HasAvx();
 
-	FORCEINLINE static bool CanRunTranscriber()
+	static FUETensorVoxModule& Get()
+	{
+		return FModuleManager::GetModuleChecked<FUETensorVoxModule>("UETensorVox");
+	}
+
+	/** Every transcription session in the process runs through this. */
+	FDeepSpeechSessionManager& GetSessionManager()
 	{
-		return HasAvx();
+		return *SessionManager;
 	}
 
-	void* DeepSpeechHandle;
+	/** Loaded models, shared by every session and kept around for a while after the last one is done with them. */
+	FDeepSpeechModelRegistry& GetModelRegistry()
+	{
+		return *ModelRegistry;
+	}
+
+	/** Writes captured utterances to disk when TensorVox.Capture is on. */
+	FDeepSpeechCaptureWriter& GetCaptureWriter()
+	{
+		return *CaptureWriter;
+	}
+
+	/** True once a libdeepspeech build the CPU can run was loaded. */
+	static bool CanRunTranscriber();
+
+	void* DeepSpeechHandle = nullptr;
+
+	FDeepSpeechSessionManager* SessionManager = nullptr;
+	FDeepSpeechModelRegistry* ModelRegistry = nullptr;
+	FDeepSpeechCaptureWriter* CaptureWriter = nullptr;
+
+	// Publishes the pipeline stats and CSV profiler columns once a frame.
+	FTSTicker::FDelegateHandle StatsTickerHandle;
 
 };
 
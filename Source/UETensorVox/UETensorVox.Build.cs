@@ -29,6 +29,8 @@ public class UETensorVox : ModuleRules
 			{
 				"AudioMixer",
 				"AudioPlatformConfiguration",
+				"Json",
+				"JsonUtilities",
 			}
 		);
 
@@ -42,20 +44,21 @@ public class UETensorVox : ModuleRules
 				}
 			);
 			AddEngineThirdPartyPrivateStaticDependencies(Target, "WebRTC");
+		}
+
+		// Only these have the engine's RtAudio module, the microphone source is compiled out everywhere else.
+		bool bWithRtAudio = Target.Platform.IsInGroup(UnrealPlatformGroup.Windows) || Target.Platform == UnrealTargetPlatform.Mac;
+		PrivateDefinitions.Add("TENSORVOX_WITH_RTAUDIO=" + (bWithRtAudio ? "1" : "0"));
 
+		if (bWithRtAudio)
+		{
+			PrivateDependencyModuleNames.Add("AudioCaptureRtAudio");
 			PrivateIncludePaths.AddRange(
 				new string[] {
 					Path.Combine(EngineDirectory, "Source", "Runtime", "AudioCaptureImplementations", "AudioCaptureRtAudio", "Private") // This is required to include RtAudio.h in AudioRecordingManager.h.
 				}
 			);
 		}
-		
-
-		if (Target.Platform.IsInGroup(UnrealPlatformGroup.Windows) ||
-		    Target.Platform == UnrealTargetPlatform.Mac)
-		{
-			PrivateDependencyModuleNames.Add("AudioCaptureRtAudio");
-		}
 		// else if (Target.Platform == UnrealTargetPlatform.PS4)
 		// {
 		// 	PrivateDependencyModuleNames.Add("AudioCaptureSony");